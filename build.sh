@@ -9,6 +9,23 @@ set -e
 # 設定
 EMSDK_DIR="$HOME/emsdk"
 PORT=8000
+RENDER_THREADS=4
+MT_INITIAL_MEMORY=268435456 # 256MB
+
+# wasm から公開する関数
+EXPORTS_BASE="'_generate_sound','_generate_sound_multi','_get_sample','_free_buffer','_malloc','_free'"
+EXPORTS_BASE="$EXPORTS_BASE,'_renderer_create','_renderer_destroy','_renderer_render','_renderer_render_to','_renderer_get_buffer','_renderer_get_buffer_length','_renderer_set_output_rate'"
+EXPORTS_BASE="$EXPORTS_BASE,'_renderer_set_buffer_format','_renderer_set_dither','_renderer_set_channel_mask','_renderer_set_engine'"
+EXPORTS_BASE="$EXPORTS_BASE,'_renderer_start','_renderer_start_from','_renderer_snapshot','_renderer_render_block_to'"
+EXPORTS_BASE="$EXPORTS_BASE,'_renderer_set_capture','_renderer_pack_capture','_unpack_render'"
+EXPORTS_BASE="$EXPORTS_BASE,'_profile_reset','_profile_report'"
+
+# OPM_PROFILE=1 ./build.sh で OPM_Clock のステージ別計測を入れる (profile_report() で表示)
+PROFILE_FLAGS=""
+if [ "${OPM_PROFILE:-0}" = "1" ]; then
+    PROFILE_FLAGS="-DOPM_PROFILE"
+fi
+EXPORTS_POOL="'_render_pool_start','_render_pool_submit','_render_pool_get_buffer','_render_pool_release','_render_pool_set_output_rate'"
 
 # 色付き出力
 RED='\033[0;31m'
@@ -212,6 +229,19 @@ load_emsdk_env() {
 # ビルド実行
 # =============================================================================
 
+# emcc 呼び出し (引数: 出力ファイル名 公開関数リスト [追加ソース・フラグ...])
+emcc_build() {
+    local output="$1"
+    local exports="$2"
+    shift 2
+    
+    emcc sine_test.c opm_renderer.c opm_resampler.c opm_codec.c opm_profile.c opm.c opm_simd.c opm_fast.c -O3 $PROFILE_FLAGS "$@" \
+      -s WASM=1 \
+      -s EXPORTED_FUNCTIONS="[$exports]" \
+      -s EXPORTED_RUNTIME_METHODS="['cwrap','getValue','HEAPU8','HEAP16','HEAPF32']" \
+      -o "$output"
+}
+
 build_project() {
     print_section "プロジェクトビルド"
     
@@ -222,30 +252,46 @@ build_project() {
         return 1
     fi
     
+    if [ ! -f "opm_renderer.c" ]; then
+        print_error "opm_renderer.c が見つからない"
+        return 1
+    fi
+    
     if [ ! -f "opm.c" ]; then
         print_error "opm.c が見つからない"
         return 1
     fi
     
-    print_info "コンパイル中..."
+    # スカラー版、wasm SIMD (simd128) 版、マルチスレッド版の3つを作る。
+    # どれを読み込むかは index.html が実行時に判定する
+    print_info "コンパイル中 (スカラー版)..."
+    if ! emcc_build sine_test.js "$EXPORTS_BASE" -s ALLOW_MEMORY_GROWTH=1; then
+        print_error "ビルドが失敗した"
+        return 1
+    fi
     
-    emcc sine_test.c opm.c -O3 \
-      -s WASM=1 \
-      -s EXPORTED_FUNCTIONS="['_generate_sound','_get_sample','_free_buffer','_malloc','_free']" \
-      -s EXPORTED_RUNTIME_METHODS="['cwrap','getValue','HEAPU8']" \
-      -o sine_test.js
+    print_info "コンパイル中 (SIMD版)..."
+    if ! emcc_build sine_test_simd.js "$EXPORTS_BASE" -msimd128 -s ALLOW_MEMORY_GROWTH=1; then
+        print_error "SIMD版のビルドが失敗した"
+        return 1
+    fi
     
-    if [ $? -ne 0 ]; then
-        print_error "ビルドが失敗した"
+    # マルチスレッド版 (SharedArrayBuffer が使える cross-origin isolated なページ用)
+    # pthreads とメモリ拡張の併用は JS 側のヒープビューが古くなるので、固定サイズで確保する
+    print_info "コンパイル中 (マルチスレッド版)..."
+    if ! emcc_build sine_test_mt.js "$EXPORTS_BASE,$EXPORTS_POOL" opm_render_pool.c -msimd128 -pthread \
+        -s PTHREAD_POOL_SIZE=$RENDER_THREADS -s INITIAL_MEMORY=$MT_INITIAL_MEMORY; then
+        print_error "マルチスレッド版のビルドが失敗した"
         return 1
     fi
     
     print_info "ビルド完了"
     
     # 成果物の確認
-    if [ -f "sine_test.js" ] && [ -f "sine_test.wasm" ]; then
+    if [ -f "sine_test.js" ] && [ -f "sine_test.wasm" ] && [ -f "sine_test_simd.js" ] && [ -f "sine_test_simd.wasm" ] \
+        && [ -f "sine_test_mt.js" ] && [ -f "sine_test_mt.wasm" ]; then
         print_info "成果物:"
-        ls -lh sine_test.js sine_test.wasm | awk '{print "  " $9 " (" $5 ")"}'
+        ls -lh sine_test.js sine_test.wasm sine_test_simd.js sine_test_simd.wasm sine_test_mt.js sine_test_mt.wasm | awk '{print "  " $9 " (" $5 ")"}'
     else
         print_error "成果物が見つからない"
         return 1
@@ -273,7 +319,8 @@ start_server() {
     print_info "サーバーを停止するには Ctrl+C を押せ"
     echo ""
     
-    python3 -m http.server "$PORT"
+    # マルチスレッド版には COOP/COEP ヘッダ (cross-origin isolation) が必要
+    python3 serve.py "$PORT"
 }
 
 # =============================================================================
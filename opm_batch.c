@@ -0,0 +1,150 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "opm_batch.h"
+
+// --- データ構造 ---
+
+// ワーカーごとの未処理ジョブ [head, tail)。
+// 持ち主は head から取り、盗む側は tail から取る
+typedef struct {
+    pthread_mutex_t lock;
+    int head;
+    int tail;
+} batch_deque_t;
+
+typedef struct batch batch_t;
+
+typedef struct {
+    batch_t *batch;
+    int id;
+    pthread_t thread;
+    int failed;
+} batch_worker_t;
+
+struct batch {
+    batch_deque_t *deques;
+    batch_worker_t *workers;
+    int num_workers;
+    opm_batch_job_fn job;
+    void *user;
+};
+
+
+// ============================================================
+// 1. Scheduling
+// ============================================================
+
+static int deque_pop_front(batch_deque_t *q) {
+    int index = -1;
+    pthread_mutex_lock(&q->lock);
+    if (q->head < q->tail) {
+        index = q->head++;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return index;
+}
+
+static int deque_pop_back(batch_deque_t *q) {
+    int index = -1;
+    pthread_mutex_lock(&q->lock);
+    if (q->head < q->tail) {
+        index = --q->tail;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return index;
+}
+
+// 自分の分を先に処理し、尽きたら隣から順にほかのワーカーの分を盗む。
+// ジョブが増えることはないので、一周して何もなければ終わり
+static int batch_next_job(batch_t *b, int self) {
+    int index = deque_pop_front(&b->deques[self]);
+    for (int k = 1; index < 0 && k < b->num_workers; k++) {
+        index = deque_pop_back(&b->deques[(self + k) % b->num_workers]);
+    }
+    return index;
+}
+
+static void *batch_worker_main(void *arg) {
+    batch_worker_t *w = (batch_worker_t *)arg;
+    batch_t *b = w->batch;
+
+    opm_renderer_t *renderer = opm_renderer_create();
+
+    int index;
+    while ((index = batch_next_job(b, w->id)) >= 0) {
+        if (!renderer || b->job(index, renderer, b->user) != 0) {
+            w->failed++;
+        }
+    }
+
+    opm_renderer_destroy(renderer);
+    return NULL;
+}
+
+
+// ============================================================
+// 2. Batch API
+// ============================================================
+
+int opm_batch_default_threads(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    if (n > OPM_BATCH_MAX_THREADS) n = OPM_BATCH_MAX_THREADS;
+    return (int)n;
+}
+
+int opm_batch_run(int num_jobs, int num_threads, opm_batch_job_fn job, void *user) {
+    if (num_jobs <= 0) return 0;
+    if (!job) return -1;
+
+    if (num_threads <= 0) num_threads = opm_batch_default_threads();
+    if (num_threads > OPM_BATCH_MAX_THREADS) num_threads = OPM_BATCH_MAX_THREADS;
+    if (num_threads > num_jobs) num_threads = num_jobs;
+
+    batch_t b;
+    b.num_workers = num_threads;
+    b.job = job;
+    b.user = user;
+    b.deques = (batch_deque_t *)calloc(num_threads, sizeof(batch_deque_t));
+    b.workers = (batch_worker_t *)calloc(num_threads, sizeof(batch_worker_t));
+    if (!b.deques || !b.workers) {
+        free(b.deques);
+        free(b.workers);
+        return -1;
+    }
+
+    // 連続した範囲で分けておく (隣り合うジョブは同じワーカーが処理しやすい)
+    for (int i = 0; i < num_threads; i++) {
+        pthread_mutex_init(&b.deques[i].lock, NULL);
+        b.deques[i].head = (int)((long long)num_jobs * i / num_threads);
+        b.deques[i].tail = (int)((long long)num_jobs * (i + 1) / num_threads);
+        b.workers[i].batch = &b;
+        b.workers[i].id = i;
+    }
+
+    // ワーカー 0 は呼び出し元のスレッドで動かす
+    int started = 1;
+    for (int i = 1; i < num_threads; i++) {
+        if (pthread_create(&b.workers[i].thread, NULL, batch_worker_main, &b.workers[i]) != 0) {
+            break;
+        }
+        started++;
+    }
+    // 起動できなかったワーカーの分は、動いているワーカーが盗んで処理する
+    batch_worker_main(&b.workers[0]);
+
+    int failed = b.workers[0].failed;
+    for (int i = 1; i < started; i++) {
+        pthread_join(b.workers[i].thread, NULL);
+        failed += b.workers[i].failed;
+    }
+
+    for (int i = 0; i < num_threads; i++) {
+        pthread_mutex_destroy(&b.deques[i].lock);
+    }
+    free(b.deques);
+    free(b.workers);
+    return failed;
+}
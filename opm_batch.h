@@ -0,0 +1,33 @@
+// バッチレンダリング用のワークスティーリング・スレッドプール
+//
+// 0 ～ num_jobs-1 のジョブを num_threads 本のワーカーで処理する。
+// 最初に各ワーカーへ連続した範囲を割り当て、自分の分が尽きたワーカーは
+// ほかのワーカーの残りを後ろから盗む。ワーカーごとに opm_renderer_t を
+// 1つ持ち、ジョブ間で使い回す (チップはワーカーごとに1つ)。
+#ifndef _OPM_BATCH_H_
+#define _OPM_BATCH_H_
+
+#include "opm_renderer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OPM_BATCH_MAX_THREADS 256
+
+// index 番目のジョブを renderer で処理する。成功時 0、失敗時 0 以外。
+// 複数のワーカーから同時に呼ばれる
+typedef int (*opm_batch_job_fn)(int index, opm_renderer_t *renderer, void *user);
+
+// すべてのジョブが終わるまで待つ。失敗したジョブの数を返す (起動できなければ -1)。
+// num_threads が 0 以下ならオンラインの CPU 数を使う
+int opm_batch_run(int num_jobs, int num_threads, opm_batch_job_fn job, void *user);
+
+// num_threads に 0 以下を渡したときに使われるスレッド数
+int opm_batch_default_threads(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
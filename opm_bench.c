@@ -0,0 +1,669 @@
+// エミュレータとレンダーループのベンチマーク
+//
+// Nuked OPM を更新したときや最適化を入れたときに速度の変化を追えるよう、
+// 次を測って JSON で書き出す。
+//   - OPM_Clock        : 8チャンネル発音中のチップを回したときのクロック数/秒
+//   - render_loop      : レンダラーの1サンプルのループ (64 クロック + 出力) のサンプル数/秒
+//   - OPM_Reset        : 1回あたりの時間
+//   - プリセット       : presets.json の全エントリを generate_sound と同じく
+//                        opm_renderer_render で鳴らしたときの実時間比
+//   - 合成した負荷     : 8チャンネル、LFO あり、ノイズあり、書き込みを詰め込んだ列
+//   - fast エンジン    : プリセットと合成した負荷を OPM_RENDERER_ENGINE_FAST でも鳴らし、
+//                        実時間比 (fast_*)、Nuked に対する速度比 (fast_speedup)、
+//                        Nuked の出力に対する SNR (fast_snr) を出す
+//   - SIMD エンジン    : OPM_SIMD_LANES 個の同じ負荷を opm_renderer_render_multi (opm_simd.c) で
+//                        まとめて鳴らした実時間比 (simd) と、1つずつ Nuked で鳴らしたときに対する
+//                        速度比 (simd_speedup)。出力が一致しなければ失敗にする。
+//                        ISA は -DOPM_SIMD_ARCH=sse4.1|avx2|native で変えられる
+//
+// どのケースも repeat 回測って最も速い回を採る。checksum は出力の値から作るので、
+// 計算が省かれていないことの確認と、エミュレータの出力が変わったことの目安になる。
+//
+//   opm-bench -i presets.json > bench.json
+//   opm-bench -i presets.json -t 5 -n 5 -o bench.json
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#include <getopt.h>
+#include "opm.h"
+#include "opm_renderer.h"
+#include "opm_events.h"
+#include "opm_profile.h"
+#include "opm_simd.h"
+
+#define OPM_CLOCK 3579545
+#define CLOCK_STEP 64
+#define RESET_ITERATIONS 2000
+#define BLOCK_FRAMES 4096
+// fast_snr の値。出力が Nuked と完全に一致したとき (JSON には inf を書けない)
+#define SNR_EXACT 999.0
+
+typedef struct {
+    const char *input;    // presets.json。NULL ならプリセットは測らない
+    const char *output;   // "-" は stdout
+    double seconds;       // 合成した負荷を鳴らす長さ
+    int repeat;
+    int quiet;
+} bench_options_t;
+
+// 1ケースの結果
+typedef struct {
+    char name[96];
+    const char *kind;     // "clock" / "render_loop" / "reset" / "preset" / "stress"
+                          // "fast_preset" / "fast_stress" / "fast_speedup" / "fast_snr"
+                          // "simd" / "simd_speedup"
+    const char *unit;     // value の単位
+    double value;         // 大きいほど速い (reset は小さいほど速い、fast_snr は大きいほど正確)
+    double seconds;       // 最速の回にかかった時間
+    double audio_seconds; // 鳴らした長さ (ないケースは 0)
+    uint32_t checksum;
+} bench_result_t;
+
+typedef struct {
+    bench_result_t *items;
+    int count;
+    int capacity;
+} bench_results_t;
+
+typedef struct {
+    opm_event_t *items;
+    int count;
+    int capacity;
+} event_list_t;
+
+
+// ============================================================
+// 1. Utilities
+// ============================================================
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// FNV-1a
+static uint32_t checksum_update(uint32_t hash, const void *data, size_t size) {
+    const uint8_t *p = (const uint8_t *)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+#define CHECKSUM_INIT 2166136261u
+
+static bench_result_t *results_add(bench_results_t *list, const char *kind, const char *name, const char *unit) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 32;
+        bench_result_t *items = (bench_result_t *)realloc(list->items, sizeof(bench_result_t) * capacity);
+        if (!items) return NULL;
+        list->items = items;
+        list->capacity = capacity;
+    }
+    bench_result_t *r = &list->items[list->count++];
+    memset(r, 0, sizeof(*r));
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->kind = kind;
+    r->unit = unit;
+    return r;
+}
+
+static int events_add(event_list_t *list, float time, uint8_t addr, uint8_t data) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 256;
+        opm_event_t *items = (opm_event_t *)realloc(list->items, sizeof(opm_event_t) * capacity);
+        if (!items) return -1;
+        list->items = items;
+        list->capacity = capacity;
+    }
+    opm_event_t *e = &list->items[list->count++];
+    memset(e, 0, sizeof(*e));
+    e->time = time;
+    e->addr = addr;
+    e->data = data;
+    return 0;
+}
+
+
+// ============================================================
+// 2. Synthetic Sequences
+// ============================================================
+
+typedef enum {
+    STRESS_LFO = 1,     // LFO で全チャンネルに PM / AM をかける
+    STRESS_NOISE = 2,   // チャンネル 7 のオペレーター 4 をノイズにする
+    STRESS_DENSE = 4    // 鳴らしている間、書ける速さで KC / TL を書き続ける
+} stress_flags_t;
+
+// 8チャンネルすべてに CON=4 (2つの FM ペア) の音色を設定してキーオンする
+static int build_stress(event_list_t *list, int flags, double seconds) {
+    int status = 0;
+
+    if (flags & STRESS_LFO) {
+        status |= events_add(list, 0.0f, 0x18, 0xC0);         // LFRQ
+        status |= events_add(list, 0.0f, 0x19, 0x7F);         // AMD
+        status |= events_add(list, 0.0f, 0x19, 0x80 | 0x40);  // PMD
+        status |= events_add(list, 0.0f, 0x1B, 0x02);         // 三角波
+    }
+    if (flags & STRESS_NOISE) {
+        status |= events_add(list, 0.0f, 0x0F, 0x80 | 0x10);
+    }
+
+    for (int ch = 0; ch < 8; ch++) {
+        status |= events_add(list, 0.0f, (uint8_t)(0x20 + ch), 0xC0 | (3 << 3) | 4);
+        status |= events_add(list, 0.0f, (uint8_t)(0x28 + ch), (uint8_t)(0x3A + ch * 8));
+        status |= events_add(list, 0.0f, (uint8_t)(0x30 + ch), 0x00);
+        status |= events_add(list, 0.0f, (uint8_t)(0x38 + ch), (flags & STRESS_LFO) ? 0x73 : 0x00);
+        for (int op = 0; op < 4; op++) {
+            uint8_t slot = (uint8_t)(op * 8 + ch);
+            int carrier = op == 1 || op == 3;
+            status |= events_add(list, 0.0f, (uint8_t)(0x40 + slot), (uint8_t)(0x01 + op));
+            status |= events_add(list, 0.0f, (uint8_t)(0x60 + slot), carrier ? 0x10 : 0x24);
+            status |= events_add(list, 0.0f, (uint8_t)(0x80 + slot), 0x1F);
+            status |= events_add(list, 0.0f, (uint8_t)(0xA0 + slot), (flags & STRESS_LFO) ? 0x80 : 0x00);
+            status |= events_add(list, 0.0f, (uint8_t)(0xC0 + slot), 0x00);
+            status |= events_add(list, 0.0f, (uint8_t)(0xE0 + slot), 0x0F);
+        }
+        status |= events_add(list, 0.0f, 0x08, (uint8_t)(0x78 | ch));
+    }
+
+    if (flags & STRESS_DENSE) {
+        // レンダラーは 1 書き込みに 2 サンプルかかるので、その分だけ詰める
+        double rate = opm_renderer_sample_rate();
+        int writes = (int)(seconds * rate / 2.0);
+        for (int i = 0; i < writes; i++) {
+            float time = (float)(i * 2.0 / rate);
+            int ch = i & 7;
+            if (i & 8) {
+                status |= events_add(list, time, (uint8_t)(0x28 + ch), (uint8_t)(0x30 + ((i >> 4) & 0x3F)));
+            } else {
+                status |= events_add(list, time, (uint8_t)(0x60 + 8 + ch), (uint8_t)(0x10 + ((i >> 4) & 0x0F)));
+            }
+        }
+    }
+    return status;
+}
+
+
+// ============================================================
+// 3. Benchmarks
+// ============================================================
+
+// 合成した負荷を 1 秒鳴らした後のチップ (発音中の状態) を取る
+static int make_busy_chip(opm_renderer_t *renderer, opm_t *chip) {
+    event_list_t list = { 0 };
+    if (build_stress(&list, STRESS_LFO | STRESS_NOISE, 0.0) != 0) {
+        free(list.items);
+        return -1;
+    }
+
+    int frames = (int)opm_renderer_sample_rate();
+    int ok = opm_renderer_render(renderer, list.items, list.count, frames) == frames;
+    if (ok) memcpy(chip, opm_renderer_chip(renderer), sizeof(opm_t));
+    free(list.items);
+    return ok ? 0 : -1;
+}
+
+static int bench_clock(const bench_options_t *opt, const opm_t *busy, bench_results_t *results) {
+    long long clocks = (long long)(opt->seconds * OPM_CLOCK);
+    opm_t *chip = (opm_t *)malloc(sizeof(opm_t));
+    bench_result_t *r = results_add(results, "clock", "OPM_Clock", "clocks/s");
+    if (!chip || !r) {
+        free(chip);
+        return -1;
+    }
+
+    for (int rep = 0; rep < opt->repeat; rep++) {
+        memcpy(chip, busy, sizeof(opm_t));
+        int32_t out[2] = { 0, 0 };
+        uint8_t sh1, sh2, so;
+        uint32_t hash = CHECKSUM_INIT;
+
+        double start = now_seconds();
+        for (long long i = 0; i < clocks; i++) {
+            OPM_Clock(chip, out, &sh1, &sh2, &so);
+            if ((i & (CLOCK_STEP - 1)) == CLOCK_STEP - 1) hash = checksum_update(hash, out, sizeof(out));
+        }
+        double elapsed = now_seconds() - start;
+
+        if (rep == 0 || elapsed < r->seconds) r->seconds = elapsed;
+        r->checksum = hash;
+    }
+    r->value = r->seconds > 0.0 ? clocks / r->seconds : 0.0;
+    r->audio_seconds = (double)clocks / OPM_CLOCK;
+    free(chip);
+    return 0;
+}
+
+// イベントを書き終えたレンダラーで render_block を回す (シーケンサの分はほぼ 0)
+static int bench_render_loop(const bench_options_t *opt, opm_renderer_t *renderer, const opm_t *busy,
+                             float *block, bench_results_t *results) {
+    int total = (int)(opt->seconds * opm_renderer_sample_rate());
+    bench_result_t *r = results_add(results, "render_loop", "render_loop", "samples/s");
+    if (!r) return -1;
+
+    opm_output_t out;
+    opm_output_init_interleaved(&out, OPM_SAMPLE_FLOAT32, block);
+
+    for (int rep = 0; rep < opt->repeat; rep++) {
+        uint32_t hash = CHECKSUM_INIT;
+        opm_renderer_start_from(renderer, busy, NULL, 0);
+
+        double start = now_seconds();
+        for (int done = 0; done < total; done += BLOCK_FRAMES) {
+            int n = total - done < BLOCK_FRAMES ? total - done : BLOCK_FRAMES;
+            opm_renderer_render_block(renderer, n, &out);
+            hash = checksum_update(hash, block, sizeof(float) * 2 * n);
+        }
+        double elapsed = now_seconds() - start;
+
+        if (rep == 0 || elapsed < r->seconds) r->seconds = elapsed;
+        r->checksum = hash;
+    }
+    r->value = r->seconds > 0.0 ? total / r->seconds : 0.0;
+    r->audio_seconds = total / opm_renderer_sample_rate();
+    return 0;
+}
+
+static int bench_reset(const bench_options_t *opt, bench_results_t *results) {
+    opm_t *chip = (opm_t *)malloc(sizeof(opm_t));
+    bench_result_t *r = results_add(results, "reset", "OPM_Reset", "ns/call");
+    if (!chip || !r) {
+        free(chip);
+        return -1;
+    }
+
+    for (int rep = 0; rep < opt->repeat; rep++) {
+        double start = now_seconds();
+        for (int i = 0; i < RESET_ITERATIONS; i++) {
+            OPM_Reset(chip, OPM_CLOCK);
+        }
+        double elapsed = now_seconds() - start;
+        if (rep == 0 || elapsed < r->seconds) r->seconds = elapsed;
+    }
+    r->value = r->seconds * 1e9 / RESET_ITERATIONS;
+    r->checksum = checksum_update(CHECKSUM_INIT, chip, sizeof(opm_t));
+    free(chip);
+    return 0;
+}
+
+// generate_sound と同じく、OPM_Reset からイベント列を num_frames 鳴らして内部バッファに書く
+static int bench_sequence(const bench_options_t *opt, opm_renderer_t *renderer, const char *kind,
+                          const char *name, const opm_event_t *events, int count, int num_frames,
+                          bench_results_t *results) {
+    bench_result_t *r = results_add(results, kind, name, "x realtime");
+    if (!r) return -1;
+
+    for (int rep = 0; rep < opt->repeat; rep++) {
+        double start = now_seconds();
+        int frames = opm_renderer_render(renderer, events, count, num_frames);
+        double elapsed = now_seconds() - start;
+        if (frames != num_frames) return -1;
+
+        if (rep == 0 || elapsed < r->seconds) r->seconds = elapsed;
+        r->checksum = checksum_update(CHECKSUM_INIT, opm_renderer_buffer(renderer),
+                                      sizeof(float) * opm_renderer_buffer_length(renderer));
+    }
+    r->audio_seconds = num_frames / opm_renderer_sample_rate();
+    r->value = r->seconds > 0.0 ? r->audio_seconds / r->seconds : 0.0;
+    return 0;
+}
+
+// Nuked で鳴らした直後の reference と同じ列を fast でも鳴らし、速度と誤差を結果に足す
+static int bench_fast_sequence(const bench_options_t *opt, opm_renderer_t *fast, const opm_renderer_t *reference,
+                               const char *kind, const char *name, const opm_event_t *events, int count,
+                               int num_frames, bench_results_t *results) {
+    double nuked_seconds = results->items[results->count - 1].seconds;
+    if (bench_sequence(opt, fast, kind, name, events, count, num_frames, results) != 0) return -1;
+    double fast_seconds = results->items[results->count - 1].seconds;
+    uint32_t checksum = results->items[results->count - 1].checksum;
+    double audio_seconds = num_frames / opm_renderer_sample_rate();
+
+    bench_result_t *speedup = results_add(results, "fast_speedup", name, "x nuked");
+    if (!speedup) return -1;
+    speedup->seconds = fast_seconds;
+    speedup->audio_seconds = audio_seconds;
+    speedup->value = fast_seconds > 0.0 ? nuked_seconds / fast_seconds : 0.0;
+    speedup->checksum = checksum;
+
+    // SNR = 10 log10 (Σ ref² / Σ (ref - fast)²)
+    const float *ref = opm_renderer_buffer(reference);
+    const float *out = opm_renderer_buffer(fast);
+    int length = opm_renderer_buffer_length(fast);
+    if (opm_renderer_buffer_length(reference) != length) return -1;
+    double signal = 0.0, noise = 0.0;
+    for (int i = 0; i < length; i++) {
+        double d = (double)ref[i] - (double)out[i];
+        signal += (double)ref[i] * ref[i];
+        noise += d * d;
+    }
+    bench_result_t *snr = results_add(results, "fast_snr", name, "dB");
+    if (!snr) return -1;
+    snr->seconds = fast_seconds;
+    snr->audio_seconds = audio_seconds;
+    if (noise == 0.0) {
+        snr->value = SNR_EXACT;
+    } else if (signal == 0.0) {
+        snr->value = 0.0;
+    } else {
+        snr->value = 10.0 * log10(signal / noise);
+    }
+    snr->checksum = checksum;
+    return 0;
+}
+
+static int bench_presets(const bench_options_t *opt, opm_renderer_t *renderer, opm_renderer_t *fast,
+                         bench_results_t *results) {
+    size_t length;
+    char *json = opm_events_read_file(opt->input, &length);
+    if (!json) {
+        fprintf(stderr, "cannot read %s\n", opt->input);
+        return -1;
+    }
+
+    opm_preset_t *presets;
+    int count;
+    char error[128];
+    int parsed = opm_events_parse_bank(json, length, &presets, &count, error, sizeof(error));
+    free(json);
+    if (parsed != 0) {
+        fprintf(stderr, "%s: %s\n", opt->input, error);
+        return -1;
+    }
+
+    int status = 0;
+    for (int i = 0; i < count && status == 0; i++) {
+        char name[96];
+        if (presets[i].name[0]) {
+            snprintf(name, sizeof(name), "%d:%s", i, presets[i].name);
+        } else {
+            snprintf(name, sizeof(name), "%d", i);
+        }
+        int frames = (int)(opm_events_duration(presets[i].events, presets[i].count) * opm_renderer_sample_rate());
+        status = bench_sequence(opt, renderer, "preset", name, presets[i].events, presets[i].count, frames, results);
+        if (status == 0) {
+            status = bench_fast_sequence(opt, fast, renderer, "fast_preset", name, presets[i].events,
+                                         presets[i].count, frames, results);
+        }
+    }
+    opm_events_free_bank(presets, count);
+    return status;
+}
+
+static int bench_stress(const bench_options_t *opt, opm_renderer_t *renderer, opm_renderer_t *fast,
+                        bench_results_t *results) {
+    static const struct {
+        const char *name;
+        int flags;
+    } cases[] = {
+        { "8ch",            0 },
+        { "8ch_lfo",        STRESS_LFO },
+        { "8ch_noise",      STRESS_NOISE },
+        { "8ch_dense",      STRESS_DENSE },
+        { "8ch_lfo_noise_dense", STRESS_LFO | STRESS_NOISE | STRESS_DENSE },
+    };
+
+    int frames = (int)(opt->seconds * opm_renderer_sample_rate());
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        event_list_t list = { 0 };
+        int status = build_stress(&list, cases[i].flags, opt->seconds);
+        if (status == 0) {
+            status = bench_sequence(opt, renderer, "stress", cases[i].name, list.items, list.count, frames, results);
+        }
+        if (status == 0) {
+            status = bench_fast_sequence(opt, fast, renderer, "fast_stress", cases[i].name, list.items,
+                                         list.count, frames, results);
+        }
+        free(list.items);
+        if (status != 0) return -1;
+    }
+    return 0;
+}
+
+
+// 同じ負荷 (8ch、LFO、ノイズ) を OPM_SIMD_LANES 個、1つずつ Nuked で鳴らしたときと
+// render_multi でまとめて鳴らしたときを比べる
+static int bench_simd(const bench_options_t *opt, opm_renderer_t *renderer, bench_results_t *results) {
+    event_list_t list = { 0 };
+    if (build_stress(&list, STRESS_LFO | STRESS_NOISE, opt->seconds) != 0) {
+        free(list.items);
+        return -1;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "render_multi_%d", OPM_SIMD_LANES);
+    int frames = (int)(opt->seconds * opm_renderer_sample_rate());
+    const opm_event_t *events[OPM_SIMD_LANES];
+    int counts[OPM_SIMD_LANES];
+    for (int l = 0; l < OPM_SIMD_LANES; l++) {
+        events[l] = list.items;
+        counts[l] = list.count;
+    }
+
+    bench_result_t *r = results_add(results, "simd", name, "x realtime");
+    double scalar_seconds = 0.0;
+    uint32_t scalar_hash = CHECKSUM_INIT;
+    int status = r ? 0 : -1;
+    for (int rep = 0; rep < opt->repeat && status == 0; rep++) {
+        // 1つずつ鳴らす (出力は voice の順に並べたものとしてハッシュする)
+        uint32_t hash = CHECKSUM_INIT;
+        double elapsed = 0.0;
+        for (int l = 0; l < OPM_SIMD_LANES && status == 0; l++) {
+            double start = now_seconds();
+            int rendered = opm_renderer_render(renderer, events[l], counts[l], frames);
+            elapsed += now_seconds() - start;
+            if (rendered != frames) status = -1;
+            hash = checksum_update(hash, opm_renderer_buffer(renderer), sizeof(float) * 2 * (size_t)frames);
+        }
+        if (rep == 0 || elapsed < scalar_seconds) scalar_seconds = elapsed;
+        scalar_hash = hash;
+
+        double start = now_seconds();
+        int rendered = opm_renderer_render_multi(renderer, events, counts, OPM_SIMD_LANES, frames);
+        elapsed = now_seconds() - start;
+        if (rendered != frames) status = -1;
+        if (rep == 0 || elapsed < r->seconds) r->seconds = elapsed;
+        r->checksum = checksum_update(CHECKSUM_INIT, opm_renderer_buffer(renderer),
+                                      sizeof(float) * opm_renderer_buffer_length(renderer));
+    }
+    free(list.items);
+    if (status != 0) return -1;
+    if (r->checksum != scalar_hash) {
+        fprintf(stderr, "%s: output differs from the scalar engine\n", name);
+        return -1;
+    }
+
+    r->audio_seconds = (double)OPM_SIMD_LANES * frames / opm_renderer_sample_rate();
+    r->value = r->seconds > 0.0 ? r->audio_seconds / r->seconds : 0.0;
+
+    bench_result_t *speedup = results_add(results, "simd_speedup", name, "x scalar");
+    if (!speedup) return -1;
+    speedup->seconds = r->seconds;
+    speedup->audio_seconds = r->audio_seconds;
+    speedup->value = r->seconds > 0.0 ? scalar_seconds / r->seconds : 0.0;
+    speedup->checksum = r->checksum;
+    return 0;
+}
+
+
+// ============================================================
+// 4. Report
+// ============================================================
+
+static void json_string(FILE *fp, const char *s) {
+    fputc('"', fp);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fprintf(fp, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(fp, "\\u%04x", c);
+        } else {
+            fputc(c, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+static void write_json(FILE *fp, const bench_options_t *opt, const bench_results_t *results) {
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"benchmark\": \"opm-bench\",\n");
+    fprintf(fp, "  \"timestamp\": %lld,\n", (long long)time(NULL));
+#ifdef __VERSION__
+    fprintf(fp, "  \"compiler\": ");
+    json_string(fp, __VERSION__);
+    fprintf(fp, ",\n");
+#endif
+    fprintf(fp, "  \"profile\": %s,\n", opm_profile_enabled() ? "true" : "false");
+    fprintf(fp, "  \"sample_rate\": %.6f,\n", opm_renderer_sample_rate());
+    fprintf(fp, "  \"repeat\": %d,\n", opt->repeat);
+    fprintf(fp, "  \"results\": [\n");
+    for (int i = 0; i < results->count; i++) {
+        const bench_result_t *r = &results->items[i];
+        fprintf(fp, "    { \"kind\": \"%s\", \"name\": ", r->kind);
+        json_string(fp, r->name);
+        fprintf(fp, ", \"value\": %.6g, \"unit\": \"%s\", \"seconds\": %.6f, \"audio_seconds\": %.6f, "
+                    "\"checksum\": \"%08x\" }%s\n",
+                r->value, r->unit, r->seconds, r->audio_seconds, r->checksum, i + 1 < results->count ? "," : "");
+    }
+    fprintf(fp, "  ]\n");
+    fprintf(fp, "}\n");
+}
+
+static void print_summary(const bench_results_t *results) {
+    for (int i = 0; i < results->count; i++) {
+        const bench_result_t *r = &results->items[i];
+        fprintf(stderr, "%-12s %-28s %14.4g %s\n", r->kind, r->name, r->value, r->unit);
+    }
+}
+
+
+// ============================================================
+// 5. Main
+// ============================================================
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "\n"
+        "options:\n"
+        "  -i, --input FILE      presets.json to benchmark end to end (default: none)\n"
+        "  -o, --output FILE     JSON results (default: stdout)\n"
+        "  -t, --seconds SEC     audio length for the clock, loop and stress cases (default: 2)\n"
+        "  -n, --repeat N        runs per case; the fastest is reported (default: 3)\n"
+        "  -q, --quiet           do not print the summary to stderr\n"
+        "  -h, --help            show this help\n",
+        prog);
+}
+
+// 成功時 0、終了すべきとき 1 (help)、エラー時 -1
+static int parse_options(int argc, char **argv, bench_options_t *opt) {
+    static const struct option long_options[] = {
+        { "input",   required_argument, NULL, 'i' },
+        { "output",  required_argument, NULL, 'o' },
+        { "seconds", required_argument, NULL, 't' },
+        { "repeat",  required_argument, NULL, 'n' },
+        { "quiet",   no_argument,       NULL, 'q' },
+        { "help",    no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    opt->input = NULL;
+    opt->output = "-";
+    opt->seconds = 2.0;
+    opt->repeat = 3;
+    opt->quiet = 0;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "i:o:t:n:qh", long_options, NULL)) != -1) {
+        switch (c) {
+        case 'i':
+            opt->input = optarg;
+            break;
+        case 'o':
+            opt->output = optarg;
+            break;
+        case 't':
+            opt->seconds = atof(optarg);
+            if (opt->seconds <= 0.0 || opt->seconds > 600.0) {
+                fprintf(stderr, "invalid length: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'n':
+            opt->repeat = atoi(optarg);
+            if (opt->repeat <= 0) {
+                fprintf(stderr, "invalid repeat count: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'q':
+            opt->quiet = 1;
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 1;
+        default:
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (optind != argc) {
+        print_usage(argv[0]);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    bench_options_t opt;
+    int parsed = parse_options(argc, argv, &opt);
+    if (parsed != 0) return parsed > 0 ? 0 : 2;
+
+    bench_results_t results = { 0 };
+    opm_renderer_t *renderer = opm_renderer_create();
+    opm_renderer_t *fast = opm_renderer_create();
+    opm_t *busy = (opm_t *)malloc(sizeof(opm_t));
+    float *block = (float *)malloc(sizeof(float) * 2 * BLOCK_FRAMES);
+    int status = 0;
+
+    if (!renderer || !fast || !busy || !block || opm_renderer_set_engine(fast, OPM_RENDERER_ENGINE_FAST) != 0 ||
+        make_busy_chip(renderer, busy) != 0) {
+        fprintf(stderr, "out of memory\n");
+        status = 1;
+    } else if (bench_clock(&opt, busy, &results) != 0 ||
+               bench_render_loop(&opt, renderer, busy, block, &results) != 0 ||
+               bench_reset(&opt, &results) != 0 ||
+               (opt.input && bench_presets(&opt, renderer, fast, &results) != 0) ||
+               bench_stress(&opt, renderer, fast, &results) != 0 ||
+               bench_simd(&opt, renderer, &results) != 0) {
+        fprintf(stderr, "benchmark failed\n");
+        status = 1;
+    }
+
+    if (status == 0) {
+        FILE *out = strcmp(opt.output, "-") == 0 ? stdout : fopen(opt.output, "w");
+        if (!out) {
+            fprintf(stderr, "cannot open %s\n", opt.output);
+            status = 1;
+        } else {
+            write_json(out, &opt, &results);
+            if (out != stdout ? fclose(out) != 0 : fflush(out) != 0) status = 1;
+        }
+        if (!opt.quiet) print_summary(&results);
+    }
+
+    free(block);
+    free(busy);
+    opm_renderer_destroy(fast);
+    opm_renderer_destroy(renderer);
+    free(results.items);
+    return status;
+}
@@ -0,0 +1,918 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "opm_codec.h"
+
+// ストリームの先頭: "OPMZ", バージョン (u8), 形式 (u8: 0 = f32, 1 = s16), 0 (u16),
+// サンプルレート, ブロックのフレーム数, フレーム数, ブロック数 (u32)。
+// 続けてブロックの位置 (ストリームの先頭からのバイト数、u32) を ブロック数 + 1 個 (最後は終わりの位置)。
+// 数値はすべてリトルエンディアン
+#define STREAM_MAGIC "OPMZ"
+#define STREAM_VERSION 1
+#define HEADER_SIZE 24
+
+// ブロックの先頭のバイト
+#define BLOCK_CODED 0   // 続けてステレオの組み合わせ (u8) と2チャンネル分のサブフレーム (ビット列)
+#define BLOCK_RAW 1     // 続けて元のサンプルをそのまま (リトルエンディアンのインターリーブ)
+
+// ステレオの組み合わせ。side = L - R、mid = (L + R) >> 1
+#define STEREO_LR 0
+#define STEREO_LS 1
+#define STEREO_SR 2
+#define STEREO_MS 3
+
+// サブフレーム (1チャンネル分) の種類 (2 ビット)
+#define SUB_CONSTANT 0  // 値 (32 ビット)
+#define SUB_VERBATIM 1  // 幅 (6 ビット) と各サンプル
+#define SUB_FIXED 2     // 次数 (3 ビット)、先頭の幅 (6 ビット) と先頭の次数個、残差
+#define SUB_LPC 3       // 次数 - 1 (5 ビット)、係数の精度 - 1 (4 ビット)、シフト (5 ビット)、
+                        // 先頭の幅と先頭の次数個、係数、残差
+
+#define MAX_FIXED_ORDER 4
+#define MAX_LPC_ORDER 32
+#define LPC_PRECISION 15
+#define MAX_PARTITION_ORDER 8
+#define RICE_ESCAPE 31  // 分割のパラメータがこの値なら、幅 (6 ビット) と各残差をそのまま書く
+#define MAX_RICE_PARAM 30
+
+// 予測の残差が 32 ビットに収まるよう、整数として扱うサンプルはこの範囲に限る
+#define MAX_SAMPLE_MAGNITUDE (1 << 24)
+
+// LPC を試す次数 (残差が最も小さくなるものを使う)
+static const int lpc_orders[] = { 8, 16, 32 };
+#define NUM_LPC_ORDERS (int)(sizeof(lpc_orders) / sizeof(lpc_orders[0]))
+#define MAX_TRIED_LPC_ORDER 32
+
+
+// ============================================================
+// 1. Bits
+// ============================================================
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    uint64_t acc;
+    int bits;           // acc に溜まっているビット数 (8 未満)
+    int error;          // メモリが確保できなかった
+} bit_writer_t;
+
+static void bw_byte(bit_writer_t *bw, uint8_t b) {
+    if (bw->size == bw->capacity) {
+        size_t capacity = bw->capacity > 0 ? bw->capacity * 2 : 65536;
+        uint8_t *grown = (uint8_t *)realloc(bw->data, capacity);
+        if (!grown) {
+            bw->error = 1;
+            return;
+        }
+        bw->data = grown;
+        bw->capacity = capacity;
+    }
+    bw->data[bw->size++] = b;
+}
+
+static void bw_u32(bit_writer_t *bw, uint32_t v) {
+    for (int i = 0; i < 4; i++) bw_byte(bw, (uint8_t)(v >> (i * 8)));
+}
+
+// 上位ビットから n (32 以下) ビット書く
+static void bw_put(bit_writer_t *bw, uint32_t value, int n) {
+    if (n == 0) return;
+    uint64_t mask = ((uint64_t)1 << n) - 1;
+    bw->acc = (bw->acc << n) | (value & mask);
+    bw->bits += n;
+    while (bw->bits >= 8) {
+        bw->bits -= 8;
+        bw_byte(bw, (uint8_t)(bw->acc >> bw->bits));
+    }
+}
+
+static void bw_put_signed(bit_writer_t *bw, int32_t value, int n) {
+    bw_put(bw, (uint32_t)value, n);
+}
+
+// バイトの境目までを 0 で埋める
+static void bw_align(bit_writer_t *bw) {
+    if (bw->bits > 0) bw_put(bw, 0, 8 - bw->bits);
+}
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint64_t cache;     // 上位 bits ビットが読める
+    int bits;
+    int overrun;        // end を越えて補った 0 のバイト数
+} bit_reader_t;
+
+static void br_init(bit_reader_t *br, const uint8_t *p, const uint8_t *end) {
+    br->p = p;
+    br->end = end;
+    br->cache = 0;
+    br->bits = 0;
+    br->overrun = 0;
+}
+
+static void br_refill(bit_reader_t *br) {
+    while (br->bits <= 56) {
+        uint64_t b = 0;
+        if (br->p < br->end) {
+            b = *br->p++;
+        } else {
+            br->overrun++;
+        }
+        br->cache |= b << (56 - br->bits);
+        br->bits += 8;
+    }
+}
+
+// 補った 0 まで読んでいれば壊れている
+static int br_failed(const bit_reader_t *br) {
+    return br->overrun * 8 > br->bits;
+}
+
+static uint32_t br_get(bit_reader_t *br, int n) {
+    if (n == 0) return 0;
+    if (br->bits < n) br_refill(br);
+    uint32_t v = (uint32_t)(br->cache >> (64 - n));
+    br->cache <<= n;
+    br->bits -= n;
+    return v;
+}
+
+static int32_t br_get_signed(bit_reader_t *br, int n) {
+    if (n == 0) return 0;
+    uint32_t v = br_get(br, n);
+    // n ビットの2の補数を符号拡張する
+    uint32_t sign = (uint32_t)1 << (n - 1);
+    return (int32_t)((v ^ sign) - sign);
+}
+
+static int count_leading_zeros(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(v);
+#else
+    int n = 0;
+    while (!(v & ((uint64_t)1 << 63))) {
+        v <<= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+// 0 の並び (q 個) と 1 で q を読む。長すぎれば (壊れている) UINT32_MAX
+static uint32_t br_get_unary(bit_reader_t *br) {
+    uint32_t q = 0;
+    for (;;) {
+        if (br->bits == 0 || br->cache == 0) {
+            q += (uint32_t)br->bits;
+            br->cache = 0;
+            br->bits = 0;
+            if (q > UINT32_MAX / 2 || br_failed(br)) return UINT32_MAX;
+            br_refill(br);
+            continue;
+        }
+        int zeros = count_leading_zeros(br->cache);
+        // 1 がキャッシュの最後のビットなら zeros + 1 = 64 になる (64 ビットのシフトは未定義) ので2回に分ける
+        br->cache = (br->cache << zeros) << 1;
+        br->bits -= zeros + 1;
+        return q + (uint32_t)zeros;
+    }
+}
+
+static uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t u) {
+    return (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+}
+
+// v を2の補数で書くのに必要なビット数
+static int signed_bits(int32_t v) {
+    uint32_t u = zigzag(v);
+    int n = 0;
+    while (u) {
+        n++;
+        u >>= 1;
+    }
+    return n;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (i * 8));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+// ============================================================
+// 2. Prediction
+// ============================================================
+
+// 固定の多項式予測の残差。先頭の order 個は residual に入れない
+static void fixed_residual(const int32_t *x, int n, int order, int32_t *residual) {
+    for (int i = order; i < n; i++) {
+        int32_t r;
+        switch (order) {
+        case 0: r = x[i]; break;
+        case 1: r = x[i] - x[i - 1]; break;
+        case 2: r = x[i] - 2 * x[i - 1] + x[i - 2]; break;
+        case 3: r = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3]; break;
+        default: r = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4]; break;
+        }
+        residual[i - order] = r;
+    }
+}
+
+static void fixed_restore(int32_t *x, int n, int order, const int32_t *residual) {
+    for (int i = order; i < n; i++) {
+        int64_t p;
+        switch (order) {
+        case 0: p = 0; break;
+        case 1: p = x[i - 1]; break;
+        case 2: p = 2 * (int64_t)x[i - 1] - x[i - 2]; break;
+        case 3: p = 3 * (int64_t)x[i - 1] - 3 * (int64_t)x[i - 2] + x[i - 3]; break;
+        default: p = 4 * (int64_t)x[i - 1] - 6 * (int64_t)x[i - 2] + 4 * (int64_t)x[i - 3] - x[i - 4]; break;
+        }
+        x[i] = (int32_t)(uint32_t)(p + residual[i - order]);
+    }
+}
+
+// 量子化した係数での予測の残差。32 ビットに収まらなければ -1
+static int lpc_residual(const int32_t *x, int n, const int32_t *coefs, int order, int shift, int32_t *residual) {
+    for (int i = order; i < n; i++) {
+        int64_t sum = 0;
+        for (int j = 0; j < order; j++) {
+            sum += (int64_t)coefs[j] * x[i - 1 - j];
+        }
+        int64_t r = x[i] - (sum >> shift);
+        if (r > INT32_MAX / 2 || r < INT32_MIN / 2) return -1;
+        residual[i - order] = (int32_t)r;
+    }
+    return 0;
+}
+
+static void lpc_restore(int32_t *x, int n, const int32_t *coefs, int order, int shift, const int32_t *residual) {
+    for (int i = order; i < n; i++) {
+        int64_t sum = 0;
+        for (int j = 0; j < order; j++) {
+            sum += (int64_t)coefs[j] * x[i - 1 - j];
+        }
+        x[i] = (int32_t)(uint32_t)((sum >> shift) + residual[i - order]);
+    }
+}
+
+// 窓 (Welch) をかけた自己相関 autoc[0..max_order]
+static void lpc_autocorrelation(const int32_t *x, int n, int max_order, double *windowed, double *autoc) {
+    double half = (n - 1) * 0.5;
+    double width = (n + 1) * 0.5;
+    for (int i = 0; i < n; i++) {
+        double t = (i - half) / width;
+        windowed[i] = x[i] * (1.0 - t * t);
+    }
+    for (int lag = 0; lag <= max_order; lag++) {
+        double sum = 0.0;
+        for (int i = lag; i < n; i++) {
+            sum += windowed[i] * windowed[i - lag];
+        }
+        autoc[lag] = sum;
+    }
+}
+
+// レビンソン・ダービン法。lpc[o - 1][j] に次数 o の係数 (x[i - 1 - j] に掛ける) を返す。
+// 求められた次数を返す
+static int lpc_levinson(const double *autoc, int max_order, double lpc[][MAX_TRIED_LPC_ORDER]) {
+    double a[MAX_TRIED_LPC_ORDER];
+    double err = autoc[0];
+    if (!(err > 0.0)) return 0;
+
+    for (int i = 0; i < max_order; i++) {
+        double r = -autoc[i + 1];
+        for (int j = 0; j < i; j++) {
+            r -= a[j] * autoc[i - j];
+        }
+        r /= err;
+
+        a[i] = r;
+        for (int j = 0; j < i / 2; j++) {
+            double t = a[j];
+            a[j] += r * a[i - 1 - j];
+            a[i - 1 - j] += r * t;
+        }
+        if (i & 1) {
+            a[i / 2] += a[i / 2] * r;
+        }
+        err *= 1.0 - r * r;
+        for (int j = 0; j <= i; j++) {
+            lpc[i][j] = -a[j];
+        }
+        if (!(err > 0.0)) return i + 1;
+    }
+    return max_order;
+}
+
+// 係数を precision ビットの整数と shift にする (丸めの誤差は次の係数に持ち越す)。できなければ -1
+static int lpc_quantize(const double *lpc, int order, int precision, int32_t *coefs, int *shift) {
+    double cmax = 0.0;
+    for (int i = 0; i < order; i++) {
+        if (fabs(lpc[i]) > cmax) cmax = fabs(lpc[i]);
+    }
+    if (!(cmax > 0.0)) return -1;
+
+    int log2cmax;
+    frexp(cmax, &log2cmax);
+    int s = precision - 1 - log2cmax;
+    if (s > 31) s = 31;
+    if (s < 0) return -1;
+
+    int32_t qmax = (1 << (precision - 1)) - 1;
+    int32_t qmin = -(1 << (precision - 1));
+    double error = 0.0;
+    for (int i = 0; i < order; i++) {
+        error += lpc[i] * (double)((int64_t)1 << s);
+        long q = lround(error);
+        if (q > qmax) q = qmax;
+        if (q < qmin) q = qmin;
+        error -= (double)q;
+        coefs[i] = (int32_t)q;
+    }
+    *shift = s;
+    return 0;
+}
+
+
+// ============================================================
+// 3. Residual
+// ============================================================
+//
+// 残差は 2^p 個の分割に分け、分割ごとに Rice 符号のパラメータ k を決める。
+// 最初の分割だけ先頭 (予測の次数の個数) の分だけ短い。
+
+typedef struct {
+    int partition_order;
+    uint8_t params[1 << MAX_PARTITION_ORDER];
+    uint64_t bits;
+} rice_plan_t;
+
+// 合計 sum、count 個の分割の k と見積もったビット数
+static uint64_t rice_partition_cost(uint64_t sum, int count, int width, uint8_t *param) {
+    uint64_t escape = 5 + 6 + (uint64_t)count * width;
+    if (count == 0) {
+        *param = 0;
+        return 5;
+    }
+    int k = 0;
+    while (k < MAX_RICE_PARAM && ((uint64_t)count << (k + 1)) < sum) k++;
+    uint64_t best = UINT64_MAX;
+    for (int c = k > 0 ? k - 1 : 0; c <= k + 1 && c <= MAX_RICE_PARAM; c++) {
+        uint64_t bits = 5 + (uint64_t)count * (c + 1) + (sum >> c);
+        if (bits < best) {
+            best = bits;
+            *param = (uint8_t)c;
+        }
+    }
+    if (escape < best) {
+        *param = RICE_ESCAPE;
+        best = escape;
+    }
+    return best;
+}
+
+static int max_partition_order(int n, int order) {
+    int p = 0;
+    while (p < MAX_PARTITION_ORDER && (n & ((2 << p) - 1)) == 0 && (n >> (p + 1)) > order) p++;
+    return p;
+}
+
+// 分割の次数とパラメータを決める。u は残差の zigzag
+static void rice_plan(const uint32_t *u, int n, int order, rice_plan_t *plan) {
+    int pmax = max_partition_order(n, order);
+    uint64_t sums[1 << MAX_PARTITION_ORDER];
+    uint32_t maxima[1 << MAX_PARTITION_ORDER];
+    int parts = 1 << pmax;
+    int size = n >> pmax;
+    for (int i = 0, pos = 0; i < parts; i++) {
+        int end = (i + 1) * size - order;
+        uint64_t sum = 0;
+        uint32_t max = 0;
+        for (; pos < end; pos++) {
+            sum += u[pos];
+            if (u[pos] > max) max = u[pos];
+        }
+        sums[i] = sum;
+        maxima[i] = max;
+    }
+
+    plan->bits = UINT64_MAX;
+    for (int p = pmax; p >= 0; p--) {
+        int count = 1 << p;
+        uint8_t params[1 << MAX_PARTITION_ORDER];
+        uint64_t bits = 4;
+        for (int i = 0; i < count; i++) {
+            uint32_t m = maxima[i];
+            int width = 0;
+            while (m) {
+                width++;
+                m >>= 1;
+            }
+            int samples = (n >> p) - (i == 0 ? order : 0);
+            bits += rice_partition_cost(sums[i], samples, width, &params[i]);
+        }
+        if (bits < plan->bits) {
+            plan->bits = bits;
+            plan->partition_order = p;
+            memcpy(plan->params, params, (size_t)count);
+        }
+        // 次 (1つ粗い分割) のために隣どうしをまとめる
+        for (int i = 0; i < count / 2; i++) {
+            sums[i] = sums[2 * i] + sums[2 * i + 1];
+            maxima[i] = maxima[2 * i] > maxima[2 * i + 1] ? maxima[2 * i] : maxima[2 * i + 1];
+        }
+    }
+}
+
+static void rice_write(bit_writer_t *bw, const int32_t *residual, const uint32_t *u, int n, int order,
+                       const rice_plan_t *plan) {
+    int p = plan->partition_order;
+    bw_put(bw, (uint32_t)p, 4);
+    int pos = 0;
+    for (int i = 0; i < (1 << p); i++) {
+        int end = (i + 1) * (n >> p) - order;
+        int k = plan->params[i];
+        bw_put(bw, (uint32_t)k, 5);
+        if (k == RICE_ESCAPE) {
+            uint32_t max = 0;
+            for (int j = pos; j < end; j++) {
+                if (u[j] > max) max = u[j];
+            }
+            int width = 0;
+            while (max) {
+                width++;
+                max >>= 1;
+            }
+            bw_put(bw, (uint32_t)width, 6);
+            for (; pos < end; pos++) bw_put_signed(bw, residual[pos], width);
+            continue;
+        }
+        for (; pos < end; pos++) {
+            uint32_t q = u[pos] >> k;
+            while (q >= 32) {
+                bw_put(bw, 0, 32);
+                q -= 32;
+            }
+            bw_put(bw, 1, (int)q + 1);
+            bw_put(bw, u[pos], k);
+        }
+    }
+}
+
+static int rice_read(bit_reader_t *br, int n, int order, int32_t *residual) {
+    int p = (int)br_get(br, 4);
+    if (p > MAX_PARTITION_ORDER || (n >> p) < order || (n & ((1 << p) - 1)) != 0) return -1;
+    int pos = 0;
+    for (int i = 0; i < (1 << p); i++) {
+        int end = (i + 1) * (n >> p) - order;
+        int k = (int)br_get(br, 5);
+        if (k == RICE_ESCAPE) {
+            int width = (int)br_get(br, 6);
+            if (width > 32) return -1;
+            for (; pos < end; pos++) residual[pos] = br_get_signed(br, width);
+        } else {
+            for (; pos < end; pos++) {
+                uint32_t q = br_get_unary(br);
+                if (q == UINT32_MAX || (k > 0 && q > (UINT32_MAX >> k))) return -1;
+                residual[pos] = unzigzag((q << k) | br_get(br, k));
+            }
+        }
+        if (br_failed(br)) return -1;
+    }
+    return 0;
+}
+
+
+// ============================================================
+// 4. Subframes
+// ============================================================
+
+// エンコーダーの作業領域 (ブロック1つ分)
+typedef struct {
+    int32_t channels[4][OPM_CODEC_BLOCK_FRAMES];    // L, R, side, mid
+    int32_t residual[OPM_CODEC_BLOCK_FRAMES];
+    uint32_t u[OPM_CODEC_BLOCK_FRAMES];
+    double windowed[OPM_CODEC_BLOCK_FRAMES];
+} encoder_t;
+
+typedef struct {
+    int type;
+    int order;
+    int shift;
+    int32_t coefs[MAX_LPC_ORDER];
+    uint64_t bits;
+} subframe_plan_t;
+
+static int warmup_bits(const int32_t *x, int order) {
+    int width = 0;
+    for (int i = 0; i < order; i++) {
+        int w = signed_bits(x[i]);
+        if (w > width) width = w;
+    }
+    return width;
+}
+
+// 残差 (enc->residual) を符号にしたときのビット数
+static uint64_t residual_bits(encoder_t *enc, int n, int order, rice_plan_t *rice) {
+    for (int i = 0; i < n - order; i++) {
+        enc->u[i] = zigzag(enc->residual[i]);
+    }
+    rice_plan(enc->u, n, order, rice);
+    return rice->bits;
+}
+
+// x (n サンプル) を最も小さく書ける方法を選ぶ
+static void subframe_choose(encoder_t *enc, const int32_t *x, int n, subframe_plan_t *best) {
+    int constant = 1;
+    int width = 0;
+    for (int i = 0; i < n; i++) {
+        if (x[i] != x[0]) constant = 0;
+        int w = signed_bits(x[i]);
+        if (w > width) width = w;
+    }
+    if (constant) {
+        best->type = SUB_CONSTANT;
+        best->bits = 2 + 32;
+        return;
+    }
+    best->type = SUB_VERBATIM;
+    best->bits = 2 + 6 + (uint64_t)n * width;
+
+    rice_plan_t rice;
+    for (int order = 0; order <= MAX_FIXED_ORDER && order < n; order++) {
+        fixed_residual(x, n, order, enc->residual);
+        uint64_t bits = 2 + 3 + 6 + (uint64_t)order * warmup_bits(x, order) + residual_bits(enc, n, order, &rice);
+        if (bits < best->bits) {
+            best->type = SUB_FIXED;
+            best->order = order;
+            best->bits = bits;
+        }
+    }
+
+    double autoc[MAX_TRIED_LPC_ORDER + 1];
+    double lpc[MAX_TRIED_LPC_ORDER][MAX_TRIED_LPC_ORDER];
+    int max_order = MAX_TRIED_LPC_ORDER < n - 1 ? MAX_TRIED_LPC_ORDER : n - 1;
+    if (max_order <= 0) return;
+    lpc_autocorrelation(x, n, max_order, enc->windowed, autoc);
+    int found = lpc_levinson(autoc, max_order, lpc);
+    for (int c = 0; c < NUM_LPC_ORDERS; c++) {
+        int order = lpc_orders[c];
+        if (order > found) break;
+        int32_t coefs[MAX_LPC_ORDER];
+        int shift;
+        if (lpc_quantize(lpc[order - 1], order, LPC_PRECISION, coefs, &shift) != 0) continue;
+        if (lpc_residual(x, n, coefs, order, shift, enc->residual) != 0) continue;
+        uint64_t bits = 2 + 5 + 4 + 5 + 6 + (uint64_t)order * (warmup_bits(x, order) + LPC_PRECISION)
+            + residual_bits(enc, n, order, &rice);
+        if (bits < best->bits) {
+            best->type = SUB_LPC;
+            best->order = order;
+            best->shift = shift;
+            memcpy(best->coefs, coefs, sizeof(int32_t) * order);
+            best->bits = bits;
+        }
+    }
+}
+
+static void subframe_write(bit_writer_t *bw, encoder_t *enc, const int32_t *x, int n, const subframe_plan_t *plan) {
+    bw_put(bw, (uint32_t)plan->type, 2);
+    if (plan->type == SUB_CONSTANT) {
+        bw_put_signed(bw, x[0], 32);
+        return;
+    }
+    if (plan->type == SUB_VERBATIM) {
+        int width = warmup_bits(x, n);
+        bw_put(bw, (uint32_t)width, 6);
+        for (int i = 0; i < n; i++) bw_put_signed(bw, x[i], width);
+        return;
+    }
+
+    int order = plan->order;
+    int width = warmup_bits(x, order);
+    if (plan->type == SUB_FIXED) {
+        bw_put(bw, (uint32_t)order, 3);
+        fixed_residual(x, n, order, enc->residual);
+    } else {
+        bw_put(bw, (uint32_t)(order - 1), 5);
+        bw_put(bw, LPC_PRECISION - 1, 4);
+        bw_put(bw, (uint32_t)plan->shift, 5);
+        lpc_residual(x, n, plan->coefs, order, plan->shift, enc->residual);
+    }
+    bw_put(bw, (uint32_t)width, 6);
+    for (int i = 0; i < order; i++) bw_put_signed(bw, x[i], width);
+    if (plan->type == SUB_LPC) {
+        for (int i = 0; i < order; i++) bw_put_signed(bw, plan->coefs[i], LPC_PRECISION);
+    }
+
+    rice_plan_t rice;
+    residual_bits(enc, n, order, &rice);
+    rice_write(bw, enc->residual, enc->u, n, order, &rice);
+}
+
+// residual は n サンプル分の作業領域
+static int subframe_read(bit_reader_t *br, int32_t *x, int n, int32_t *residual) {
+    int type = (int)br_get(br, 2);
+    if (type == SUB_CONSTANT) {
+        int32_t v = br_get_signed(br, 32);
+        for (int i = 0; i < n; i++) x[i] = v;
+        return br_failed(br) ? -1 : 0;
+    }
+    if (type == SUB_VERBATIM) {
+        int width = (int)br_get(br, 6);
+        if (width > 32) return -1;
+        for (int i = 0; i < n; i++) x[i] = br_get_signed(br, width);
+        return br_failed(br) ? -1 : 0;
+    }
+
+    int order;
+    int precision = 0;
+    int shift = 0;
+    int32_t coefs[MAX_LPC_ORDER];
+    if (type == SUB_FIXED) {
+        order = (int)br_get(br, 3);
+        if (order > MAX_FIXED_ORDER) return -1;
+    } else {
+        order = (int)br_get(br, 5) + 1;
+        precision = (int)br_get(br, 4) + 1;
+        shift = (int)br_get(br, 5);
+    }
+    if (order > n) return -1;
+    int width = (int)br_get(br, 6);
+    if (width > 32) return -1;
+    for (int i = 0; i < order; i++) x[i] = br_get_signed(br, width);
+    if (type == SUB_LPC) {
+        for (int i = 0; i < order; i++) coefs[i] = br_get_signed(br, precision);
+    }
+    if (rice_read(br, n, order, residual) != 0) return -1;
+
+    if (type == SUB_FIXED) {
+        fixed_restore(x, n, order, residual);
+    } else {
+        lpc_restore(x, n, coefs, order, shift, residual);
+    }
+    return 0;
+}
+
+
+// ============================================================
+// 5. Blocks
+// ============================================================
+
+static size_t sample_bytes(opm_sample_format_t format) {
+    return format == OPM_SAMPLE_INT16 ? sizeof(int16_t) : sizeof(float);
+}
+
+// pcm のフレーム first から n フレームを整数にして L / R に入れる。
+// float で 1/32768 の整数倍でない値 (-0.0 も) があれば -1
+static int block_to_integers(const void *pcm, opm_sample_format_t format, int first, int n, int32_t *left,
+                             int32_t *right) {
+    if (format == OPM_SAMPLE_INT16) {
+        const int16_t *s = (const int16_t *)pcm + (size_t)first * 2;
+        for (int i = 0; i < n; i++) {
+            left[i] = s[i * 2];
+            right[i] = s[i * 2 + 1];
+        }
+        return 0;
+    }
+    const float *s = (const float *)pcm + (size_t)first * 2;
+    for (int i = 0; i < n * 2; i++) {
+        float v = s[i] * 32768.0f;
+        if (!(v >= -(float)MAX_SAMPLE_MAGNITUDE && v <= (float)MAX_SAMPLE_MAGNITUDE)) return -1;
+        int32_t q = (int32_t)v;
+        if ((float)q != v || (q == 0 && signbit(s[i]))) return -1;
+        if (i & 1) {
+            right[i >> 1] = q;
+        } else {
+            left[i >> 1] = q;
+        }
+    }
+    return 0;
+}
+
+static void block_write_raw(bit_writer_t *bw, const void *pcm, opm_sample_format_t format, int first, int n) {
+    bw_byte(bw, BLOCK_RAW);
+    if (format == OPM_SAMPLE_INT16) {
+        const int16_t *s = (const int16_t *)pcm + (size_t)first * 2;
+        for (int i = 0; i < n * 2; i++) {
+            bw_byte(bw, (uint8_t)((uint16_t)s[i] & 0xFF));
+            bw_byte(bw, (uint8_t)((uint16_t)s[i] >> 8));
+        }
+        return;
+    }
+    const float *s = (const float *)pcm + (size_t)first * 2;
+    for (int i = 0; i < n * 2; i++) {
+        uint32_t bits;
+        memcpy(&bits, &s[i], sizeof(bits));
+        bw_u32(bw, bits);
+    }
+}
+
+static void block_write(bit_writer_t *bw, encoder_t *enc, const void *pcm, opm_sample_format_t format,
+                        int first, int n) {
+    int32_t *left = enc->channels[0];
+    int32_t *right = enc->channels[1];
+    if (block_to_integers(pcm, format, first, n, left, right) != 0) {
+        block_write_raw(bw, pcm, format, first, n);
+        return;
+    }
+    int32_t *side = enc->channels[2];
+    int32_t *mid = enc->channels[3];
+    for (int i = 0; i < n; i++) {
+        side[i] = left[i] - right[i];
+        mid[i] = (left[i] + right[i]) >> 1;
+    }
+
+    subframe_plan_t plans[4];
+    for (int ch = 0; ch < 4; ch++) {
+        subframe_choose(enc, enc->channels[ch], n, &plans[ch]);
+    }
+    static const int pairs[4][2] = { { 0, 1 }, { 0, 2 }, { 2, 1 }, { 3, 2 } };
+    int mode = STEREO_LR;
+    for (int m = 1; m < 4; m++) {
+        if (plans[pairs[m][0]].bits + plans[pairs[m][1]].bits
+            < plans[pairs[mode][0]].bits + plans[pairs[mode][1]].bits) {
+            mode = m;
+        }
+    }
+
+    bw_byte(bw, BLOCK_CODED);
+    bw_byte(bw, (uint8_t)mode);
+    for (int c = 0; c < 2; c++) {
+        int ch = pairs[mode][c];
+        subframe_write(bw, enc, enc->channels[ch], n, &plans[ch]);
+    }
+    bw_align(bw);
+}
+
+// ブロック (n フレーム) のフレーム from から count フレームを pcm に書く。
+// scratch は 3 * OPM_CODEC_BLOCK_FRAMES 個の作業領域
+static int block_read(const uint8_t *p, const uint8_t *end, opm_sample_format_t format, int n, int from,
+                      int count, void *pcm, int32_t *scratch) {
+    if (p >= end) return -1;
+    if (*p == BLOCK_RAW) {
+        size_t bytes = sample_bytes(format);
+        if ((size_t)(end - p - 1) < bytes * 2 * (size_t)n) return -1;
+        const uint8_t *s = p + 1 + bytes * 2 * (size_t)from;
+        if (format == OPM_SAMPLE_INT16) {
+            int16_t *d = (int16_t *)pcm;
+            for (int i = 0; i < count * 2; i++) {
+                d[i] = (int16_t)(uint16_t)(s[i * 2] | (s[i * 2 + 1] << 8));
+            }
+        } else {
+            float *d = (float *)pcm;
+            for (int i = 0; i < count * 2; i++) {
+                uint32_t bits = get_u32(s + i * 4);
+                memcpy(&d[i], &bits, sizeof(bits));
+            }
+        }
+        return 0;
+    }
+    if (*p != BLOCK_CODED || end - p < 2 || p[1] > STEREO_MS) return -1;
+
+    int mode = p[1];
+    int32_t *a = scratch;
+    int32_t *b = scratch + OPM_CODEC_BLOCK_FRAMES;
+    int32_t *residual = scratch + 2 * OPM_CODEC_BLOCK_FRAMES;
+    bit_reader_t br;
+    br_init(&br, p + 2, end);
+    if (subframe_read(&br, a, n, residual) != 0 || subframe_read(&br, b, n, residual) != 0) return -1;
+
+    for (int i = from; i < from + count; i++) {
+        int32_t l, r;
+        switch (mode) {
+        case STEREO_LR: l = a[i]; r = b[i]; break;
+        case STEREO_LS: l = a[i]; r = (int32_t)((uint32_t)a[i] - (uint32_t)b[i]); break;
+        case STEREO_SR: l = (int32_t)((uint32_t)b[i] + (uint32_t)a[i]); r = b[i]; break;
+        default: {
+            int64_t side = b[i];
+            int64_t sum = ((int64_t)a[i] * 2) | (side & 1);
+            l = (int32_t)((sum + side) >> 1);
+            r = (int32_t)((sum - side) >> 1);
+            break;
+        }
+        }
+        int k = (i - from) * 2;
+        if (format == OPM_SAMPLE_INT16) {
+            ((int16_t *)pcm)[k] = (int16_t)l;
+            ((int16_t *)pcm)[k + 1] = (int16_t)r;
+        } else {
+            ((float *)pcm)[k] = (float)l / 32768.0f;
+            ((float *)pcm)[k + 1] = (float)r / 32768.0f;
+        }
+    }
+    return 0;
+}
+
+
+// ============================================================
+// 6. API
+// ============================================================
+
+void *opm_codec_encode(const void *pcm, opm_sample_format_t format, int num_frames, uint32_t sample_rate,
+                       size_t *size) {
+    if ((!pcm && num_frames > 0) || num_frames < 0 || !size) return NULL;
+
+    int num_blocks = (num_frames + OPM_CODEC_BLOCK_FRAMES - 1) / OPM_CODEC_BLOCK_FRAMES;
+    encoder_t *enc = (encoder_t *)malloc(sizeof(encoder_t));
+    uint32_t *offsets = (uint32_t *)malloc(sizeof(uint32_t) * ((size_t)num_blocks + 1));
+    bit_writer_t bw = { NULL, 0, 0, 0, 0, 0 };
+    if (!enc || !offsets) bw.error = 1;
+
+    size_t table = HEADER_SIZE + 4 * ((size_t)num_blocks + 1);
+    for (size_t i = 0; i < table && !bw.error; i++) bw_byte(&bw, 0);
+    for (int b = 0; b < num_blocks && !bw.error; b++) {
+        offsets[b] = (uint32_t)bw.size;
+        int first = b * OPM_CODEC_BLOCK_FRAMES;
+        int n = num_frames - first < OPM_CODEC_BLOCK_FRAMES ? num_frames - first : OPM_CODEC_BLOCK_FRAMES;
+        block_write(&bw, enc, pcm, format, first, n);
+        if (bw.size > UINT32_MAX) bw.error = 1;
+    }
+    free(enc);
+
+    if (bw.error) {
+        free(offsets);
+        free(bw.data);
+        return NULL;
+    }
+    offsets[num_blocks] = (uint32_t)bw.size;
+
+    uint8_t *h = bw.data;
+    memcpy(h, STREAM_MAGIC, 4);
+    h[4] = STREAM_VERSION;
+    h[5] = format == OPM_SAMPLE_INT16 ? 1 : 0;
+    h[6] = 0;
+    h[7] = 0;
+    put_u32(h + 8, sample_rate);
+    put_u32(h + 12, OPM_CODEC_BLOCK_FRAMES);
+    put_u32(h + 16, (uint32_t)num_frames);
+    put_u32(h + 20, (uint32_t)num_blocks);
+    for (int b = 0; b <= num_blocks; b++) {
+        put_u32(h + HEADER_SIZE + 4 * (size_t)b, offsets[b]);
+    }
+    free(offsets);
+    *size = bw.size;
+    return bw.data;
+}
+
+int opm_codec_info(const void *data, size_t size, opm_codec_info_t *info) {
+    const uint8_t *h = (const uint8_t *)data;
+    if (!h || !info || size < HEADER_SIZE || memcmp(h, STREAM_MAGIC, 4) != 0) return -1;
+    if (h[4] != STREAM_VERSION || h[5] > 1 || get_u32(h + 12) != OPM_CODEC_BLOCK_FRAMES) return -1;
+
+    uint32_t frames = get_u32(h + 16);
+    uint32_t blocks = get_u32(h + 20);
+    if (frames > INT32_MAX || blocks != (frames + OPM_CODEC_BLOCK_FRAMES - 1) / OPM_CODEC_BLOCK_FRAMES) return -1;
+    if ((size - HEADER_SIZE) / 4 < (size_t)blocks + 1) return -1;
+    if (get_u32(h + HEADER_SIZE + 4 * (size_t)blocks) > size) return -1;
+
+    info->format = h[5] == 1 ? OPM_SAMPLE_INT16 : OPM_SAMPLE_FLOAT32;
+    info->sample_rate = get_u32(h + 8);
+    info->num_frames = (int)frames;
+    info->num_blocks = (int)blocks;
+    return 0;
+}
+
+int opm_codec_decode(const void *data, size_t size, int first_frame, int num_frames, void *pcm) {
+    opm_codec_info_t info;
+    if (opm_codec_info(data, size, &info) != 0 || first_frame < 0 || num_frames < 0 || !pcm) return -1;
+    if (first_frame >= info.num_frames) return 0;
+    if (num_frames > info.num_frames - first_frame) num_frames = info.num_frames - first_frame;
+
+    int32_t *scratch = (int32_t *)malloc(sizeof(int32_t) * 3 * OPM_CODEC_BLOCK_FRAMES);
+    if (!scratch) return -1;
+
+    const uint8_t *bytes = (const uint8_t *)data;
+    size_t frame_bytes = sample_bytes(info.format) * 2;
+    int done = 0;
+    while (done < num_frames) {
+        int frame = first_frame + done;
+        int b = frame / OPM_CODEC_BLOCK_FRAMES;
+        int block_first = b * OPM_CODEC_BLOCK_FRAMES;
+        int n = info.num_frames - block_first < OPM_CODEC_BLOCK_FRAMES ? info.num_frames - block_first
+                                                                       : OPM_CODEC_BLOCK_FRAMES;
+        int from = frame - block_first;
+        int count = n - from < num_frames - done ? n - from : num_frames - done;
+
+        uint32_t start = get_u32(bytes + HEADER_SIZE + 4 * (size_t)b);
+        uint32_t end = get_u32(bytes + HEADER_SIZE + 4 * ((size_t)b + 1));
+        if (start > end || end > size
+            || block_read(bytes + start, bytes + end, info.format, n, from, count,
+                          (uint8_t *)pcm + frame_bytes * (size_t)done, scratch) != 0) {
+            free(scratch);
+            return -1;
+        }
+        done += count;
+    }
+    free(scratch);
+    return done;
+}
@@ -0,0 +1,48 @@
+// レンダリング結果の可逆圧縮 (.opmz)
+//
+// OPM の出力は 16 ビット程度の範囲の整数で、無音と周期的な波形が多いので、
+// 線形予測 (固定の多項式予測、または量子化した LPC 係数) の残差を Rice 符号で書く。
+//   - OPM_CODEC_BLOCK_FRAMES フレームずつのブロックに分け、ブロックの位置の表を先頭に置く。
+//     途中のフレームからでも、そのブロックだけ読めばデコードできる
+//   - ステレオは L / R、L / side、side / R、mid / side のうち小さくなるものをブロックごとに選ぶ
+//   - float で、値が 1/32768 の整数倍でないブロック (リサンプルした出力など) はそのまま書く
+//     (ビットごと元に戻るが、縮まない)
+// デコードは整数演算だけなので、エンコードしたマシンによらず同じ結果になる。
+#ifndef _OPM_CODEC_H_
+#define _OPM_CODEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "opm_renderer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 1ブロックのフレーム数 (ランダムアクセスの単位)
+#define OPM_CODEC_BLOCK_FRAMES 4096
+
+typedef struct {
+    opm_sample_format_t format;
+    uint32_t sample_rate;   // エンコード時に渡した値 (ファイルとして書くとき用。デコードには使わない)
+    int num_frames;
+    int num_blocks;
+} opm_codec_info_t;
+
+// pcm (インターリーブのステレオ num_frames フレーム。opm_renderer の出力と同じ並び) を圧縮する。
+// 戻り値は malloc したデータ (free で解放する) で、*size にバイト数を返す。失敗時は NULL
+void *opm_codec_encode(const void *pcm, opm_sample_format_t format, int num_frames, uint32_t sample_rate,
+                       size_t *size);
+
+// ヘッダを読む。壊れていれば -1
+int opm_codec_info(const void *data, size_t size, opm_codec_info_t *info);
+
+// first_frame から num_frames フレームを pcm (エンコードしたときの形式のインターリーブ) に書く。
+// 書いたフレーム数を返す (範囲が終わりを越えるときは短くなる)。壊れていれば -1
+int opm_codec_decode(const void *data, size_t size, int first_frame, int num_frames, void *pcm);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,151 @@
+// opm_codec の往復テスト (ctest から呼ぶ)
+//
+// 無音の中にまばらなスパイク、急な立ち上がり、ノイズ、サイン波などを混ぜた int16 と float の
+// 信号を opm_codec_encode して、全体と途中からの opm_codec_decode がビットごと元に戻るかを見る。
+// Rice 符号の 0 の並びがビットリーダーのキャッシュの端にかかる場合 (スパースな信号で出やすい) も
+// 含むよう、ランダムな信号をたくさん試す。
+//
+//   opm-codec-test            (既定 1000 回)
+//   opm-codec-test -n 100000 -s 7
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <getopt.h>
+#include "opm_codec.h"
+
+#define DEFAULT_TRIALS 1000
+#define MAX_FRAMES (OPM_CODEC_BLOCK_FRAMES * 2 + 123)
+
+static uint32_t xorshift32(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static int16_t clamp16(int32_t v) {
+    return (int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+}
+
+// 1チャンネル分の信号を作る。kind ごとに、スパース・急な変化・周期的なものを混ぜる
+static void make_channel(uint32_t *rng, int16_t *pcm, int num_frames, int stride) {
+    int kind = (int)(xorshift32(rng) % 6);
+    double phase = 0.0;
+    double step = 0.001 + (xorshift32(rng) % 1000) * 0.0005;
+    int32_t level = 0;
+    for (int i = 0; i < num_frames; i++) {
+        int32_t v = 0;
+        uint32_t x = xorshift32(rng);
+        switch (kind) {
+        case 0: // ほとんど 0 で、ときどき大きなスパイク
+            v = x % 997 == 0 ? (int32_t)(xorshift32(rng) % 65536) - 32768 : 0;
+            break;
+        case 1: // 無音と急な立ち上がり・減衰のくり返し
+            if (x % 2048 == 0) level = (int32_t)(xorshift32(rng) % 65536) - 32768;
+            level -= level / 16;
+            v = level;
+            break;
+        case 2: // 小さい値の並びに、たまに最大振幅
+            v = x % 1500 == 0 ? (x & 0x10000 ? 32767 : -32768) : (int32_t)(x % 3) - 1;
+            break;
+        case 3: // サイン波に短いクリック
+            phase += step;
+            v = (int32_t)(sin(phase) * 12000.0) + (x % 4000 == 0 ? 20000 : 0);
+            break;
+        case 4: // 白色ノイズ
+            v = (int32_t)(x % 65536) - 32768;
+            break;
+        default: // 長い無音のあとに1サンプルだけ
+            v = i == num_frames - 1 || x % 30011 == 0 ? 32767 : 0;
+            break;
+        }
+        pcm[(size_t)i * stride] = clamp16(v);
+    }
+}
+
+// 全体と途中から (ブロックの境界をまたぐ範囲) をデコードして比べる。一致すれば 1
+static int round_trip(const void *pcm, opm_sample_format_t format, int num_frames, uint32_t *rng) {
+    size_t frame_bytes = (format == OPM_SAMPLE_INT16 ? sizeof(int16_t) : sizeof(float)) * 2;
+    size_t size;
+    void *packed = opm_codec_encode(pcm, format, num_frames, 0, &size);
+    void *decoded = malloc(frame_bytes * (size_t)num_frames + 1);
+    int ok = packed && decoded;
+    if (ok) {
+        ok = opm_codec_decode(packed, size, 0, num_frames, decoded) == num_frames
+            && memcmp(pcm, decoded, frame_bytes * (size_t)num_frames) == 0;
+    }
+    if (ok) {
+        int first = (int)(xorshift32(rng) % (uint32_t)num_frames);
+        int count = 1 + (int)(xorshift32(rng) % (uint32_t)(num_frames - first));
+        ok = opm_codec_decode(packed, size, first, count, decoded) == count
+            && memcmp((const uint8_t *)pcm + frame_bytes * (size_t)first, decoded, frame_bytes * (size_t)count) == 0;
+    }
+    free(packed);
+    free(decoded);
+    return ok;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-n TRIALS] [-s SEED]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    int trials = DEFAULT_TRIALS;
+    uint32_t seed = 1;
+    int c;
+    while ((c = getopt(argc, argv, "n:s:h")) != -1) {
+        switch (c) {
+        case 'n': trials = atoi(optarg); break;
+        case 's': seed = (uint32_t)strtoul(optarg, NULL, 10); break;
+        default: usage(argv[0]); return c == 'h' ? 0 : 2;
+        }
+    }
+    if (trials <= 0 || seed == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int16_t *pcm16 = (int16_t *)malloc(sizeof(int16_t) * 2 * MAX_FRAMES);
+    float *pcmf = (float *)malloc(sizeof(float) * 2 * MAX_FRAMES);
+    if (!pcm16 || !pcmf) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    uint32_t rng = seed;
+    int failures = 0;
+    for (int t = 0; t < trials; t++) {
+        int num_frames = 1 + (int)(xorshift32(&rng) % MAX_FRAMES);
+        make_channel(&rng, pcm16, num_frames, 2);
+        if (xorshift32(&rng) % 4 == 0) {
+            // L と R が同じ (mid / side が効く)
+            for (int i = 0; i < num_frames; i++) pcm16[i * 2 + 1] = pcm16[i * 2];
+        } else {
+            make_channel(&rng, pcm16 + 1, num_frames, 2);
+        }
+        if (!round_trip(pcm16, OPM_SAMPLE_INT16, num_frames, &rng)) {
+            fprintf(stderr, "trial %d: int16 round trip failed (%d frames)\n", t, num_frames);
+            failures++;
+        }
+
+        // float は 1/32768 の整数倍 (圧縮する) のものと、そうでないブロック (そのまま書く) を混ぜる
+        int raw = xorshift32(&rng) % 8 == 0;
+        for (int i = 0; i < num_frames * 2; i++) {
+            pcmf[i] = (float)pcm16[i] / 32768.0f + (raw && i % 4096 == 17 ? 1e-7f : 0.0f);
+        }
+        if (!round_trip(pcmf, OPM_SAMPLE_FLOAT32, num_frames, &rng)) {
+            fprintf(stderr, "trial %d: float round trip failed (%d frames)\n", t, num_frames);
+            failures++;
+        }
+    }
+
+    free(pcm16);
+    free(pcmf);
+    printf("%d trials, %d failures\n", trials, failures);
+    return failures ? 1 : 0;
+}
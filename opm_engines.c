@@ -0,0 +1,417 @@
+/* 検証用のエンジン
+ *
+ * opm-golden / opm-fuzz が出力とチップの状態を比べるエンジンの一覧。
+ * 1番目の reference が基準 (OPM_Clock をそのまま回す) で、ほかはそれと
+ * ビット単位で同じ結果になるはずのもの。
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "opm.h"
+#include "opm_simd.h"
+#include "opm_renderer.h"
+#include "opm_engines.h"
+
+#define OPM_CLOCK 3579545
+#define CLOCK_STEP 64
+#define BUSY_CYCLES 128
+#define SAMPLE_RATE ((double)OPM_CLOCK / CLOCK_STEP)
+#define SAMPLES_PER_ACCESS ((double)BUSY_CYCLES / CLOCK_STEP)
+
+// renderer / stems が1回に render_block するフレーム数
+#define ENGINE_BLOCK_FRAMES 1024
+
+// 報告するチップ状態の違いの数
+#define MAX_FIELD_REPORT 12
+
+// fast が reference と比べて許す差 (LFO とテストレジスタを止めた入力で。フルスケールの約 -54dB)。
+// 鳴っている最中の RL/FB/CON や DT2 の書き換えは、チャンネルごとに届くクロックまでは追わず
+// round の境目で反映するので、ランダムな書き込み列の 0.2% ほどはこれを超えてずれる
+#define FAST_TOLERANCE 64
+
+
+// ============================================================
+// 1. Sequencer
+// ============================================================
+
+// opm_renderer の sequencer と同じ (参照実装はレンダラーに依存させない)
+typedef struct {
+    const opm_event_t *events;
+    int count;
+    int index;
+    double next_available;
+    int pending_data;
+    int position;
+} sequencer_t;
+
+static void sequencer_init(sequencer_t *s, const opm_event_t *events, int count) {
+    memset(s, 0, sizeof(*s));
+    s->events = events;
+    s->count = count;
+}
+
+static int sequencer_next(sequencer_t *s, uint32_t *port, uint8_t *data) {
+    int sample = s->position;
+    if (s->index >= s->count) return 0;
+
+    const opm_event_t *evt = &s->events[s->index];
+    if ((double)sample < evt->time * SAMPLE_RATE) return 0;
+    if ((double)sample < s->next_available) return 0;
+
+    if (!s->pending_data) {
+        *port = 0;
+        *data = evt->addr;
+        s->pending_data = 1;
+    } else {
+        *port = 1;
+        *data = evt->data;
+        s->pending_data = 0;
+        s->index++;
+    }
+    s->next_available = (double)sample + SAMPLES_PER_ACCESS;
+    return 1;
+}
+
+// ============================================================
+// 2. Engines
+// ============================================================
+
+// --- reference: OPM_Clock をそのまま回す ---
+
+typedef struct {
+    opm_t chip;
+    sequencer_t seq;
+} reference_engine_t;
+
+static void *reference_create(void) {
+    return calloc(1, sizeof(reference_engine_t));
+}
+
+static void reference_start(void *engine, const opm_event_t *events, int count) {
+    reference_engine_t *e = (reference_engine_t *)engine;
+    OPM_Reset(&e->chip, OPM_CLOCK);
+    sequencer_init(&e->seq, events, count);
+}
+
+static int reference_render(void *engine, int32_t *out, int frames) {
+    reference_engine_t *e = (reference_engine_t *)engine;
+    for (int i = 0; i < frames; i++) {
+        uint32_t port;
+        uint8_t data;
+        if (sequencer_next(&e->seq, &port, &data)) OPM_Write(&e->chip, port, data);
+        e->seq.position++;
+
+        uint8_t sh1, sh2, so;
+        for (int j = 0; j < CLOCK_STEP; j++) {
+            OPM_Clock(&e->chip, &out[i * 2], &sh1, &sh2, &so);
+        }
+    }
+    return frames;
+}
+
+static void reference_state(void *engine, opm_t *chip) {
+    memcpy(chip, &((reference_engine_t *)engine)->chip, sizeof(opm_t));
+}
+
+// --- renderer / stems / fast: opm_renderer (float の出力を int に戻す) ---
+
+typedef struct {
+    opm_renderer_t *renderer;
+    float buffer[ENGINE_BLOCK_FRAMES * 2];
+    int stems;
+} renderer_engine_t;
+
+static void *renderer_create_engine(int stems, opm_renderer_engine_t kind) {
+    renderer_engine_t *e = (renderer_engine_t *)calloc(1, sizeof(renderer_engine_t));
+    if (!e) return NULL;
+    e->renderer = opm_renderer_create();
+    if (!e->renderer || opm_renderer_set_engine(e->renderer, kind) != 0) {
+        opm_renderer_destroy(e->renderer);
+        free(e);
+        return NULL;
+    }
+    e->stems = stems;
+    return e;
+}
+
+static void *renderer_create(void) {
+    return renderer_create_engine(0, OPM_RENDERER_ENGINE_NUKED);
+}
+
+static void *stems_create(void) {
+    return renderer_create_engine(1, OPM_RENDERER_ENGINE_NUKED);
+}
+
+static void *fast_create(void) {
+    return renderer_create_engine(0, OPM_RENDERER_ENGINE_FAST);
+}
+
+static void renderer_destroy(void *engine) {
+    renderer_engine_t *e = (renderer_engine_t *)engine;
+    if (!e) return;
+    opm_renderer_destroy(e->renderer);
+    free(e);
+}
+
+static void renderer_start(void *engine, const opm_event_t *events, int count) {
+    renderer_engine_t *e = (renderer_engine_t *)engine;
+    opm_renderer_start(e->renderer, events, count);
+}
+
+static int renderer_render(void *engine, int32_t *out, int frames) {
+    renderer_engine_t *e = (renderer_engine_t *)engine;
+    opm_output_t master;
+    opm_output_init_interleaved(&master, OPM_SAMPLE_FLOAT32, e->buffer);
+
+    int done = 0;
+    while (done < frames) {
+        int n = frames - done < ENGINE_BLOCK_FRAMES ? frames - done : ENGINE_BLOCK_FRAMES;
+        int got;
+        if (e->stems) {
+            opm_output_t stems[OPM_RENDERER_NUM_CHANNELS];
+            memset(stems, 0, sizeof(stems));
+            got = opm_renderer_render_stems(e->renderer, n, &master, stems);
+        } else {
+            got = opm_renderer_render_block(e->renderer, n, &master);
+        }
+        if (got != n) return done;
+
+        // float は int の値 / 32768 なので誤差なく戻る
+        for (int i = 0; i < n * 2; i++) {
+            out[done * 2 + i] = (int32_t)(e->buffer[i] * 32768.0f);
+        }
+        done += n;
+    }
+    return done;
+}
+
+static void renderer_state(void *engine, opm_t *chip) {
+    memcpy(chip, opm_renderer_chip(((renderer_engine_t *)engine)->renderer), sizeof(opm_t));
+}
+
+// --- simd: 全レーンで同じ列を鳴らし、全レーンが一致することも確かめる ---
+
+typedef struct {
+    opm_simd_t chip;
+    sequencer_t seq[OPM_SIMD_LANES];
+    int lane_mismatch;
+} simd_engine_t;
+
+static void *simd_create(void) {
+    return calloc(1, sizeof(simd_engine_t));
+}
+
+static void simd_start(void *engine, const opm_event_t *events, int count) {
+    simd_engine_t *e = (simd_engine_t *)engine;
+    OPM_SIMD_Reset(&e->chip, OPM_CLOCK);
+    for (int l = 0; l < OPM_SIMD_LANES; l++) {
+        sequencer_init(&e->seq[l], events, count);
+    }
+    e->lane_mismatch = 0;
+}
+
+static int simd_render(void *engine, int32_t *out, int frames) {
+    simd_engine_t *e = (simd_engine_t *)engine;
+    int32_t sample_buf[OPM_SIMD_LANES * 2];
+
+    for (int i = 0; i < frames; i++) {
+        for (int l = 0; l < OPM_SIMD_LANES; l++) {
+            uint32_t port;
+            uint8_t data;
+            if (sequencer_next(&e->seq[l], &port, &data)) OPM_SIMD_Write(&e->chip, l, port, data);
+            e->seq[l].position++;
+        }
+        for (int j = 0; j < CLOCK_STEP; j++) {
+            OPM_SIMD_Clock(&e->chip, sample_buf);
+        }
+
+        out[i * 2 + 0] = sample_buf[0];
+        out[i * 2 + 1] = sample_buf[1];
+        for (int l = 1; l < OPM_SIMD_LANES; l++) {
+            if (sample_buf[l * 2] != sample_buf[0] || sample_buf[l * 2 + 1] != sample_buf[1]) {
+                // レーン 0 と違う値を出したレーンがあれば、レーン 0 の結果を壊して不一致にする
+                if (!e->lane_mismatch) {
+                    fprintf(stderr, "simd: lane %d differs from lane 0 at frame %d\n", l, e->seq[0].position - 1);
+                }
+                e->lane_mismatch = 1;
+                out[i * 2 + 0] = sample_buf[l * 2];
+                out[i * 2 + 1] = sample_buf[l * 2 + 1];
+                break;
+            }
+        }
+    }
+    return frames;
+}
+
+static void simd_state(void *engine, opm_t *chip) {
+    memset(chip, 0, sizeof(opm_t));
+    OPM_SIMD_StoreLane(&((simd_engine_t *)engine)->chip, 0, chip);
+}
+
+static const opm_engine_t engines[] = {
+    { "reference", reference_create, free, reference_start, reference_render, reference_state },
+    { "renderer", renderer_create, renderer_destroy, renderer_start, renderer_render, renderer_state },
+    { "stems", stems_create, renderer_destroy, renderer_start, renderer_render, renderer_state },
+    { "simd", simd_create, free, simd_start, simd_render, simd_state },
+    { "fast", fast_create, renderer_destroy, renderer_start, renderer_render, renderer_state, 1, FAST_TOLERANCE },
+};
+
+#define NUM_ENGINES ((int)(sizeof(engines) / sizeof(engines[0])))
+
+int opm_engine_count(void) {
+    return NUM_ENGINES;
+}
+
+const opm_engine_t *opm_engine_get(int index) {
+    return index >= 0 && index < NUM_ENGINES ? &engines[index] : NULL;
+}
+
+const opm_engine_t *opm_engine_find(const char *name) {
+    for (int i = 0; i < NUM_ENGINES; i++) {
+        if (strcmp(engines[i].name, name) == 0) return &engines[i];
+    }
+    return NULL;
+}
+
+// 近似エンジンがずれるものを止めた値にする。LFO は 0x19 の AMD / PMD の選択 (bit 7) と
+// 0x1B の CT だけ残し、テストレジスタ (0x01、opp では 0x09) は 0 にする
+static int approx_masked(const opm_event_t *evt, uint8_t *data) {
+    if ((evt->addr == 0x01 || evt->addr == 0x09) && evt->data != 0) {
+        *data = 0;
+        return 1;
+    }
+    if (evt->addr == 0x19 && (evt->data & 0x7f) != 0) {
+        *data = evt->data & 0x80;
+        return 1;
+    }
+    if (evt->addr == 0x1b && (evt->data & 0x03) != 0) {
+        *data = evt->data & 0xfc;
+        return 1;
+    }
+    return 0;
+}
+
+int opm_engine_mask_approx(opm_event_t *events, int count) {
+    int masked = 0;
+    for (int i = 0; i < count; i++) {
+        uint8_t data;
+        if (approx_masked(&events[i], &data)) {
+            events[i].data = data;
+            masked++;
+        }
+    }
+    return masked;
+}
+
+int opm_engine_uses_approx(const opm_event_t *events, int count) {
+    for (int i = 0; i < count; i++) {
+        uint8_t data;
+        if (approx_masked(&events[i], &data)) return 1;
+    }
+    return 0;
+}
+
+int opm_engine_frame_matches(const opm_engine_t *engine, const int32_t expected[2], const int32_t actual[2]) {
+    if (!engine->approximate) return expected[0] == actual[0] && expected[1] == actual[1];
+    int32_t dl = expected[0] - actual[0];
+    int32_t dr = expected[1] - actual[1];
+    return dl >= -engine->tolerance && dl <= engine->tolerance && dr >= -engine->tolerance && dr <= engine->tolerance;
+}
+
+
+// ============================================================
+// 3. Chip State Diff
+// ============================================================
+
+typedef struct {
+    const char *name;
+    size_t offset;
+    size_t size;
+} chip_field_t;
+
+#define CHIP_FIELD(f) { #f, offsetof(opm_t, f), sizeof(((opm_t *)0)->f) }
+
+static const chip_field_t chip_fields[] = {
+    CHIP_FIELD(cycles), CHIP_FIELD(ic), CHIP_FIELD(ic2), CHIP_FIELD(opp), CHIP_FIELD(write_data),
+    CHIP_FIELD(write_a), CHIP_FIELD(write_a_en), CHIP_FIELD(write_d), CHIP_FIELD(write_d_en),
+    CHIP_FIELD(write_busy), CHIP_FIELD(write_busy_cnt), CHIP_FIELD(mode_address), CHIP_FIELD(io_ct1),
+    CHIP_FIELD(io_ct2), CHIP_FIELD(lfo_am_lock), CHIP_FIELD(lfo_pm_lock), CHIP_FIELD(lfo_counter1),
+    CHIP_FIELD(lfo_counter1_of1), CHIP_FIELD(lfo_counter1_of2), CHIP_FIELD(lfo_counter2),
+    CHIP_FIELD(lfo_counter2_load), CHIP_FIELD(lfo_counter2_of), CHIP_FIELD(lfo_counter2_of_lock),
+    CHIP_FIELD(lfo_counter2_of_lock2), CHIP_FIELD(lfo_counter3_clock), CHIP_FIELD(lfo_counter3),
+    CHIP_FIELD(lfo_counter3_step), CHIP_FIELD(lfo_frq_update), CHIP_FIELD(lfo_clock),
+    CHIP_FIELD(lfo_clock_lock), CHIP_FIELD(lfo_clock_test), CHIP_FIELD(lfo_test), CHIP_FIELD(lfo_val),
+    CHIP_FIELD(lfo_val_carry), CHIP_FIELD(lfo_out1), CHIP_FIELD(lfo_out2), CHIP_FIELD(lfo_out2_b),
+    CHIP_FIELD(lfo_mult_carry), CHIP_FIELD(lfo_trig_sign), CHIP_FIELD(lfo_saw_sign),
+    CHIP_FIELD(lfo_bit_counter), CHIP_FIELD(eg_state), CHIP_FIELD(eg_level), CHIP_FIELD(eg_rate),
+    CHIP_FIELD(eg_sl), CHIP_FIELD(eg_tl), CHIP_FIELD(eg_tl_opp), CHIP_FIELD(eg_zr),
+    CHIP_FIELD(eg_timershift_lock), CHIP_FIELD(eg_timer_lock), CHIP_FIELD(eg_inchi), CHIP_FIELD(eg_shift),
+    CHIP_FIELD(eg_clock), CHIP_FIELD(eg_clockcnt), CHIP_FIELD(eg_clockquotinent), CHIP_FIELD(eg_inc),
+    CHIP_FIELD(eg_ratemax), CHIP_FIELD(eg_instantattack), CHIP_FIELD(eg_inclinear), CHIP_FIELD(eg_incattack),
+    CHIP_FIELD(eg_mute), CHIP_FIELD(eg_outtemp), CHIP_FIELD(eg_out), CHIP_FIELD(eg_am), CHIP_FIELD(eg_ams),
+    CHIP_FIELD(eg_timercarry), CHIP_FIELD(eg_timer), CHIP_FIELD(eg_timer2), CHIP_FIELD(eg_timerbstop),
+    CHIP_FIELD(eg_serial), CHIP_FIELD(eg_serial_bit), CHIP_FIELD(eg_test), CHIP_FIELD(pg_fnum),
+    CHIP_FIELD(pg_kcode), CHIP_FIELD(pg_inc), CHIP_FIELD(pg_phase), CHIP_FIELD(pg_reset),
+    CHIP_FIELD(pg_reset_latch), CHIP_FIELD(pg_serial), CHIP_FIELD(pg_opp_pms), CHIP_FIELD(pg_opp_dt2),
+    CHIP_FIELD(op_phase_in), CHIP_FIELD(op_mod_in), CHIP_FIELD(op_phase), CHIP_FIELD(op_logsin),
+    CHIP_FIELD(op_atten), CHIP_FIELD(op_exp), CHIP_FIELD(op_pow), CHIP_FIELD(op_sign), CHIP_FIELD(op_out),
+    CHIP_FIELD(op_connect), CHIP_FIELD(op_counter), CHIP_FIELD(op_fbupdate), CHIP_FIELD(op_fbshift),
+    CHIP_FIELD(op_c1update), CHIP_FIELD(op_modtable), CHIP_FIELD(op_m1), CHIP_FIELD(op_c1),
+    CHIP_FIELD(op_mod), CHIP_FIELD(op_fb), CHIP_FIELD(op_mixl), CHIP_FIELD(op_mixr), CHIP_FIELD(op_opp_rl),
+    CHIP_FIELD(op_opp_fb), CHIP_FIELD(mix), CHIP_FIELD(mix2), CHIP_FIELD(mix_op), CHIP_FIELD(mix_serial),
+    CHIP_FIELD(mix_bits), CHIP_FIELD(mix_top_bits_lock), CHIP_FIELD(mix_sign_lock),
+    CHIP_FIELD(mix_sign_lock2), CHIP_FIELD(mix_exp_lock), CHIP_FIELD(mix_clamp_low),
+    CHIP_FIELD(mix_clamp_high), CHIP_FIELD(mix_out_bit), CHIP_FIELD(smp_so), CHIP_FIELD(smp_sh1),
+    CHIP_FIELD(smp_sh2), CHIP_FIELD(noise_lfsr), CHIP_FIELD(noise_timer), CHIP_FIELD(noise_timer_of),
+    CHIP_FIELD(noise_update), CHIP_FIELD(noise_bit), CHIP_FIELD(mode_test), CHIP_FIELD(mode_kon_operator),
+    CHIP_FIELD(mode_kon_channel), CHIP_FIELD(reg_address), CHIP_FIELD(reg_address_ready),
+    CHIP_FIELD(reg_data), CHIP_FIELD(reg_data_ready), CHIP_FIELD(ch_rl), CHIP_FIELD(ch_fb),
+    CHIP_FIELD(ch_connect), CHIP_FIELD(ch_kc), CHIP_FIELD(ch_kf), CHIP_FIELD(ch_pms), CHIP_FIELD(ch_ams),
+    CHIP_FIELD(sl_dt1), CHIP_FIELD(sl_mul), CHIP_FIELD(sl_tl), CHIP_FIELD(sl_ks), CHIP_FIELD(sl_ar),
+    CHIP_FIELD(sl_am_e), CHIP_FIELD(sl_d1r), CHIP_FIELD(sl_dt2), CHIP_FIELD(sl_d2r), CHIP_FIELD(sl_d1l),
+    CHIP_FIELD(sl_rr), CHIP_FIELD(noise_en), CHIP_FIELD(noise_freq), CHIP_FIELD(ch_ramp_div),
+    CHIP_FIELD(reg_20_delay), CHIP_FIELD(reg_28_delay), CHIP_FIELD(reg_30_delay), CHIP_FIELD(opp_tl_cnt),
+    CHIP_FIELD(opp_tl), CHIP_FIELD(timer_a_reg), CHIP_FIELD(timer_b_reg), CHIP_FIELD(timer_a_temp),
+    CHIP_FIELD(timer_a_do_reset), CHIP_FIELD(timer_a_do_load), CHIP_FIELD(timer_a_inc),
+    CHIP_FIELD(timer_a_val), CHIP_FIELD(timer_a_of), CHIP_FIELD(timer_a_load), CHIP_FIELD(timer_a_status),
+    CHIP_FIELD(timer_b_sub), CHIP_FIELD(timer_b_sub_of), CHIP_FIELD(timer_b_inc), CHIP_FIELD(timer_b_val),
+    CHIP_FIELD(timer_b_of), CHIP_FIELD(timer_b_do_reset), CHIP_FIELD(timer_b_do_load),
+    CHIP_FIELD(timer_b_temp), CHIP_FIELD(timer_b_status), CHIP_FIELD(timer_irq), CHIP_FIELD(lfo_freq_hi),
+    CHIP_FIELD(lfo_freq_lo), CHIP_FIELD(lfo_pmd), CHIP_FIELD(lfo_amd), CHIP_FIELD(lfo_wave),
+    CHIP_FIELD(timer_irqa), CHIP_FIELD(timer_irqb), CHIP_FIELD(timer_loada), CHIP_FIELD(timer_loadb),
+    CHIP_FIELD(timer_reseta), CHIP_FIELD(timer_resetb), CHIP_FIELD(mode_csm), CHIP_FIELD(nc_active),
+    CHIP_FIELD(nc_active_lock), CHIP_FIELD(nc_sign), CHIP_FIELD(nc_sign_lock), CHIP_FIELD(nc_sign_lock2),
+    CHIP_FIELD(nc_bit), CHIP_FIELD(nc_out), CHIP_FIELD(op_mix), CHIP_FIELD(kon_csm), CHIP_FIELD(kon_csm_lock),
+    CHIP_FIELD(kon_do), CHIP_FIELD(kon_chanmatch), CHIP_FIELD(kon), CHIP_FIELD(kon2), CHIP_FIELD(mode_kon),
+    CHIP_FIELD(dac_osh1), CHIP_FIELD(dac_osh2), CHIP_FIELD(dac_bits), CHIP_FIELD(dac_output),
+};
+
+#define NUM_CHIP_FIELDS ((int)(sizeof(chip_fields) / sizeof(chip_fields[0])))
+
+int opm_engine_chip_diff(const opm_t *expected, const opm_t *actual, FILE *report) {
+    const uint8_t *a = (const uint8_t *)expected;
+    const uint8_t *b = (const uint8_t *)actual;
+    int differences = 0;
+    for (int i = 0; i < NUM_CHIP_FIELDS; i++) {
+        const chip_field_t *f = &chip_fields[i];
+        if (memcmp(a + f->offset, b + f->offset, f->size) == 0) continue;
+        if (report && differences < MAX_FIELD_REPORT) {
+            fprintf(report, "    %-24s", f->name);
+            // 配列は最初に違うバイトだけ出す
+            for (size_t k = 0; k < f->size; k++) {
+                if (a[f->offset + k] != b[f->offset + k]) {
+                    fprintf(report, " byte %zu: expected 0x%02x, got 0x%02x", k, a[f->offset + k], b[f->offset + k]);
+                    break;
+                }
+            }
+            fputc('\n', report);
+        }
+        differences++;
+    }
+    if (report && differences > MAX_FIELD_REPORT) {
+        fprintf(report, "    ... and %d more fields\n", differences - MAX_FIELD_REPORT);
+    }
+    return differences;
+}
@@ -0,0 +1,62 @@
+/* 検証用のエンジン (opm-golden / opm-fuzz 用)
+ *
+ * どのエンジンも OPM_Reset から始め、opm_renderer と同じタイミング
+ * (1 書き込み 2 サンプル) でイベントを書き、1フレームごとに OPM の生の出力
+ * (int32 の L / R) を返す。opm_engine_get(0) が基準の reference で、
+ * ほかのエンジンは出力もチップの状態もそれとビット単位で一致するはず。
+ * 速いエンジンを足したときはここに登録すると、両方のツールで検証される。
+ * ビット一致しない近似エンジン (fast) は approximate を立てて登録する。
+ * そのエンジンには LFO とテストレジスタを止めた入力 (opm_engine_mask_approx) だけを渡し、
+ * 出力を tolerance までの差で比べる (チップの状態とゴールデンファイルのハッシュは比べない)。
+ */
+#ifndef _OPM_ENGINES_H_
+#define _OPM_ENGINES_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "opm.h"
+#include "opm_renderer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    const char *name;
+    void *(*create)(void);
+    void (*destroy)(void *engine);
+    // events は最後の render まで有効であること
+    void (*start)(void *engine, const opm_event_t *events, int count);
+    // frames フレームを out ([L0, R0, L1, R1, ...]) に書く。書いたフレーム数を返す
+    int (*render)(void *engine, int32_t *out, int frames);
+    // 現在のチップの状態を chip に書く
+    void (*state)(void *engine, opm_t *chip);
+    // 0 ならビット一致するはずのエンジン。1 なら上の近似エンジン
+    int approximate;
+    // approximate のとき、reference と比べて許す L / R の差 (OPM の生の出力の単位)
+    int32_t tolerance;
+} opm_engine_t;
+
+int opm_engine_count(void);
+const opm_engine_t *opm_engine_get(int index);
+const opm_engine_t *opm_engine_find(const char *name);
+
+// LFO の深さ (0x19) と波形 (0x1B の下位 2 ビット)、テストレジスタ (0x01 / 0x09) の書き込みを 0 にする。
+// 近似エンジンはこれらを使うと大きくずれるので、比べる前に入力をこうする。書き換えた数を返す
+int opm_engine_mask_approx(opm_event_t *events, int count);
+// events に opm_engine_mask_approx で書き換わるもの (LFO、テストレジスタ) があるか
+int opm_engine_uses_approx(const opm_event_t *events, int count);
+
+// expected (reference) と actual の1フレームが engine として一致するか
+// (ビット一致のエンジンは同じ値、近似エンジンは tolerance までの差)
+int opm_engine_frame_matches(const opm_engine_t *engine, const int32_t expected[2], const int32_t actual[2]);
+
+// opm_t をフィールドごとに比べ、違うフィールドの数を返す。
+// report が NULL でなければ違うフィールドと最初に違うバイトを書く
+int opm_engine_chip_diff(const opm_t *expected, const opm_t *actual, FILE *report);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,390 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <float.h>
+#include <math.h>
+#include "opm_events.h"
+
+// 必要な部分だけ読む最小限の JSON パーサー。
+// 知らないキーの値は型を問わず読み飛ばす
+
+#define JSON_MAX_DEPTH 64
+
+typedef struct {
+    const char *p;
+    const char *end;
+    char *error;
+    size_t error_size;
+} json_reader_t;
+
+typedef struct {
+    opm_event_t *items;
+    int count;
+    int capacity;
+} event_list_t;
+
+
+// ============================================================
+// 1. Reader Primitives
+// ============================================================
+
+static int json_fail(json_reader_t *r, const char *message) {
+    if (r->error && r->error_size > 0) {
+        snprintf(r->error, r->error_size, "%s", message);
+    }
+    return -1;
+}
+
+static void json_skip_ws(json_reader_t *r) {
+    while (r->p < r->end && isspace((unsigned char)*r->p)) {
+        r->p++;
+    }
+}
+
+// 空白を飛ばして次の文字が c なら消費して 1 を返す
+static int json_accept(json_reader_t *r, char c) {
+    json_skip_ws(r);
+    if (r->p < r->end && *r->p == c) {
+        r->p++;
+        return 1;
+    }
+    return 0;
+}
+
+// 文字列を out に読む (out_size を超えた分は切り捨て)。
+// エスケープは \uXXXX 以外をそのまま1文字として扱う (キーと数値文字列しか読まないため)
+static int json_read_string(json_reader_t *r, char *out, size_t out_size) {
+    if (!json_accept(r, '"')) return json_fail(r, "expected string");
+
+    size_t n = 0;
+    while (r->p < r->end && *r->p != '"') {
+        char c = *r->p++;
+        if (c == '\\') {
+            if (r->p >= r->end) break;
+            c = *r->p++;
+            if (c == 'u') {
+                r->p = (r->end - r->p >= 4) ? r->p + 4 : r->end;
+                c = '?';
+            }
+        }
+        if (out && n + 1 < out_size) {
+            out[n++] = c;
+        }
+    }
+    if (out && out_size > 0) out[n] = '\0';
+
+    if (r->p >= r->end) return json_fail(r, "unterminated string");
+    r->p++;
+    return 0;
+}
+
+// 数値、または "0x20" のような数値文字列を読む
+static int json_read_number(json_reader_t *r, double *value) {
+    json_skip_ws(r);
+    char text[64];
+
+    if (r->p < r->end && *r->p == '"') {
+        if (json_read_string(r, text, sizeof(text)) != 0) return -1;
+    } else {
+        size_t n = 0;
+        while (r->p < r->end && (isalnum((unsigned char)*r->p) || strchr("+-.", *r->p))) {
+            if (n + 1 < sizeof(text)) text[n++] = *r->p;
+            r->p++;
+        }
+        text[n] = '\0';
+    }
+
+    char *endp;
+    const char *s = text;
+    while (isspace((unsigned char)*s)) s++;
+    if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        *value = (double)strtol(s, &endp, 16);
+    } else {
+        *value = strtod(s, &endp);
+    }
+    if (endp == s) return json_fail(r, "expected number");
+    return 0;
+}
+
+static int json_skip_value(json_reader_t *r, int depth) {
+    if (depth > JSON_MAX_DEPTH) return json_fail(r, "nesting too deep");
+
+    json_skip_ws(r);
+    if (r->p >= r->end) return json_fail(r, "unexpected end of input");
+
+    char c = *r->p;
+    if (c == '"') {
+        return json_read_string(r, NULL, 0);
+    }
+    if (c == '{' || c == '[') {
+        char close = c == '{' ? '}' : ']';
+        r->p++;
+        if (json_accept(r, close)) return 0;
+        do {
+            if (c == '{') {
+                if (json_read_string(r, NULL, 0) != 0) return -1;
+                if (!json_accept(r, ':')) return json_fail(r, "expected ':'");
+            }
+            if (json_skip_value(r, depth + 1) != 0) return -1;
+        } while (json_accept(r, ','));
+        if (!json_accept(r, close)) return json_fail(r, c == '{' ? "expected '}'" : "expected ']'");
+        return 0;
+    }
+
+    // 数値 / true / false / null
+    const char *start = r->p;
+    while (r->p < r->end && (isalnum((unsigned char)*r->p) || strchr("+-.", *r->p))) {
+        r->p++;
+    }
+    if (r->p == start) return json_fail(r, "unexpected character");
+    return 0;
+}
+
+
+// ============================================================
+// 2. Events
+// ============================================================
+
+static int event_list_push(event_list_t *list, const opm_event_t *evt) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity > 0 ? list->capacity * 2 : 64;
+        opm_event_t *items = (opm_event_t *)realloc(list->items, sizeof(opm_event_t) * capacity);
+        if (!items) return -1;
+        list->items = items;
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = *evt;
+    return 0;
+}
+
+// { "time": ..., "addr": ..., "data": ... }
+static int json_read_event(json_reader_t *r, opm_event_t *evt) {
+    memset(evt, 0, sizeof(*evt));
+    if (!json_accept(r, '{')) return json_fail(r, "expected event object");
+    if (json_accept(r, '}')) return 0;
+
+    do {
+        char key[32];
+        if (json_read_string(r, key, sizeof(key)) != 0) return -1;
+        if (!json_accept(r, ':')) return json_fail(r, "expected ':'");
+
+        // 範囲外の値を整数型 / float に変換するのは未定義動作なので、先に弾く
+        double value;
+        if (strcmp(key, "time") == 0) {
+            if (json_read_number(r, &value) != 0) return -1;
+            if (!isinf(value) && (value > FLT_MAX || value < -FLT_MAX)) return json_fail(r, "\"time\" out of range");
+            evt->time = (float)value;
+        } else if (strcmp(key, "addr") == 0) {
+            if (json_read_number(r, &value) != 0) return -1;
+            if (!(value >= 0.0 && value < 256.0)) return json_fail(r, "\"addr\" must be 0..255");
+            evt->addr = (uint8_t)value;
+        } else if (strcmp(key, "data") == 0) {
+            if (json_read_number(r, &value) != 0) return -1;
+            if (!(value >= 0.0 && value < 256.0)) return json_fail(r, "\"data\" must be 0..255");
+            evt->data = (uint8_t)value;
+        } else {
+            if (json_skip_value(r, 1) != 0) return -1;
+        }
+    } while (json_accept(r, ','));
+
+    if (!json_accept(r, '}')) return json_fail(r, "expected '}'");
+    return 0;
+}
+
+// { "name": ..., "events": [ ... ], ... } から events (と name) を読む。name は NULL 可
+static int json_read_events_object(json_reader_t *r, event_list_t *list, char *name, size_t name_size) {
+    int found = 0;
+    if (!json_accept(r, '{')) return json_fail(r, "expected object");
+    if (json_accept(r, '}')) return json_fail(r, "missing \"events\"");
+
+    do {
+        char key[32];
+        if (json_read_string(r, key, sizeof(key)) != 0) return -1;
+        if (!json_accept(r, ':')) return json_fail(r, "expected ':'");
+
+        if (strcmp(key, "name") == 0 && name) {
+            json_skip_ws(r);
+            if (r->p < r->end && *r->p == '"') {
+                if (json_read_string(r, name, name_size) != 0) return -1;
+            } else if (json_skip_value(r, 1) != 0) {
+                return -1;
+            }
+        } else if (strcmp(key, "events") == 0 && !found) {
+            found = 1;
+            if (!json_accept(r, '[')) return json_fail(r, "\"events\" must be an array");
+            if (!json_accept(r, ']')) {
+                do {
+                    opm_event_t evt;
+                    if (json_read_event(r, &evt) != 0) return -1;
+                    if (event_list_push(list, &evt) != 0) return json_fail(r, "out of memory");
+                } while (json_accept(r, ','));
+                if (!json_accept(r, ']')) return json_fail(r, "expected ']'");
+            }
+        } else {
+            if (json_skip_value(r, 1) != 0) return -1;
+        }
+    } while (json_accept(r, ','));
+
+    if (!json_accept(r, '}')) return json_fail(r, "expected '}'");
+    if (!found) return json_fail(r, "missing \"events\"");
+    return 0;
+}
+
+int opm_events_parse_json(const char *json, size_t length, int preset, opm_event_t **events, int *count,
+                          char *error, size_t error_size) {
+    json_reader_t r = { json, json + length, error, error_size };
+    event_list_t list = { NULL, 0, 0 };
+    int result;
+
+    *events = NULL;
+    *count = 0;
+
+    json_skip_ws(&r);
+    if (r.p < r.end && *r.p == '[') {
+        // プリセットの配列 (presets.json)
+        r.p++;
+        result = json_fail(&r, "preset index out of range");
+        for (int i = 0; !json_accept(&r, ']'); i++) {
+            if (i > 0 && !json_accept(&r, ',')) {
+                result = json_fail(&r, "expected ','");
+                break;
+            }
+            if (i == preset) {
+                result = json_read_events_object(&r, &list, NULL, 0);
+                break;
+            }
+            if (json_skip_value(&r, 1) != 0) {
+                result = -1;
+                break;
+            }
+        }
+    } else {
+        result = json_read_events_object(&r, &list, NULL, 0);
+    }
+
+    if (result != 0) {
+        free(list.items);
+        return -1;
+    }
+
+    *events = list.items;
+    *count = list.count;
+    return 0;
+}
+
+static int bank_push(opm_preset_t **presets, int *count, int *capacity, const opm_preset_t *preset) {
+    if (*count == *capacity) {
+        int grown_capacity = *capacity > 0 ? *capacity * 2 : 16;
+        opm_preset_t *grown = (opm_preset_t *)realloc(*presets, sizeof(opm_preset_t) * grown_capacity);
+        if (!grown) return -1;
+        *presets = grown;
+        *capacity = grown_capacity;
+    }
+    (*presets)[(*count)++] = *preset;
+    return 0;
+}
+
+int opm_events_parse_bank(const char *json, size_t length, opm_preset_t **presets, int *count,
+                          char *error, size_t error_size) {
+    json_reader_t r = { json, json + length, error, error_size };
+    opm_preset_t *items = NULL;
+    int n = 0;
+    int capacity = 0;
+    int result = 0;
+
+    *presets = NULL;
+    *count = 0;
+
+    json_skip_ws(&r);
+    int is_array = r.p < r.end && *r.p == '[';
+    if (is_array) r.p++;
+
+    for (int i = 0; ; i++) {
+        if (is_array) {
+            if (json_accept(&r, ']')) break;
+            if (i > 0 && !json_accept(&r, ',')) {
+                result = json_fail(&r, "expected ','");
+                break;
+            }
+        } else if (i > 0) {
+            break;
+        }
+
+        opm_preset_t preset;
+        event_list_t list = { NULL, 0, 0 };
+        memset(&preset, 0, sizeof(preset));
+        result = json_read_events_object(&r, &list, preset.name, sizeof(preset.name));
+        preset.events = list.items;
+        preset.count = list.count;
+        if (result == 0 && bank_push(&items, &n, &capacity, &preset) != 0) {
+            result = json_fail(&r, "out of memory");
+        }
+        if (result != 0) {
+            free(list.items);
+            break;
+        }
+    }
+
+    if (result != 0) {
+        opm_events_free_bank(items, n);
+        return -1;
+    }
+
+    *presets = items;
+    *count = n;
+    return 0;
+}
+
+void opm_events_free_bank(opm_preset_t *presets, int count) {
+    if (!presets) return;
+    for (int i = 0; i < count; i++) {
+        free(presets[i].events);
+    }
+    free(presets);
+}
+
+void opm_events_free(opm_event_t *events) {
+    free(events);
+}
+
+char *opm_events_read_file(const char *path, size_t *length) {
+    FILE *fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (!fp) return NULL;
+
+    size_t capacity = 1 << 16;
+    size_t n = 0;
+    char *data = (char *)malloc(capacity);
+    while (data) {
+        n += fread(data + n, 1, capacity - n - 1, fp);
+        if (n < capacity - 1) break;
+        char *grown = (char *)realloc(data, capacity * 2);
+        if (!grown) {
+            free(data);
+            data = NULL;
+            break;
+        }
+        data = grown;
+        capacity *= 2;
+    }
+
+    int failed = ferror(fp);
+    if (fp != stdin) fclose(fp);
+    if (!data || failed) {
+        free(data);
+        return NULL;
+    }
+
+    data[n] = '\0';
+    *length = n;
+    return data;
+}
+
+double opm_events_duration(const opm_event_t *events, int count) {
+    if (!events || count <= 0) return 1.0;
+    double max_time = 0.0;
+    for (int i = 0; i < count; i++) {
+        if (events[i].time > max_time) max_time = events[i].time;
+    }
+    return max_time + 1.0;
+}
@@ -0,0 +1,47 @@
+// イベント JSON の読み込み
+//
+// presets.json / index.html のエディタと同じ形式
+//   { "events": [ { "time": 0.0, "addr": "0x20", "data": "0xC7" }, ... ] }
+// を opm_event_t の配列にする。addr / data は "0x.." 形式の文字列でも数値でもよい。
+// presets.json のようなプリセットの配列の場合は preset 番目のものを読む。
+#ifndef _OPM_EVENTS_H_
+#define _OPM_EVENTS_H_
+
+#include <stddef.h>
+#include "opm_renderer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 成功時は 0 を返し、*events (opm_events_free で解放する) と *count を設定する。
+// 失敗時は -1 を返し、error に理由を書く (error は NULL でもよい)
+int opm_events_parse_json(const char *json, size_t length, int preset, opm_event_t **events, int *count,
+                          char *error, size_t error_size);
+void opm_events_free(opm_event_t *events);
+
+// プリセット1つ分 (presets.json の配列の要素)
+typedef struct {
+    char name[64];        // "name" がなければ空文字列
+    opm_event_t *events;
+    int count;
+} opm_preset_t;
+
+// プリセットの配列 (presets.json) をすべて読む。単体の { "events": ... } なら1つとして読む。
+// 成功時は 0 を返し、*presets (opm_events_free_bank で解放する) と *count を設定する
+int opm_events_parse_bank(const char *json, size_t length, opm_preset_t **presets, int *count,
+                          char *error, size_t error_size);
+void opm_events_free_bank(opm_preset_t *presets, int count);
+
+// ファイル全体を読む ("-" は stdin)。NUL 終端した上で *length に長さを返す。
+// 失敗時は NULL。free で解放する
+char *opm_events_read_file(const char *path, size_t *length);
+
+// 鳴らす長さ (秒)。最後のイベントの時刻 + 1 秒 (index.html と同じ)
+double opm_events_duration(const opm_event_t *events, int count);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
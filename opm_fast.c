@@ -0,0 +1,1071 @@
+/* Sample-level OPM engine
+ *
+ * See opm_fast.h. Each round visits the 32 slots once, channel by channel
+ * (M1, M2, C1, C2), and applies what opm.c spreads over the pipeline stages
+ * of that slot: key-on, envelope step, phase step, operator and mixer. The
+ * cross-slot timing that matters for the sound is kept at round
+ * granularity: the modulator history, the envelope timer, the L / R mixer
+ * windows (which straddle the two rounds of a sample, one sample of
+ * latency) and the DAC truncation. Silent channels are skipped entirely.
+ *
+ * This file is derived from Nuked OPM and is distributed under the same
+ * license (GNU LGPL 2.1 or later), see opm.h.
+ */
+#include <string.h>
+#include <stdint.h>
+
+/* ROM テーブルとピッチ計算ヘルパーは opm.c のものをそのまま使う */
+#define OPM_VENDOR_PREFIX OPM_Fast_Ref_
+#include "opm_vendor.h"
+
+#include "opm_fast.h"
+
+#define FAST_MUTE_LEVEL 0x3ff
+// eg_out がこれ以上ならオペレータの出力は 0 (logsin + eg_out * 4 >= 0xd00)
+#define FAST_SILENT_EG_OUT 832
+
+enum {
+    fast_group_m1 = 0,
+    fast_group_m2 = 1,
+    fast_group_c1 = 2,
+    fast_group_c2 = 3
+};
+
+
+// ============================================================
+// 1. Phase Generator
+// ============================================================
+
+// OPM_PhaseCalcIncrement と同じ計算
+static uint32_t fast_calc_increment(const opm_t *chip, uint32_t slot)
+{
+    uint32_t dt = chip->sl_dt1[slot];
+    uint32_t dt_l = dt & 3;
+    uint32_t detune = 0;
+    uint32_t multi = chip->sl_mul[slot];
+    uint32_t kcode = chip->pg_kcode[slot];
+    uint32_t fnum = chip->pg_fnum[slot];
+    uint32_t block = kcode >> 2;
+    uint32_t basefreq = (fnum << block) >> 2;
+    uint32_t note, sum, sum_h, sum_l, inc;
+    if (dt_l)
+    {
+        if (kcode > 0x1c)
+        {
+            kcode = 0x1c;
+        }
+        block = kcode >> 2;
+        note = kcode & 0x03;
+        sum = block + 9 + ((dt_l == 3) | (dt_l & 0x02));
+        sum_h = sum >> 1;
+        sum_l = sum & 0x01;
+        detune = pg_detune[(sum_l << 2) | note] >> (9 - sum_h);
+    }
+    if (dt & 0x04)
+    {
+        basefreq -= detune;
+    }
+    else
+    {
+        basefreq += detune;
+    }
+    basefreq &= 0x1ffff;
+    if (multi)
+    {
+        inc = basefreq * multi;
+    }
+    else
+    {
+        inc = basefreq >> 1;
+    }
+    return inc & 0xfffff;
+}
+
+// チャンネルのスロットのうち inc_dirty のもの (PM の入力が変わったときは 4 つとも) の
+// pg_fnum / pg_kcode / pg_inc を作り直す (OPM_PhaseCalcFNumBlock)
+static void fast_update_channel(opm_fast_t *f, uint32_t ch, uint32_t key)
+{
+    opm_t *chip = &f->chip;
+    uint32_t kcf = (chip->ch_kc[ch] << 6) + chip->ch_kf[ch];
+    uint32_t pms = chip->ch_pms[ch];
+    int32_t lfo_pm = OPM_LFOApplyPMS(key & 127, pms);
+    int32_t sign = (key & 0x80) != 0 && pms != 0 ? 0 : 1;
+    uint32_t dirty = f->pm_key[ch] != key ? 0xffffffff : f->inc_dirty;
+    uint32_t g;
+
+    for (g = 0; g < 4; g++)
+    {
+        uint32_t slot = g * 8 + ch;
+        uint32_t kcode;
+        if (!(dirty & (1u << slot)))
+        {
+            continue;
+        }
+        kcode = OPM_CalcKCode(kcf, lfo_pm, sign, chip->sl_dt2[slot]);
+        chip->pg_fnum[slot] = OPM_KCToFNum(kcode);
+        chip->pg_kcode[slot] = kcode >> 8;
+        chip->pg_inc[slot] = fast_calc_increment(chip, slot);
+    }
+    f->pm_key[ch] = key;
+    f->inc_dirty &= ~(0x01010101u << ch);
+}
+
+
+// ============================================================
+// 2. Envelope Generator
+// ============================================================
+
+typedef struct {
+    uint8_t tick;           // この round で eg_level を進めるか (eg_clock)
+    uint8_t shift_lock;     // eg_timershift_lock
+    uint8_t timer_lock;     // eg_timer_lock & 3
+    uint8_t kon_csm;        // この round のタイマー A による CSM のキーオン
+    uint8_t kon_csm_prev;   // 前の round の分。スロット 0～4 はまだこちらを見る
+} fast_eg_clock_t;
+
+// OPM_CSM は cycles == 2 で kon_csm を入れ替えるので、それより前に EnvelopePhase1 を通る
+// スロット 0～4 (cycles + 2) には 1 round 遅れて届く
+#define FAST_CSM_LATE_SLOTS 5
+
+// 3 round に 1 回、eg_timer の一番下の 1 のビットで速いレートを間引く
+static void fast_eg_timer(opm_fast_t *f, fast_eg_clock_t *eg)
+{
+    opm_t *chip = &f->chip;
+    uint32_t t = chip->eg_timer;
+    uint32_t bit;
+
+    eg->tick = (chip->eg_clockcnt & 2) != 0 || chip->mode_test[0];
+    if (chip->eg_clockcnt & 2)
+    {
+        chip->eg_clockcnt = 0;
+    }
+    else
+    {
+        chip->eg_clockcnt++;
+    }
+    if (!eg->tick)
+    {
+        return;
+    }
+
+    chip->eg_timershift_lock = 0;
+    for (bit = 0; bit < 14; bit++)
+    {
+        if (t & (1 << bit))
+        {
+            chip->eg_timershift_lock = bit + 1;
+            break;
+        }
+    }
+    chip->eg_timer_lock = ((t + 1) & 1) | (t & 2);
+    chip->eg_timer = (uint16_t)(t + 1);
+}
+
+// OPM_EnvelopePhase1 ～ 5 を 1 スロット分。オペレータが使う eg_out を返す
+static uint32_t fast_envelope(opm_fast_t *f, const fast_eg_clock_t *eg, uint32_t slot, uint32_t ch)
+{
+    opm_t *chip = &f->chip;
+    uint32_t kon = chip->mode_kon[slot] | (slot < FAST_CSM_LATE_SLOTS ? eg->kon_csm_prev : eg->kon_csm);
+    uint32_t edge = kon && !chip->kon[slot];
+    uint32_t state = chip->eg_state[slot];
+    uint32_t level = chip->eg_level[slot];
+    uint32_t rate = 0, ksv, zr, ratemax, sl, ams, am = 0, tl, out;
+    uint32_t inc = 0, eg_off, slreach, eg_zero, mute, inclinear = 0, incattack, step = 0;
+
+    chip->kon2[slot] = chip->kon[slot];
+    chip->kon[slot] = kon;
+
+    switch (edge ? eg_num_attack : state)
+    {
+    case eg_num_attack:
+        rate = chip->sl_ar[slot];
+        break;
+    case eg_num_decay:
+        rate = chip->sl_d1r[slot];
+        break;
+    case eg_num_sustain:
+        rate = chip->sl_d2r[slot];
+        break;
+    case eg_num_release:
+        rate = chip->sl_rr[slot] * 2 + 1;
+        break;
+    }
+    zr = rate == 0;
+    ksv = chip->pg_kcode[slot] >> (chip->sl_ks[slot] ^ 3);
+    if (chip->sl_ks[slot] == 0 && zr)
+    {
+        ksv &= ~3;
+    }
+    rate = rate * 2 + ksv;
+    if (rate & 64)
+    {
+        rate = 63;
+    }
+    ratemax = (rate >> 1) == 31;
+    sl = chip->sl_d1l[slot] == 15 ? 31 : chip->sl_d1l[slot];
+
+    ams = chip->sl_am_e[slot] ? chip->ch_ams[ch] : 0;
+    if (ams)
+    {
+        am = chip->lfo_am_lock << (ams - 1);
+    }
+    if (chip->opp)
+    {
+        tl = (chip->sl_tl[slot] & 128) ? chip->opp_tl[slot] : chip->sl_tl[slot] << 3;
+    }
+    else
+    {
+        tl = chip->sl_tl[slot] << 3;
+    }
+    out = level + am;
+    if (out & 1024)
+    {
+        out = 1023;
+    }
+    out += tl;
+    if (out & 1024)
+    {
+        out = 1023;
+    }
+    if (chip->mode_test[5])
+    {
+        out = 0;
+    }
+
+    // レベルの更新
+    if (eg->tick)
+    {
+        if (rate >= 48)
+        {
+            inc = eg_stephi[rate & 3][eg->timer_lock] + (rate >> 2) - 11;
+            if (inc > 4)
+            {
+                inc = 4;
+            }
+        }
+        else if (!zr)
+        {
+            switch ((eg->shift_lock + (rate >> 2)) & 15)
+            {
+            case 12:
+                inc = rate != 0;
+                break;
+            case 13:
+                inc = (rate >> 1) & 1;
+                break;
+            case 14:
+                inc = rate & 1;
+                break;
+            }
+        }
+    }
+
+    eg_off = (level & 0x3f0) == 0x3f0;
+    slreach = (level >> 4) == (sl << 1);
+    eg_zero = level == 0;
+    mute = eg_off && state != eg_num_attack && !edge;
+    if (!edge && !eg_off)
+    {
+        switch (state)
+        {
+        case eg_num_decay:
+            inclinear = !slreach;
+            break;
+        case eg_num_sustain:
+        case eg_num_release:
+            inclinear = 1;
+            break;
+        }
+    }
+    incattack = state == eg_num_attack && !ratemax && kon && !eg_zero;
+
+    if (edge)
+    {
+        chip->eg_state[slot] = eg_num_attack;
+    }
+    else if (!kon)
+    {
+        chip->eg_state[slot] = eg_num_release;
+    }
+    else
+    {
+        switch (state)
+        {
+        case eg_num_attack:
+            if (eg_zero)
+            {
+                chip->eg_state[slot] = eg_num_decay;
+            }
+            break;
+        case eg_num_decay:
+            if (eg_off)
+            {
+                chip->eg_state[slot] = eg_num_release;
+            }
+            else if (slreach)
+            {
+                chip->eg_state[slot] = eg_num_sustain;
+            }
+            break;
+        case eg_num_sustain:
+            if (eg_off)
+            {
+                chip->eg_state[slot] = eg_num_release;
+            }
+            break;
+        }
+    }
+
+    if (ratemax && edge)
+    {
+        level = 0;
+    }
+    if (mute)
+    {
+        level = FAST_MUTE_LEVEL;
+    }
+    if (inc)
+    {
+        if (inclinear)
+        {
+            step |= 1 << (inc - 1);
+        }
+        if (incattack)
+        {
+            step |= ((~(int32_t)chip->eg_level[slot]) << inc) >> 5;
+        }
+    }
+    chip->eg_level[slot] = (uint16_t)(level + step);
+    chip->pg_reset[slot] = edge;
+
+    return out;
+}
+
+// YM2164: TL の bit 7 が立っているスロットは ch_ramp_div の間隔で 1 ずつ近づける (OPP_TLRamp)
+static void fast_tl_ramp(opm_t *chip)
+{
+    uint32_t ch, g;
+    for (ch = 0; ch < 8; ch++)
+    {
+        uint32_t match = chip->ch_ramp_div[ch] == chip->opp_tl_cnt[ch];
+        chip->opp_tl_cnt[ch] = match ? 0 : chip->opp_tl_cnt[ch] + 1;
+        for (g = 0; g < 4; g++)
+        {
+            uint32_t slot = g * 8 + ch;
+            uint32_t tl = chip->sl_tl[slot];
+            if (!(tl & 128))
+            {
+                chip->opp_tl[slot] = tl << 3;
+            }
+            else if (match)
+            {
+                uint32_t val = chip->opp_tl[slot] >> 3;
+                tl &= 127;
+                if (val < tl)
+                    chip->opp_tl[slot]++;
+                else if (val > tl)
+                    chip->opp_tl[slot]--;
+            }
+        }
+    }
+}
+
+
+// ============================================================
+// 3. Operator
+// ============================================================
+
+// OPM_OperatorPhase1 ～ 12 をまとめたもの。14 ビットの符号付きの出力を返す
+static int32_t fast_operator(const opm_t *chip, uint32_t slot, int32_t mod, uint32_t eg_out)
+{
+    uint32_t phase = ((chip->pg_phase[slot] >> 10) + mod) & 1023;
+    uint32_t index = phase & 255;
+    uint32_t atten;
+    int32_t out;
+
+    if (phase & 256)
+    {
+        index ^= 255;
+    }
+    atten = logsinrom[index] + (eg_out << 2);
+    if (atten & 4096)
+    {
+        atten = 4095;
+    }
+    out = (exprom[atten & 255] << 2) >> (atten >> 8);
+    if (!chip->opp && chip->mode_test[4])
+    {
+        out |= 0x2000;
+    }
+    if (phase & 512)
+    {
+        out = ((out ^ 0x3fff) + 1) & 0x3fff;
+    }
+    if (out & 0x2000)
+    {
+        out |= ~0x3fff;
+    }
+    return out;
+}
+
+
+// ============================================================
+// 4. LFO / Noise / Timers
+// ============================================================
+
+static void fast_lfo_tick(opm_fast_t *f)
+{
+    opm_t *chip = &f->chip;
+    if (chip->lfo_wave == 3)
+    {
+        f->lfo_phase = (uint16_t)chip->noise_lfsr;
+    }
+    else
+    {
+        f->lfo_phase += chip->lfo_wave == 2 ? 2 : 1;
+    }
+}
+
+// 256 クロックに 1 回 lfo_counter2 を進め、あふれたら LFO を 1 tick 進める
+static void fast_lfo_unit(opm_fast_t *f)
+{
+    opm_t *chip = &f->chip;
+    if (f->lfo_extra)
+    {
+        f->lfo_extra = 0;
+        fast_lfo_tick(f);
+    }
+    chip->lfo_counter2++;
+    if (chip->lfo_counter2 & 0x8000)
+    {
+        uint8_t c3 = chip->lfo_counter3;
+        chip->lfo_counter2 = lfo_counter2_table[chip->lfo_freq_hi];
+        fast_lfo_tick(f);
+        // lfo_counter3 の一番下の 0 のビットで freq_lo のビットを選び、追加の tick を入れる
+        if ((c3 & 1) == 0)
+            f->lfo_extra = (chip->lfo_freq_lo & 8) != 0;
+        else if ((c3 & 2) == 0)
+            f->lfo_extra = (chip->lfo_freq_lo & 4) != 0;
+        else if ((c3 & 4) == 0)
+            f->lfo_extra = (chip->lfo_freq_lo & 2) != 0;
+        else if ((c3 & 8) == 0)
+            f->lfo_extra = (chip->lfo_freq_lo & 1) != 0;
+        chip->lfo_counter3 = (c3 + 1) & 15;
+    }
+}
+
+// 位相から lfo_am_lock / lfo_pm_lock を作る (OPM_DoLFOMult の掛け算)
+static void fast_lfo_lock(opm_fast_t *f, int pm)
+{
+    opm_t *chip = &f->chip;
+    uint32_t n = chip->mode_test[1] ? 0 : f->lfo_phase;
+    uint32_t v = n & 255;
+    if (!pm)
+    {
+        uint32_t a;
+        switch (chip->lfo_wave)
+        {
+        case 1:
+            a = (n & 128) ? 0 : 255;
+            break;
+        case 2:
+            a = (n & 256) ? v : 255 - v;
+            break;
+        default:
+            a = 255 - v;
+            break;
+        }
+        chip->lfo_am_lock = (uint8_t)((a * chip->lfo_amd) >> 7);
+    }
+    else
+    {
+        uint32_t sign, mag;
+        switch (chip->lfo_wave)
+        {
+        case 1:
+            sign = (n >> 7) & 1;
+            mag = 128;
+            break;
+        case 2:
+            sign = (n >> 8) & 1;
+            mag = (v & 128) ? (~v & 127) : (v & 127);
+            break;
+        default:
+            sign = v >> 7;
+            mag = sign ? (~v & 127) : (v & 127);
+            break;
+        }
+        chip->lfo_pm_lock = (uint8_t)((sign << 7) | ((mag * chip->lfo_pmd) >> 7));
+    }
+}
+
+// OPM_Noise / OPM_NoiseTimer / OPM_NoiseChannel の lfsr を 1 round 分回す
+static void fast_noise(opm_fast_t *f)
+{
+    opm_t *chip = &f->chip;
+    uint32_t target = chip->noise_freq ^ 31;
+    // モードレジスタの書き込みが届くのは 1 クロック目 (OPM_DoIO の後の OPM_DoRegWrite) なので、
+    // 書いた直後の 0 クロック目は前の値で比べる
+    uint32_t target0 = f->noise_freq_late ? f->noise_freq_old ^ 31u : target;
+    uint32_t c;
+    f->noise_freq_late = 0;
+
+    // タイマーがあふれない round の lfsr は 16 ビットの回転を 2 周するだけで、元に戻る
+    if (!chip->noise_update && !chip->noise_timer_of && chip->noise_timer != target
+        && chip->noise_timer != target0 && ((chip->noise_timer + 1) & 31) != target)
+    {
+        chip->nc_sign_lock = (chip->noise_lfsr >> 13) & 1;
+        chip->noise_timer = (chip->noise_timer + 2) & 31;
+        return;
+    }
+    for (c = 0; c < 32; c++)
+    {
+        uint32_t timer = chip->noise_timer;
+        uint8_t bit;
+        if (chip->noise_update)
+        {
+            uint8_t rst = (chip->noise_lfsr & 0xffff) == 0 && chip->noise_bit == 0;
+            uint8_t xr = ((chip->noise_lfsr >> 2) & 1) ^ chip->noise_bit;
+            bit = rst | xr;
+            chip->noise_bit = chip->noise_lfsr & 1;
+        }
+        else
+        {
+            bit = chip->noise_lfsr & 1;
+        }
+        chip->noise_lfsr = (chip->noise_lfsr >> 1) | ((uint32_t)bit << 15);
+
+        chip->noise_update = chip->noise_timer_of;
+        if ((c & 15) == 15)
+        {
+            timer = (timer + 1) & 31;
+            if (chip->noise_timer_of)
+            {
+                timer = 0;
+            }
+        }
+        chip->noise_timer_of = chip->noise_timer == (c == 0 ? target0 : target);
+        chip->noise_timer = timer;
+
+        if (c == 12)
+        {
+            chip->nc_sign_lock = chip->noise_lfsr & 1;
+        }
+    }
+}
+
+// ノイズが有効なとき、スロット 31 の出力の代わりに足す値 (OPM_NoiseChannel)。
+// 符号はこの round の 12 クロック目で取った lfsr のビット
+static int32_t fast_noise_output(const opm_t *chip, uint32_t eg_out)
+{
+    int32_t level = (int32_t)(eg_out & 0x3fc) * 2;
+    if (chip->nc_sign_lock)
+    {
+        return 2040 - level;
+    }
+    return level - 2048 + (eg_out < 1022 ? 7 : 0);
+}
+
+// タイマー A / B を 1 round 分進める (OPM_DoTimerA ～ OPM_DoTimerB2)
+static void fast_timers(opm_fast_t *f)
+{
+    opm_t *chip = &f->chip;
+    uint32_t do_load = 0;
+
+    if (!chip->timer_loada)
+    {
+        chip->timer_a_val = 0;
+    }
+    else if (chip->timer_a_temp)
+    {
+        chip->timer_a_val = chip->timer_a_reg;
+        do_load = 1;
+    }
+    else if (++chip->timer_a_val & 1024)
+    {
+        chip->timer_a_val = chip->timer_a_reg;
+        chip->timer_a_status |= chip->timer_irqa;
+        do_load = 1;
+    }
+    chip->timer_a_temp = !chip->timer_loada;
+    f->kon_csm_next = do_load && chip->mode_csm;
+
+    chip->timer_b_sub++;
+    chip->timer_b_sub_of = chip->opp ? (chip->timer_b_sub >> 5) & 1 : (chip->timer_b_sub >> 4) & 1;
+    chip->timer_b_sub &= chip->opp ? 31 : 15;
+    if (!chip->timer_loadb)
+    {
+        chip->timer_b_val = 0;
+    }
+    else if (chip->timer_b_temp)
+    {
+        chip->timer_b_val = chip->timer_b_reg;
+    }
+    else if (chip->timer_b_sub_of && ++chip->timer_b_val & 256)
+    {
+        chip->timer_b_val = chip->timer_b_reg;
+        chip->timer_b_status |= chip->timer_irqb;
+    }
+    chip->timer_b_temp = !chip->timer_loadb;
+    chip->timer_irq = chip->timer_a_status || chip->timer_b_status;
+}
+
+
+// ============================================================
+// 5. Round / Sample
+// ============================================================
+
+// キーオンもしておらず、完全に減衰したスロット。出力は 0 で、次のキーオンまで状態は変わらない
+static int fast_slot_idle(const opm_t *chip, uint32_t slot)
+{
+    return !chip->kon[slot] && !chip->mode_kon[slot] && chip->eg_state[slot] == eg_num_release
+        && chip->eg_level[slot] == FAST_MUTE_LEVEL;
+}
+
+static void fast_mix(opm_fast_t *f, uint32_t half, uint32_t slot, uint32_t ch, int32_t out, uint32_t rl)
+{
+    // L はラウンド 1 のスロット 15 ～ 31 とラウンド 2 の 0 ～ 14、R は 31 と 0 ～ 30 を足す
+    uint32_t l = half ? slot <= 14 : slot >= 15;
+    uint32_t r = half ? slot <= 30 : slot == 31;
+    if ((rl & 1) && l)
+    {
+        f->mix[0] += out;
+        f->ch_mix[0][ch] += out;
+    }
+    if ((rl & 2) && r)
+    {
+        f->mix[1] += out;
+        f->ch_mix[1][ch] += out;
+    }
+}
+
+static void fast_round(opm_fast_t *f, uint32_t half)
+{
+    opm_t *chip = &f->chip;
+    fast_eg_clock_t eg;
+    uint32_t noise = chip->noise_en;
+    uint32_t pm_input = chip->lfo_pmd ? chip->lfo_pm_lock : 0;
+    uint32_t ch, g;
+
+    if (half)
+    {
+        f->inc_dirty |= f->inc_late;
+        f->inc_late = 0;
+    }
+    // タイマーはスロットの計算に使わないので先に進め、この round の CSM のキーオンを得る
+    eg.kon_csm_prev = f->kon_csm_next;
+    chip->kon_csm = eg.kon_csm_prev;
+    fast_timers(f);
+    eg.kon_csm = f->kon_csm_next;
+    fast_eg_timer(f, &eg);
+    eg.shift_lock = chip->eg_timershift_lock;
+    eg.timer_lock = chip->eg_timer_lock & 3;
+
+    fast_noise(f);
+    if (chip->opp)
+    {
+        fast_tl_ramp(chip);
+    }
+
+    for (ch = 0; ch < 8; ch++)
+    {
+        uint32_t con = chip->ch_connect[ch];
+        uint32_t rl = (f->mix_mask >> ch) & 1 ? chip->ch_rl[ch] : 0;
+        uint32_t key = chip->ch_pms[ch] ? pm_input : 0;
+        int32_t m1_prev = chip->op_m1[ch][0];
+        int32_t c1_prev = chip->op_c1[ch];
+        int32_t out[4];
+
+        if (!eg.kon_csm && !eg.kon_csm_prev && !(noise && ch == 7)
+            && fast_slot_idle(chip, ch) && fast_slot_idle(chip, ch + 8)
+            && fast_slot_idle(chip, ch + 16) && fast_slot_idle(chip, ch + 24))
+        {
+            chip->op_m1[ch][1] = chip->op_m1[ch][0];
+            chip->op_m1[ch][0] = 0;
+            chip->op_c1[ch] = 0;
+            continue;
+        }
+        if ((f->inc_dirty & (0x01010101u << ch)) || f->pm_key[ch] != key)
+        {
+            fast_update_channel(f, ch, key);
+        }
+
+        for (g = 0; g < 4; g++)
+        {
+            uint32_t slot = g * 8 + ch;
+            uint32_t eg_out = fast_envelope(f, &eg, slot, ch);
+            int32_t mod1 = 0, mod2 = 0, mod;
+
+            // 変調の入力 (fm_algorithm の行: M1 の直前の 2 つ, C1, 直前のオペレータ)
+            switch (g)
+            {
+            case fast_group_m1:
+                mod = (chip->op_m1[ch][0] + chip->op_m1[ch][1]) >> 1;
+                mod = chip->ch_fb[ch] ? mod >> (9 - chip->ch_fb[ch]) : 0;
+                break;
+            case fast_group_m2:
+                if (fm_algorithm[1][0][con])
+                    mod2 |= m1_prev;
+                if (fm_algorithm[1][2][con])
+                    mod1 |= c1_prev;
+                mod = (mod1 + mod2) >> 1;
+                break;
+            case fast_group_c1:
+                if (fm_algorithm[2][3][con])
+                    mod2 |= out[0];
+                mod = mod2 >> 1;
+                break;
+            default:
+                if (fm_algorithm[3][0][con])
+                    mod2 |= out[0];
+                if (fm_algorithm[3][3][con])
+                    mod2 |= out[1];
+                if (fm_algorithm[3][2][con])
+                    mod1 |= c1_prev;
+                if (fm_algorithm[3][4][con])
+                    mod1 |= out[1];
+                mod = (mod1 + mod2) >> 1;
+                break;
+            }
+
+            out[g] = eg_out < FAST_SILENT_EG_OUT ? fast_operator(chip, slot, mod, eg_out) : 0;
+
+            if (chip->pg_reset[slot] || chip->mode_test[3])
+            {
+                chip->pg_phase[slot] = 0;
+            }
+            else
+            {
+                chip->pg_phase[slot] = (chip->pg_phase[slot] + chip->pg_inc[slot]) & 0xfffff;
+            }
+
+            if (g == fast_group_m1)
+            {
+                chip->op_m1[ch][1] = chip->op_m1[ch][0];
+                chip->op_m1[ch][0] = (int16_t)out[0];
+            }
+            else if (g == fast_group_c1)
+            {
+                chip->op_c1[ch] = (int16_t)out[2];
+            }
+
+            if (slot == 31 && chip->noise_en)
+            {
+                fast_mix(f, half, slot, ch, fast_noise_output(chip, eg_out), rl);
+            }
+            else if (fm_algorithm[g][5][con] && out[g])
+            {
+                fast_mix(f, half, slot, ch, out[g], rl);
+            }
+        }
+    }
+
+    if ((f->rounds & 7) == 0)
+    {
+        fast_lfo_unit(f);
+    }
+    if ((f->rounds & 7) == 3)
+    {
+        fast_lfo_lock(f, 0);
+    }
+    if ((f->rounds & 7) == 7)
+    {
+        fast_lfo_lock(f, 1);
+    }
+    f->rounds++;
+}
+
+// OPM_DAC: 仮数 10 ビット + 指数 3 ビットに落とす
+static int32_t fast_dac(int32_t v)
+{
+    uint32_t m;
+    int32_t shift = 0;
+    if (v < -32768)
+    {
+        v = -32768;
+    }
+    else if (v > 32767)
+    {
+        v = 32767;
+    }
+    m = (uint32_t)(v ^ (v >> 31)) >> 9;
+    while (m)
+    {
+        shift++;
+        m >>= 1;
+    }
+    return v & ~((1 << shift) - 1);
+}
+
+static void fast_key_on(opm_t *chip, uint8_t data)
+{
+    uint32_t ch = data & 7;
+    chip->mode_kon_channel = ch;
+    chip->mode_kon_operator[0] = (data >> 3) & 1;
+    chip->mode_kon_operator[1] = (data >> 4) & 1;
+    chip->mode_kon_operator[2] = (data >> 5) & 1;
+    chip->mode_kon_operator[3] = (data >> 6) & 1;
+    chip->mode_kon[ch + 0] = chip->mode_kon_operator[0];
+    chip->mode_kon[ch + 8] = chip->mode_kon_operator[2];
+    chip->mode_kon[ch + 16] = chip->mode_kon_operator[1];
+    chip->mode_kon[ch + 24] = chip->mode_kon_operator[3];
+}
+
+void OPM_Fast_Sample(opm_fast_t *f, int32_t *output)
+{
+    uint32_t ch;
+
+    // 返すのは前のサンプルで積算し終わった分 (OPM_Clock と同じく 1 サンプル遅れる)
+    if (output)
+    {
+        output[0] = f->output[0];
+        output[1] = f->output[1];
+    }
+    for (ch = 0; ch < 8; ch++)
+    {
+        f->ch_output[0][ch] = f->ch_mix[0][ch];
+        f->ch_output[1][ch] = f->ch_mix[1][ch];
+        f->ch_mix[0][ch] = 0;
+        f->ch_mix[1][ch] = 0;
+    }
+
+    fast_round(f, 0);
+    // キーオンの書き込みが mode_kon に届くのは 2 つめの round
+    if (f->kon_pending)
+    {
+        f->kon_pending = 0;
+        fast_key_on(&f->chip, f->kon_data);
+    }
+    fast_round(f, 1);
+
+    f->output[0] = fast_dac(f->mix[0]);
+    f->output[1] = fast_dac(f->mix[1]);
+    f->chip.dac_output[0] = f->output[0];
+    f->chip.dac_output[1] = f->output[1];
+    f->mix[0] = 0;
+    f->mix[1] = 0;
+}
+
+
+// ============================================================
+// 6. Register Write
+// ============================================================
+
+static void fast_mode_write(opm_fast_t *f, uint8_t data)
+{
+    opm_t *chip = &f->chip;
+    uint32_t i;
+
+    if (chip->mode_address == (chip->opp ? 9 : 1))
+    {
+        for (i = 0; i < 8; i++)
+        {
+            chip->mode_test[i] = (data >> i) & 0x01;
+        }
+    }
+    switch (chip->mode_address)
+    {
+    case 0x08:
+        f->kon_data = data;
+        f->kon_pending = 1;
+        break;
+    case 0x0f:
+        if (!f->noise_freq_late)
+        {
+            f->noise_freq_old = chip->noise_freq;
+        }
+        f->noise_freq_late = 1;
+        chip->noise_en = data >> 7;
+        chip->noise_freq = data & 0x1f;
+        break;
+    case 0x10:
+        chip->timer_a_reg &= 0x03;
+        chip->timer_a_reg |= data << 2;
+        break;
+    case 0x11:
+        chip->timer_a_reg &= 0x3fc;
+        chip->timer_a_reg |= data & 0x03;
+        break;
+    case 0x12:
+        chip->timer_b_reg = data;
+        break;
+    case 0x14:
+        chip->mode_csm = (data >> 7) & 1;
+        chip->timer_irqb = (data >> 3) & 1;
+        chip->timer_irqa = (data >> 2) & 1;
+        if (data & 0x20)
+        {
+            chip->timer_b_status = 0;
+        }
+        if (data & 0x10)
+        {
+            chip->timer_a_status = 0;
+        }
+        chip->timer_loadb = (data >> 1) & 1;
+        chip->timer_loada = (data >> 0) & 1;
+        chip->timer_irq = chip->timer_a_status || chip->timer_b_status;
+        break;
+    case 0x18:
+        chip->lfo_freq_hi = data >> 4;
+        chip->lfo_freq_lo = data & 0x0f;
+        chip->lfo_counter2 = lfo_counter2_table[chip->lfo_freq_hi];
+        break;
+    case 0x19:
+        if (data & 0x80)
+        {
+            chip->lfo_pmd = data & 0x7f;
+        }
+        else
+        {
+            chip->lfo_amd = data;
+        }
+        break;
+    case 0x1b:
+        chip->lfo_wave = data & 0x03;
+        chip->io_ct1 = (data >> 6) & 0x01;
+        chip->io_ct2 = data >> 7;
+        break;
+    }
+}
+
+// KC / KF を書いたとき、M1 と前半のチャンネルの M2 はこの round の
+// OPM_PhaseCalcFNumBlock が書き込みより先に回るので、新しい値は 2 つめの round から効く
+static void fast_pitch_written(opm_fast_t *f, uint32_t ch)
+{
+    uint32_t late = 0x01u << ch;
+    if (ch < (f->chip.opp ? 3u : 2u))
+    {
+        late |= 0x0100u << ch;
+    }
+    f->inc_dirty |= (0x01010101u << ch) & ~late;
+    f->inc_late |= late;
+}
+
+static void fast_reg_write(opm_fast_t *f, uint8_t address, uint8_t data)
+{
+    opm_t *chip = &f->chip;
+    uint32_t ch = address & 7;
+    uint32_t slot = address & 0x1f;
+
+    if (address < 0x20)
+    {
+        if (chip->opp && address < 8)
+        {
+            chip->ch_ramp_div[ch] = data;
+        }
+        return;
+    }
+    if (address < 0x40)
+    {
+        switch (address & 0x18)
+        {
+        case 0x00: // RL, FB, CONNECT
+            chip->ch_rl[ch] = data >> 6;
+            chip->ch_fb[ch] = (data >> 3) & 0x07;
+            chip->ch_connect[ch] = data & 0x07;
+            break;
+        case 0x08: // KC
+            chip->ch_kc[ch] = data & 0x7f;
+            fast_pitch_written(f, ch);
+            break;
+        case 0x10: // KF
+            chip->ch_kf[ch] = data >> 2;
+            fast_pitch_written(f, ch);
+            break;
+        case 0x18: // PMS, AMS
+            chip->ch_pms[ch] = (data >> 4) & 0x07;
+            chip->ch_ams[ch] = data & 0x03;
+            f->inc_dirty |= 0x01010101u << ch;
+            break;
+        }
+        return;
+    }
+    switch (address & 0xe0)
+    {
+    case 0x40: // DT1, MUL
+        chip->sl_dt1[slot] = (data >> 4) & 0x07;
+        chip->sl_mul[slot] = data & 0x0f;
+        // OPM_PhaseCalcIncrement より先に書き込みが届くのは YM2164 のスロット 3 以降だけ
+        if (chip->opp && slot >= 3)
+        {
+            f->inc_dirty |= 1u << slot;
+        }
+        else
+        {
+            f->inc_late |= 1u << slot;
+        }
+        break;
+    case 0x60: // TL
+        chip->sl_tl[slot] = chip->opp ? data : data & 0x7f;
+        break;
+    case 0x80: // KS, AR
+        chip->sl_ks[slot] = data >> 6;
+        chip->sl_ar[slot] = data & 0x1f;
+        break;
+    case 0xa0: // AMS-EN, D1R
+        chip->sl_am_e[slot] = data >> 7;
+        chip->sl_d1r[slot] = data & 0x1f;
+        break;
+    case 0xc0: // DT2, D2R
+        chip->sl_dt2[slot] = data >> 6;
+        chip->sl_d2r[slot] = data & 0x1f;
+        f->inc_dirty |= 1u << slot;
+        break;
+    case 0xe0: // D1L, RR
+        chip->sl_d1l[slot] = data >> 4;
+        chip->sl_rr[slot] = data & 0x0f;
+        break;
+    }
+}
+
+void OPM_Fast_Write(opm_fast_t *f, uint32_t port, uint8_t data)
+{
+    opm_t *chip = &f->chip;
+
+    if ((port & 1) == 0)
+    {
+        // アドレス: OPM_DoRegWrite と同じく、0x20 未満はモードレジスタだけに入る
+        chip->mode_address = data;
+        chip->reg_address_ready = (data & 0xe0) != 0 || (chip->opp && (data & 0xf8) == 0);
+        if (chip->reg_address_ready)
+        {
+            chip->reg_address = data;
+        }
+        return;
+    }
+
+    fast_mode_write(f, data);
+    if (chip->reg_address_ready)
+    {
+        chip->reg_data = data;
+        fast_reg_write(f, chip->reg_address, data);
+    }
+}
+
+
+// ============================================================
+// 7. Reset / Load
+// ============================================================
+
+void OPM_Fast_Load(opm_fast_t *f, const opm_t *state)
+{
+    memset(f, 0, sizeof(*f));
+    f->chip = *state;
+    // サンプルの境目 (cycles == 0) では lfo_val は位相を 2 ビット左にずらして持っている
+    f->lfo_phase = (uint16_t)(state->lfo_val >> 2);
+    f->rounds = state->lfo_counter1 >> 1;
+    f->lfo_extra = state->lfo_counter3_step;
+    f->kon_csm_next = state->kon_csm_lock;
+    f->inc_dirty = 0xffffffff;
+    f->mix_mask = 0xff;
+    f->output[0] = state->dac_output[0];
+    f->output[1] = state->dac_output[1];
+}
+
+void OPM_Fast_Reset(opm_fast_t *f, uint32_t flags)
+{
+    opm_t state;
+    // リセット直後の状態は Nuked の OPM_Reset で作る (2048 クロックなので軽い)
+    OPM_Fast_Ref_Reset(&state, flags);
+    OPM_Fast_Load(f, &state);
+}
@@ -0,0 +1,67 @@
+/* Sample-level OPM engine
+ *
+ * Fast, approximate counterpart of the Nuked OPM core (opm.c). Instead of
+ * stepping the die-level pipelines one clock at a time, OPM_Fast_Sample
+ * produces one output sample (64 clocks, i.e. two 32-slot rounds) by running
+ * the envelope, phase and operator math once per slot and round. Register
+ * writes land in the same opm_t register fields as in opm.c and the ROM
+ * tables are shared with it, so the output follows Nuked closely but is not
+ * bit-exact: pipeline delays inside a round, the OPP register delays and
+ * the LFO noise waveform are simplified. opm-bench reports the SNR against
+ * the reference for every preset; opm-golden and opm-fuzz compare it with
+ * the reference on inputs without LFO or test register writes, within a
+ * small tolerance (see opm_engines.c).
+ *
+ * This file is derived from Nuked OPM and is distributed under the same
+ * license (GNU LGPL 2.1 or later), see opm.h.
+ */
+#ifndef _OPM_FAST_H_
+#define _OPM_FAST_H_
+
+#include <stdint.h>
+#include "opm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    /* レジスタと、opm.c と意味が同じ内部状態 (eg_level, pg_phase, op_m1,
+     * noise_lfsr, タイマーなど) はここに置く。パイプラインの途中の値は使わない */
+    opm_t chip;
+
+    uint32_t rounds;        // リセットからの round (32 クロック) 数
+    uint16_t lfo_phase;     // LFO の位相。のこぎり波で 1 tick に 1 進む
+    uint8_t lfo_extra;      // freq_lo による追加の tick を次の単位で入れる
+    uint8_t kon_pending;    // 0x08 の書き込みは 2 つめの round で反映する
+    uint8_t kon_data;
+    uint8_t kon_csm_next;   // 前の round でタイマー A が出した CSM のキーオン
+    uint8_t noise_freq_old; // 0x0F を書いた直後の round の 0 クロック目はまだ前の noise_freq で比べる
+    uint8_t noise_freq_late;
+    uint32_t inc_dirty;     // 次の round で pg_inc を計算し直すスロット (bit slot)
+    uint32_t inc_late;      // 書き込みがパイプラインに届くのが 2 つめの round のスロット
+    uint8_t pm_key[8];      // pg_inc を計算したときの PM の入力
+
+    // bit ch が 1 のチャンネルだけミックスに入れる (ほかの状態は変わらない)
+    uint8_t mix_mask;
+
+    int32_t mix[2];         // 積算中の L / R
+    int32_t ch_mix[2][8];   // チャンネルごとの L / R (次の OPM_Fast_Sample で ch_output に移す)
+    int32_t output[2];      // 次の OPM_Fast_Sample が返す L / R (DAC 後)
+    // 直前の OPM_Fast_Sample が返した L / R のチャンネルごとの内訳 (DAC 前、クリップなし)
+    int32_t ch_output[2][8];
+} opm_fast_t;
+
+// flags は OPM_Reset と同じ (opm_flags_ym2164 で OPP)
+void OPM_Fast_Reset(opm_fast_t *chip, uint32_t flags);
+// OPM_Clock で回した opm_t の状態から続ける (サンプルの境目で取ったもの)
+void OPM_Fast_Load(opm_fast_t *chip, const opm_t *state);
+void OPM_Fast_Write(opm_fast_t *chip, uint32_t port, uint8_t data);
+// 64 クロック分進めて、OPM_Clock を 64 回回したあとの出力にあたる L / R を output に書く
+void OPM_Fast_Sample(opm_fast_t *chip, int32_t *output);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,542 @@
+// 参照実装と速いエンジンの差分ファズ
+//
+// ランダムなタイミングのランダムなレジスタ書き込み列を作り、参照実装
+// (OPM_Clock をそのまま回すループ) と各エンジン (opm_engines.h に登録したもの) を
+// 並べて1フレームずつ鳴らし、出力と opm_t の状態全体を毎フレーム比べる。
+// 近似エンジン (fast) には LFO とテストレジスタを止めた入力を渡し、出力だけを許す差の範囲で比べる。
+// ずれたら入力を小さくして (書き込みを減らし、待ち時間と値を 0 に寄せる)、
+// イベント JSON (presets.json と同じ形式) に書き、ずれたフィールドを表示する。
+// 書いた JSON は opm-fuzz -r や opm-render でそのまま鳴らせる。
+//
+// 入力は3バイト単位のレコード (前の書き込みからの待ちフレーム数, addr, data)。
+// OPM_FUZZ_LIBFUZZER を定義してビルドすると main の代わりに LLVMFuzzerTestOneInput になる
+// (clang -fsanitize=fuzzer)。
+//
+//   opm-fuzz -n 1000 -s 1
+//   opm-fuzz -e simd -o crash
+//   opm-fuzz -r crash-simd-1234.json
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <getopt.h>
+#include "opm.h"
+#include "opm_renderer.h"
+#include "opm_events.h"
+#include "opm_engines.h"
+
+#define SAMPLE_RATE (3579545.0 / 64)
+
+#define RECORD_SIZE 3
+#define DEFAULT_ITERATIONS 200
+#define DEFAULT_MAX_RECORDS 64
+#define DEFAULT_MAX_FRAMES 8192
+
+// 最後の書き込みのあとに鳴らすフレーム数 (エンベロープや LFO がずれるのを待つ)
+#define TAIL_FRAMES 512
+
+// ずれたときに表示する直前のイベントの数
+#define RECENT_EVENTS 8
+
+typedef struct {
+    int iterations;
+    uint32_t seed;
+    const char *engine;     // NULL なら reference 以外の全エンジン
+    const char *output;     // ずれた入力を書くファイル名の先頭
+    const char *replay;     // 鳴らし直すイベント JSON
+    int max_records;
+    int max_frames;
+    double max_seconds;     // 0 なら無制限
+    int quiet;
+} fuzz_options_t;
+
+typedef struct {
+    uint8_t delay;  // 前の書き込みからの待ち (フレーム)
+    uint8_t addr;
+    uint8_t data;
+} fuzz_record_t;
+
+// エンジンのインスタンスと作業用のバッファ (iteration ごとに作り直さない)
+typedef struct {
+    void *reference;
+    void *actual[16];
+    opm_t *expected_chip;
+    opm_t *actual_chip;
+    opm_event_t *events;
+    int capacity;
+    int max_frames;
+} fuzz_context_t;
+
+// 1回の比較の結果
+typedef struct {
+    int frame;      // 最初にずれたフレーム。-1 なら一致
+    int output;     // 1 なら出力が、0 ならチップの状態がずれた
+} fuzz_result_t;
+
+
+// ============================================================
+// 1. Input
+// ============================================================
+
+static uint32_t xorshift32(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// 実際に使うレジスタに寄せた書き込み (たまに未使用のアドレスも混ぜる)
+static void random_record(uint32_t *rng, fuzz_record_t *r) {
+    static const uint8_t globals[] = { 0x01, 0x0F, 0x10, 0x11, 0x12, 0x14, 0x18, 0x19, 0x1B };
+
+    uint32_t kind = xorshift32(rng) % 100;
+    if (kind < 50) r->delay = 0;
+    else if (kind < 85) r->delay = (uint8_t)(1 + xorshift32(rng) % 15);
+    else r->delay = (uint8_t)xorshift32(rng);
+
+    kind = xorshift32(rng) % 100;
+    r->data = (uint8_t)xorshift32(rng);
+    if (kind < 15) {
+        // キーオン / キーオフ
+        r->addr = 0x08;
+        r->data &= 0x7F;
+    } else if (kind < 25) {
+        r->addr = globals[xorshift32(rng) % sizeof(globals)];
+    } else if (kind < 45) {
+        r->addr = (uint8_t)(0x20 + xorshift32(rng) % 0x20);
+    } else if (kind < 97) {
+        r->addr = (uint8_t)(0x40 + xorshift32(rng) % 0xC0);
+        // TL は小さい (大きい音) ほうに寄せる
+        if ((r->addr & 0xE0) == 0x60 && (xorshift32(rng) & 1)) r->data &= 0x1F;
+    } else {
+        r->addr = (uint8_t)xorshift32(rng);
+    }
+}
+
+static int random_records(uint32_t seed, int max_records, fuzz_record_t *records) {
+    uint32_t rng = seed ? seed : 1;
+    for (int i = 0; i < 4; i++) xorshift32(&rng);
+    int count = 1 + (int)(xorshift32(&rng) % (uint32_t)max_records);
+    for (int i = 0; i < count; i++) random_record(&rng, &records[i]);
+    return count;
+}
+
+// レコードを engine に渡すイベントにし、鳴らすフレーム数を返す
+static int records_to_events(const fuzz_record_t *records, int count, const opm_engine_t *engine,
+                             opm_event_t *events, int max_frames) {
+    int frame = 0;
+    for (int i = 0; i < count; i++) {
+        frame += records[i].delay;
+        events[i].time = (float)(frame / SAMPLE_RATE);
+        events[i].addr = records[i].addr;
+        events[i].data = records[i].data;
+    }
+    if (engine->approximate) opm_engine_mask_approx(events, count);
+    // 1 書き込みに 2 フレームかかるので、詰まった分も足す
+    int frames = frame + 2 * count + TAIL_FRAMES;
+    return frames < max_frames ? frames : max_frames;
+}
+
+
+// ============================================================
+// 2. Differential Run
+// ============================================================
+
+static int context_init(fuzz_context_t *ctx, int capacity, int max_frames) {
+    memset(ctx, 0, sizeof(*ctx));
+    if (opm_engine_count() > (int)(sizeof(ctx->actual) / sizeof(ctx->actual[0]))) return -1;
+
+    ctx->reference = opm_engine_get(0)->create();
+    for (int i = 1; i < opm_engine_count(); i++) {
+        ctx->actual[i] = opm_engine_get(i)->create();
+        if (!ctx->actual[i]) return -1;
+    }
+    ctx->expected_chip = (opm_t *)malloc(sizeof(opm_t));
+    ctx->actual_chip = (opm_t *)malloc(sizeof(opm_t));
+    ctx->events = (opm_event_t *)malloc(sizeof(opm_event_t) * (capacity > 0 ? capacity : 1));
+    ctx->capacity = capacity;
+    ctx->max_frames = max_frames;
+    return ctx->reference && ctx->expected_chip && ctx->actual_chip && ctx->events ? 0 : -1;
+}
+
+static void context_free(fuzz_context_t *ctx) {
+    if (ctx->reference) opm_engine_get(0)->destroy(ctx->reference);
+    for (int i = 1; i < opm_engine_count(); i++) {
+        if (ctx->actual[i]) opm_engine_get(i)->destroy(ctx->actual[i]);
+    }
+    free(ctx->expected_chip);
+    free(ctx->actual_chip);
+    free(ctx->events);
+}
+
+// engine を参照実装と frames フレーム比べる。report が NULL でなければずれた内容を書く
+static fuzz_result_t run_events(fuzz_context_t *ctx, int engine_index, const opm_event_t *events, int count,
+                                int frames, FILE *report) {
+    const opm_engine_t *reference = opm_engine_get(0);
+    const opm_engine_t *engine = opm_engine_get(engine_index);
+    void *actual = ctx->actual[engine_index];
+    fuzz_result_t result = { -1, 0 };
+
+    reference->start(ctx->reference, events, count);
+    engine->start(actual, events, count);
+    for (int frame = 0; frame < frames; frame++) {
+        // 近似エンジンの opm_t はパイプラインの途中の値を持たないので、状態は比べない
+        if (!engine->approximate) {
+            reference->state(ctx->reference, ctx->expected_chip);
+            engine->state(actual, ctx->actual_chip);
+            if (opm_engine_chip_diff(ctx->expected_chip, ctx->actual_chip, NULL) > 0) {
+                if (report) {
+                    fprintf(report, "  chip state differs before frame %d (cycle %u):\n", frame,
+                            ctx->expected_chip->cycles);
+                    opm_engine_chip_diff(ctx->expected_chip, ctx->actual_chip, report);
+                }
+                result.frame = frame;
+                return result;
+            }
+        }
+
+        int32_t expected[2], got[2];
+        reference->render(ctx->reference, expected, 1);
+        engine->render(actual, got, 1);
+        if (!opm_engine_frame_matches(engine, expected, got)) {
+            if (report) {
+                fprintf(report, "  output differs at frame %d: expected (%d, %d), got (%d, %d)\n", frame,
+                        expected[0], expected[1], got[0], got[1]);
+            }
+            result.frame = frame;
+            result.output = 1;
+            return result;
+        }
+    }
+    return result;
+}
+
+static fuzz_result_t run_records(fuzz_context_t *ctx, int engine_index, const fuzz_record_t *records, int count) {
+    int frames = records_to_events(records, count, opm_engine_get(engine_index), ctx->events, ctx->max_frames);
+    return run_events(ctx, engine_index, ctx->events, count, frames, NULL);
+}
+
+
+// ============================================================
+// 3. Minimize
+// ============================================================
+
+// ずれが残る範囲でレコードを減らす (ddmin と同じく、大きな塊から順に取り除く)。
+// そのあと残ったレコードの待ちと値を 0 に寄せる。残ったレコード数を返す
+static int minimize(fuzz_context_t *ctx, int engine_index, fuzz_record_t *records, int count) {
+    fuzz_record_t *trial = (fuzz_record_t *)malloc(sizeof(fuzz_record_t) * (count > 0 ? count : 1));
+    if (!trial) return count;
+
+    for (int chunk = count / 2; chunk >= 1; chunk /= 2) {
+        int start = 0;
+        while (start < count && count > 1) {
+            int end = start + chunk < count ? start + chunk : count;
+            int n = 0;
+            for (int i = 0; i < count; i++) {
+                if (i < start || i >= end) trial[n++] = records[i];
+            }
+            if (n > 0 && run_records(ctx, engine_index, trial, n).frame >= 0) {
+                memcpy(records, trial, sizeof(fuzz_record_t) * n);
+                count = n;
+            } else {
+                start = end;
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        fuzz_record_t saved = records[i];
+        if (records[i].delay != 0) {
+            records[i].delay = 0;
+            if (run_records(ctx, engine_index, records, count).frame < 0) records[i] = saved;
+        }
+        saved = records[i];
+        if (records[i].data != 0) {
+            records[i].data = 0;
+            if (run_records(ctx, engine_index, records, count).frame < 0) records[i] = saved;
+        }
+    }
+    free(trial);
+    return count;
+}
+
+
+// ============================================================
+// 4. Report
+// ============================================================
+
+// frame より前に書いたイベントのうち最後のいくつか
+static void report_recent_events(const opm_event_t *events, int count, int frame) {
+    int last = -1;
+    for (int i = 0; i < count; i++) {
+        if ((double)events[i].time * SAMPLE_RATE <= (double)frame) last = i;
+    }
+    int first = last - RECENT_EVENTS + 1 > 0 ? last - RECENT_EVENTS + 1 : 0;
+    for (int i = first; i <= last; i++) {
+        fprintf(stderr, "    event %d: time %.6f (frame %.0f) addr 0x%02X data 0x%02X\n", i, events[i].time,
+                (double)events[i].time * SAMPLE_RATE, events[i].addr, events[i].data);
+    }
+}
+
+// presets.json と同じ形式で書く。time は float に戻したとき同じ値になる桁数で書く
+static int write_events_json(const char *path, const opm_event_t *events, int count) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+    fprintf(fp, "{\n  \"events\": [\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(fp, "    { \"time\": %.9g, \"addr\": \"0x%02X\", \"data\": \"0x%02X\" }%s\n", events[i].time,
+                events[i].addr, events[i].data, i + 1 < count ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    if (fclose(fp) != 0) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+// ずれた入力を小さくして表示し、output があればファイルに書く
+static void report_failure(fuzz_context_t *ctx, int engine_index, fuzz_record_t *records, int count,
+                           uint32_t seed, const char *output) {
+    const char *name = opm_engine_get(engine_index)->name;
+    fuzz_result_t found = run_records(ctx, engine_index, records, count);
+    int minimized = minimize(ctx, engine_index, records, count);
+
+    int frames = records_to_events(records, minimized, opm_engine_get(engine_index), ctx->events, ctx->max_frames);
+    fuzz_result_t result = run_events(ctx, engine_index, ctx->events, minimized, frames, NULL);
+    fprintf(stderr, "%s: %s differs from reference at frame %d (seed %u, %d writes)\n", name,
+            found.output ? "output" : "chip state", found.frame, seed, count);
+    fprintf(stderr, "  minimized to %d writes, differs at frame %d\n", minimized, result.frame);
+    if (result.frame >= 0) {
+        // 小さくした入力を、ずれたフレームまでで切って鳴らし直す
+        run_events(ctx, engine_index, ctx->events, minimized, result.frame + 1, stderr);
+        fprintf(stderr, "  last writes before frame %d:\n", result.frame);
+        report_recent_events(ctx->events, minimized, result.frame);
+    }
+
+    if (output) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s-%s-%u.json", output, name, seed);
+        if (write_events_json(path, ctx->events, minimized) == 0) {
+            fprintf(stderr, "  wrote %s (replay: opm-fuzz -e %s -r %s)\n", path, name, path);
+        }
+    }
+}
+
+
+// ============================================================
+// 5. Main
+// ============================================================
+
+#ifdef OPM_FUZZ_LIBFUZZER
+
+// libFuzzer から呼ばれる。ずれたら表示して abort する (libFuzzer が入力を保存・縮小する)
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static fuzz_context_t ctx;
+    static int initialized = 0;
+    static fuzz_record_t records[4096];
+    if (!initialized) {
+        if (context_init(&ctx, 4096, DEFAULT_MAX_FRAMES) != 0) abort();
+        initialized = 1;
+    }
+
+    int count = (int)(size / RECORD_SIZE);
+    if (count > 4096) count = 4096;
+    for (int i = 0; i < count; i++) {
+        records[i].delay = data[i * RECORD_SIZE + 0];
+        records[i].addr = data[i * RECORD_SIZE + 1];
+        records[i].data = data[i * RECORD_SIZE + 2];
+    }
+
+    for (int e = 1; e < opm_engine_count(); e++) {
+        int frames = records_to_events(records, count, opm_engine_get(e), ctx.events, ctx.max_frames);
+        fuzz_result_t result = run_events(&ctx, e, ctx.events, count, frames, NULL);
+        if (result.frame >= 0) {
+            fprintf(stderr, "%s differs from reference:\n", opm_engine_get(e)->name);
+            run_events(&ctx, e, ctx.events, count, result.frame + 1, stderr);
+            abort();
+        }
+    }
+    return 0;
+}
+
+#else
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "\n"
+        "options:\n"
+        "  -n, --iterations N    random inputs to try (default: %d, 0: until -t)\n"
+        "  -s, --seed N          seed of the first input (default: time)\n"
+        "  -e, --engine NAME     engine to compare with the reference (default: all)\n"
+        "  -w, --writes N        max register writes per input (default: %d)\n"
+        "  -f, --frames N        max frames per input (default: %d)\n"
+        "  -t, --time SECONDS    stop after this many seconds\n"
+        "  -o, --output PREFIX   write minimized inputs to PREFIX-<engine>-<seed>.json\n"
+        "  -r, --replay FILE     compare the engines on an events JSON instead\n"
+        "  -q, --quiet           no progress output\n"
+        "  -h, --help            show this help\n",
+        prog, DEFAULT_ITERATIONS, DEFAULT_MAX_RECORDS, DEFAULT_MAX_FRAMES);
+}
+
+static int run_replay(fuzz_context_t *ctx, const fuzz_options_t *opt, int first, int last) {
+    size_t length;
+    char *json = opm_events_read_file(opt->replay, &length);
+    if (!json) {
+        perror(opt->replay);
+        return 1;
+    }
+    opm_event_t *events = NULL;
+    int count = 0;
+    char error[256];
+    int status = opm_events_parse_json(json, length, 0, &events, &count, error, sizeof(error));
+    free(json);
+    if (status != 0) {
+        fprintf(stderr, "%s: %s\n", opt->replay, error);
+        return 1;
+    }
+
+    double duration = opm_events_duration(events, count);
+    int frames = (int)(duration * SAMPLE_RATE);
+    int failures = 0;
+    for (int e = first; e <= last; e++) {
+        if (opm_engine_get(e)->approximate && opm_engine_uses_approx(events, count)) {
+            printf("%s: uses LFO or the test register (not compared)\n", opm_engine_get(e)->name);
+            continue;
+        }
+        fuzz_result_t result = run_events(ctx, e, events, count, frames, NULL);
+        if (result.frame < 0) {
+            printf("%s: matches the reference for %d frames\n", opm_engine_get(e)->name, frames);
+            continue;
+        }
+        fprintf(stderr, "%s: %s differs from reference at frame %d\n", opm_engine_get(e)->name,
+                result.output ? "output" : "chip state", result.frame);
+        run_events(ctx, e, events, count, result.frame + 1, stderr);
+        fprintf(stderr, "  last writes before frame %d:\n", result.frame);
+        report_recent_events(events, count, result.frame);
+        failures++;
+    }
+    opm_events_free(events);
+    return failures ? 1 : 0;
+}
+
+static int run_fuzz(fuzz_context_t *ctx, const fuzz_options_t *opt, int first, int last) {
+    fuzz_record_t *records = (fuzz_record_t *)malloc(sizeof(fuzz_record_t) * opt->max_records);
+    if (!records) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    struct timespec t0, now;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int failures = 0;
+    int iteration;
+    for (iteration = 0; opt->iterations == 0 || iteration < opt->iterations; iteration++) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double elapsed = (double)(now.tv_sec - t0.tv_sec) + (double)(now.tv_nsec - t0.tv_nsec) * 1e-9;
+        if (opt->max_seconds > 0 && elapsed >= opt->max_seconds) break;
+
+        // seed を1つずつ進めるので、-s <seed> -n 1 で同じ入力を作り直せる
+        uint32_t seed = opt->seed + (uint32_t)iteration;
+        int count = random_records(seed, opt->max_records, records);
+        for (int e = first; e <= last; e++) {
+            if (run_records(ctx, e, records, count).frame < 0) continue;
+            // records は縮小で書き換わるので、ほかのエンジンのために作り直す
+            report_failure(ctx, e, records, count, seed, opt->output);
+            count = random_records(seed, opt->max_records, records);
+            failures++;
+        }
+        if (!opt->quiet && (iteration + 1) % 50 == 0) {
+            fprintf(stderr, "%d inputs, %d failures, %.1f s\n", iteration + 1, failures, elapsed);
+        }
+    }
+    if (!opt->quiet) {
+        printf("%d inputs (seed %u..%u), %d failures\n", iteration, opt->seed,
+               opt->seed + (uint32_t)(iteration > 0 ? iteration - 1 : 0), failures);
+    }
+    free(records);
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    static const struct option long_options[] = {
+        { "iterations", required_argument, NULL, 'n' },
+        { "seed",       required_argument, NULL, 's' },
+        { "engine",     required_argument, NULL, 'e' },
+        { "writes",     required_argument, NULL, 'w' },
+        { "frames",     required_argument, NULL, 'f' },
+        { "time",       required_argument, NULL, 't' },
+        { "output",     required_argument, NULL, 'o' },
+        { "replay",     required_argument, NULL, 'r' },
+        { "quiet",      no_argument,       NULL, 'q' },
+        { "help",       no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    fuzz_options_t opt;
+    memset(&opt, 0, sizeof(opt));
+    opt.iterations = DEFAULT_ITERATIONS;
+    opt.seed = (uint32_t)time(NULL);
+    opt.max_records = DEFAULT_MAX_RECORDS;
+    opt.max_frames = DEFAULT_MAX_FRAMES;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "n:s:e:w:f:t:o:r:qh", long_options, NULL)) != -1) {
+        switch (c) {
+        case 'n': opt.iterations = atoi(optarg); break;
+        case 's': opt.seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'e': opt.engine = optarg; break;
+        case 'w': opt.max_records = atoi(optarg); break;
+        case 'f': opt.max_frames = atoi(optarg); break;
+        case 't': opt.max_seconds = atof(optarg); break;
+        case 'o': opt.output = optarg; break;
+        case 'r': opt.replay = optarg; break;
+        case 'q': opt.quiet = 1; break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (optind != argc || opt.iterations < 0 || opt.max_records <= 0 || opt.max_frames <= 0) {
+        print_usage(argv[0]);
+        return 2;
+    }
+    if (opt.iterations == 0 && opt.max_seconds <= 0) {
+        fprintf(stderr, "-n 0 needs -t\n");
+        return 2;
+    }
+
+    int first = 1, last = opm_engine_count() - 1;
+    if (opt.engine) {
+        const opm_engine_t *engine = opm_engine_find(opt.engine);
+        if (!engine || engine == opm_engine_get(0)) {
+            fprintf(stderr, "unknown engine: %s\n", opt.engine);
+            return 2;
+        }
+        for (int i = 1; i < opm_engine_count(); i++) {
+            if (opm_engine_get(i) == engine) first = last = i;
+        }
+    }
+
+    fuzz_context_t ctx;
+    if (context_init(&ctx, opt.max_records, opt.max_frames) != 0) {
+        fprintf(stderr, "out of memory\n");
+        context_free(&ctx);
+        return 1;
+    }
+    int status = opt.replay ? run_replay(&ctx, &opt, first, last) : run_fuzz(&ctx, &opt, first, last);
+    context_free(&ctx);
+    return status;
+}
+
+#endif
@@ -0,0 +1,756 @@
+// エンジンのビット一致テスト (ゴールデン出力)
+//
+// opm.c を速くする変更で音が変わっていないことを確かめるためのツール。
+// presets.json の全エントリと、全レジスタ・全アルゴリズム・LFO の全波形・ノイズ・
+// タイマー・CSM を使う合成した列 (コーパス) を鳴らし、
+//   record : 参照実装 (OPM_Clock をそのまま回すループ) の出力を
+//            ブロックごとのハッシュにしてファイルに書く
+//   verify : 各エンジン (レンダラー、ステム、SIMD など) の出力を参照実装と
+//            1サンプルずつ比べ、record したファイル (既定はリポジトリの golden.txt) とも比べる。
+//            参照実装も同じ opm.c から作るので、別のビルド (コンパイラ、最適化オプション、
+//            opm.c の更新前後) でずれたことはファイルと比べないと分からない
+// 一致しなければ最初にずれたサンプルと、チップの状態が最初にずれたサンプル・
+// フィールドを表示する。-i を付けなければ presets.json を読む。
+//
+//   opm-golden record -o golden.txt      (opm.c の出力を意図して変えたときに作り直す)
+//   opm-golden verify
+//   opm-golden verify -e simd
+//   opm-golden verify -i other.json -g other_golden.txt
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include "opm.h"
+#include "opm_renderer.h"
+#include "opm_events.h"
+#include "opm_engines.h"
+
+#define SAMPLE_RATE (3579545.0 / 64)
+
+// 比べるときの基準 (OPM_Clock をそのまま回すエンジン)
+#define reference_engine (opm_engine_get(0))
+
+// ハッシュ1つあたりのフレーム数 (-b で変えられる)。ファイルと比べたときは
+// ずれた位置がこの単位でしか分からない
+#define DEFAULT_BLOCK_FRAMES 1024
+
+#define GOLDEN_MAGIC "# opm-golden v1"
+
+// -i / -g を付けないときに使うもの (CMake がソースディレクトリのパスを渡す)
+#ifndef OPM_GOLDEN_PRESETS
+#define OPM_GOLDEN_PRESETS "presets.json"
+#endif
+#ifndef OPM_GOLDEN_FILE
+#define OPM_GOLDEN_FILE "golden.txt"
+#endif
+#define MAX_NAME 96
+
+typedef struct {
+    const char *command;  // "record" / "verify"
+    const char *input;    // presets.json。NULL ならプリセットは使わない
+    const char *golden;   // verify で比べるファイル
+    const char *output;   // record の出力。"-" は stdout
+    const char *engine;   // verify するエンジン ("all" で全部)
+    int block_frames;
+} golden_options_t;
+
+typedef struct {
+    char name[MAX_NAME];
+    opm_event_t *events;
+    int count;
+    int capacity;
+    int frames;
+} golden_seq_t;
+
+typedef struct {
+    golden_seq_t *items;
+    int count;
+} golden_corpus_t;
+
+
+// ============================================================
+// 1. Utilities
+// ============================================================
+
+#define HASH_INIT 14695981039346656037ull
+
+// FNV-1a 64
+static uint64_t hash_update(uint64_t hash, const void *data, size_t size) {
+    const uint8_t *p = (const uint8_t *)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// タイマーは音に出ないので、ステータスもブロックのハッシュに入れる
+static uint64_t hash_block(const int32_t *samples, int frames, const opm_t *chip) {
+    uint64_t hash = hash_update(HASH_INIT, samples, sizeof(int32_t) * 2 * (size_t)frames);
+    uint8_t status[3] = { chip->timer_a_status, chip->timer_b_status, chip->timer_irq };
+    return hash_update(hash, status, sizeof(status));
+}
+
+static int seq_add(golden_seq_t *seq, double time, uint8_t addr, uint8_t data) {
+    if (seq->count == seq->capacity) {
+        int capacity = seq->capacity ? seq->capacity * 2 : 256;
+        opm_event_t *events = (opm_event_t *)realloc(seq->events, sizeof(opm_event_t) * capacity);
+        if (!events) return -1;
+        seq->events = events;
+        seq->capacity = capacity;
+    }
+    opm_event_t *e = &seq->events[seq->count++];
+    memset(e, 0, sizeof(*e));
+    e->time = (float)time;
+    e->addr = addr;
+    e->data = data;
+    return 0;
+}
+
+static golden_seq_t *corpus_add(golden_corpus_t *corpus, const char *name, double seconds) {
+    golden_seq_t *items = (golden_seq_t *)realloc(corpus->items, sizeof(golden_seq_t) * (corpus->count + 1));
+    if (!items) return NULL;
+    corpus->items = items;
+    golden_seq_t *seq = &items[corpus->count++];
+    memset(seq, 0, sizeof(*seq));
+    snprintf(seq->name, sizeof(seq->name), "%s", name);
+    seq->frames = (int)(seconds * SAMPLE_RATE);
+    return seq;
+}
+
+static void corpus_free(golden_corpus_t *corpus) {
+    for (int i = 0; i < corpus->count; i++) {
+        free(corpus->items[i].events);
+    }
+    free(corpus->items);
+    corpus->items = NULL;
+    corpus->count = 0;
+}
+
+// xorshift32 (コーパスはどのビルドでも同じ列になる)
+static uint32_t random_next(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+
+// ============================================================
+// 2. Corpus
+// ============================================================
+
+// 1チャンネル分の音色。op ごとに DT1 / MUL / KS / DT2 を変えて全部の組み合わせに近づける
+static int add_voice(golden_seq_t *seq, double time, int ch, int con, int fb, uint8_t kc, int ams_en) {
+    int status = 0;
+    status |= seq_add(seq, time, (uint8_t)(0x20 + ch), (uint8_t)(0xC0 | (fb << 3) | con));
+    status |= seq_add(seq, time, (uint8_t)(0x28 + ch), kc);
+    status |= seq_add(seq, time, (uint8_t)(0x30 + ch), (uint8_t)(ch << 2));
+    for (int op = 0; op < 4; op++) {
+        int slot = op * 8 + ch;
+        status |= seq_add(seq, time, (uint8_t)(0x40 + slot), (uint8_t)(((op + ch) & 7) << 4 | ((op * 3 + ch) & 15)));
+        status |= seq_add(seq, time, (uint8_t)(0x60 + slot), (uint8_t)(op == 3 ? 0x08 : 0x18 + op * 4));
+        status |= seq_add(seq, time, (uint8_t)(0x80 + slot), (uint8_t)(((op + ch) & 3) << 6 | (0x1F - op)));
+        status |= seq_add(seq, time, (uint8_t)(0xA0 + slot), (uint8_t)((ams_en ? 0x80 : 0x00) | (0x04 + op)));
+        status |= seq_add(seq, time, (uint8_t)(0xC0 + slot), (uint8_t)(((op + ch) & 3) << 6 | 0x03));
+        status |= seq_add(seq, time, (uint8_t)(0xE0 + slot), (uint8_t)(0x27 + op * 0x10));
+    }
+    return status;
+}
+
+// CON ごとに全チャンネルを鳴らし、途中でキーオフ / 再キーオン (スロットの組み合わせを変える)
+static int build_algorithm(golden_corpus_t *corpus, int con) {
+    char name[MAX_NAME];
+    snprintf(name, sizeof(name), "alg%d", con);
+    golden_seq_t *seq = corpus_add(corpus, name, 0.5);
+    if (!seq) return -1;
+
+    int status = 0;
+    for (int ch = 0; ch < 8; ch++) {
+        status |= add_voice(seq, 0.0, ch, con, (ch + con) & 7, (uint8_t)(0x20 + ch * 0x0C + con), 0);
+        status |= seq_add(seq, 0.0, 0x08, (uint8_t)(0x78 | ch));
+    }
+    for (int ch = 0; ch < 8; ch++) {
+        status |= seq_add(seq, 0.25, 0x08, (uint8_t)ch);
+        status |= seq_add(seq, 0.30, 0x08, (uint8_t)((((ch + 1) & 15) << 3) | ch));
+    }
+    return status;
+}
+
+// LFO の波形ごとに PM / AM をかけ、途中で LFO をリセット (テストレジスタ 0x01 の bit1) する
+static int build_lfo(golden_corpus_t *corpus, int wave) {
+    char name[MAX_NAME];
+    snprintf(name, sizeof(name), "lfo_w%d", wave);
+    golden_seq_t *seq = corpus_add(corpus, name, 0.5);
+    if (!seq) return -1;
+
+    int status = 0;
+    status |= seq_add(seq, 0.0, 0x18, (uint8_t)(0xA0 + wave * 0x10));
+    status |= seq_add(seq, 0.0, 0x19, 0x60);
+    status |= seq_add(seq, 0.0, 0x19, 0x80 | 0x50);
+    status |= seq_add(seq, 0.0, 0x1B, (uint8_t)(0xC0 | wave));
+    for (int ch = 0; ch < 8; ch++) {
+        status |= add_voice(seq, 0.0, ch, ch, 2, (uint8_t)(0x30 + ch * 0x08), 1);
+        status |= seq_add(seq, 0.0, (uint8_t)(0x38 + ch), (uint8_t)(((ch & 7) << 4) | (ch & 3)));
+        status |= seq_add(seq, 0.0, 0x08, (uint8_t)(0x78 | ch));
+    }
+    status |= seq_add(seq, 0.2, 0x01, 0x02);
+    status |= seq_add(seq, 0.2, 0x01, 0x00);
+    status |= seq_add(seq, 0.3, 0x18, 0x40);
+    return status;
+}
+
+// ノイズ周波数を全部通す
+static int build_noise(golden_corpus_t *corpus) {
+    golden_seq_t *seq = corpus_add(corpus, "noise", 0.5);
+    if (!seq) return -1;
+
+    int status = add_voice(seq, 0.0, 7, 7, 0, 0x4A, 0);
+    status |= seq_add(seq, 0.0, 0x08, 0x78 | 7);
+    for (int f = 0; f < 32; f++) {
+        status |= seq_add(seq, f * 0.015, 0x0F, (uint8_t)(0x80 | f));
+    }
+    status |= seq_add(seq, 0.49, 0x0F, 0x00);
+    return status;
+}
+
+// タイマー A / B をロードして、IRQ を有効にしたりフラグをリセットしたりする
+static int build_timers(golden_corpus_t *corpus) {
+    golden_seq_t *seq = corpus_add(corpus, "timers", 0.5);
+    if (!seq) return -1;
+
+    int status = 0;
+    status |= seq_add(seq, 0.0, 0x10, 0xF0);
+    status |= seq_add(seq, 0.0, 0x11, 0x02);
+    status |= seq_add(seq, 0.0, 0x12, 0xE0);
+    status |= seq_add(seq, 0.0, 0x14, 0x0F);
+    for (int i = 1; i < 10; i++) {
+        status |= seq_add(seq, i * 0.045, 0x14, (uint8_t)((i & 1 ? 0x30 : 0x00) | 0x0F));
+        status |= seq_add(seq, i * 0.045 + 0.01, 0x12, (uint8_t)(0x80 + i * 8));
+    }
+    status |= seq_add(seq, 0.46, 0x14, 0x30);
+    return status;
+}
+
+// CSM: タイマー A があふれるたびに全スロットをキーオンする
+static int build_csm(golden_corpus_t *corpus) {
+    golden_seq_t *seq = corpus_add(corpus, "csm", 0.5);
+    if (!seq) return -1;
+
+    int status = 0;
+    for (int ch = 0; ch < 8; ch++) {
+        status |= add_voice(seq, 0.0, ch, 7, 0, (uint8_t)(0x40 + ch), 0);
+    }
+    status |= seq_add(seq, 0.0, 0x10, 0xE0);
+    status |= seq_add(seq, 0.0, 0x11, 0x00);
+    status |= seq_add(seq, 0.0, 0x14, 0x80 | 0x15);
+    status |= seq_add(seq, 0.3, 0x14, 0x80 | 0x35);
+    status |= seq_add(seq, 0.4, 0x14, 0x00);
+    return status;
+}
+
+// 全レジスタ (0x00 ～ 0xFF) に乱数を書き、その後も音源部分に乱数を書き続ける
+static int build_registers(golden_corpus_t *corpus, uint32_t seed) {
+    char name[MAX_NAME];
+    snprintf(name, sizeof(name), "registers_%08x", seed);
+    golden_seq_t *seq = corpus_add(corpus, name, 0.5);
+    if (!seq) return -1;
+
+    uint32_t state = seed;
+    int status = 0;
+    for (int addr = 0; addr < 0x100; addr++) {
+        status |= seq_add(seq, 0.0, (uint8_t)addr, (uint8_t)random_next(&state));
+    }
+    // テストレジスタを戻す (ほかは乱数のまま)
+    status |= seq_add(seq, 0.0, 0x01, 0x00);
+    for (int i = 0; i < 400; i++) {
+        double time = 0.02 + i * 0.001;
+        uint32_t r = random_next(&state);
+        if ((r & 7) == 0) {
+            status |= seq_add(seq, time, 0x08, (uint8_t)(r >> 8));
+        } else {
+            status |= seq_add(seq, time, (uint8_t)(0x20 + ((r >> 8) % 0xE0)), (uint8_t)(r >> 16));
+        }
+    }
+    return status;
+}
+
+static int load_presets(golden_corpus_t *corpus, const char *path) {
+    size_t length;
+    char *json = opm_events_read_file(path, &length);
+    if (!json) {
+        fprintf(stderr, "cannot read %s\n", path);
+        return -1;
+    }
+
+    opm_preset_t *presets;
+    int count;
+    char error[128];
+    int parsed = opm_events_parse_bank(json, length, &presets, &count, error, sizeof(error));
+    free(json);
+    if (parsed != 0) {
+        fprintf(stderr, "%s: %s\n", path, error);
+        return -1;
+    }
+
+    int status = 0;
+    for (int i = 0; i < count && status == 0; i++) {
+        char name[MAX_NAME];
+        snprintf(name, sizeof(name), "preset%d", i);
+        golden_seq_t *seq = corpus_add(corpus, name, opm_events_duration(presets[i].events, presets[i].count));
+        if (!seq) {
+            status = -1;
+            break;
+        }
+        for (int e = 0; e < presets[i].count && status == 0; e++) {
+            status = seq_add(seq, presets[i].events[e].time, presets[i].events[e].addr, presets[i].events[e].data);
+        }
+    }
+    opm_events_free_bank(presets, count);
+    return status;
+}
+
+static int build_corpus(golden_corpus_t *corpus, const char *presets) {
+    if (presets && load_presets(corpus, presets) != 0) return -1;
+
+    int status = 0;
+    for (int con = 0; con < 8; con++) status |= build_algorithm(corpus, con);
+    for (int wave = 0; wave < 4; wave++) status |= build_lfo(corpus, wave);
+    status |= build_noise(corpus);
+    status |= build_timers(corpus);
+    status |= build_csm(corpus);
+    status |= build_registers(corpus, 0x12345678u);
+    status |= build_registers(corpus, 0x9E3779B9u);
+    return status;
+}
+
+
+// ============================================================
+// 3. Diagnostics
+// ============================================================
+
+// frame より前で最後に書いたイベント (どの書き込みの後でずれたかの目安)
+static void report_recent_events(const golden_seq_t *seq, int frame) {
+    int last = -1;
+    for (int i = 0; i < seq->count; i++) {
+        if (seq->events[i].time * SAMPLE_RATE <= (double)frame) last = i;
+    }
+    if (last < 0) return;
+    int first = last >= 3 ? last - 3 : 0;
+    fprintf(stderr, "  events up to frame %d (times are scheduled, writes may lag):\n", frame);
+    for (int i = first; i <= last; i++) {
+        fprintf(stderr, "    #%d  %.6f s  0x%02x = 0x%02x\n", i, seq->events[i].time,
+                seq->events[i].addr, seq->events[i].data);
+    }
+}
+
+// 2つのエンジンを1フレームずつ回し、チップの状態が最初にずれたフレームを探す
+static void report_state_divergence(const opm_engine_t *engine, void *actual, void *reference,
+                                    const golden_seq_t *seq, int limit) {
+    opm_t *expected_chip = (opm_t *)malloc(sizeof(opm_t));
+    opm_t *actual_chip = (opm_t *)malloc(sizeof(opm_t));
+    if (!expected_chip || !actual_chip) {
+        free(expected_chip);
+        free(actual_chip);
+        return;
+    }
+
+    reference_engine->start(reference, seq->events, seq->count);
+    engine->start(actual, seq->events, seq->count);
+    int32_t scratch[2];
+    for (int frame = 0; frame <= limit; frame++) {
+        reference_engine->state(reference, expected_chip);
+        engine->state(actual, actual_chip);
+        if (opm_engine_chip_diff(expected_chip, actual_chip, NULL) > 0) {
+            fprintf(stderr, "  chip state first differs before frame %d (cycle %u):\n", frame, expected_chip->cycles);
+            opm_engine_chip_diff(expected_chip, actual_chip, stderr);
+            break;
+        }
+        if (frame == limit) {
+            fprintf(stderr, "  chip state matches up to frame %d\n", frame);
+            break;
+        }
+        reference_engine->render(reference, scratch, 1);
+        engine->render(actual, scratch, 1);
+    }
+    free(expected_chip);
+    free(actual_chip);
+}
+
+
+// ============================================================
+// 4. Record / Verify
+// ============================================================
+
+typedef struct {
+    char name[MAX_NAME];
+    int frames;
+    int block_frames;
+    int num_blocks;
+    uint64_t *hashes;
+} golden_entry_t;
+
+typedef struct {
+    golden_entry_t *items;
+    int count;
+} golden_file_t;
+
+static void golden_file_free(golden_file_t *file) {
+    for (int i = 0; i < file->count; i++) {
+        free(file->items[i].hashes);
+    }
+    free(file->items);
+    file->items = NULL;
+    file->count = 0;
+}
+
+// 1行 = "<name> <frames> <block_frames> <hash> <hash> ..."
+static int golden_file_read(const char *path, golden_file_t *file) {
+    size_t length;
+    char *text = opm_events_read_file(path, &length);
+    if (!text) {
+        fprintf(stderr, "cannot read %s\n", path);
+        return -1;
+    }
+    if (strncmp(text, GOLDEN_MAGIC, strlen(GOLDEN_MAGIC)) != 0) {
+        fprintf(stderr, "%s: not an opm-golden file\n", path);
+        free(text);
+        return -1;
+    }
+
+    int status = 0;
+    char *save = NULL;
+    for (char *line = strtok_r(text, "\n", &save); line && status == 0; line = strtok_r(NULL, "\n", &save)) {
+        if (line[0] == '#' || line[0] == '\0') continue;
+
+        golden_entry_t entry;
+        memset(&entry, 0, sizeof(entry));
+        int consumed = 0;
+        if (sscanf(line, "%95s %d %d%n", entry.name, &entry.frames, &entry.block_frames, &consumed) != 3 ||
+            entry.frames < 0 || entry.block_frames <= 0) {
+            fprintf(stderr, "%s: malformed line: %.40s\n", path, line);
+            status = -1;
+            break;
+        }
+        entry.num_blocks = (entry.frames + entry.block_frames - 1) / entry.block_frames;
+        entry.hashes = (uint64_t *)calloc(entry.num_blocks > 0 ? entry.num_blocks : 1, sizeof(uint64_t));
+        golden_entry_t *items = (golden_entry_t *)realloc(file->items, sizeof(golden_entry_t) * (file->count + 1));
+        if (!entry.hashes || !items) {
+            free(entry.hashes);
+            if (items) file->items = items;
+            status = -1;
+            break;
+        }
+        file->items = items;
+
+        const char *p = line + consumed;
+        for (int b = 0; b < entry.num_blocks; b++) {
+            int n = 0;
+            unsigned long long h;
+            if (sscanf(p, "%llx%n", &h, &n) != 1) {
+                fprintf(stderr, "%s: %s: missing hashes\n", path, entry.name);
+                status = -1;
+                break;
+            }
+            entry.hashes[b] = (uint64_t)h;
+            p += n;
+        }
+        file->items[file->count++] = entry;
+    }
+    free(text);
+    return status;
+}
+
+static const golden_entry_t *golden_file_find(const golden_file_t *file, const char *name) {
+    for (int i = 0; i < file->count; i++) {
+        if (strcmp(file->items[i].name, name) == 0) return &file->items[i];
+    }
+    return NULL;
+}
+
+static int run_record(const golden_options_t *opt, const golden_corpus_t *corpus) {
+    const opm_engine_t *engine = opm_engine_find(opt->engine ? opt->engine : "reference");
+    if (!engine) {
+        fprintf(stderr, "unknown engine: %s\n", opt->engine);
+        return 2;
+    }
+
+    FILE *out = strcmp(opt->output, "-") == 0 ? stdout : fopen(opt->output, "w");
+    void *e = engine->create();
+    int32_t *block = (int32_t *)malloc(sizeof(int32_t) * 2 * opt->block_frames);
+    opm_t *chip = (opm_t *)malloc(sizeof(opm_t));
+    int status = 0;
+    if (!out || !e || !block || !chip) {
+        fprintf(stderr, out ? "out of memory\n" : "cannot open output\n");
+        status = 1;
+    }
+
+    if (status == 0) {
+        fprintf(out, "%s\n", GOLDEN_MAGIC);
+        fprintf(out, "# engine %s, %d sequences\n", engine->name, corpus->count);
+    }
+    for (int s = 0; s < corpus->count && status == 0; s++) {
+        const golden_seq_t *seq = &corpus->items[s];
+        engine->start(e, seq->events, seq->count);
+        fprintf(out, "%s %d %d", seq->name, seq->frames, opt->block_frames);
+        for (int done = 0; done < seq->frames; done += opt->block_frames) {
+            int n = seq->frames - done < opt->block_frames ? seq->frames - done : opt->block_frames;
+            if (engine->render(e, block, n) != n) {
+                status = 1;
+                break;
+            }
+            engine->state(e, chip);
+            fprintf(out, " %016llx", (unsigned long long)hash_block(block, n, chip));
+        }
+        fputc('\n', out);
+    }
+
+    if (out && out != stdout && fclose(out) != 0) status = 1;
+    if (e) engine->destroy(e);
+    free(block);
+    free(chip);
+    return status;
+}
+
+// engine を参照実装と1フレームずつ比べ、golden があればそのハッシュとも比べる。
+// 近似エンジンは LFO かテストレジスタを使う列を飛ばし、許す差の範囲で参照実装とだけ比べる。
+// 一致すれば 0
+static int verify_engine(const golden_options_t *opt, const opm_engine_t *engine, const golden_corpus_t *corpus,
+                         const golden_file_t *golden) {
+    void *actual = engine->create();
+    void *reference = reference_engine->create();
+    int32_t *expected_block = (int32_t *)malloc(sizeof(int32_t) * 2 * opt->block_frames);
+    int32_t *actual_block = (int32_t *)malloc(sizeof(int32_t) * 2 * opt->block_frames);
+    opm_t *chip = (opm_t *)malloc(sizeof(opm_t));
+    if (!actual || !reference || !expected_block || !actual_block || !chip) {
+        fprintf(stderr, "out of memory\n");
+        if (actual) engine->destroy(actual);
+        if (reference) reference_engine->destroy(reference);
+        free(expected_block);
+        free(actual_block);
+        free(chip);
+        return 1;
+    }
+
+    int failures = 0;
+    int skipped = 0;
+    for (int s = 0; s < corpus->count; s++) {
+        const golden_seq_t *seq = &corpus->items[s];
+        if (engine->approximate && opm_engine_uses_approx(seq->events, seq->count)) {
+            skipped++;
+            continue;
+        }
+        const golden_entry_t *entry = golden && !engine->approximate ? golden_file_find(golden, seq->name) : NULL;
+        if (golden && !engine->approximate && !entry) {
+            fprintf(stderr, "%s: %s: not in golden file (skipped hash check)\n", engine->name, seq->name);
+        } else if (entry && (entry->frames != seq->frames || entry->block_frames != opt->block_frames)) {
+            fprintf(stderr, "%s: %s: golden file has %d frames in blocks of %d, corpus has %d in blocks of %d\n",
+                    engine->name, seq->name, entry->frames, entry->block_frames, seq->frames, opt->block_frames);
+            failures++;
+            continue;
+        }
+
+        reference_engine->start(reference, seq->events, seq->count);
+        engine->start(actual, seq->events, seq->count);
+
+        int diverged = -1;
+        int golden_block = -1;
+        for (int done = 0, b = 0; done < seq->frames && diverged < 0; done += opt->block_frames, b++) {
+            int n = seq->frames - done < opt->block_frames ? seq->frames - done : opt->block_frames;
+            reference_engine->render(reference, expected_block, n);
+            if (engine->render(actual, actual_block, n) != n) {
+                fprintf(stderr, "%s: %s: render failed at frame %d\n", engine->name, seq->name, done);
+                diverged = done;
+                break;
+            }
+
+            engine->state(actual, chip);
+            if (entry && golden_block < 0 && hash_block(actual_block, n, chip) != entry->hashes[b]) {
+                golden_block = b;
+            }
+
+            for (int i = 0; i < n; i++) {
+                if (!opm_engine_frame_matches(engine, &expected_block[i * 2], &actual_block[i * 2])) {
+                    diverged = done + i;
+                    fprintf(stderr, "%s: %s: first divergent frame %d (%.6f s): expected L %d R %d, got L %d R %d\n",
+                            engine->name, seq->name, diverged, diverged / SAMPLE_RATE,
+                            expected_block[i * 2], expected_block[i * 2 + 1],
+                            actual_block[i * 2], actual_block[i * 2 + 1]);
+                    break;
+                }
+            }
+        }
+
+        if (golden_block >= 0) {
+            int first = golden_block * opt->block_frames;
+            fprintf(stderr, "%s: %s: differs from the golden file in block %d (frames %d - %d)%s\n",
+                    engine->name, seq->name, golden_block, first, first + opt->block_frames - 1,
+                    diverged < 0 ? "; this build's OPM_Clock changed too" : "");
+        }
+        if (diverged >= 0) {
+            report_recent_events(seq, diverged);
+            if (!engine->approximate) report_state_divergence(engine, actual, reference, seq, diverged);
+        }
+        if (diverged >= 0 || golden_block >= 0) failures++;
+    }
+
+    engine->destroy(actual);
+    reference_engine->destroy(reference);
+    free(expected_block);
+    free(actual_block);
+    free(chip);
+
+    if (engine->approximate) {
+        fprintf(stderr, "%s: %d / %d sequences match (reference, within %d; %d using LFO or the test register skipped)\n",
+                engine->name, corpus->count - skipped - failures, corpus->count - skipped, (int)engine->tolerance,
+                skipped);
+    } else {
+        fprintf(stderr, "%s: %d / %d sequences match%s\n", engine->name, corpus->count - failures, corpus->count,
+                golden ? " (reference and golden file)" : " (reference)");
+    }
+    return failures > 0;
+}
+
+static int run_verify(const golden_options_t *opt, const golden_corpus_t *corpus) {
+    golden_file_t golden = { 0 };
+    if (opt->golden && golden_file_read(opt->golden, &golden) != 0) {
+        golden_file_free(&golden);
+        return 1;
+    }
+
+    int status = 0;
+    const char *name = opt->engine ? opt->engine : "all";
+    if (strcmp(name, "all") == 0) {
+        for (int i = 0; i < opm_engine_count(); i++) {
+            status |= verify_engine(opt, opm_engine_get(i), corpus, opt->golden ? &golden : NULL);
+        }
+    } else {
+        const opm_engine_t *engine = opm_engine_find(name);
+        if (!engine) {
+            fprintf(stderr, "unknown engine: %s\n", name);
+            status = 2;
+        } else {
+            status = verify_engine(opt, engine, corpus, opt->golden ? &golden : NULL);
+        }
+    }
+    golden_file_free(&golden);
+    return status;
+}
+
+
+// ============================================================
+// 5. Main
+// ============================================================
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+        "usage: %s record [options]\n"
+        "       %s verify [options]\n"
+        "\n"
+        "options:\n"
+        "  -i, --input FILE      presets.json to add to the corpus (default: %s)\n"
+        "  -o, --output FILE     record: golden file to write (default: stdout)\n"
+        "  -g, --golden FILE     verify: also compare against this golden file\n"
+        "                        (default without -i: %s)\n"
+        "  -G, --no-golden       verify: compare with the reference engine only\n"
+        "  -e, --engine NAME     record: engine to record (default: reference)\n"
+        "                        verify: engine to check, or all (default: all)\n"
+        "  -b, --block FRAMES    frames per hash (default: %d)\n"
+        "  -l, --list            list the corpus and engines\n"
+        "  -h, --help            show this help\n",
+        prog, prog, OPM_GOLDEN_PRESETS, OPM_GOLDEN_FILE, DEFAULT_BLOCK_FRAMES);
+}
+
+static void print_list(const golden_corpus_t *corpus) {
+    printf("engines:");
+    for (int i = 0; i < opm_engine_count(); i++) printf(" %s", opm_engine_get(i)->name);
+    printf("\ncorpus:\n");
+    for (int i = 0; i < corpus->count; i++) {
+        printf("  %-24s %7d frames, %5d events\n", corpus->items[i].name, corpus->items[i].frames,
+               corpus->items[i].count);
+    }
+}
+
+int main(int argc, char **argv) {
+    static const struct option long_options[] = {
+        { "input",  required_argument, NULL, 'i' },
+        { "output", required_argument, NULL, 'o' },
+        { "golden", required_argument, NULL, 'g' },
+        { "no-golden", no_argument,    NULL, 'G' },
+        { "engine", required_argument, NULL, 'e' },
+        { "block",  required_argument, NULL, 'b' },
+        { "list",   no_argument,       NULL, 'l' },
+        { "help",   no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    golden_options_t opt;
+    memset(&opt, 0, sizeof(opt));
+    opt.output = "-";
+    opt.block_frames = DEFAULT_BLOCK_FRAMES;
+    int list = 0;
+    int no_golden = 0;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "i:o:g:Ge:b:lh", long_options, NULL)) != -1) {
+        switch (c) {
+        case 'i': opt.input = optarg; break;
+        case 'o': opt.output = optarg; break;
+        case 'g': opt.golden = optarg; break;
+        case 'G': no_golden = 1; break;
+        case 'e': opt.engine = optarg; break;
+        case 'b':
+            opt.block_frames = atoi(optarg);
+            if (opt.block_frames <= 0) {
+                fprintf(stderr, "invalid block size: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'l': list = 1; break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (!list) {
+        if (optind != argc - 1 || (strcmp(argv[optind], "record") != 0 && strcmp(argv[optind], "verify") != 0)) {
+            print_usage(argv[0]);
+            return 2;
+        }
+        opt.command = argv[optind];
+    }
+
+    // 既定のゴールデンファイルは既定のプリセットを record したもの
+    if (!opt.input) {
+        opt.input = OPM_GOLDEN_PRESETS;
+        if (!opt.golden) opt.golden = OPM_GOLDEN_FILE;
+    }
+    if (no_golden) opt.golden = NULL;
+
+    golden_corpus_t corpus = { 0 };
+    if (build_corpus(&corpus, opt.input) != 0) {
+        fprintf(stderr, "cannot build the corpus\n");
+        corpus_free(&corpus);
+        return 1;
+    }
+
+    int status;
+    if (list) {
+        print_list(&corpus);
+        status = 0;
+    } else if (strcmp(opt.command, "record") == 0) {
+        status = run_record(&opt, &corpus);
+    } else {
+        status = run_verify(&opt, &corpus);
+    }
+    corpus_free(&corpus);
+    return status;
+}
@@ -0,0 +1,154 @@
+#include <stdlib.h>
+#include <math.h>
+#include "opm_multisample.h"
+
+// --- レジスタ ---
+#define REG_KEY_ON 0x08
+#define REG_CON 0x20  // 0x20 + ch: RL / FB / CON
+#define REG_KC 0x28   // 0x28 + ch
+#define REG_KF 0x30   // 0x30 + ch
+#define REG_TL 0x60   // 0x60 + op * 8 + ch (op: M1, M2, C1, C2 の順)
+
+// スナップショットを取る前に、最後の書き込みのビジー期間が明けるのを待つフレーム数
+#define SNAPSHOT_SETTLE_FRAMES 4
+
+// TL 1 ステップ = 0.75dB
+#define TL_DB_PER_STEP 0.75
+
+struct opm_multisample {
+    opm_t snapshot;
+    int channel;
+    uint8_t key_on_mask;  // 0x08 に書くオペレーターのビット (bit3-6)
+    uint8_t tl[4];        // 音色設定での TL (M1, M2, C1, C2)
+    uint8_t carriers;     // キャリアのオペレーター (bit0-3: M1, M2, C1, C2)
+};
+
+
+// ============================================================
+// 1. Tone Analysis
+// ============================================================
+
+// CON (アルゴリズム) ごとのキャリア。bit0-3 = M1, M2, C1, C2
+static const uint8_t carrier_table[8] = {
+    0x08, 0x08, 0x08, 0x08, 0x0c, 0x0e, 0x0e, 0x0f
+};
+
+// 音色設定として残すなら 1。KC / KF / キーオンはノートごとに書くので外す
+static int is_tone_register(uint8_t addr) {
+    if (addr == REG_KEY_ON) return 0;
+    if (addr >= REG_KC && addr < REG_KF + 8) return 0;
+    return 1;
+}
+
+
+// ============================================================
+// 2. Multisample API
+// ============================================================
+
+opm_multisample_t *opm_multisample_create(const opm_event_t *tone, int event_count) {
+    opm_multisample_t *ms = (opm_multisample_t *)calloc(1, sizeof(opm_multisample_t));
+    opm_event_t *prefix = (opm_event_t *)malloc(sizeof(opm_event_t) * (event_count > 0 ? event_count : 1));
+    opm_renderer_t *r = opm_renderer_create();
+    if (!ms || !prefix || !r) {
+        free(ms);
+        free(prefix);
+        opm_renderer_destroy(r);
+        return NULL;
+    }
+
+    // キーオンからチャンネルとオペレーターを決める
+    ms->channel = 0;
+    ms->key_on_mask = 0x78;
+    for (int i = 0; i < event_count; i++) {
+        if (tone[i].addr == REG_KEY_ON && (tone[i].data & 0x78) != 0) {
+            ms->channel = tone[i].data & 7;
+            ms->key_on_mask = tone[i].data & 0x78;
+            break;
+        }
+    }
+
+    // 音色設定部分。時刻は詰めて、書き込み順だけを保つ
+    int prefix_count = 0;
+    uint8_t con = 0;
+    for (int i = 0; i < event_count; i++) {
+        uint8_t addr = tone[i].addr;
+        if (!is_tone_register(addr)) continue;
+        prefix[prefix_count] = tone[i];
+        prefix[prefix_count].time = 0.0f;
+        prefix_count++;
+
+        if (addr == REG_CON + ms->channel) {
+            con = tone[i].data & 7;
+        } else if (addr >= REG_TL && addr < REG_TL + 32 && (addr & 7) == ms->channel) {
+            ms->tl[(addr - REG_TL) >> 3] = tone[i].data & 0x7f;
+        }
+    }
+    ms->carriers = carrier_table[con];
+
+    // 書き終わるまで鳴らしてチップの状態を取っておく
+    float scratch[2 * SNAPSHOT_SETTLE_FRAMES];
+    opm_output_t out;
+    opm_output_init_interleaved(&out, OPM_SAMPLE_FLOAT32, scratch);
+    opm_renderer_start(r, prefix, prefix_count);
+    while (!opm_renderer_finished(r)) {
+        opm_renderer_render_block(r, 1, &out);
+    }
+    opm_renderer_render_block(r, SNAPSHOT_SETTLE_FRAMES, &out);
+    ms->snapshot = *opm_renderer_chip(r);
+
+    opm_renderer_destroy(r);
+    free(prefix);
+    return ms;
+}
+
+void opm_multisample_destroy(opm_multisample_t *ms) {
+    free(ms);
+}
+
+double opm_midi_to_kc(double note, uint8_t *kc, uint8_t *kf) {
+    if (note < OPM_MIDI_NOTE_MIN) note = OPM_MIDI_NOTE_MIN;
+    if (note > OPM_MIDI_NOTE_MAX) note = OPM_MIDI_NOTE_MAX;
+
+    // KF は 1/64 半音
+    int steps = (int)floor(note * 64.0 + 0.5);
+    int semitone = steps >> 6;
+    int fraction = steps & 63;
+    if (semitone >= OPM_MIDI_NOTE_MAX) {
+        semitone = OPM_MIDI_NOTE_MAX;
+        fraction = 0;
+    }
+
+    // KC は C# から始まる 12 音を 0-2, 4-6, 8-10, 12-14 に詰めたもの
+    static const uint8_t note_code[12] = { 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14 };
+    int octave = (semitone - 1) / 12 - 1;
+    *kc = (uint8_t)((octave << 4) | note_code[(semitone - 1) % 12]);
+    *kf = (uint8_t)(fraction << 2);
+    return semitone + fraction / 64.0;
+}
+
+void opm_multisample_start(const opm_multisample_t *ms, opm_renderer_t *renderer, double note, int velocity,
+                           double hold, opm_event_t *events) {
+    uint8_t kc, kf;
+    opm_midi_to_kc(note, &kc, &kf);
+
+    if (velocity < 1) velocity = 1;
+    if (velocity > 127) velocity = 127;
+
+    // ベロシティはキャリアの減衰にする (40 * log10(v / 127) dB)
+    double db = -40.0 * log10(velocity / 127.0);
+    int attenuation = (int)floor(db / TL_DB_PER_STEP + 0.5);
+
+    int n = 0;
+    events[n++] = (opm_event_t){ 0.0f, (uint8_t)(REG_KC + ms->channel), kc, { 0, 0 } };
+    events[n++] = (opm_event_t){ 0.0f, (uint8_t)(REG_KF + ms->channel), kf, { 0, 0 } };
+    for (int op = 0; op < 4 && attenuation > 0; op++) {
+        if (!(ms->carriers & (1 << op))) continue;
+        int tl = ms->tl[op] + attenuation;
+        if (tl > 127) tl = 127;
+        events[n++] = (opm_event_t){ 0.0f, (uint8_t)(REG_TL + op * 8 + ms->channel), (uint8_t)tl, { 0, 0 } };
+    }
+    events[n++] = (opm_event_t){ 0.0f, REG_KEY_ON, (uint8_t)(ms->key_on_mask | ms->channel), { 0, 0 } };
+    events[n++] = (opm_event_t){ (float)hold, REG_KEY_ON, (uint8_t)ms->channel, { 0, 0 } };
+
+    opm_renderer_start_from(renderer, &ms->snapshot, events, n);
+}
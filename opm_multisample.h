@@ -0,0 +1,49 @@
+// 音色のマルチサンプル生成
+//
+// 音色のイベント列を「音色設定」(キーコード・キーオン以外の書き込み) と
+// ノート部分に分け、音色設定だけを1回鳴らしたチップの状態をスナップショットに
+// しておく。各ノートはスナップショットのコピーから始めて KC/KF・ベロシティ
+// (キャリアの TL)・キーオン/オフだけを書くので、ノートごとに OPM_Reset から
+// 音色を書き直す必要がない。スナップショットは読み取り専用なので、
+// 複数スレッドから同時に使ってよい。
+#ifndef _OPM_MULTISAMPLE_H_
+#define _OPM_MULTISAMPLE_H_
+
+#include <stdint.h>
+#include "opm_renderer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 1ノートで書くイベントの最大数 (KC, KF, TL x4, キーオン, キーオフ)
+#define OPM_MULTISAMPLE_MAX_NOTE_EVENTS 8
+
+// OPM で出せる MIDI ノートの範囲 (クロック 3579545Hz で KC 0x4A = A4 = 440Hz)
+#define OPM_MIDI_NOTE_MIN 13   // C#0 (KC 0x00)
+#define OPM_MIDI_NOTE_MAX 108  // C8  (KC 0x7E)
+
+typedef struct opm_multisample opm_multisample_t;
+
+// tone を解析して音色設定部分を鳴らし、スナップショットを作る。
+// 鳴らすチャンネルとオペレーターのマスクは tone のキーオン (0x08) から取る
+// (キーオンがなければチャンネル 0、全オペレーター)。失敗時は NULL
+opm_multisample_t *opm_multisample_create(const opm_event_t *tone, int event_count);
+void opm_multisample_destroy(opm_multisample_t *ms);
+
+// MIDI ノート番号 (小数部はセント/100) を KC / KF に変換する。
+// 範囲外は OPM_MIDI_NOTE_MIN / MAX に丸め、実際に鳴るノート番号を返す
+double opm_midi_to_kc(double note, uint8_t *kc, uint8_t *kf);
+
+// note / velocity (1 ～ 127) を hold 秒押して離すイベントを events に書き、
+// renderer をスナップショットから開始する。以降は opm_renderer_render_block で
+// 続きを取り出す。events は OPM_MULTISAMPLE_MAX_NOTE_EVENTS 個分の領域で、
+// レンダリングが終わるまで有効であること
+void opm_multisample_start(const opm_multisample_t *ms, opm_renderer_t *renderer, double note, int velocity,
+                           double hold, opm_event_t *events);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
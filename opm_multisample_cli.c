@@ -0,0 +1,448 @@
+// 音色のマルチサンプル書き出し
+//
+// 音色 JSON (presets.json と同じ形式) を、指定したノート範囲・ベロシティで
+// 1ノート1ファイルの WAV にし、サンプラー用の SFZ と JSON のマップを書く。
+// 音色設定は opm_multisample のスナップショットで1回だけ鳴らし、各ノートは
+// opm_batch で全コアに振り分ける。
+//
+//   opm-multisample -o samples/ tone.json
+//   opm-multisample -p 3 --lo 24 --hi 96 --step 3 --velocities 127,80,40 -o samples/ presets.json
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include "opm_renderer.h"
+#include "opm_events.h"
+#include "opm_wav.h"
+#include "opm_batch.h"
+#include "opm_multisample.h"
+
+#define DEFAULT_BLOCK_FRAMES 4096
+#define MAX_VELOCITIES 16
+
+typedef struct {
+    const char *input;    // "-" は stdin
+    const char *output;   // 出力ディレクトリ
+    const char *name;     // 出力ファイル名の先頭
+    opm_sample_format_t format;
+    int preset;
+    int lo;               // MIDI ノート番号 (0 ～ 127)
+    int hi;
+    int step;
+    int velocities[MAX_VELOCITIES];
+    int velocity_count;
+    double hold;          // キーオンからキーオフまで (秒)
+    double length;        // 1サンプルの長さ (秒)
+    int jobs;             // 0 以下なら CPU 数
+    int quiet;
+    double rate;          // 出力のサンプルレート。0 なら OPM のレートのまま
+} cli_options_t;
+
+// 1つのサンプル (ノート x ベロシティ)
+typedef struct {
+    int note;             // 実際に鳴るノート番号 (OPM_MIDI_NOTE_MIN ～ MAX)
+    int lokey;            // このサンプルで鳴らす鍵盤の範囲
+    int hikey;
+    int velocity;
+    int lovel;
+    int hivel;
+    uint8_t kc;
+    uint8_t kf;
+    char file[96];        // 出力ディレクトリからの相対パス
+    int status;           // 0: 成功
+} sample_entry_t;
+
+typedef struct {
+    sample_entry_t *items;
+    int count;
+    const cli_options_t *opt;
+    const opm_multisample_t *ms;
+    uint32_t frames;
+} sample_set_t;
+
+
+// ============================================================
+// 1. Command Line
+// ============================================================
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+        "usage: %s -o DIR [options] <tone.json | presets.json | ->\n"
+        "\n"
+        "options:\n"
+        "  -o, --output DIR         output directory (required)\n"
+        "  -n, --name NAME          file name prefix (default: sample)\n"
+        "  -p, --preset N           preset index when the input is an array (default: 0)\n"
+        "  -l, --lo NOTE            lowest MIDI note (default: 0)\n"
+        "  -u, --hi NOTE            highest MIDI note (default: 127)\n"
+        "  -s, --step N             semitones between samples (default: 1)\n"
+        "  -v, --velocities LIST    comma separated velocities (default: 127)\n"
+        "  -t, --hold SEC           key-on time (default: 1.0)\n"
+        "  -d, --length SEC         length of each sample (default: hold + 1.0)\n"
+        "  -f, --format FORMAT      f32 (IEEE float, default) or s16 (16bit PCM)\n"
+        "  -r, --rate HZ            resample to HZ, e.g. 44100 or 48000 (default: OPM rate)\n"
+        "  -j, --jobs N             worker threads (default: number of CPUs)\n"
+        "  -q, --quiet              do not print the written files\n"
+        "  -h, --help               show this help\n"
+        "\n"
+        "notes outside MIDI %d-%d are clamped to the OPM range.\n",
+        prog, OPM_MIDI_NOTE_MIN, OPM_MIDI_NOTE_MAX);
+}
+
+static int parse_velocities(const char *text, cli_options_t *opt) {
+    opt->velocity_count = 0;
+    while (*text) {
+        char *endp;
+        long v = strtol(text, &endp, 10);
+        if (endp == text || v < 1 || v > 127 || opt->velocity_count == MAX_VELOCITIES) return -1;
+        opt->velocities[opt->velocity_count++] = (int)v;
+        text = *endp == ',' ? endp + 1 : endp;
+        if (*endp != ',' && *endp != '\0') return -1;
+    }
+    return opt->velocity_count > 0 ? 0 : -1;
+}
+
+static int compare_ints(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+// 成功時 0、終了すべきとき 1 (help)、エラー時 -1
+static int parse_options(int argc, char **argv, cli_options_t *opt) {
+    static const struct option long_options[] = {
+        { "output",     required_argument, NULL, 'o' },
+        { "name",       required_argument, NULL, 'n' },
+        { "preset",     required_argument, NULL, 'p' },
+        { "lo",         required_argument, NULL, 'l' },
+        { "hi",         required_argument, NULL, 'u' },
+        { "step",       required_argument, NULL, 's' },
+        { "velocities", required_argument, NULL, 'v' },
+        { "hold",       required_argument, NULL, 't' },
+        { "length",     required_argument, NULL, 'd' },
+        { "format",     required_argument, NULL, 'f' },
+        { "rate",       required_argument, NULL, 'r' },
+        { "jobs",       required_argument, NULL, 'j' },
+        { "quiet",      no_argument,       NULL, 'q' },
+        { "help",       no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    opt->input = NULL;
+    opt->output = NULL;
+    opt->name = "sample";
+    opt->format = OPM_SAMPLE_FLOAT32;
+    opt->preset = 0;
+    opt->lo = 0;
+    opt->hi = 127;
+    opt->step = 1;
+    opt->velocities[0] = 127;
+    opt->velocity_count = 1;
+    opt->hold = 1.0;
+    opt->length = 0.0;
+    opt->jobs = 0;
+    opt->quiet = 0;
+    opt->rate = 0.0;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "o:n:p:l:u:s:v:t:d:f:r:j:qh", long_options, NULL)) != -1) {
+        switch (c) {
+        case 'o':
+            opt->output = optarg;
+            break;
+        case 'n':
+            opt->name = optarg;
+            break;
+        case 'p':
+            opt->preset = atoi(optarg);
+            break;
+        case 'l':
+            opt->lo = atoi(optarg);
+            break;
+        case 'u':
+            opt->hi = atoi(optarg);
+            break;
+        case 's':
+            opt->step = atoi(optarg);
+            break;
+        case 'v':
+            if (parse_velocities(optarg, opt) != 0) {
+                fprintf(stderr, "invalid velocities: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 't':
+            opt->hold = atof(optarg);
+            break;
+        case 'd':
+            opt->length = atof(optarg);
+            break;
+        case 'f':
+            if (strcmp(optarg, "f32") == 0) {
+                opt->format = OPM_SAMPLE_FLOAT32;
+            } else if (strcmp(optarg, "s16") == 0) {
+                opt->format = OPM_SAMPLE_INT16;
+            } else {
+                fprintf(stderr, "unknown format: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'r':
+            opt->rate = atof(optarg);
+            break;
+        case 'j':
+            opt->jobs = atoi(optarg);
+            break;
+        case 'q':
+            opt->quiet = 1;
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 1;
+        default:
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (optind != argc - 1 || !opt->output) {
+        print_usage(argv[0]);
+        return -1;
+    }
+    if (opt->lo < 0 || opt->hi > 127 || opt->lo > opt->hi || opt->step <= 0) {
+        fprintf(stderr, "invalid note range: %d-%d step %d\n", opt->lo, opt->hi, opt->step);
+        return -1;
+    }
+    if (opt->hold < 0.0) opt->hold = 0.0;
+    if (opt->length <= 0.0) opt->length = opt->hold + 1.0;
+    opt->input = argv[optind];
+
+    // ベロシティは小さい順にして重複を除く
+    qsort(opt->velocities, opt->velocity_count, sizeof(int), compare_ints);
+    int n = 0;
+    for (int i = 0; i < opt->velocity_count; i++) {
+        if (n == 0 || opt->velocities[n - 1] != opt->velocities[i]) opt->velocities[n++] = opt->velocities[i];
+    }
+    opt->velocity_count = n;
+    return 0;
+}
+
+
+// ============================================================
+// 2. Sample Layout
+// ============================================================
+
+// lo ～ hi を step ごとに鳴らすノートを notes に書き、数を返す。
+// OPM の範囲に丸めて同じになったノートは1つにまとめる
+static int collect_notes(const cli_options_t *opt, int *notes) {
+    int count = 0;
+    for (int note = opt->lo; note <= opt->hi; note += opt->step) {
+        uint8_t kc, kf;
+        int actual = (int)opm_midi_to_kc(note, &kc, &kf);
+        if (count == 0 || notes[count - 1] != actual) notes[count++] = actual;
+    }
+    return count;
+}
+
+// ノートとベロシティの組み合わせを並べ、鍵盤とベロシティの担当範囲を決める。
+// 隣り合うサンプルの中間で分け、両端は 0 / 127 (ベロシティは 1 / 127) まで広げる
+static int build_layout(sample_set_t *set) {
+    const cli_options_t *opt = set->opt;
+    int notes[128];
+    int note_count = collect_notes(opt, notes);
+
+    set->count = note_count * opt->velocity_count;
+    set->items = (sample_entry_t *)calloc(set->count, sizeof(sample_entry_t));
+    if (!set->items) return -1;
+
+    for (int i = 0; i < note_count; i++) {
+        for (int j = 0; j < opt->velocity_count; j++) {
+            sample_entry_t *e = &set->items[i * opt->velocity_count + j];
+            e->note = notes[i];
+            e->lokey = i == 0 ? 0 : (notes[i - 1] + notes[i]) / 2 + 1;
+            e->hikey = i == note_count - 1 ? 127 : (notes[i] + notes[i + 1]) / 2;
+            e->velocity = opt->velocities[j];
+            e->lovel = j == 0 ? 1 : opt->velocities[j - 1] + 1;
+            e->hivel = j == opt->velocity_count - 1 ? 127 : opt->velocities[j];
+            opm_midi_to_kc(e->note, &e->kc, &e->kf);
+            snprintf(e->file, sizeof(e->file), "%s_%03d_v%03d.wav", opt->name, e->note, e->velocity);
+            e->status = -1;
+        }
+    }
+    return 0;
+}
+
+
+// ============================================================
+// 3. Rendering
+// ============================================================
+
+static int sample_job(int index, opm_renderer_t *renderer, void *user) {
+    sample_set_t *set = (sample_set_t *)user;
+    const cli_options_t *opt = set->opt;
+    sample_entry_t *e = &set->items[index];
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", opt->output, e->file);
+
+    size_t bytes_per_sample = opt->format == OPM_SAMPLE_INT16 ? sizeof(int16_t) : sizeof(float);
+    void *block = malloc(bytes_per_sample * 2 * DEFAULT_BLOCK_FRAMES);
+    FILE *out = block ? fopen(path, "wb") : NULL;
+    if (!out) {
+        free(block);
+        return e->status = -1;
+    }
+
+    opm_event_t events[OPM_MULTISAMPLE_MAX_NOTE_EVENTS];
+    if (opm_renderer_set_output_rate(renderer, opt->rate, OPM_RESAMPLE_HIGH) != 0) {
+        fclose(out);
+        free(block);
+        return e->status = -1;
+    }
+    opm_multisample_start(set->ms, renderer, e->note, e->velocity, opt->hold, events);
+    e->status = opm_wav_write_render(out, renderer, opt->format, set->frames, block, DEFAULT_BLOCK_FRAMES);
+
+    if (fclose(out) != 0) e->status = -1;
+    free(block);
+    return e->status;
+}
+
+
+// ============================================================
+// 4. Maps
+// ============================================================
+
+static FILE *open_map(const cli_options_t *opt, const char *extension) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s.%s", opt->output, opt->name, extension);
+    FILE *fp = fopen(path, "w");
+    if (!fp) fprintf(stderr, "cannot open %s\n", path);
+    return fp;
+}
+
+static int close_map(FILE *fp) {
+    int failed = ferror(fp);
+    if (fclose(fp) != 0) failed = 1;
+    return failed ? -1 : 0;
+}
+
+static int write_sfz(const sample_set_t *set) {
+    FILE *fp = open_map(set->opt, "sfz");
+    if (!fp) return -1;
+
+    fprintf(fp, "// %s: %d samples\n", set->opt->name, set->count);
+    fprintf(fp, "<control>\ndefault_path=./\n\n<group>\nloop_mode=no_loop\n\n");
+    for (int i = 0; i < set->count; i++) {
+        const sample_entry_t *e = &set->items[i];
+        fprintf(fp, "<region> sample=%s lokey=%d hikey=%d pitch_keycenter=%d lovel=%d hivel=%d\n",
+                e->file, e->lokey, e->hikey, e->note, e->lovel, e->hivel);
+    }
+    return close_map(fp);
+}
+
+static int write_json(const sample_set_t *set) {
+    FILE *fp = open_map(set->opt, "json");
+    if (!fp) return -1;
+
+    fprintf(fp, "{\n  \"sample_rate\": %.6f,\n  \"frames\": %u,\n  \"hold\": %.6f,\n  \"samples\": [\n",
+            set->opt->rate > 0.0 ? set->opt->rate : opm_renderer_sample_rate(), (unsigned)set->frames, set->opt->hold);
+    for (int i = 0; i < set->count; i++) {
+        const sample_entry_t *e = &set->items[i];
+        fprintf(fp,
+                "    { \"file\": \"%s\", \"note\": %d, \"lokey\": %d, \"hikey\": %d, "
+                "\"velocity\": %d, \"lovel\": %d, \"hivel\": %d, \"kc\": \"0x%02X\", \"kf\": \"0x%02X\" }%s\n",
+                e->file, e->note, e->lokey, e->hikey, e->velocity, e->lovel, e->hivel, e->kc, e->kf,
+                i + 1 < set->count ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    return close_map(fp);
+}
+
+
+// ============================================================
+// 5. Main
+// ============================================================
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static opm_multisample_t *load_tone(const cli_options_t *opt) {
+    size_t json_length;
+    char *json = opm_events_read_file(opt->input, &json_length);
+    if (!json) {
+        fprintf(stderr, "cannot read %s\n", opt->input);
+        return NULL;
+    }
+
+    opm_event_t *events;
+    int event_count;
+    char error[128];
+    int result = opm_events_parse_json(json, json_length, opt->preset, &events, &event_count, error, sizeof(error));
+    free(json);
+    if (result != 0) {
+        fprintf(stderr, "%s: %s\n", opt->input, error);
+        return NULL;
+    }
+
+    opm_multisample_t *ms = opm_multisample_create(events, event_count);
+    if (!ms) fprintf(stderr, "out of memory\n");
+    opm_events_free(events);
+    return ms;
+}
+
+int main(int argc, char **argv) {
+    cli_options_t opt;
+    int parsed = parse_options(argc, argv, &opt);
+    if (parsed != 0) return parsed > 0 ? 0 : 2;
+
+    if (mkdir(opt.output, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "cannot create directory %s\n", opt.output);
+        return 1;
+    }
+
+    double total = opt.length * (opt.rate > 0.0 ? opt.rate : opm_renderer_sample_rate());
+    if (total >= (double)INT32_MAX) {
+        fprintf(stderr, "length too long: %g\n", opt.length);
+        return 2;
+    }
+
+    double start = now_seconds();
+    sample_set_t set = { NULL, 0, &opt, NULL, (uint32_t)total };
+    set.ms = load_tone(&opt);
+    if (!set.ms) return 1;
+    if (build_layout(&set) != 0) {
+        fprintf(stderr, "out of memory\n");
+        opm_multisample_destroy((opm_multisample_t *)set.ms);
+        return 1;
+    }
+
+    int threads = opt.jobs > 0 ? opt.jobs : opm_batch_default_threads();
+    int failed = opm_batch_run(set.count, threads, sample_job, &set);
+    int status = failed == 0 ? 0 : 1;
+
+    // 結果は鍵盤の順番で出す
+    for (int i = 0; i < set.count; i++) {
+        const sample_entry_t *e = &set.items[i];
+        if (e->status != 0) {
+            fprintf(stderr, "FAILED %s/%s\n", opt.output, e->file);
+        } else if (!opt.quiet) {
+            printf("%s/%s\n", opt.output, e->file);
+        }
+    }
+    if (status == 0 && (write_sfz(&set) != 0 || write_json(&set) != 0)) {
+        fprintf(stderr, "cannot write the sample map\n");
+        status = 1;
+    }
+    if (status == 0 && !opt.quiet) {
+        fprintf(stderr, "%d samples, %d threads in %.3f sec\n", set.count, threads, now_seconds() - start);
+    }
+
+    free(set.items);
+    opm_multisample_destroy((opm_multisample_t *)set.ms);
+    return status;
+}
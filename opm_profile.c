@@ -0,0 +1,260 @@
+/* OPM_Clock per-stage profiler
+ *
+ * opm_profile_clock() runs the same stage sequence as OPM_Clock() in opm.c,
+ * reading a timestamp between groups of stages on every
+ * OPM_PROFILE_SAMPLE_INTERVAL-th call. The stages are the static functions
+ * of opm.c itself (pulled in through opm_vendor.h), so the output is
+ * identical to OPM_Clock(). Keep the order below in sync with OPM_Clock()
+ * when opm.c is updated.
+ *
+ * This file is derived from Nuked OPM and is distributed under the same
+ * license (GNU LGPL 2.1 or later), see opm.h.
+ */
+#ifdef OPM_PROFILE
+
+#define _POSIX_C_SOURCE 200809L
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#define OPM_VENDOR_PREFIX OPM_Profile_
+#include "opm_vendor.h"
+
+#include "opm_profile.h"
+
+#if defined(__EMSCRIPTEN__)
+#include <emscripten.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILE_USE_RDTSC
+#endif
+
+static opm_profile_stats_t stats;
+static unsigned sample_countdown;
+
+
+// ============================================================
+// 1. Timestamps
+// ============================================================
+
+static inline uint64_t profile_now(void) {
+#if defined(__EMSCRIPTEN__)
+    return (uint64_t)(emscripten_get_now() * 1e6);
+#elif defined(PROFILE_USE_RDTSC)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+const char *opm_profile_tick_unit(void) {
+#if defined(PROFILE_USE_RDTSC)
+    return "cycles";
+#else
+    return "ns";
+#endif
+}
+
+// 直前の時刻からここまでを group に足す
+#define PROFILE_MARK(group) do { \
+        uint64_t now_ = profile_now(); \
+        stats.ticks[group] += now_ - last; \
+        last = now_; \
+    } while (0)
+
+
+// ============================================================
+// 2. Instrumented Clock
+// ============================================================
+
+// OPM_Clock と同じ順番でステージを呼ぶ
+static void profile_clock_sampled(opm_t *chip) {
+    uint64_t last = profile_now();
+
+    OPM_Output(chip);
+    OPM_DAC(chip);
+    OPM_Mixer2(chip);
+    OPM_Mixer(chip);
+    PROFILE_MARK(OPM_PROFILE_MIXER);
+
+    OPM_OperatorPhase16(chip);
+    OPM_OperatorPhase15(chip);
+    OPM_OperatorPhase14(chip);
+    OPM_OperatorPhase13(chip);
+    OPM_OperatorPhase12(chip);
+    OPM_OperatorPhase11(chip);
+    OPM_OperatorPhase10(chip);
+    OPM_OperatorPhase9(chip);
+    OPM_OperatorPhase8(chip);
+    OPM_OperatorPhase7(chip);
+    OPM_OperatorPhase6(chip);
+    OPM_OperatorPhase5(chip);
+    OPM_OperatorPhase4(chip);
+    OPM_OperatorPhase3(chip);
+    OPM_OperatorPhase2(chip);
+    OPM_OperatorPhase1(chip);
+    OPM_OperatorCounter(chip);
+    PROFILE_MARK(OPM_PROFILE_OPERATOR);
+
+    OPM_EnvelopeTimer(chip);
+    OPM_EnvelopePhase6(chip);
+    OPM_EnvelopePhase5(chip);
+    OPM_EnvelopePhase4(chip);
+    OPM_EnvelopePhase3(chip);
+    OPM_EnvelopePhase2(chip);
+    OPM_EnvelopePhase1(chip);
+
+    if (chip->opp)
+        OPP_TLRamp(chip);
+    PROFILE_MARK(OPM_PROFILE_ENVELOPE);
+
+    OPM_PhaseDebug(chip);
+    OPM_PhaseGenerate(chip);
+    OPM_PhaseCalcIncrement(chip);
+    OPM_PhaseCalcFNumBlock(chip);
+    PROFILE_MARK(OPM_PROFILE_PHASE);
+
+    OPM_DoTimerIRQ(chip);
+    OPM_DoTimerA(chip);
+    OPM_DoTimerB(chip);
+    PROFILE_MARK(OPM_PROFILE_TIMER_IO);
+    OPM_DoLFOMult(chip);
+    OPM_DoLFO1(chip);
+    PROFILE_MARK(OPM_PROFILE_LFO);
+    OPM_Noise(chip);
+    PROFILE_MARK(OPM_PROFILE_NOISE);
+    OPM_KeyOn2(chip);
+    OPM_DoRegWrite(chip);
+    PROFILE_MARK(OPM_PROFILE_TIMER_IO);
+    OPM_EnvelopeClock(chip);
+    PROFILE_MARK(OPM_PROFILE_ENVELOPE);
+    OPM_NoiseTimer(chip);
+    PROFILE_MARK(OPM_PROFILE_NOISE);
+    OPM_KeyOn1(chip);
+    OPM_DoIO(chip);
+    OPM_DoTimerA2(chip);
+    OPM_DoTimerB2(chip);
+    PROFILE_MARK(OPM_PROFILE_TIMER_IO);
+    OPM_DoLFO2(chip);
+    PROFILE_MARK(OPM_PROFILE_LFO);
+    OPM_CSM(chip);
+    PROFILE_MARK(OPM_PROFILE_TIMER_IO);
+    OPM_NoiseChannel(chip);
+    PROFILE_MARK(OPM_PROFILE_NOISE);
+    OPM_DoIC(chip);
+    PROFILE_MARK(OPM_PROFILE_TIMER_IO);
+
+    stats.sampled_clocks++;
+}
+
+void opm_profile_clock(opm_t *chip, int32_t *output, uint8_t *sh1, uint8_t *sh2, uint8_t *so) {
+    stats.total_clocks++;
+    if (sample_countdown > 0) {
+        sample_countdown--;
+        OPM_Profile_Clock(chip, output, sh1, sh2, so);
+        return;
+    }
+    sample_countdown = OPM_PROFILE_SAMPLE_INTERVAL - 1;
+
+    profile_clock_sampled(chip);
+
+    // OPM_Clock の最後と同じ
+    if (sh1)
+    {
+        *sh1 = chip->smp_sh1;
+    }
+    if (sh2)
+    {
+        *sh2 = chip->smp_sh2;
+    }
+    if (so)
+    {
+        *so = chip->smp_so;
+    }
+    if (output)
+    {
+        output[0] = chip->dac_output[0];
+        output[1] = chip->dac_output[1];
+    }
+    chip->cycles = (chip->cycles + 1) & 31;
+}
+
+int opm_profile_enabled(void) {
+    return 1;
+}
+
+void opm_profile_reset(void) {
+    memset(&stats, 0, sizeof(stats));
+    sample_countdown = 0;
+}
+
+void opm_profile_get(opm_profile_stats_t *out) {
+    *out = stats;
+}
+
+#else // OPM_PROFILE
+
+#include <string.h>
+#include "opm_profile.h"
+
+int opm_profile_enabled(void) {
+    return 0;
+}
+
+void opm_profile_clock(opm_t *chip, int32_t *output, uint8_t *sh1, uint8_t *sh2, uint8_t *so) {
+    OPM_Clock(chip, output, sh1, sh2, so);
+}
+
+void opm_profile_reset(void) {
+}
+
+void opm_profile_get(opm_profile_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+}
+
+const char *opm_profile_tick_unit(void) {
+    return "ns";
+}
+
+#endif // OPM_PROFILE
+
+
+// ============================================================
+// 3. Report
+// ============================================================
+
+const char *opm_profile_group_name(opm_profile_group_t group) {
+    static const char *const names[OPM_PROFILE_NUM_GROUPS] = {
+        "operator", "envelope", "phase", "lfo", "noise", "mixer/dac", "timer/io"
+    };
+    return (unsigned)group < OPM_PROFILE_NUM_GROUPS ? names[group] : "?";
+}
+
+void opm_profile_report(FILE *fp) {
+    opm_profile_stats_t s;
+    opm_profile_get(&s);
+    if (!opm_profile_enabled()) {
+        fprintf(fp, "profiling is disabled (build with OPM_PROFILE)\n");
+        return;
+    }
+    if (s.sampled_clocks == 0) {
+        fprintf(fp, "no clocks sampled\n");
+        return;
+    }
+
+    uint64_t total = 0;
+    for (int g = 0; g < OPM_PROFILE_NUM_GROUPS; g++) {
+        total += s.ticks[g];
+    }
+
+    fprintf(fp, "OPM_Clock profile: %llu of %llu clocks sampled (1/%d)\n",
+            (unsigned long long)s.sampled_clocks, (unsigned long long)s.total_clocks, OPM_PROFILE_SAMPLE_INTERVAL);
+    fprintf(fp, "  %-10s %7s %14s\n", "group", "share", opm_profile_tick_unit());
+    for (int g = 0; g < OPM_PROFILE_NUM_GROUPS; g++) {
+        fprintf(fp, "  %-10s %6.1f%% %14.2f /clock\n", opm_profile_group_name((opm_profile_group_t)g),
+                total > 0 ? 100.0 * s.ticks[g] / total : 0.0, (double)s.ticks[g] / s.sampled_clocks);
+    }
+    fprintf(fp, "  %-10s %6.1f%% %14.2f /clock\n", "total", 100.0, (double)total / s.sampled_clocks);
+}
@@ -0,0 +1,72 @@
+// OPM_Clock のステージ別プロファイラ
+//
+// OPM_Clock が呼ぶ約55のステージをグループ (オペレーター、エンベロープ、
+// 位相、LFO、ノイズ、ミキサー/DAC、タイマー/IO) に分け、それぞれにかかった
+// 時間を積算する。OPM_PROFILE を定義してビルドしたときだけ有効で、
+// 定義しなければレンダラーは OPM_Clock を直接呼ぶのでオーバーヘッドはない。
+//
+// 時刻の読み取りは毎クロックではなく OPM_PROFILE_SAMPLE_INTERVAL クロックに
+// 1回だけ行う (サンプリング)。時刻の取り方は環境ごとに違う:
+//   x86 ネイティブ : rdtsc (CPU サイクル)
+//   Emscripten     : emscripten_get_now() (performance.now、ナノ秒に換算)
+//   それ以外       : clock_gettime(CLOCK_MONOTONIC) (ナノ秒)
+// performance.now は分解能が粗い (ブラウザにより 5us ～ 100us) ので、
+// wasm ではサンプル数を十分に取って割合で見ること。
+// 各区切りの値には時刻の読み取り自体のコストも入るので、区切りの多い
+// グループ (タイマー/IO、ノイズ) は実際より大きめに出る。
+//
+// 積算値はプロセスに1つで、ロックしない。プロファイルは1スレッドで取ること。
+#ifndef _OPM_PROFILE_H_
+#define _OPM_PROFILE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "opm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef OPM_PROFILE_SAMPLE_INTERVAL
+#define OPM_PROFILE_SAMPLE_INTERVAL 16
+#endif
+
+typedef enum {
+    OPM_PROFILE_OPERATOR,   // OPM_OperatorPhase1 ～ 16, OPM_OperatorCounter
+    OPM_PROFILE_ENVELOPE,   // OPM_EnvelopeTimer, OPM_EnvelopePhase1 ～ 6, OPM_EnvelopeClock, OPP_TLRamp
+    OPM_PROFILE_PHASE,      // OPM_PhaseDebug, OPM_PhaseGenerate, OPM_PhaseCalcIncrement, OPM_PhaseCalcFNumBlock
+    OPM_PROFILE_LFO,        // OPM_DoLFOMult, OPM_DoLFO1, OPM_DoLFO2
+    OPM_PROFILE_NOISE,      // OPM_Noise, OPM_NoiseTimer, OPM_NoiseChannel
+    OPM_PROFILE_MIXER,      // OPM_Output, OPM_DAC, OPM_Mixer2, OPM_Mixer
+    OPM_PROFILE_TIMER_IO,   // タイマー、IRQ、キーオン、レジスタ書き込み、CSM、IC
+    OPM_PROFILE_NUM_GROUPS
+} opm_profile_group_t;
+
+typedef struct {
+    uint64_t ticks[OPM_PROFILE_NUM_GROUPS];  // グループごとの積算 (サンプリングしたクロックのみ)
+    uint64_t sampled_clocks;                 // 時刻を測ったクロック数
+    uint64_t total_clocks;                   // opm_profile_clock を呼んだ回数
+} opm_profile_stats_t;
+
+// OPM_PROFILE 付きでビルドされていれば 1
+int opm_profile_enabled(void);
+
+// OPM_Clock と同じ処理をしながらステージごとの時間を測る (結果は OPM_Clock と同一)。
+// OPM_PROFILE なしのビルドでは OPM_Clock をそのまま呼ぶ
+void opm_profile_clock(opm_t *chip, int32_t *output, uint8_t *sh1, uint8_t *sh2, uint8_t *so);
+
+void opm_profile_reset(void);
+void opm_profile_get(opm_profile_stats_t *stats);
+
+const char *opm_profile_group_name(opm_profile_group_t group);
+// ticks の単位 ("cycles" か "ns")
+const char *opm_profile_tick_unit(void);
+
+// グループごとの割合と1クロックあたりの時間を表にして fp に書く
+void opm_profile_report(FILE *fp);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
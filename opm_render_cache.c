@@ -0,0 +1,328 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "opm_render_cache.h"
+#include "opm_codec.h"
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+// ディスクのファイルの先頭: "OPMC", バージョン (u32), キー (u64), 続くデータのバイト数 (u64)。
+// データは OPM のレートのフレームを opm_codec で圧縮したもの (メモリにも圧縮したまま置く)
+#define FILE_MAGIC "OPMC"
+#define FILE_HEADER_SIZE 24
+
+typedef struct {
+    uint64_t key;
+    void *data;
+    size_t size;
+    uint64_t last_used;
+} cache_entry_t;
+
+struct opm_render_cache {
+    pthread_mutex_t lock;
+    cache_entry_t *entries;
+    int count;
+    int capacity;
+    size_t bytes;
+    size_t max_bytes;
+    uint64_t clock;      // last_used 用。get / put のたびに進める
+    char *dir;
+};
+
+
+// ============================================================
+// 1. Key
+// ============================================================
+
+static uint64_t fnv_update(uint64_t hash, const void *data, size_t size) {
+    const uint8_t *p = (const uint8_t *)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static uint64_t fnv_u64(uint64_t hash, uint64_t v) {
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = (uint8_t)(v >> (i * 8));
+    }
+    return fnv_update(hash, bytes, sizeof(bytes));
+}
+
+// 書かれないイベント (+Inf など) のサンプル位置。render_cache.js と同じ値 (Number.MAX_SAFE_INTEGER)
+#define NEVER_SAMPLE INT64_C(9007199254740991)
+
+// シーケンサ (opm_renderer.c) が evt を書き始められる最初のサンプル。
+// NaN は sample < NaN が偽なのですぐ書かれる (0 と同じ)
+static int64_t trigger_sample(float time) {
+    double t = (double)time * opm_renderer_sample_rate();
+    if (!(t > 0.0)) return 0;
+    if (t >= (double)NEVER_SAMPLE) return NEVER_SAMPLE;
+    return (int64_t)ceil(t);
+}
+
+uint64_t opm_render_cache_key(const opm_event_t *events, int event_count, const opm_render_cache_params_t *params) {
+    uint64_t hash = FNV_OFFSET;
+    hash = fnv_u64(hash, OPM_RENDER_CACHE_VERSION);
+    hash = fnv_u64(hash, params->chip);
+    hash = fnv_u64(hash, (uint64_t)params->engine);
+    hash = fnv_u64(hash, params->channel_mask);
+    hash = fnv_u64(hash, (uint64_t)(int64_t)params->num_frames);
+
+    hash = fnv_u64(hash, (uint64_t)(int64_t)event_count);
+    for (int i = 0; i < event_count; i++) {
+        hash = fnv_u64(hash, (uint64_t)trigger_sample(events[i].time));
+        hash = fnv_u64(hash, ((uint64_t)events[i].addr << 8) | events[i].data);
+    }
+    return hash;
+}
+
+
+// ============================================================
+// 2. Memory (LRU)
+// ============================================================
+
+static cache_entry_t *find_entry(opm_render_cache_t *cache, uint64_t key) {
+    for (int i = 0; i < cache->count; i++) {
+        if (cache->entries[i].key == key) return &cache->entries[i];
+    }
+    return NULL;
+}
+
+static void remove_entry(opm_render_cache_t *cache, int index) {
+    cache->bytes -= cache->entries[index].size;
+    free(cache->entries[index].data);
+    cache->entries[index] = cache->entries[--cache->count];
+}
+
+// size バイト入るまで古いものから捨てる
+static void evict_for(opm_render_cache_t *cache, size_t size) {
+    while (cache->count > 0 && cache->bytes + size > cache->max_bytes) {
+        int oldest = 0;
+        for (int i = 1; i < cache->count; i++) {
+            if (cache->entries[i].last_used < cache->entries[oldest].last_used) oldest = i;
+        }
+        remove_entry(cache, oldest);
+    }
+}
+
+// data の持ち主はキャッシュになる (失敗したら解放する)
+static int insert_entry(opm_render_cache_t *cache, uint64_t key, void *data, size_t size) {
+    if (size > cache->max_bytes) {
+        free(data);
+        return -1;
+    }
+    cache_entry_t *e = find_entry(cache, key);
+    if (e) remove_entry(cache, (int)(e - cache->entries));
+    evict_for(cache, size);
+
+    if (cache->count == cache->capacity) {
+        int capacity = cache->capacity > 0 ? cache->capacity * 2 : 64;
+        cache_entry_t *grown = (cache_entry_t *)realloc(cache->entries, sizeof(cache_entry_t) * capacity);
+        if (!grown) {
+            free(data);
+            return -1;
+        }
+        cache->entries = grown;
+        cache->capacity = capacity;
+    }
+    e = &cache->entries[cache->count++];
+    e->key = key;
+    e->data = data;
+    e->size = size;
+    e->last_used = ++cache->clock;
+    cache->bytes += size;
+    return 0;
+}
+
+
+// ============================================================
+// 3. Disk
+// ============================================================
+
+static void entry_path(const opm_render_cache_t *cache, uint64_t key, char *path, size_t path_size) {
+    snprintf(path, path_size, "%s/%016llx.opmc", cache->dir, (unsigned long long)key);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (i * 8));
+}
+
+static void put_u64(uint8_t *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (uint8_t)(v >> (i * 8));
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// ファイルが壊れている、別のキー・バージョンのものなら NULL
+static void *disk_read(const opm_render_cache_t *cache, uint64_t key, size_t *size) {
+    char path[4096];
+    entry_path(cache, key, path, sizeof(path));
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+
+    uint8_t header[FILE_HEADER_SIZE];
+    void *data = NULL;
+    if (fread(header, 1, sizeof(header), fp) == sizeof(header) && memcmp(header, FILE_MAGIC, 4) == 0
+        && get_u32(header + 4) == OPM_RENDER_CACHE_VERSION && get_u64(header + 8) == key) {
+        uint64_t length = get_u64(header + 16);
+        data = length > 0 && length <= SIZE_MAX ? malloc((size_t)length) : NULL;
+        if (data && fread(data, 1, (size_t)length, fp) == length) {
+            *size = (size_t)length;
+        } else {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(fp);
+    return data;
+}
+
+// 一時ファイルに書いてから rename する (同じキーを書くほかのプロセスと混ざらない)
+static int disk_write(const opm_render_cache_t *cache, uint64_t key, const void *data, size_t size) {
+    char path[4096];
+    char temp[4096 + 32];
+    entry_path(cache, key, path, sizeof(path));
+    snprintf(temp, sizeof(temp), "%s.%ld.tmp", path, (long)getpid());
+
+    FILE *fp = fopen(temp, "wb");
+    if (!fp) return -1;
+    uint8_t header[FILE_HEADER_SIZE];
+    memcpy(header, FILE_MAGIC, 4);
+    put_u32(header + 4, OPM_RENDER_CACHE_VERSION);
+    put_u64(header + 8, key);
+    put_u64(header + 16, size);
+    int status = fwrite(header, 1, sizeof(header), fp) == sizeof(header)
+        && fwrite(data, 1, size, fp) == size ? 0 : -1;
+    if (fclose(fp) != 0) status = -1;
+    if (status == 0 && rename(temp, path) != 0) status = -1;
+    if (status != 0) remove(temp);
+    return status;
+}
+
+
+// ============================================================
+// 4. API
+// ============================================================
+
+opm_render_cache_t *opm_render_cache_create(size_t max_bytes, const char *dir) {
+    opm_render_cache_t *cache = (opm_render_cache_t *)calloc(1, sizeof(opm_render_cache_t));
+    if (!cache) return NULL;
+    cache->max_bytes = max_bytes;
+    if (dir) {
+        if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+            free(cache);
+            return NULL;
+        }
+        cache->dir = (char *)malloc(strlen(dir) + 1);
+        if (!cache->dir) {
+            free(cache);
+            return NULL;
+        }
+        strcpy(cache->dir, dir);
+    }
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+void opm_render_cache_destroy(opm_render_cache_t *cache) {
+    if (!cache) return;
+    for (int i = 0; i < cache->count; i++) {
+        free(cache->entries[i].data);
+    }
+    free(cache->entries);
+    free(cache->dir);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+// data (圧縮したもの) を展開する。失敗したら NULL
+static float *unpack(const void *data, size_t size, int *num_frames) {
+    opm_codec_info_t info;
+    if (opm_codec_info(data, size, &info) != 0 || info.format != OPM_SAMPLE_FLOAT32 || info.num_frames <= 0) {
+        return NULL;
+    }
+    float *frames = (float *)malloc(sizeof(float) * 2 * (size_t)info.num_frames);
+    if (frames && opm_codec_decode(data, size, 0, info.num_frames, frames) != info.num_frames) {
+        free(frames);
+        frames = NULL;
+    }
+    *num_frames = info.num_frames;
+    return frames;
+}
+
+float *opm_render_cache_get(opm_render_cache_t *cache, uint64_t key, int *num_frames) {
+    if (!cache || !num_frames) return NULL;
+
+    // 展開はロックの外でするので、圧縮したものをコピーしてくる
+    pthread_mutex_lock(&cache->lock);
+    cache_entry_t *e = find_entry(cache, key);
+    void *copy = NULL;
+    size_t size = 0;
+    if (e) {
+        e->last_used = ++cache->clock;
+        copy = malloc(e->size);
+        if (copy) {
+            memcpy(copy, e->data, e->size);
+            size = e->size;
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+    if (copy || !cache->dir) {
+        float *frames = copy ? unpack(copy, size, num_frames) : NULL;
+        free(copy);
+        return frames;
+    }
+
+    // ディスクから読んだものはメモリにも置く
+    void *loaded = disk_read(cache, key, &size);
+    if (!loaded) return NULL;
+    float *frames = unpack(loaded, size, num_frames);
+    if (frames) {
+        pthread_mutex_lock(&cache->lock);
+        insert_entry(cache, key, loaded, size);
+        pthread_mutex_unlock(&cache->lock);
+    } else {
+        free(loaded);
+    }
+    return frames;
+}
+
+int opm_render_cache_put(opm_render_cache_t *cache, uint64_t key, const float *frames, int num_frames) {
+    if (!cache || !frames || num_frames <= 0) return -1;
+
+    size_t size;
+    void *packed = opm_codec_encode(frames, OPM_SAMPLE_FLOAT32, num_frames, 0, &size);
+    if (!packed) return -1;
+
+    int status = -1;
+    if (cache->dir) {
+        status = disk_write(cache, key, packed, size);
+    }
+    if (size <= cache->max_bytes) {
+        pthread_mutex_lock(&cache->lock);
+        int inserted = insert_entry(cache, key, packed, size);
+        pthread_mutex_unlock(&cache->lock);
+        if (inserted == 0) status = 0;
+    } else {
+        free(packed);
+    }
+    return status;
+}
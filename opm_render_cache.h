@@ -0,0 +1,62 @@
+// レンダリング結果のキャッシュ
+//
+// 同じイベント列を同じチップの設定で鳴らした結果を、正規化したイベント列と設定の
+// ハッシュをキーにして持つ。ヒットすればエミュレータを回さずに済む。
+// 持つのはリサンプル前の OPM のレートのフレーム (opm_renderer_capture) で、
+// 使うときに opm_renderer_resample で出力の形にする (整数なのでよく縮む)。
+// 出力の設定 (レート、品質、形式、ディザ) はキーに入らないので、同じエミュレーションは
+// 1つだけ持ち、どの出力の形にも使える。
+//   - メモリ: 合計サイズが max_bytes を超えたら最も長く使っていないものから捨てる (LRU)
+//   - ディスク: dir を指定すると <dir>/<キー 16 桁>.opmc にも書き、メモリにないときに読む
+//     ("OPMC" のヘッダーの後に opm_codec のデータが続くので、.opmz としては読めない)
+// どちらにも opm_codec で可逆圧縮して置く。
+// スレッドセーフ (opm-render --batch のスレッドで共有する)。ネイティブ専用
+// (ブラウザ版は render_cache.js が同じキーの作り方で IndexedDB に置く)。
+#ifndef _OPM_RENDER_CACHE_H_
+#define _OPM_RENDER_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "opm_renderer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 中身の意味が変わったら (キーの作り方、エミュレータの出力が変わる更新など) 上げる
+#define OPM_RENDER_CACHE_VERSION 4
+
+typedef struct opm_render_cache opm_render_cache_t;
+
+// エミュレーションの結果を決める設定。イベント列と一緒にキーに入る
+typedef struct {
+    uint32_t chip;                  // チップの種類 (opm_renderer_chip_flags)
+    opm_renderer_engine_t engine;
+    uint8_t channel_mask;
+    int num_frames;                 // 鳴らす長さ (OPM のレートのフレーム数。出力のレートによらない)
+} opm_render_cache_params_t;
+
+// イベント列と設定のキー (FNV-1a 64 ビット)。イベントの時刻はシーケンサが書き込む
+// サンプル位置にそろえてから入れるので、書き方 (0.5 と 0.50000001、"0x20" と 32 など) が
+// 違っても同じ音になるイベント列は同じキーになる
+uint64_t opm_render_cache_key(const opm_event_t *events, int event_count, const opm_render_cache_params_t *params);
+
+// max_bytes はメモリに置く (圧縮した) データの合計の上限。dir は NULL ならメモリだけ
+// (ディレクトリはなければ作る)。失敗時は NULL
+opm_render_cache_t *opm_render_cache_create(size_t max_bytes, const char *dir);
+void opm_render_cache_destroy(opm_render_cache_t *cache);
+
+// 見つかれば OPM のレートのフレーム ([L0, R0, ...] の float。free で解放する) を返し、
+// *num_frames にフレーム数を入れる。なければ NULL。
+// 出力に変換するには先読みの分 (opm_resampler_latency) も要るので、長さが出力の設定によって
+// 足りないことがある (opm_renderer_resample が短く返す)。そのときは鳴らし直して put し直す
+float *opm_render_cache_get(opm_render_cache_t *cache, uint64_t key, int *num_frames);
+// frames (OPM のレートの num_frames フレーム) を圧縮して持つ。
+// max_bytes より大きいものはディスクにだけ書く。成功時 0
+int opm_render_cache_put(opm_render_cache_t *cache, uint64_t key, const float *frames, int num_frames);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
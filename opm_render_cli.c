@@ -0,0 +1,914 @@
+// コマンドラインのオフラインレンダラー
+//
+// presets.json / index.html と同じ形式のイベント JSON を読み、
+// WAV (float32 か int16) をファイルか stdout に書き出す。
+// 出力は一定フレーム数ずつレンダリングしてすぐ書くので、1時間の曲でも
+// 出力全体をメモリに持たない。
+//
+//   opm-render -o out.wav tone.json
+//   opm-render -p 1 -f s16 presets.json > out.wav
+//   opm-render -r 48000 -o out.wav tone.json         (48kHz にリサンプル)
+//   opm-render --stems -o song.wav song.json        (song_ch0.wav ～ song_ch7.wav も書く)
+//   opm-render --batch -o previews/ tones/          (ディレクトリ内の *.json を全部)
+//   opm-render --batch -j 8 -o previews/ presets.json (配列の全エントリ)
+//   opm-render -P -o /dev/null song.json           (OPM_PROFILE 付きビルドでステージ別の時間を表示)
+//   opm-render -e fast --batch -o previews/ tones/ (サンプル単位の近似エンジンで速くプレビュー)
+//   opm-render -C ~/.cache/opm -o out.wav tone.json (同じ入力と設定なら前の結果を使う)
+//   opm-render -o song.opmz song.json              (可逆圧縮して書く。opm_codec.h)
+//   opm-render -o song.wav song.opmz               (圧縮したものを WAV に戻す)
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "opm_renderer.h"
+#include "opm_events.h"
+#include "opm_wav.h"
+#include "opm_batch.h"
+#include "opm_profile.h"
+#include "opm_render_cache.h"
+#include "opm_codec.h"
+
+#define DEFAULT_BLOCK_FRAMES 4096
+#define DEFAULT_CACHE_MB 256
+
+typedef struct {
+    const char *input;    // "-" は stdin
+    const char *output;   // "-" は stdout
+    opm_sample_format_t format;
+    int preset;
+    double duration;      // 0 以下ならイベントから決める
+    int block_frames;
+    int quiet;
+    int batch;            // input (ディレクトリか配列) の全エントリを output ディレクトリに書く
+    int jobs;             // batch のスレッド数。0 以下なら CPU 数
+    double rate;          // 出力のサンプルレート。0 なら OPM のレートのまま
+    opm_resample_quality_t quality;
+    int dither;           // リサンプルして s16 で書くときの TPDF ディザ
+    int stems;            // チャンネルごとの WAV も書く
+    uint8_t channel_mask; // ミックスに入れるチャンネル
+    int profile;          // OPM_Clock のステージ別の時間を stderr に表示する
+    opm_renderer_engine_t engine;
+    const char *cache_dir; // NULL ならキャッシュを使わない
+    double cache_mb;       // メモリに置くキャッシュの上限
+    opm_render_cache_t *cache;
+    int packed;            // output が *.opmz なので、WAV ではなく opm_codec で圧縮して書く
+} cli_options_t;
+
+
+// ============================================================
+// 1. Command Line
+// ============================================================
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+        "usage: %s [options] <events.json | ->\n"
+        "       %s --batch -o DIR [options] <directory | presets.json>\n"
+        "       %s -o FILE.wav <packed.opmz>\n"
+        "\n"
+        "options:\n"
+        "  -o, --output FILE     output WAV file (default: stdout), or directory with --batch;\n"
+        "                        FILE.opmz writes a losslessly compressed render instead\n"
+        "  -f, --format FORMAT   f32 (IEEE float, default) or s16 (16bit PCM)\n"
+        "  -p, --preset N        preset index when the input is an array (default: 0)\n"
+        "  -d, --duration SEC    length to render (default: last event + 1 sec)\n"
+        "  -b, --block FRAMES    frames rendered per block (default: %d)\n"
+        "  -q, --quiet           do not print the real-time factor\n"
+        "  -B, --batch           render every *.json in a directory or every entry of an array\n"
+        "  -j, --jobs N          worker threads for --batch (default: number of CPUs)\n"
+        "  -r, --rate HZ         resample to HZ, e.g. 44100 or 48000 (default: OPM rate, about 55930)\n"
+        "  -Q, --quality Q       resampler quality: fast, medium (default) or high\n"
+        "  -D, --dither          TPDF dither when writing resampled s16\n"
+        "  -S, --stems           also write one WAV per channel (<output>_ch0.wav ... _ch7.wav)\n"
+        "  -c, --channels LIST   channels to mix, e.g. 0,3 (default: all; others are muted)\n"
+        "  -P, --profile         print time spent per OPM_Clock stage (needs an OPM_PROFILE build)\n"
+        "  -e, --engine ENGINE   nuked (cycle-accurate, default) or fast (sample-level, approximate)\n"
+        "  -C, --cache DIR       reuse renders of identical input and settings from DIR\n"
+        "      --cache-mb MB     in-memory cache limit, shared by --batch threads (default: %d)\n"
+        "  -h, --help            show this help\n",
+        prog, prog, prog, DEFAULT_BLOCK_FRAMES, DEFAULT_CACHE_MB);
+}
+
+// "0,3,5" のようなチャンネル番号の並びをビットマスクにする
+static int parse_channels(const char *text, uint8_t *mask) {
+    *mask = 0;
+    while (*text) {
+        char *endp;
+        long ch = strtol(text, &endp, 10);
+        if (endp == text || ch < 0 || ch > 7) return -1;
+        *mask |= (uint8_t)(1 << ch);
+        if (*endp != ',' && *endp != '\0') return -1;
+        text = *endp == ',' ? endp + 1 : endp;
+    }
+    return *mask != 0 ? 0 : -1;
+}
+
+static int has_suffix(const char *text, const char *suffix) {
+    size_t n = strlen(text);
+    size_t m = strlen(suffix);
+    return n > m && strcmp(text + n - m, suffix) == 0;
+}
+
+// 成功時 0、終了すべきとき 1 (help)、エラー時 -1
+static int parse_options(int argc, char **argv, cli_options_t *opt) {
+    static const struct option long_options[] = {
+        { "output",   required_argument, NULL, 'o' },
+        { "format",   required_argument, NULL, 'f' },
+        { "preset",   required_argument, NULL, 'p' },
+        { "duration", required_argument, NULL, 'd' },
+        { "block",    required_argument, NULL, 'b' },
+        { "quiet",    no_argument,       NULL, 'q' },
+        { "batch",    no_argument,       NULL, 'B' },
+        { "jobs",     required_argument, NULL, 'j' },
+        { "rate",     required_argument, NULL, 'r' },
+        { "quality",  required_argument, NULL, 'Q' },
+        { "dither",   no_argument,       NULL, 'D' },
+        { "stems",    no_argument,       NULL, 'S' },
+        { "channels", required_argument, NULL, 'c' },
+        { "profile",  no_argument,       NULL, 'P' },
+        { "engine",   required_argument, NULL, 'e' },
+        { "cache",    required_argument, NULL, 'C' },
+        { "cache-mb", required_argument, NULL, 'M' },
+        { "help",     no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    opt->input = NULL;
+    opt->output = "-";
+    opt->format = OPM_SAMPLE_FLOAT32;
+    opt->preset = 0;
+    opt->duration = 0.0;
+    opt->block_frames = DEFAULT_BLOCK_FRAMES;
+    opt->quiet = 0;
+    opt->batch = 0;
+    opt->jobs = 0;
+    opt->rate = 0.0;
+    opt->quality = OPM_RESAMPLE_MEDIUM;
+    opt->dither = 0;
+    opt->stems = 0;
+    opt->channel_mask = 0xFF;
+    opt->profile = 0;
+    opt->engine = OPM_RENDERER_ENGINE_NUKED;
+    opt->cache_dir = NULL;
+    opt->cache_mb = DEFAULT_CACHE_MB;
+    opt->cache = NULL;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "o:f:p:d:b:qBj:r:Q:DSc:Pe:C:h", long_options, NULL)) != -1) {
+        switch (c) {
+        case 'o':
+            opt->output = optarg;
+            break;
+        case 'f':
+            if (strcmp(optarg, "f32") == 0) {
+                opt->format = OPM_SAMPLE_FLOAT32;
+            } else if (strcmp(optarg, "s16") == 0) {
+                opt->format = OPM_SAMPLE_INT16;
+            } else {
+                fprintf(stderr, "unknown format: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'p':
+            opt->preset = atoi(optarg);
+            break;
+        case 'd':
+            opt->duration = atof(optarg);
+            break;
+        case 'b':
+            opt->block_frames = atoi(optarg);
+            if (opt->block_frames <= 0) {
+                fprintf(stderr, "invalid block size: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'q':
+            opt->quiet = 1;
+            break;
+        case 'B':
+            opt->batch = 1;
+            break;
+        case 'j':
+            opt->jobs = atoi(optarg);
+            break;
+        case 'r':
+            opt->rate = atof(optarg);
+            if (opt->rate < 0.0) {
+                fprintf(stderr, "invalid rate: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'D':
+            opt->dither = 1;
+            break;
+        case 'S':
+            opt->stems = 1;
+            break;
+        case 'c':
+            if (parse_channels(optarg, &opt->channel_mask) != 0) {
+                fprintf(stderr, "invalid channels: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'P':
+            opt->profile = 1;
+            break;
+        case 'C':
+            opt->cache_dir = optarg;
+            break;
+        case 'M':
+            opt->cache_mb = atof(optarg);
+            if (opt->cache_mb < 0.0) {
+                fprintf(stderr, "invalid cache size: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'e':
+            if (strcmp(optarg, "nuked") == 0) {
+                opt->engine = OPM_RENDERER_ENGINE_NUKED;
+            } else if (strcmp(optarg, "fast") == 0) {
+                opt->engine = OPM_RENDERER_ENGINE_FAST;
+            } else {
+                fprintf(stderr, "unknown engine: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'Q':
+            if (strcmp(optarg, "fast") == 0) {
+                opt->quality = OPM_RESAMPLE_FAST;
+            } else if (strcmp(optarg, "medium") == 0) {
+                opt->quality = OPM_RESAMPLE_MEDIUM;
+            } else if (strcmp(optarg, "high") == 0) {
+                opt->quality = OPM_RESAMPLE_HIGH;
+            } else {
+                fprintf(stderr, "unknown quality: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 1;
+        default:
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (optind != argc - 1) {
+        print_usage(argv[0]);
+        return -1;
+    }
+    opt->input = argv[optind];
+    opt->packed = has_suffix(opt->output, ".opmz");
+
+    if (opt->packed && (opt->batch || opt->stems)) {
+        fprintf(stderr, "*.opmz output cannot be combined with --batch or --stems\n");
+        return -1;
+    }
+
+    if (opt->profile && !opm_profile_enabled()) {
+        fprintf(stderr, "--profile needs a build with OPM_PROFILE (cmake -DOPM_PROFILE=ON)\n");
+        return -1;
+    }
+    if (opt->profile && opt->engine != OPM_RENDERER_ENGINE_NUKED) {
+        // 計測するのは OPM_Clock のステージなので、fast では何も測れない
+        fprintf(stderr, "--profile needs the nuked engine\n");
+        return -1;
+    }
+    if (opt->profile && opt->batch) {
+        // 計測値はスレッド間で共有しないので、1本ずつのレンダリングに限る
+        fprintf(stderr, "--profile cannot be combined with --batch\n");
+        return -1;
+    }
+    return 0;
+}
+
+
+// ============================================================
+// 2. Timing
+// ============================================================
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+
+// ============================================================
+// 3. Rendering
+// ============================================================
+
+// 全体をメモリに置いてから書く (キャッシュを使うとき、*.opmz に書くとき)。
+// キャッシュにあればエミュレータには触れずにそれを書く。なければ start から全体を鳴らしてから書き、
+// キャッシュに入れる。全体を置くメモリがなければ 1 を返す (start せずに戻るので、呼び出し側がブロックずつ書く)
+static int write_whole(opm_renderer_t *renderer, const opm_event_t *events, int event_count, double duration,
+                       int total_frames, const cli_options_t *opt, FILE *out, int *cache_hit) {
+    // キーは出力の設定によらない (キャッシュにあるのは OPM のレートのフレーム)
+    opm_render_cache_params_t params;
+    params.chip = opm_renderer_chip_flags();
+    params.engine = opt->engine;
+    params.channel_mask = opt->channel_mask;
+    params.num_frames = (int)(duration * opm_renderer_sample_rate());
+    uint64_t key = opm_render_cache_key(events, event_count, &params);
+
+    size_t frame_bytes = (opt->format == OPM_SAMPLE_INT16 ? sizeof(int16_t) : sizeof(float)) * 2;
+    uint32_t sample_rate = (uint32_t)(opm_renderer_output_rate(renderer) + 0.5);
+    void *pcm = total_frames > 0 ? malloc(frame_bytes * (size_t)total_frames) : NULL;
+    if (!pcm) return 1;
+
+    // キャッシュにあるのは OPM のレートのフレームなので、レンダラーと同じように変換する
+    opm_output_t output;
+    opm_output_init_interleaved(&output, opt->format, pcm);
+    int chip_frames;
+    float *chip = opt->cache ? opm_render_cache_get(opt->cache, key, &chip_frames) : NULL;
+    *cache_hit = chip && opm_renderer_resample(chip, chip_frames, opt->rate, opt->quality, opt->dither,
+                                               total_frames, &output) == total_frames;
+    free(chip);
+    if (!*cache_hit) {
+        opm_renderer_start(renderer, events, event_count);
+        for (int done = 0; done < total_frames; ) {
+            int frames = total_frames - done < opt->block_frames ? total_frames - done : opt->block_frames;
+            opm_output_init_interleaved(&output, opt->format, (uint8_t *)pcm + frame_bytes * (size_t)done);
+            if (opm_renderer_render_block(renderer, frames, &output) != frames) {
+                free(pcm);
+                return -1;
+            }
+            done += frames;
+        }
+    }
+    int status;
+    if (opt->packed) {
+        size_t size;
+        void *packed = opm_codec_encode(pcm, opt->format, total_frames, sample_rate, &size);
+        status = packed && fwrite(packed, 1, size, out) == size ? 0 : -1;
+        free(packed);
+    } else {
+        status = opm_wav_write_header(out, opt->format, sample_rate, (uint32_t)total_frames) == 0
+            && opm_wav_write_frames(out, opt->format, pcm, (size_t)total_frames) == 0 ? 0 : -1;
+    }
+    const float *captured = status == 0 && opt->cache && !*cache_hit ? opm_renderer_capture(renderer, &chip_frames) : NULL;
+    if (captured) opm_render_cache_put(opt->cache, key, captured, chip_frames);
+    free(pcm);
+    return status;
+}
+
+// events を duration 秒ぶん out に WAV で書く。block は block_frames フレーム分の作業領域。
+// 成功時は 0 を返し、*frames_written に書いたフレーム数、*cache_hit にキャッシュを使ったかを入れる
+static int render_wav(opm_renderer_t *renderer, const opm_event_t *events, int event_count, double duration,
+                      const cli_options_t *opt, void *block, FILE *out, int *frames_written, int *cache_hit) {
+    *cache_hit = 0;
+    if (opm_renderer_set_output_rate(renderer, opt->rate, opt->quality) != 0) return -1;
+    if (opm_renderer_set_engine(renderer, opt->engine) != 0) return -1;
+    opm_renderer_set_dither(renderer, opt->dither);
+    opm_renderer_set_channel_mask(renderer, opt->channel_mask);
+
+    double total = duration * opm_renderer_output_rate(renderer);
+    if (total >= (double)INT32_MAX || duration * opm_renderer_sample_rate() >= (double)INT32_MAX) return -1;
+    int total_frames = (int)total;
+    // 取れなければキャッシュに置かないだけ
+    opm_renderer_set_capture(renderer, opt->cache ? total_frames : 0);
+
+    int whole = opt->cache || opt->packed;
+    int status = whole ? write_whole(renderer, events, event_count, duration, total_frames, opt, out, cache_hit) : 1;
+    if (status == 1 && opt->packed) return -1;
+    if (status == 1) {
+        opm_renderer_start(renderer, events, event_count);
+        status = opm_wav_write_render(out, renderer, opt->format, (uint32_t)total_frames, block, opt->block_frames);
+    }
+    if (status != 0) return -1;
+
+    *frames_written = total_frames;
+    return 0;
+}
+
+static void *alloc_block(const cli_options_t *opt) {
+    size_t bytes_per_sample = opt->format == OPM_SAMPLE_INT16 ? sizeof(int16_t) : sizeof(float);
+    return malloc(bytes_per_sample * 2 * (size_t)opt->block_frames);
+}
+
+static void print_rtf(const cli_options_t *opt, const char *label, long long frames, double elapsed) {
+    double audio_seconds = frames / (opt->rate > 0.0 ? opt->rate : opm_renderer_sample_rate());
+    fprintf(stderr, "%s%lld frames (%.2f sec) in %.3f sec, real-time factor %.1fx\n",
+            label, frames, audio_seconds, elapsed, elapsed > 0.0 ? audio_seconds / elapsed : 0.0);
+}
+
+static int load_events(const cli_options_t *opt, opm_event_t **events, int *event_count) {
+    size_t json_length;
+    char *json = opm_events_read_file(opt->input, &json_length);
+    if (!json) {
+        fprintf(stderr, "cannot read %s\n", opt->input);
+        return -1;
+    }
+
+    char error[128];
+    int result = opm_events_parse_json(json, json_length, opt->preset, events, event_count, error, sizeof(error));
+    free(json);
+    if (result != 0) {
+        fprintf(stderr, "%s: %s\n", opt->input, error);
+        return -1;
+    }
+    return 0;
+}
+
+static int run_single(const cli_options_t *opt) {
+    opm_event_t *events;
+    int event_count;
+    if (load_events(opt, &events, &event_count) != 0) return 1;
+
+    FILE *out = strcmp(opt->output, "-") == 0 ? stdout : fopen(opt->output, "wb");
+    if (!out) {
+        fprintf(stderr, "cannot open %s\n", opt->output);
+        opm_events_free(events);
+        return 1;
+    }
+
+    void *block = alloc_block(opt);
+    opm_renderer_t *renderer = opm_renderer_create();
+    double duration = opt->duration > 0.0 ? opt->duration : opm_events_duration(events, event_count);
+    int frames = 0;
+    int cache_hit = 0;
+    int status = 0;
+
+    double start = now_seconds();
+    if (!block || !renderer) {
+        fprintf(stderr, "out of memory\n");
+        status = 1;
+    } else if (render_wav(renderer, events, event_count, duration, opt, block, out, &frames, &cache_hit) != 0) {
+        fprintf(stderr, "cannot write %s\n", opt->output);
+        status = 1;
+    }
+    double elapsed = now_seconds() - start;
+
+    if (out != stdout) {
+        if (fclose(out) != 0) status = 1;
+        // 書きかけのファイルは残さない
+        if (status != 0) remove(opt->output);
+    } else if (fflush(out) != 0) {
+        status = 1;
+    }
+
+    if (status == 0 && !opt->quiet) {
+        print_rtf(opt, cache_hit ? "cached: " : "", frames, elapsed);
+    }
+
+    opm_renderer_destroy(renderer);
+    free(block);
+    opm_events_free(events);
+    return status;
+}
+
+
+// *.opmz を WAV (圧縮したときの形式とサンプルレート) に戻す
+static int run_unpack(const cli_options_t *opt) {
+    size_t size;
+    char *data = opm_events_read_file(opt->input, &size);
+    if (!data) {
+        fprintf(stderr, "cannot read %s\n", opt->input);
+        return 1;
+    }
+
+    opm_codec_info_t info;
+    void *pcm = NULL;
+    int status = 0;
+    if (opm_codec_info(data, size, &info) != 0) {
+        fprintf(stderr, "%s: not an opmz stream\n", opt->input);
+        status = 1;
+    } else {
+        size_t frame_bytes = (info.format == OPM_SAMPLE_INT16 ? sizeof(int16_t) : sizeof(float)) * 2;
+        pcm = malloc(frame_bytes * (size_t)(info.num_frames > 0 ? info.num_frames : 1));
+        if (!pcm || opm_codec_decode(data, size, 0, info.num_frames, pcm) != info.num_frames) {
+            fprintf(stderr, "%s: corrupt stream\n", opt->input);
+            status = 1;
+        }
+    }
+
+    FILE *out = NULL;
+    if (status == 0) {
+        out = strcmp(opt->output, "-") == 0 ? stdout : fopen(opt->output, "wb");
+        if (!out) {
+            fprintf(stderr, "cannot open %s\n", opt->output);
+            status = 1;
+        }
+    }
+    if (status == 0) {
+        uint32_t sample_rate = info.sample_rate > 0 ? info.sample_rate
+                                                    : (uint32_t)(opm_renderer_sample_rate() + 0.5);
+        if (opm_wav_write_header(out, info.format, sample_rate, (uint32_t)info.num_frames) != 0
+            || opm_wav_write_frames(out, info.format, pcm, (size_t)info.num_frames) != 0) {
+            fprintf(stderr, "cannot write %s\n", opt->output);
+            status = 1;
+        }
+    }
+    if (out && out != stdout) {
+        if (fclose(out) != 0) status = 1;
+    } else if (out && fflush(out) != 0) {
+        status = 1;
+    }
+
+    free(pcm);
+    free(data);
+    return status;
+}
+
+
+// ============================================================
+// 4. Stems
+// ============================================================
+//
+// master (output) と、チャンネルごとの <output の拡張子を除いた名前>_ch<N>.wav を
+// opm_renderer_render_stems で1回のレンダリングから書く。
+
+#define NUM_STEMS OPM_RENDERER_NUM_CHANNELS
+
+static int run_stems(const cli_options_t *opt) {
+    if (strcmp(opt->output, "-") == 0 || opt->rate > 0.0) {
+        fprintf(stderr, "--stems needs an output file (-o FILE) and cannot be combined with --rate\n");
+        return 2;
+    }
+
+    opm_event_t *events;
+    int event_count;
+    if (load_events(opt, &events, &event_count) != 0) return 1;
+
+    // FILE は master が [0]、チャンネル ch が [ch + 1]
+    FILE *files[NUM_STEMS + 1] = { NULL };
+    void *blocks[NUM_STEMS + 1] = { NULL };
+    char paths[NUM_STEMS + 1][4096];
+    size_t stem_length = strlen(opt->output);
+    if (stem_length > 4 && strcmp(opt->output + stem_length - 4, ".wav") == 0) stem_length -= 4;
+    snprintf(paths[0], sizeof(paths[0]), "%s", opt->output);
+    for (int ch = 0; ch < NUM_STEMS; ch++) {
+        snprintf(paths[ch + 1], sizeof(paths[ch + 1]), "%.*s_ch%d.wav", (int)stem_length, opt->output, ch);
+    }
+
+    opm_renderer_t *renderer = opm_renderer_create();
+    int status = renderer ? 0 : 1;
+    for (int i = 0; i <= NUM_STEMS && status == 0; i++) {
+        blocks[i] = alloc_block(opt);
+        files[i] = blocks[i] ? fopen(paths[i], "wb") : NULL;
+        if (!files[i]) {
+            fprintf(stderr, "cannot open %s\n", paths[i]);
+            status = 1;
+        }
+    }
+
+    double duration = opt->duration > 0.0 ? opt->duration : opm_events_duration(events, event_count);
+    double total = duration * opm_renderer_sample_rate();
+    int total_frames = total < (double)INT32_MAX ? (int)total : 0;
+    uint32_t sample_rate = (uint32_t)(opm_renderer_sample_rate() + 0.5);
+    for (int i = 0; i <= NUM_STEMS && status == 0; i++) {
+        if (opm_wav_write_header(files[i], opt->format, sample_rate, (uint32_t)total_frames) != 0) status = 1;
+    }
+
+    double start = now_seconds();
+    if (status == 0) {
+        opm_output_t master;
+        opm_output_t stems[NUM_STEMS];
+        opm_output_init_interleaved(&master, opt->format, blocks[0]);
+        for (int ch = 0; ch < NUM_STEMS; ch++) {
+            opm_output_init_interleaved(&stems[ch], opt->format, blocks[ch + 1]);
+        }
+
+        opm_renderer_set_channel_mask(renderer, opt->channel_mask);
+        if (opm_renderer_set_engine(renderer, opt->engine) != 0) status = 1;
+        opm_renderer_start(renderer, events, event_count);
+        for (int done = 0; done < total_frames && status == 0; ) {
+            int frames = total_frames - done < opt->block_frames ? total_frames - done : opt->block_frames;
+            if (opm_renderer_render_stems(renderer, frames, &master, stems) != frames) {
+                status = 1;
+                break;
+            }
+            for (int i = 0; i <= NUM_STEMS; i++) {
+                if (opm_wav_write_frames(files[i], opt->format, blocks[i], frames) != 0) status = 1;
+            }
+            done += frames;
+        }
+        if (status != 0) fprintf(stderr, "cannot write stems\n");
+    }
+    double elapsed = now_seconds() - start;
+
+    for (int i = 0; i <= NUM_STEMS; i++) {
+        if (files[i] && fclose(files[i]) != 0) status = 1;
+        free(blocks[i]);
+    }
+    // 書きかけのファイルは残さない
+    for (int i = 0; i <= NUM_STEMS && status != 0; i++) {
+        if (files[i]) remove(paths[i]);
+    }
+    if (status == 0 && !opt->quiet) {
+        for (int i = 0; i <= NUM_STEMS; i++) {
+            printf("%s\n", paths[i]);
+        }
+        print_rtf(opt, "", total_frames, elapsed);
+    }
+
+    opm_renderer_destroy(renderer);
+    opm_events_free(events);
+    return status;
+}
+
+
+// ============================================================
+// 5. Batch
+// ============================================================
+//
+// ディレクトリ内の *.json、または presets.json 形式の配列の全エントリを
+// opm_batch で全コアに振り分けてレンダリングする。
+// 出力ファイル名と結果の表示順は入力の順番だけで決まる。
+
+typedef struct {
+    char *source;          // 入力ファイル名 (表示用)
+    char *output_path;
+    opm_preset_t *bank;    // 同じファイルのエントリは bank を共有する (bank_owner だけが解放する)
+    int bank_size;
+    int bank_index;
+    int bank_owner;
+    int status;            // 0: 成功
+    int frames;
+    int cache_hit;
+    double elapsed;
+} batch_entry_t;
+
+typedef struct {
+    batch_entry_t *items;
+    int count;
+    int capacity;
+    const cli_options_t *opt;
+} batch_list_t;
+
+// ファイル名に使えない文字を '_' にする
+static void sanitize_name(const char *src, char *dst, size_t dst_size) {
+    size_t n = 0;
+    for (; *src && n + 1 < dst_size; src++) {
+        unsigned char c = (unsigned char)*src;
+        dst[n++] = (isalnum(c) || c == '-' || c == '.') ? (char)c : '_';
+    }
+    dst[n] = '\0';
+}
+
+static char *str_dup(const char *s) {
+    size_t n = strlen(s) + 1;
+    char *d = (char *)malloc(n);
+    if (d) memcpy(d, s, n);
+    return d;
+}
+
+// stem の bank を batch に追加する。bank が1つなら <stem>.wav、
+// 複数なら <stem>_<番号>_<name>.wav にする (stem が空なら番号から始める)
+static int batch_add_bank(batch_list_t *list, const char *source, const char *stem,
+                          opm_preset_t *bank, int bank_size) {
+    for (int i = 0; i < bank_size; i++) {
+        if (list->count == list->capacity) {
+            int capacity = list->capacity > 0 ? list->capacity * 2 : 64;
+            batch_entry_t *items = (batch_entry_t *)realloc(list->items, sizeof(batch_entry_t) * capacity);
+            if (!items) return -1;
+            list->items = items;
+            list->capacity = capacity;
+        }
+
+        char name[80];
+        char path[4096];
+        sanitize_name(bank[i].name, name, sizeof(name));
+        if (bank_size == 1 && stem[0]) {
+            snprintf(path, sizeof(path), "%s/%s.wav", list->opt->output, stem);
+        } else if (name[0]) {
+            snprintf(path, sizeof(path), "%s/%s%s%04d_%s.wav", list->opt->output, stem, stem[0] ? "_" : "", i, name);
+        } else {
+            snprintf(path, sizeof(path), "%s/%s%s%04d.wav", list->opt->output, stem, stem[0] ? "_" : "", i);
+        }
+
+        batch_entry_t *e = &list->items[list->count];
+        memset(e, 0, sizeof(*e));
+        e->source = str_dup(source);
+        e->output_path = str_dup(path);
+        e->bank = bank;
+        e->bank_size = bank_size;
+        e->bank_index = i;
+        e->bank_owner = i == 0;
+        e->status = -1;
+        list->count++;
+        if (!e->source || !e->output_path) return -1;
+    }
+    return 0;
+}
+
+static int batch_load_file(batch_list_t *list, const char *path, const char *stem) {
+    size_t json_length;
+    char *json = opm_events_read_file(path, &json_length);
+    if (!json) {
+        fprintf(stderr, "cannot read %s\n", path);
+        return -1;
+    }
+
+    opm_preset_t *bank;
+    int bank_size;
+    char error[128];
+    int result = opm_events_parse_bank(json, json_length, &bank, &bank_size, error, sizeof(error));
+    free(json);
+    if (result != 0) {
+        fprintf(stderr, "%s: %s\n", path, error);
+        return -1;
+    }
+    if (bank_size == 0) {
+        opm_events_free_bank(bank, bank_size);
+        return 0;
+    }
+
+    if (batch_add_bank(list, path, stem, bank, bank_size) != 0) {
+        fprintf(stderr, "out of memory\n");
+        return -1;
+    }
+    return 0;
+}
+
+// path のファイル名から拡張子を除いたもの (ディレクトリの *.json と同じ名前の付け方)。
+// "dir/" や ".json" のように名前がなければ空にする
+static void file_stem(const char *path, char *stem, size_t stem_size) {
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    const char *dot = strrchr(base, '.');
+    size_t len = dot ? (size_t)(dot - base) : strlen(base);
+    snprintf(stem, stem_size, "%.*s", (int)len, base);
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// ディレクトリ内の *.json を名前順に読む
+static int batch_load_directory(batch_list_t *list, const char *dir_path) {
+    DIR *dir = opendir(dir_path);
+    if (!dir) {
+        fprintf(stderr, "cannot open directory %s\n", dir_path);
+        return -1;
+    }
+
+    char **names = NULL;
+    int count = 0;
+    int capacity = 0;
+    int status = 0;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        size_t len = strlen(ent->d_name);
+        if (len <= 5 || strcmp(ent->d_name + len - 5, ".json") != 0) continue;
+        if (count == capacity) {
+            capacity = capacity > 0 ? capacity * 2 : 64;
+            char **grown = (char **)realloc(names, sizeof(char *) * capacity);
+            if (!grown) {
+                status = -1;
+                break;
+            }
+            names = grown;
+        }
+        names[count] = str_dup(ent->d_name);
+        if (!names[count]) {
+            status = -1;
+            break;
+        }
+        count++;
+    }
+    closedir(dir);
+
+    if (status == 0) {
+        qsort(names, count, sizeof(char *), compare_names);
+    }
+    for (int i = 0; i < count && status == 0; i++) {
+        char path[4096];
+        char stem[256];
+        snprintf(path, sizeof(path), "%s/%s", dir_path, names[i]);
+        size_t len = strlen(names[i]) - 5;
+        snprintf(stem, sizeof(stem), "%.*s", (int)len, names[i]);
+        status = batch_load_file(list, path, stem);
+    }
+
+    for (int i = 0; i < count; i++) {
+        free(names[i]);
+    }
+    free(names);
+    return status;
+}
+
+static int batch_job(int index, opm_renderer_t *renderer, void *user) {
+    batch_list_t *list = (batch_list_t *)user;
+    const cli_options_t *opt = list->opt;
+    batch_entry_t *e = &list->items[index];
+    const opm_preset_t *preset = &e->bank[e->bank_index];
+
+    void *block = alloc_block(opt);
+    FILE *out = block ? fopen(e->output_path, "wb") : NULL;
+    if (!out) {
+        free(block);
+        return e->status = -1;
+    }
+
+    double duration = opt->duration > 0.0 ? opt->duration : opm_events_duration(preset->events, preset->count);
+    double start = now_seconds();
+    e->status = render_wav(renderer, preset->events, preset->count, duration, opt, block, out, &e->frames,
+                           &e->cache_hit);
+    e->elapsed = now_seconds() - start;
+
+    if (fclose(out) != 0) e->status = -1;
+    if (e->status != 0) remove(e->output_path);
+    free(block);
+    return e->status;
+}
+
+static int run_batch(const cli_options_t *opt) {
+    if (strcmp(opt->output, "-") == 0) {
+        fprintf(stderr, "--batch needs an output directory (-o DIR)\n");
+        return 2;
+    }
+    if (mkdir(opt->output, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "cannot create directory %s\n", opt->output);
+        return 1;
+    }
+
+    batch_list_t list = { NULL, 0, 0, opt };
+    struct stat st;
+    int status;
+    if (stat(opt->input, &st) == 0 && S_ISDIR(st.st_mode)) {
+        status = batch_load_directory(&list, opt->input);
+    } else {
+        char stem[256];
+        file_stem(opt->input, stem, sizeof(stem));
+        status = batch_load_file(&list, opt->input, stem);
+    }
+
+    int failed = 0;
+    if (status == 0) {
+        int threads = opt->jobs > 0 ? opt->jobs : opm_batch_default_threads();
+        double start = now_seconds();
+        failed = opm_batch_run(list.count, threads, batch_job, &list);
+        double elapsed = now_seconds() - start;
+
+        // 結果は入力の順番で出す
+        long long total_frames = 0;
+        int cache_hits = 0;
+        for (int i = 0; i < list.count; i++) {
+            batch_entry_t *e = &list.items[i];
+            if (e->status != 0) {
+                fprintf(stderr, "FAILED %s -> %s\n", e->source, e->output_path);
+            } else {
+                total_frames += e->frames;
+                cache_hits += e->cache_hit;
+                if (!opt->quiet) printf("%s\n", e->output_path);
+            }
+        }
+        if (!opt->quiet) {
+            char label[96];
+            if (opt->cache) {
+                snprintf(label, sizeof(label), "%d files (%d cached), %d threads: ", list.count, cache_hits, threads);
+            } else {
+                snprintf(label, sizeof(label), "%d files, %d threads: ", list.count, threads);
+            }
+            print_rtf(opt, label, total_frames, elapsed);
+        }
+        if (failed != 0) status = -1;
+    }
+
+    for (int i = 0; i < list.count; i++) {
+        if (list.items[i].bank_owner) opm_events_free_bank(list.items[i].bank, list.items[i].bank_size);
+        free(list.items[i].source);
+        free(list.items[i].output_path);
+    }
+    free(list.items);
+    return status == 0 ? 0 : 1;
+}
+
+
+// ============================================================
+// 6. Main
+// ============================================================
+
+int main(int argc, char **argv) {
+    cli_options_t opt;
+    int parsed = parse_options(argc, argv, &opt);
+    if (parsed != 0) return parsed > 0 ? 0 : 2;
+
+    if (opt.cache_dir) {
+        opt.cache = opm_render_cache_create((size_t)(opt.cache_mb * 1024 * 1024), opt.cache_dir);
+        if (!opt.cache) {
+            fprintf(stderr, "cannot use cache directory %s\n", opt.cache_dir);
+            return 1;
+        }
+    }
+
+    int status;
+    if (opt.batch) {
+        status = run_batch(&opt);
+    } else if (has_suffix(opt.input, ".opmz")) {
+        status = run_unpack(&opt);
+    } else {
+        opm_profile_reset();
+        status = opt.stems ? run_stems(&opt) : run_single(&opt);
+        if (opt.profile) opm_profile_report(stderr);
+    }
+    opm_render_cache_destroy(opt.cache);
+    return status;
+}
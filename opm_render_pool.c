@@ -0,0 +1,232 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "opm_render_pool.h"
+
+// --- データ構造 ---
+
+typedef enum {
+    RENDER_JOB_QUEUED,
+    RENDER_JOB_RUNNING,
+    RENDER_JOB_DONE,
+    RENDER_JOB_FAILED
+} render_job_state_t;
+
+typedef struct render_job {
+    int id;
+    render_job_state_t state;
+    opm_event_t *events;   // submit 時にコピーしたもの
+    int event_count;
+    int num_samples;
+    opm_renderer_t *renderer; // ジョブ専用。結果はこのバッファに残る
+    struct render_job *queue_next; // 待ち行列
+    struct render_job *list_next;  // 全ジョブ一覧
+} render_job_t;
+
+struct opm_render_pool {
+    pthread_t threads[OPM_RENDER_POOL_MAX_THREADS];
+    int num_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    render_job_t *queue_head; // 未処理ジョブ (FIFO)
+    render_job_t *queue_tail;
+    render_job_t *jobs;       // 全ジョブ (解放されるまで残る)
+    int next_id;
+    int shutdown;
+    opm_render_pool_done_fn done;
+    void *user;
+    double output_rate;       // submit するジョブに設定する (submit 側のスレッドだけが使う)
+    opm_resample_quality_t quality;
+};
+
+
+// ============================================================
+// 1. Job Management
+// ============================================================
+
+static void render_job_free(render_job_t *job) {
+    free(job->events);
+    opm_renderer_destroy(job->renderer);
+    free(job);
+}
+
+// lock を取った状態で呼ぶこと
+static render_job_t *render_pool_find(opm_render_pool_t *pool, int job_id) {
+    for (render_job_t *job = pool->jobs; job; job = job->list_next) {
+        if (job->id == job_id) return job;
+    }
+    return NULL;
+}
+
+
+// ============================================================
+// 2. Worker Thread
+// ============================================================
+
+static void *render_pool_worker(void *arg) {
+    opm_render_pool_t *pool = (opm_render_pool_t *)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->queue_head && !pool->shutdown) {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        }
+        // shutdown でも残っているジョブは片付けてから抜ける
+        if (!pool->queue_head) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        render_job_t *job = pool->queue_head;
+        pool->queue_head = job->queue_next;
+        if (!pool->queue_head) pool->queue_tail = NULL;
+        job->queue_next = NULL;
+        job->state = RENDER_JOB_RUNNING;
+        pthread_mutex_unlock(&pool->lock);
+
+        int frames = opm_renderer_render(job->renderer, job->events, job->event_count, job->num_samples);
+
+        pthread_mutex_lock(&pool->lock);
+        job->state = frames > 0 ? RENDER_JOB_DONE : RENDER_JOB_FAILED;
+        int job_id = job->id;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (pool->done) {
+            pool->done(job_id, frames, pool->user);
+        }
+    }
+
+    return NULL;
+}
+
+
+// ============================================================
+// 3. Pool API
+// ============================================================
+
+opm_render_pool_t *opm_render_pool_create(int num_threads, opm_render_pool_done_fn done, void *user) {
+    if (num_threads < 1) num_threads = 1;
+    if (num_threads > OPM_RENDER_POOL_MAX_THREADS) num_threads = OPM_RENDER_POOL_MAX_THREADS;
+
+    opm_render_pool_t *pool = (opm_render_pool_t *)calloc(1, sizeof(opm_render_pool_t));
+    if (!pool) return NULL;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    pool->next_id = 1;
+    pool->done = done;
+    pool->user = user;
+
+    for (int i = 0; i < num_threads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, render_pool_worker, pool) != 0) {
+            break;
+        }
+        pool->num_threads++;
+    }
+
+    if (pool->num_threads == 0) {
+        opm_render_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void opm_render_pool_destroy(opm_render_pool_t *pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->num_threads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    render_job_t *job = pool->jobs;
+    while (job) {
+        render_job_t *next = job->list_next;
+        render_job_free(job);
+        job = next;
+    }
+
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+int opm_render_pool_thread_count(const opm_render_pool_t *pool) {
+    return pool ? pool->num_threads : 0;
+}
+
+int opm_render_pool_submit(opm_render_pool_t *pool, const opm_event_t *events, int event_count, int num_samples) {
+    if (!pool || num_samples <= 0 || event_count < 0) return 0;
+
+    render_job_t *job = (render_job_t *)calloc(1, sizeof(render_job_t));
+    if (!job) return 0;
+
+    job->event_count = event_count;
+    job->num_samples = num_samples;
+    job->events = (opm_event_t *)malloc(sizeof(opm_event_t) * (event_count > 0 ? event_count : 1));
+    job->renderer = opm_renderer_create();
+    if (!job->events || !job->renderer ||
+        opm_renderer_set_output_rate(job->renderer, pool->output_rate, pool->quality) != 0) {
+        render_job_free(job);
+        return 0;
+    }
+    if (event_count > 0) {
+        memcpy(job->events, events, sizeof(opm_event_t) * event_count);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    int job_id = pool->next_id++;
+    job->id = job_id;
+    job->state = RENDER_JOB_QUEUED;
+    job->list_next = pool->jobs;
+    pool->jobs = job;
+    if (pool->queue_tail) {
+        pool->queue_tail->queue_next = job;
+    } else {
+        pool->queue_head = job;
+    }
+    pool->queue_tail = job;
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    return job_id;
+}
+
+void opm_render_pool_set_output_rate(opm_render_pool_t *pool, double rate, opm_resample_quality_t quality) {
+    if (!pool) return;
+    pool->output_rate = rate;
+    pool->quality = quality;
+}
+
+const float *opm_render_pool_get_buffer(opm_render_pool_t *pool, int job_id) {
+    if (!pool) return NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    render_job_t *job = render_pool_find(pool, job_id);
+    const float *buffer = (job && job->state == RENDER_JOB_DONE) ? opm_renderer_buffer(job->renderer) : NULL;
+    pthread_mutex_unlock(&pool->lock);
+    return buffer;
+}
+
+int opm_render_pool_release(opm_render_pool_t *pool, int job_id) {
+    if (!pool) return 0;
+
+    pthread_mutex_lock(&pool->lock);
+    render_job_t **link = &pool->jobs;
+    while (*link && (*link)->id != job_id) {
+        link = &(*link)->list_next;
+    }
+    render_job_t *job = *link;
+    if (!job || job->state == RENDER_JOB_QUEUED || job->state == RENDER_JOB_RUNNING) {
+        pthread_mutex_unlock(&pool->lock);
+        return 0;
+    }
+    *link = job->list_next;
+    pthread_mutex_unlock(&pool->lock);
+
+    render_job_free(job);
+    return 1;
+}
@@ -0,0 +1,50 @@
+// OPM レンダースレッドプール
+//
+// 独立したレンダージョブ (プリセット、ノート、ステムなど) を複数のスレッドで
+// 並行して処理する。ジョブごとに opm_renderer_t を持つのでスレッド間で
+// 共有する状態はない。pthreads があればどこでも動く (ネイティブ、
+// Emscripten の -pthread ビルド)。
+#ifndef _OPM_RENDER_POOL_H_
+#define _OPM_RENDER_POOL_H_
+
+#include "opm_renderer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OPM_RENDER_POOL_MAX_THREADS 16
+
+typedef struct opm_render_pool opm_render_pool_t;
+
+// ジョブ完了時に「ワーカースレッド上で」呼ばれる。frames は失敗時 0
+typedef void (*opm_render_pool_done_fn)(int job_id, int frames, void *user);
+
+// num_threads 本のスレッドを起動する (1 ～ OPM_RENDER_POOL_MAX_THREADS に丸める)。
+// done は NULL でもよい。失敗時は NULL
+opm_render_pool_t *opm_render_pool_create(int num_threads, opm_render_pool_done_fn done, void *user);
+// 残っているジョブの完了を待ってからスレッドを止め、全ジョブを解放する
+void opm_render_pool_destroy(opm_render_pool_t *pool);
+
+int opm_render_pool_thread_count(const opm_render_pool_t *pool);
+
+// ジョブを積んで job_id (1 以上) を返す。失敗時は 0。
+// イベントはコピーするので、呼び出し後すぐに解放してよい
+int opm_render_pool_submit(opm_render_pool_t *pool, const opm_event_t *events, int event_count, int num_samples);
+
+// これ以降に submit するジョブの出力レート (opm_renderer_set_output_rate と同じ)。
+// submit と同じスレッドから呼ぶこと
+void opm_render_pool_set_output_rate(opm_render_pool_t *pool, double rate, opm_resample_quality_t quality);
+
+// 完了したジョブの出力 ([L0, R0, L1, R1, ...]、float を frames * 2 個)。
+// 未完了・失敗・不明なジョブは NULL
+const float *opm_render_pool_get_buffer(opm_render_pool_t *pool, int job_id);
+
+// 完了したジョブを解放する。待ち行列中・実行中のジョブは解放せず 0 を返す
+int opm_render_pool_release(opm_render_pool_t *pool, int job_id);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
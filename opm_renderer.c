@@ -0,0 +1,752 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "opm.h"
+#include "opm_simd.h"
+#include "opm_fast.h"
+#include "opm_renderer.h"
+#include "opm_resampler.h"
+#include "opm_profile.h"
+
+// --- 定数定義 ---
+#define BUSY_CYCLES 128
+#define CLOCK_STEP 64
+#define OPM_CLOCK 3579545
+
+// サンプルレート (約55930Hz)
+#define SAMPLE_RATE ((double)OPM_CLOCK / CLOCK_STEP)
+
+// 1アクションあたりの待機サンプル数
+#define SAMPLES_PER_ACCESS ((double)BUSY_CYCLES / CLOCK_STEP)
+
+// OPM_Mixer が L / R の積算 (mix[]) を 0 に戻すサイクルと、
+// OPM_DAC が L / R の出力 (dac_output[]) を更新するサイクル
+#define MIX_RESET_CYCLE_L 29
+#define MIX_RESET_CYCLE_R 13
+#define DAC_UPDATE_CYCLE_L 5
+#define DAC_UPDATE_CYCLE_R 21
+
+// OPM_PROFILE 付きのビルドではステージ別の時間を測りながら回す
+#ifdef OPM_PROFILE
+#define OPM_CLOCK_FN opm_profile_clock
+#else
+#define OPM_CLOCK_FN OPM_Clock
+#endif
+
+// ディザの乱数の初期値 (start ごとに戻すので、同じ入力なら同じ出力になる)
+#define DITHER_SEED 0x9E3779B9u
+
+// --- データ構造 ---
+
+typedef struct {
+    const opm_event_t *events;
+    int count;
+    int current_index;
+    double next_available_sample;
+    int pending_data_write;
+} sequencer_t;
+
+// チャンネルごとの出力 (ステム) を OPM_Mixer と同じタイミングで積算する
+typedef struct {
+    int32_t acc[2][OPM_RENDERER_NUM_CHANNELS];      // 積算中
+    int32_t latched[2][2][OPM_RENDERER_NUM_CHANNELS]; // 積算し終わった分 ([0] が新しい)。DAC に送られている途中
+    int32_t shown[2][OPM_RENDERER_NUM_CHANNELS];    // いま DAC が出している分
+} stem_state_t;
+
+struct opm_renderer {
+    opm_t chip;
+    opm_simd_t *simd_chip;  // render_multi を初めて呼んだときに確保する
+    opm_fast_t *fast_chip;  // OPM_RENDERER_ENGINE_FAST にしたときに確保する
+    opm_renderer_engine_t engine;
+    sequencer_t seq;
+    int position;           // start からのフレーム数 (シーケンサの時刻)
+    void *buffer;
+    size_t buffer_capacity; // 確保済みのバイト数
+    int buffer_length;      // 直前の render で書いたサンプル (L/R それぞれ1つ) の個数
+    opm_sample_format_t buffer_format;  // 直前の render で書いた形式
+    opm_sample_format_t render_format;  // render で内部バッファに書く形式
+
+    // 出力レートを変えたときだけ使う (NULL なら OPM のレートのまま)
+    opm_resampler_t *resampler;
+    double output_rate;
+    opm_resample_quality_t quality;
+    float *resample_in;     // リサンプラーに渡す OPM レートのフレーム
+    float resample_out[OPM_RESAMPLER_MAX_BLOCK * 2];
+
+    stem_state_t stems;
+    uint8_t channel_mask;   // bit ch が 1 のチャンネルだけミックスに入れる
+
+    // リサンプル後に int16 にするときの TPDF ディザ
+    int dither;
+    uint32_t dither_state;
+
+    // set_capture したとき、start から鳴らした OPM のレートのフレーム ([L0, R0, ...] の float)
+    int capture_max;        // set_capture の max_frames (出力のレートでのフレーム数)
+    int capture_failed;     // 容量を超えたので、この start の分は取れていない
+    float *capture;
+    int capture_frames;
+    int capture_capacity;   // フレーム数
+};
+
+
+// ============================================================
+// 1. OPM Hardware Control
+// ============================================================
+
+static void opm_initialize(opm_t *c) {
+    OPM_Reset(c, OPM_CLOCK);
+}
+
+// ミキサーがこのクロックで足すチャンネルが mask に入っていなければ、足す値を 0 にする。
+// op_mixl / op_mixr はミキサーしか読まず、次のクロックで作り直されるので、
+// チップのほかの状態やほかのチャンネルの出力は変わらない
+static void opm_mask_mixer(opm_t *c, uint8_t mask) {
+    uint32_t channel = ((c->cycles + 18) & 31) & 7;
+    if (!(mask & (1 << channel))) {
+        c->op_mixl = 0;
+        c->op_mixr = 0;
+    }
+}
+
+// opm_render_stereo と同じだが、mask に入っていないチャンネルをミックスしない
+static void opm_render_stereo_masked(opm_t *c, int32_t sample_buf[2], uint8_t mask) {
+    uint8_t sh1, sh2, so;
+
+    for (int j = 0; j < CLOCK_STEP; j++) {
+        opm_mask_mixer(c, mask);
+        OPM_CLOCK_FN(c, sample_buf, &sh1, &sh2, &so);
+    }
+}
+
+// 1サンプル分の処理を行い、L/Rの結果 (OPM の生の出力) を sample_buf に返す
+static void opm_render_stereo(opm_t *c, int32_t sample_buf[2]) {
+    uint8_t sh1, sh2, so;
+
+    // CLOCK_STEP分回す
+    for (int j = 0; j < CLOCK_STEP; j++) {
+        OPM_CLOCK_FN(c, sample_buf, &sh1, &sh2, &so);
+    }
+}
+
+
+// 1サンプル分回しながら、各チャンネルが mix[] に足す値を横取りして
+// stems に積算する。ミキサーは各クロックの最初に、前のクロックで
+// OPM_OperatorPhase14 が用意した op_mix / op_mixl / op_mixr を足すので、
+// OPM_Clock の前に読めば同じ値になる。L / R とも、DAC が出力を更新するときに
+// 出てくるのは2つ前に積算し終わった分なので、そこまで遅らせてそろえる
+static void opm_render_stereo_stems(opm_t *c, int32_t sample_buf[2], stem_state_t *st, uint8_t mask) {
+    uint8_t sh1, sh2, so;
+
+    for (int j = 0; j < CLOCK_STEP; j++) {
+        opm_mask_mixer(c, mask);
+
+        uint32_t cycle = c->cycles;
+        for (int side = 0; side < 2; side++) {
+            uint32_t reset = side == 0 ? MIX_RESET_CYCLE_L : MIX_RESET_CYCLE_R;
+            uint32_t update = side == 0 ? DAC_UPDATE_CYCLE_L : DAC_UPDATE_CYCLE_R;
+            if (cycle == update) {
+                memcpy(st->shown[side], st->latched[side][1], sizeof(st->shown[side]));
+            }
+            if (cycle == reset) {
+                memcpy(st->latched[side][1], st->latched[side][0], sizeof(st->latched[side][1]));
+                memcpy(st->latched[side][0], st->acc[side], sizeof(st->latched[side][0]));
+                memset(st->acc[side], 0, sizeof(st->acc[side]));
+            }
+        }
+
+        uint32_t channel = ((cycle + 18) & 31) & 7;
+        st->acc[0][channel] += c->op_mix * c->op_mixl;
+        st->acc[1][channel] += c->op_mix * c->op_mixr;
+
+        OPM_CLOCK_FN(c, sample_buf, &sh1, &sh2, &so);
+    }
+}
+
+
+// ============================================================
+// 2. Output
+// ============================================================
+
+void opm_output_init_interleaved(opm_output_t *out, opm_sample_format_t format, void *buffer) {
+    out->format = format;
+    out->left = buffer;
+    out->right = format == OPM_SAMPLE_INT16 ? (void *)((int16_t *)buffer + 1) : (void *)((float *)buffer + 1);
+    out->stride = 2;
+}
+
+void opm_output_init_planar(opm_output_t *out, opm_sample_format_t format, void *left, void *right) {
+    out->format = format;
+    out->left = left;
+    out->right = right;
+    out->stride = 1;
+}
+
+static int16_t output_clip16(int32_t v) {
+    if (v > INT16_MAX) return INT16_MAX;
+    if (v < INT16_MIN) return INT16_MIN;
+    return (int16_t)v;
+}
+
+// OPMの出力を正規化して frame 番目に書き込み
+// ミックスせず、LとRを独立して書く
+static void output_write(const opm_output_t *out, int frame, const int32_t sample_buf[2]) {
+    size_t pos = (size_t)frame * out->stride;
+    if (out->format == OPM_SAMPLE_INT16) {
+        ((int16_t *)out->left)[pos] = output_clip16(sample_buf[0]);
+        ((int16_t *)out->right)[pos] = output_clip16(sample_buf[1]);
+    } else {
+        ((float *)out->left)[pos] = (float)sample_buf[0] / 32768.0f;
+        ((float *)out->right)[pos] = (float)sample_buf[1] / 32768.0f;
+    }
+}
+
+
+// xorshift32。0 ～ 1 の一様乱数を返す
+static float dither_uniform(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return (float)(x >> 8) * (1.0f / 16777216.0f);
+}
+
+// 三角分布 (-1 ～ 1 LSB) のディザ。一様乱数2つの差
+static float dither_tpdf(uint32_t *state) {
+    return dither_uniform(state) - dither_uniform(state);
+}
+
+// リサンプル後の float (-1.0 ～ 1.0) を frame 番目に書き込み。
+// int16 にするときは dither_state が NULL でなければ TPDF ディザをかける
+static void output_write_float(const opm_output_t *out, int frame, const float sample[2], uint32_t *dither_state) {
+    size_t pos = (size_t)frame * out->stride;
+    if (out->format == OPM_SAMPLE_INT16) {
+        float l = sample[0] * 32768.0f;
+        float r = sample[1] * 32768.0f;
+        if (dither_state) {
+            l += dither_tpdf(dither_state);
+            r += dither_tpdf(dither_state);
+        }
+        ((int16_t *)out->left)[pos] = output_clip16((int32_t)lrintf(l));
+        ((int16_t *)out->right)[pos] = output_clip16((int32_t)lrintf(r));
+    } else {
+        ((float *)out->left)[pos] = sample[0];
+        ((float *)out->right)[pos] = sample[1];
+    }
+}
+
+
+// ============================================================
+// 3. Memory Management
+// ============================================================
+
+static size_t sample_size(opm_sample_format_t format) {
+    return format == OPM_SAMPLE_INT16 ? sizeof(int16_t) : sizeof(float);
+}
+
+// ステレオなので、必要な「サンプルの個数」は num_frames * 2 になる点に注意。
+// 足りるときはそのまま使い回し、足りないときだけ倍々で広げる
+static int buffer_ensure_capacity(opm_renderer_t *r, int num_samples, opm_sample_format_t format) {
+    size_t bytes = (size_t)num_samples * sample_size(format);
+    if (bytes <= r->buffer_capacity) {
+        return 1;
+    }
+
+    size_t capacity = r->buffer_capacity > 0 ? r->buffer_capacity : 16384;
+    while (capacity < bytes) {
+        capacity *= 2;
+    }
+
+    void *buffer = realloc(r->buffer, capacity);
+    if (!buffer) {
+        return 0;
+    }
+
+    r->buffer = buffer;
+    r->buffer_capacity = capacity;
+    return 1;
+}
+
+// 出力のレートで capture_max フレーム作るときに鳴らす OPM のフレームが入るだけ capture を確保する。
+// 足りていればそのまま使う。成功時 0、確保できなければ -1 (前の capture は残る)
+static int capture_alloc(opm_renderer_t *r) {
+    double needed = r->capture_max;
+    if (r->resampler) {
+        // ブロックごとの先読みの端数も含めて、リサンプラーが読む分
+        needed = ceil(r->capture_max * SAMPLE_RATE / r->output_rate) + opm_resampler_latency(r->resampler) + 2;
+    }
+    if (needed > (double)(INT32_MAX / 2)) return -1;
+    int capacity = (int)needed;
+    if (capacity <= r->capture_capacity) return 0;
+
+    float *capture = (float *)malloc(sizeof(float) * 2 * (size_t)capacity);
+    if (!capture) return -1;
+    free(r->capture);
+    r->capture = capture;
+    r->capture_capacity = capacity;
+    r->capture_frames = 0;
+    return 0;
+}
+
+
+// ============================================================
+// 4. Sequencer Logic
+// ============================================================
+
+static void sequencer_init(sequencer_t *seq, const opm_event_t *events, int event_count) {
+    seq->events = events;
+    seq->count = event_count;
+    seq->current_index = 0;
+    seq->next_available_sample = 0.0;
+    seq->pending_data_write = 0;
+}
+
+// current_sample_idx で書き込むべきものがあれば port / data を返して 1 を返す
+static int sequencer_next_write(sequencer_t *seq, int current_sample_idx, uint32_t *port, uint8_t *data) {
+    if (seq->current_index >= seq->count) {
+        return 0;
+    }
+
+    const opm_event_t *evt = &seq->events[seq->current_index];
+
+    double trigger_sample = evt->time * SAMPLE_RATE;
+    if ((double)current_sample_idx < trigger_sample) {
+        return 0;
+    }
+
+    if ((double)current_sample_idx < seq->next_available_sample) {
+        return 0;
+    }
+
+    if (seq->pending_data_write == 0) {
+        *port = 0;
+        *data = evt->addr;
+        seq->pending_data_write = 1;
+    } else {
+        *port = 1;
+        *data = evt->data;
+        seq->pending_data_write = 0;
+        seq->current_index++;
+    }
+    seq->next_available_sample = (double)current_sample_idx + SAMPLES_PER_ACCESS;
+    return 1;
+}
+
+static void sequencer_process(opm_renderer_t *r, int current_sample_idx) {
+    uint32_t port;
+    uint8_t data;
+    if (sequencer_next_write(&r->seq, current_sample_idx, &port, &data)) {
+        if (r->engine == OPM_RENDERER_ENGINE_FAST) {
+            OPM_Fast_Write(r->fast_chip, port, data);
+        } else {
+            OPM_Write(&r->chip, port, data);
+        }
+    }
+}
+
+
+// ============================================================
+// 5. Renderer API
+// ============================================================
+
+opm_renderer_t *opm_renderer_create(void) {
+    opm_renderer_t *r = (opm_renderer_t *)calloc(1, sizeof(opm_renderer_t));
+    if (r) {
+        r->dither_state = DITHER_SEED;
+        r->channel_mask = 0xFF;
+    }
+    return r;
+}
+
+void opm_renderer_destroy(opm_renderer_t *r) {
+    if (!r) return;
+    free(r->simd_chip);
+    free(r->fast_chip);
+    free(r->buffer);
+    opm_resampler_destroy(r->resampler);
+    free(r->resample_in);
+    free(r->capture);
+    free(r);
+}
+
+int opm_renderer_render(opm_renderer_t *r, const opm_event_t *events, int event_count, int num_samples) {
+    if (!r || num_samples <= 0 || num_samples > INT32_MAX / 2) return 0;
+
+    if (!buffer_ensure_capacity(r, num_samples * 2, r->render_format)) return 0;
+    r->buffer_length = num_samples * 2;
+    r->buffer_format = r->render_format;
+
+    // インターリーブ形式 (L, R, L, R...) で格納
+    opm_output_t out;
+    opm_output_init_interleaved(&out, r->render_format, r->buffer);
+    return opm_renderer_render_to(r, events, event_count, num_samples, &out);
+}
+
+int opm_renderer_render_to(opm_renderer_t *r, const opm_event_t *events, int event_count, int num_samples,
+                           const opm_output_t *out) {
+    if (!r) return 0;
+
+    opm_renderer_start(r, events, event_count);
+    return opm_renderer_render_block(r, num_samples, out);
+}
+
+void opm_renderer_start(opm_renderer_t *r, const opm_event_t *events, int event_count) {
+    if (!r) return;
+
+    if (r->engine == OPM_RENDERER_ENGINE_FAST) {
+        OPM_Fast_Reset(r->fast_chip, OPM_CLOCK);
+    } else {
+        opm_initialize(&r->chip);
+    }
+    sequencer_init(&r->seq, events, event_count);
+    r->position = 0;
+    r->capture_frames = 0;
+    r->capture_failed = 0;
+    r->dither_state = DITHER_SEED;
+    memset(&r->stems, 0, sizeof(r->stems));
+    opm_resampler_reset(r->resampler);
+}
+
+void opm_renderer_start_from(opm_renderer_t *r, const opm_t *snapshot, const opm_event_t *events, int event_count) {
+    if (!r || !snapshot) return;
+
+    if (r->engine == OPM_RENDERER_ENGINE_FAST) {
+        OPM_Fast_Load(r->fast_chip, snapshot);
+    } else {
+        r->chip = *snapshot;
+    }
+    sequencer_init(&r->seq, events, event_count);
+    r->position = 0;
+    r->capture_frames = 0;
+    r->capture_failed = 0;
+    r->dither_state = DITHER_SEED;
+    memset(&r->stems, 0, sizeof(r->stems));
+    opm_resampler_reset(r->resampler);
+}
+
+int opm_renderer_finished(const opm_renderer_t *r) {
+    return r ? r->seq.current_index >= r->seq.count : 1;
+}
+
+const opm_t *opm_renderer_chip(const opm_renderer_t *r) {
+    if (!r) return NULL;
+    return r->engine == OPM_RENDERER_ENGINE_FAST ? &r->fast_chip->chip : &r->chip;
+}
+
+int opm_renderer_set_engine(opm_renderer_t *r, opm_renderer_engine_t engine) {
+    if (!r) return -1;
+    if (engine == OPM_RENDERER_ENGINE_FAST && !r->fast_chip) {
+        r->fast_chip = (opm_fast_t *)malloc(sizeof(opm_fast_t));
+        if (!r->fast_chip) return -1;
+        OPM_Fast_Reset(r->fast_chip, OPM_CLOCK);
+    } else if (engine != OPM_RENDERER_ENGINE_FAST && engine != OPM_RENDERER_ENGINE_NUKED) {
+        return -1;
+    }
+    r->engine = engine;
+    return 0;
+}
+
+opm_renderer_engine_t opm_renderer_engine(const opm_renderer_t *r) {
+    return r ? r->engine : OPM_RENDERER_ENGINE_NUKED;
+}
+
+// OPM のレートで num_frames フレーム鳴らして out に書く
+static int render_chip_frames(opm_renderer_t *r, int num_frames, const opm_output_t *out) {
+    if (num_frames > INT32_MAX - r->position) return 0;
+
+    // 確保は set_capture で済ませてあるので、入りきらなければこの start の分は諦める
+    float *capture = NULL;
+    if (r->capture && !r->capture_failed) {
+        if (num_frames > r->capture_capacity - r->capture_frames) {
+            r->capture_failed = 1;
+        } else {
+            capture = &r->capture[(size_t)r->capture_frames * 2];
+        }
+    }
+
+    if (r->engine == OPM_RENDERER_ENGINE_FAST) {
+        r->fast_chip->mix_mask = r->channel_mask;
+    }
+    for (int i = 0; i < num_frames; i++) {
+        sequencer_process(r, r->position + i);
+
+        // ステレオで取得して書き込む (全チャンネル鳴らすときは余計な処理をしない)
+        int32_t sample_buf[2];
+        if (r->engine == OPM_RENDERER_ENGINE_FAST) {
+            OPM_Fast_Sample(r->fast_chip, sample_buf);
+        } else if (r->channel_mask == 0xFF) {
+            opm_render_stereo(&r->chip, sample_buf);
+        } else {
+            opm_render_stereo_masked(&r->chip, sample_buf, r->channel_mask);
+        }
+        output_write(out, i, sample_buf);
+        if (capture) {
+            capture[i * 2] = (float)sample_buf[0] / 32768.0f;
+            capture[i * 2 + 1] = (float)sample_buf[1] / 32768.0f;
+        }
+    }
+    r->position += num_frames;
+    if (capture) r->capture_frames += num_frames;
+    return num_frames;
+}
+
+// 出力レートで num_frames フレーム作る。OPM_RESAMPLER_MAX_BLOCK ずつ、
+// リサンプラーが必要とする分だけ OPM を先に鳴らして渡す
+static int render_resampled(opm_renderer_t *r, int num_frames, const opm_output_t *out) {
+    opm_output_t chip_out;
+    opm_output_init_interleaved(&chip_out, OPM_SAMPLE_FLOAT32, r->resample_in);
+
+    int done = 0;
+    while (done < num_frames) {
+        int want = num_frames - done < OPM_RESAMPLER_MAX_BLOCK ? num_frames - done : OPM_RESAMPLER_MAX_BLOCK;
+        int needed = opm_resampler_input_needed(r->resampler, want);
+        if (needed > 0 && render_chip_frames(r, needed, &chip_out) != needed) break;
+
+        int produced = opm_resampler_process(r->resampler, r->resample_in, needed, r->resample_out, want);
+        if (produced <= 0) break;
+        for (int i = 0; i < produced; i++) {
+            output_write_float(out, done + i, &r->resample_out[i * 2], r->dither ? &r->dither_state : NULL);
+        }
+        done += produced;
+    }
+    return done;
+}
+
+int opm_renderer_render_block(opm_renderer_t *r, int num_frames, const opm_output_t *out) {
+    if (!r || !out || !out->left || !out->right || num_frames <= 0) return 0;
+
+    // 生成したフレーム数(時間)を返す
+    if (r->resampler) {
+        return render_resampled(r, num_frames, out);
+    }
+    return render_chip_frames(r, num_frames, out);
+}
+
+int opm_renderer_render_stems(opm_renderer_t *r, int num_frames, const opm_output_t *master,
+                              const opm_output_t stems[OPM_RENDERER_NUM_CHANNELS]) {
+    if (!r || !stems || num_frames <= 0 || r->resampler) return 0;
+    if (num_frames > INT32_MAX - r->position) return 0;
+
+    opm_fast_t *fast = r->engine == OPM_RENDERER_ENGINE_FAST ? r->fast_chip : NULL;
+    if (fast) {
+        fast->mix_mask = r->channel_mask;
+    }
+    for (int i = 0; i < num_frames; i++) {
+        sequencer_process(r, r->position + i);
+
+        // 速いエンジンはチャンネルごとの内訳を自分で持っている
+        int32_t sample_buf[2];
+        if (fast) {
+            OPM_Fast_Sample(fast, sample_buf);
+        } else {
+            opm_render_stereo_stems(&r->chip, sample_buf, &r->stems, r->channel_mask);
+        }
+        if (master && master->left) {
+            output_write(master, i, sample_buf);
+        }
+        for (int ch = 0; ch < OPM_RENDERER_NUM_CHANNELS; ch++) {
+            if (!stems[ch].left) continue;
+            int32_t stem_buf[2];
+            if (fast) {
+                stem_buf[0] = fast->ch_output[0][ch];
+                stem_buf[1] = fast->ch_output[1][ch];
+            } else {
+                stem_buf[0] = r->stems.shown[0][ch];
+                stem_buf[1] = r->stems.shown[1][ch];
+            }
+            output_write(&stems[ch], i, stem_buf);
+        }
+    }
+    r->position += num_frames;
+    return num_frames;
+}
+
+int opm_renderer_set_output_rate(opm_renderer_t *r, double rate, opm_resample_quality_t quality) {
+    if (!r) return -1;
+
+    // OPM のレートのままにする
+    if (rate <= 0.0 || rate == SAMPLE_RATE) {
+        opm_resampler_destroy(r->resampler);
+        free(r->resample_in);
+        r->resampler = NULL;
+        r->resample_in = NULL;
+        r->output_rate = 0.0;
+        if (r->capture_max > 0) capture_alloc(r);
+        return 0;
+    }
+
+    // 同じ設定ならそのまま使う (バッチのジョブごとに呼んでもよいように)
+    if (r->resampler && r->output_rate == rate && r->quality == quality) {
+        return 0;
+    }
+
+    opm_resampler_t *resampler = opm_resampler_create(SAMPLE_RATE, rate, quality);
+    int max_input = (int)ceil(OPM_RESAMPLER_MAX_BLOCK * SAMPLE_RATE / rate) + 2 * opm_resampler_latency(resampler) + 2;
+    float *resample_in = resampler ? (float *)malloc(sizeof(float) * 2 * max_input) : NULL;
+    if (!resample_in) {
+        opm_resampler_destroy(resampler);
+        return -1;
+    }
+
+    opm_resampler_destroy(r->resampler);
+    free(r->resample_in);
+    r->resampler = resampler;
+    r->resample_in = resample_in;
+    r->output_rate = rate;
+    r->quality = quality;
+    // 確保できなくても、取っておけるのが max_frames より短くなるだけ
+    if (r->capture_max > 0) capture_alloc(r);
+    return 0;
+}
+
+int opm_renderer_set_capture(opm_renderer_t *r, int max_frames) {
+    if (!r) return -1;
+    r->capture_max = max_frames > 0 ? max_frames : 0;
+    if (r->capture_max > 0 && capture_alloc(r) == 0) return 0;
+
+    int status = r->capture_max > 0 ? -1 : 0;
+    free(r->capture);
+    r->capture = NULL;
+    r->capture_max = 0;
+    r->capture_capacity = 0;
+    r->capture_frames = 0;
+    return status;
+}
+
+const float *opm_renderer_capture(const opm_renderer_t *r, int *num_frames) {
+    if (!r || r->capture_failed || !r->capture) return NULL;
+    if (num_frames) *num_frames = r->capture_frames;
+    return r->capture;
+}
+
+int opm_renderer_resample(const float *in, int in_frames, double rate, opm_resample_quality_t quality, int dither,
+                          int num_frames, const opm_output_t *out) {
+    if (!in || in_frames < 0 || !out || !out->left || !out->right || num_frames <= 0) return 0;
+
+    // OPM のレートのままなら書き写すだけ
+    if (rate <= 0.0 || rate == SAMPLE_RATE) {
+        int frames = num_frames < in_frames ? num_frames : in_frames;
+        for (int i = 0; i < frames; i++) {
+            output_write_float(out, i, &in[i * 2], NULL);
+        }
+        return frames;
+    }
+
+    // render_resampled と同じ順に渡す (リサンプラーは渡し方によらず同じ結果になる)
+    opm_resampler_t *resampler = opm_resampler_create(SAMPLE_RATE, rate, quality);
+    if (!resampler) return 0;
+    uint32_t dither_state = DITHER_SEED;
+    float block[OPM_RESAMPLER_MAX_BLOCK * 2];
+    int done = 0;
+    int consumed = 0;
+    while (done < num_frames) {
+        int want = num_frames - done < OPM_RESAMPLER_MAX_BLOCK ? num_frames - done : OPM_RESAMPLER_MAX_BLOCK;
+        int needed = opm_resampler_input_needed(resampler, want);
+        if (needed > in_frames - consumed) break;
+
+        int produced = opm_resampler_process(resampler, &in[(size_t)consumed * 2], needed, block, want);
+        if (produced <= 0) break;
+        consumed += needed;
+        for (int i = 0; i < produced; i++) {
+            output_write_float(out, done + i, &block[i * 2], dither ? &dither_state : NULL);
+        }
+        done += produced;
+    }
+    opm_resampler_destroy(resampler);
+    return done;
+}
+
+double opm_renderer_output_rate(const opm_renderer_t *r) {
+    return r && r->resampler ? r->output_rate : SAMPLE_RATE;
+}
+
+double opm_renderer_sample_rate(void) {
+    return SAMPLE_RATE;
+}
+
+uint32_t opm_renderer_chip_flags(void) {
+    return OPM_CLOCK & opm_flags_ym2164;
+}
+
+// OPM_SIMD_LANES 台ずつロックステップで鳴らす
+int opm_renderer_render_multi(opm_renderer_t *r, const opm_event_t *const *events, const int *event_counts,
+                              int num_voices, int num_samples) {
+    if (!r || num_voices <= 0 || num_samples <= 0) return 0;
+    if (num_samples > INT32_MAX / 2 / num_voices) return 0;
+
+    if (!r->simd_chip) {
+        r->simd_chip = (opm_simd_t *)malloc(sizeof(opm_simd_t));
+        if (!r->simd_chip) return 0;
+    }
+    if (!buffer_ensure_capacity(r, num_voices * num_samples * 2, OPM_SAMPLE_FLOAT32)) return 0;
+    r->buffer_length = num_voices * num_samples * 2;
+    r->buffer_format = OPM_SAMPLE_FLOAT32;
+
+    sequencer_t seqs[OPM_SIMD_LANES];
+    int32_t sample_buf[OPM_SIMD_LANES * 2];
+
+    for (int base = 0; base < num_voices; base += OPM_SIMD_LANES) {
+        int lanes = num_voices - base;
+        if (lanes > OPM_SIMD_LANES) lanes = OPM_SIMD_LANES;
+
+        OPM_SIMD_Reset(r->simd_chip, OPM_CLOCK);
+        for (int l = 0; l < lanes; l++) {
+            sequencer_init(&seqs[l], events[base + l], event_counts[base + l]);
+        }
+
+        for (int i = 0; i < num_samples; i++) {
+            for (int l = 0; l < lanes; l++) {
+                uint32_t port;
+                uint8_t data;
+                if (sequencer_next_write(&seqs[l], i, &port, &data)) {
+                    OPM_SIMD_Write(r->simd_chip, l, port, data);
+                }
+            }
+
+            for (int j = 0; j < CLOCK_STEP; j++) {
+                OPM_SIMD_Clock(r->simd_chip, sample_buf);
+            }
+
+            for (int l = 0; l < lanes; l++) {
+                float *out = &((float *)r->buffer)[((size_t)(base + l) * num_samples + i) * 2];
+                out[0] = (float)sample_buf[l * 2 + 0] / 32768.0f;
+                out[1] = (float)sample_buf[l * 2 + 1] / 32768.0f;
+            }
+        }
+    }
+
+    return num_samples;
+}
+
+const float *opm_renderer_buffer(const opm_renderer_t *r) {
+    return r && r->buffer_format == OPM_SAMPLE_FLOAT32 ? (const float *)r->buffer : NULL;
+}
+
+const void *opm_renderer_buffer_data(const opm_renderer_t *r) {
+    return r ? r->buffer : NULL;
+}
+
+opm_sample_format_t opm_renderer_buffer_format(const opm_renderer_t *r) {
+    return r ? r->buffer_format : OPM_SAMPLE_FLOAT32;
+}
+
+void opm_renderer_set_buffer_format(opm_renderer_t *r, opm_sample_format_t format) {
+    if (r) r->render_format = format;
+}
+
+void opm_renderer_set_channel_mask(opm_renderer_t *r, uint8_t mask) {
+    if (r) r->channel_mask = mask;
+}
+
+uint8_t opm_renderer_channel_mask(const opm_renderer_t *r) {
+    return r ? r->channel_mask : 0xFF;
+}
+
+void opm_renderer_set_dither(opm_renderer_t *r, int enabled) {
+    if (r) r->dither = enabled != 0;
+}
+
+int opm_renderer_buffer_length(const opm_renderer_t *r) {
+    return r ? r->buffer_length : 0;
+}
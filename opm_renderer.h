@@ -0,0 +1,169 @@
+// OPM レンダラー
+//
+// イベント列 (時刻 + レジスタ書き込み) を OPM で鳴らして float のステレオ
+// 波形にする。状態はすべて opm_renderer_t の中にあるので、複数のレンダラーを
+// 同時に持てる (複数トラック、A/B 比較、ワーカースレッドごとに1つ、など)。
+// 1つのレンダラーを複数スレッドから同時に使うのは不可。
+#ifndef _OPM_RENDERER_H_
+#define _OPM_RENDERER_H_
+
+#include <stdint.h>
+#include "opm.h"
+#include "opm_resampler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 入力イベント。JS 側とは 8 バイト固定のレイアウトでやりとりする
+typedef struct {
+    float time;     // 秒
+    uint8_t addr;
+    uint8_t data;
+    uint8_t pad[2];
+} opm_event_t;
+
+typedef struct opm_renderer opm_renderer_t;
+
+#define OPM_RENDERER_NUM_CHANNELS 8
+
+// 呼び出し側が用意した出力先
+typedef enum {
+    OPM_SAMPLE_FLOAT32, // -1.0 ～ 1.0
+    OPM_SAMPLE_INT16    // 範囲外はクリップする
+} opm_sample_format_t;
+
+typedef struct {
+    opm_sample_format_t format;
+    void *left;   // L チャンネルのフレーム 0 の位置
+    void *right;  // R チャンネルのフレーム 0 の位置
+    int stride;   // 次のフレームまでの距離 (要素数)。インターリーブなら 2、プレーナーなら 1
+} opm_output_t;
+
+// [L0, R0, L1, R1, ...] 形式の buffer に書く出力先を作る
+void opm_output_init_interleaved(opm_output_t *out, opm_sample_format_t format, void *buffer);
+// L と R を別々の配列に書く出力先を作る
+void opm_output_init_planar(opm_output_t *out, opm_sample_format_t format, void *left, void *right);
+
+// 失敗時は NULL
+opm_renderer_t *opm_renderer_create(void);
+void opm_renderer_destroy(opm_renderer_t *r);
+
+// events を num_samples フレーム鳴らす。生成したフレーム数を返す (失敗時は 0)。
+// 出力バッファは次の render まで有効で、容量が足りるあいだは使い回す
+int opm_renderer_render(opm_renderer_t *r, const opm_event_t *events, int event_count, int num_samples);
+
+// render と同じだが、内部バッファを使わず out に直接書く。
+// レンダリング中にメモリ確保は一切しない
+int opm_renderer_render_to(opm_renderer_t *r, const opm_event_t *events, int event_count, int num_samples,
+                           const opm_output_t *out);
+
+// ストリーミング用。start で先頭に戻し、render_block を呼ぶたびに続きの
+// num_frames フレームを out に書く (長い曲を一定サイズずつ書き出すときなど)。
+// events は最後の render_block まで有効であること
+void opm_renderer_start(opm_renderer_t *r, const opm_event_t *events, int event_count);
+int opm_renderer_render_block(opm_renderer_t *r, int num_frames, const opm_output_t *out);
+
+// render_block と同じだが、master と一緒にチャンネルごとの出力 (ステム) を
+// stems[0..7] に書く。8回ミュートして鳴らし直すのと違い、1回のレンダリングで済む。
+// ステムは OPM_Mixer が mix[] に足す値をチャンネルごとに分けたもので、
+// master と同じサンプルにそろえてある。ステムは量子化もクリップもしないので
+// (int16 で書くときだけ ±32767 でクリップ)、ステムの合計は master と次の分だけ違う:
+//   - チップは合計を 16 ビットの範囲でクリップする (大音量で複数チャンネルが重なったとき)
+//   - DAC は 10 ビット仮数の浮動小数点なので、大きい値ほど下位ビットが落ちる
+// master と stems[ch].left は NULL でもよい (書かない)。OPM_Reset から始めたとき
+// (start) に正確になる。リサンプル中 (set_output_rate) は使えず 0 を返す
+int opm_renderer_render_stems(opm_renderer_t *r, int num_frames, const opm_output_t *master,
+                              const opm_output_t stems[OPM_RENDERER_NUM_CHANNELS]);
+
+// bit ch (0 ～ 7) が 1 のチャンネルだけをミックスに入れる (既定は 0xFF、全チャンネル)。
+// ミュートしたチャンネルはミキサーで足さないだけで、チップの状態
+// (エンベロープ、LFO、ほかのチャンネルの出力) は変わらない。
+// 次の render_block から効くので、鳴らしている途中でソロ / ミュートを切り替えてよい。
+// start しても戻らない。render_multi には効かない
+void opm_renderer_set_channel_mask(opm_renderer_t *r, uint8_t mask);
+uint8_t opm_renderer_channel_mask(const opm_renderer_t *r);
+
+// チップのエミュレーションの方式
+typedef enum {
+    OPM_RENDERER_ENGINE_NUKED, // Nuked OPM を 1 クロックずつ回す。ビット単位で正確 (既定)
+    OPM_RENDERER_ENGINE_FAST   // サンプル単位の近似エンジン (opm_fast.h)。数倍～20 倍速いが LFO を使うと一致しない
+} opm_renderer_engine_t;
+
+// engine で鳴らす。大量のプレビューなど、多少の誤差より速さが欲しいときに FAST にする
+// (Nuked との SNR は opm-bench で測れる)。start / start_from の前に呼ぶこと。
+// FAST でも同じイベント列・同じ opm_t のレジスタのフィールドを使い、channel_mask、
+// ステム、スナップショット (chip / start_from) も使える。render_multi は常に Nuked。
+// 成功時 0、失敗時 -1 (設定は変わらない)
+int opm_renderer_set_engine(opm_renderer_t *r, opm_renderer_engine_t engine);
+opm_renderer_engine_t opm_renderer_engine(const opm_renderer_t *r);
+
+// start と同じだが、OPM_Reset せずに snapshot のチップ状態から始める
+void opm_renderer_start_from(opm_renderer_t *r, const opm_t *snapshot, const opm_event_t *events, int event_count);
+// シーケンサがすべてのイベントを書き終えていれば 1
+int opm_renderer_finished(const opm_renderer_t *r);
+// 現在のチップ状態 (スナップショットを取るとき用)
+const opm_t *opm_renderer_chip(const opm_renderer_t *r);
+
+// OPM のサンプルレート (OPM クロック / 64、約55930Hz)
+double opm_renderer_sample_rate(void);
+// start がリセットするチップの種類 (opm_flags_none / opm_flags_ym2164)。
+// opm_renderer_chip(r)->opp と違い、start する前から分かる (キャッシュのキーなどに使う)
+uint32_t opm_renderer_chip_flags(void);
+
+// 出力のサンプルレートを rate (Hz、44100 / 48000 など) にする。0 以下なら
+// OPM のレートのまま (リサンプルしない)。以降 render / render_to / render_block の
+// フレーム数は出力レートでのフレーム数になり、レンダラーは出力に必要な分だけ
+// OPM を先に鳴らす (先読みは opm_resampler_latency フレーム、HIGH で約1.1ms)。
+// 出力の時刻はイベントの時刻とそろう。start の前に呼ぶこと。
+// render_multi には効かない。成功時 0、失敗時 -1 (設定は変わらない)
+int opm_renderer_set_output_rate(opm_renderer_t *r, double rate, opm_resample_quality_t quality);
+// 出力のサンプルレート (set_output_rate していなければ opm_renderer_sample_rate と同じ)
+double opm_renderer_output_rate(const opm_renderer_t *r);
+
+// max_frames > 0 にすると、start から render / render_to / render_block で鳴らした OPM のレートの
+// (リサンプル前の) 出力も取っておく。リサンプルした結果はそのままでは縮まないので、
+// キャッシュにはこちらを圧縮して置き、使うときに opm_renderer_resample する。
+// start から出力のレートで max_frames フレーム鳴らす分をここと set_output_rate で確保しておき、
+// レンダリング中は確保しない (超えて鳴らすとその start の分は取れない)。
+// 0 にすると無効にして取っておいた分も解放する。render_stems と render_multi は取らない。
+// 成功時 0、確保できなければ -1 (無効になる)
+int opm_renderer_set_capture(opm_renderer_t *r, int max_frames);
+// start から取っておいたフレーム ([L0, R0, L1, R1, ...] の float、*num_frames フレーム)。
+// 次の start まで有効。有効にしていない、または max_frames を超えて鳴らしたときは NULL
+const float *opm_renderer_capture(const opm_renderer_t *r, int *num_frames);
+// 取っておいた OPM のレートのフレーム in (in_frames フレーム) を、set_output_rate(rate, quality) と
+// set_dither(dither) をしたレンダラーと同じように変換して num_frames フレーム out に書く。
+// start から鳴らしたときの render_block の結果とビット単位で一致する。書いたフレーム数を返す
+int opm_renderer_resample(const float *in, int in_frames, double rate, opm_resample_quality_t quality, int dither,
+                          int num_frames, const opm_output_t *out);
+
+// 複数のイベント列を SIMD エンジンでまとめて鳴らす。
+// 結果は voice ごとに num_samples * 2 個の float を連続して並べる
+// (voice v のサンプル i は (v * num_samples + i) * 2 + {0,1})
+int opm_renderer_render_multi(opm_renderer_t *r, const opm_event_t *const *events, const int *event_counts,
+                              int num_voices, int num_samples);
+
+// render で内部バッファに書く形式 (既定は OPM_SAMPLE_FLOAT32)。
+// OPM_SAMPLE_INT16 にするとメモリもコピーも半分になる。render_multi は常に float
+void opm_renderer_set_buffer_format(opm_renderer_t *r, opm_sample_format_t format);
+
+// リサンプルした結果を int16 で出すとき、丸める前に TPDF ディザ (±1 LSB) をかける。
+// 乱数は start ごとに同じ値から始めるので、同じ入力なら出力も同じ。
+// リサンプルしないときの int16 は OPM の出力そのもの (整数) なのでディザは不要で、かけない
+void opm_renderer_set_dither(opm_renderer_t *r, int enabled);
+
+// 直前の render の結果。[L0, R0, L1, R1, ...] の順。
+// float 以外の形式で書いたときは NULL (opm_renderer_buffer_data を使う)
+const float *opm_renderer_buffer(const opm_renderer_t *r);
+// 直前の render の結果 (形式は opm_renderer_buffer_format)
+const void *opm_renderer_buffer_data(const opm_renderer_t *r);
+opm_sample_format_t opm_renderer_buffer_format(const opm_renderer_t *r);
+// 直前の render の結果に含まれるサンプルの個数 (フレーム数 * 2)
+int opm_renderer_buffer_length(const opm_renderer_t *r);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,289 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "opm_resampler.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// 内積を何本の部分和に分けるか。taps はこの倍数にする。
+// 部分和ごとに独立した演算になるのでコンパイラがベクトル命令にまとめられる
+// (-ffast-math なしでも結果はビルドによらず同じ)
+#define RESAMPLER_LANES 8
+
+// レート比を有理数にするときに試す 2 のべき乗の上限 (55930.390625 = 3579545 / 64)
+#define RATE_SCALE_MAX_SHIFT 16
+
+typedef struct {
+    int taps;           // フィルタの長さ (入力フレーム数)
+    int phases;         // 係数表の位相の数
+    double attenuation; // 阻止域の減衰量 (dB)
+} quality_preset_t;
+
+static const quality_preset_t quality_presets[] = {
+    {  24,  64,  60.0 },  // OPM_RESAMPLE_FAST
+    {  64, 256,  90.0 },  // OPM_RESAMPLE_MEDIUM
+    { 128, 256, 120.0 },  // OPM_RESAMPLE_HIGH
+};
+
+struct opm_resampler {
+    int taps;
+    int half;             // taps / 2 (= 先読み)
+    int phases;
+
+    // 位相 p の係数は coeffs[p * taps]、次の位相との差は deltas[p * taps]
+    float *coeffs;
+    float *deltas;
+
+    // 1出力あたり入力を step / den フレーム進める
+    uint64_t step;
+    uint64_t den;
+    uint64_t frac;        // 現在位置の小数部 (0 ～ den-1)
+
+    // 入力の履歴 (プレーナー)。index は現在位置の整数部のバッファ上の位置
+    float *hist_l;
+    float *hist_r;
+    int capacity;
+    int length;
+    int index;
+};
+
+
+// ============================================================
+// 1. Filter Design
+// ============================================================
+
+// 0次の第1種変形ベッセル関数
+static double bessel_i0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 64; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+static double kaiser_beta(double attenuation) {
+    if (attenuation > 50.0) return 0.1102 * (attenuation - 8.7);
+    if (attenuation > 21.0) return 0.5842 * pow(attenuation - 21.0, 0.4) + 0.07886 * (attenuation - 21.0);
+    return 0.0;
+}
+
+// 位相ごとの係数表を作る。cutoff は入力のサンプルレートを 1 とした遮断周波数
+static int design_filter(opm_resampler_t *rs, double cutoff, double attenuation) {
+    int taps = rs->taps;
+    size_t count = (size_t)(rs->phases + 1) * taps;
+    double *table = (double *)malloc(sizeof(double) * count);
+    rs->coeffs = (float *)malloc(sizeof(float) * count);
+    rs->deltas = (float *)malloc(sizeof(float) * count);
+    if (!table || !rs->coeffs || !rs->deltas) {
+        free(table);
+        return 0;
+    }
+
+    double beta = kaiser_beta(attenuation);
+    double i0_beta = bessel_i0(beta);
+
+    for (int p = 0; p <= rs->phases; p++) {
+        double *row = &table[(size_t)p * taps];
+        double sum = 0.0;
+        for (int k = 0; k < taps; k++) {
+            // 出力位置から入力 k までの距離 (入力フレーム数)
+            double d = (double)p / rs->phases + (rs->half - 1 - k);
+            double x = 2.0 * cutoff * d;
+            double sinc = fabs(x) < 1e-12 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+            double w = d / rs->half;
+            double window = fabs(w) >= 1.0 ? 0.0 : bessel_i0(beta * sqrt(1.0 - w * w)) / i0_beta;
+            row[k] = sinc * window;
+            sum += row[k];
+        }
+        // 位相によって直流のゲインが変わらないようにする
+        for (int k = 0; k < taps; k++) {
+            row[k] /= sum;
+        }
+    }
+
+    for (int p = 0; p <= rs->phases; p++) {
+        for (int k = 0; k < taps; k++) {
+            size_t i = (size_t)p * taps + k;
+            rs->coeffs[i] = (float)table[i];
+            rs->deltas[i] = p < rs->phases ? (float)(table[i + taps] - table[i]) : 0.0f;
+        }
+    }
+
+    free(table);
+    return 1;
+}
+
+static uint64_t gcd_u64(uint64_t a, uint64_t b) {
+    while (b != 0) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// in_rate / out_rate を既約分数 step / den にする
+static int rate_ratio(double in_rate, double out_rate, uint64_t *step, uint64_t *den) {
+    int shift = 0;
+    while (shift < RATE_SCALE_MAX_SHIFT &&
+           (in_rate * (1 << shift) != floor(in_rate * (1 << shift)) ||
+            out_rate * (1 << shift) != floor(out_rate * (1 << shift)))) {
+        shift++;
+    }
+    double scale = (double)(1 << shift);
+    uint64_t num = (uint64_t)floor(in_rate * scale + 0.5);
+    uint64_t d = (uint64_t)floor(out_rate * scale + 0.5);
+    if (num == 0 || d == 0) return 0;
+
+    uint64_t g = gcd_u64(num, d);
+    *step = num / g;
+    *den = d / g;
+    return 1;
+}
+
+
+// ============================================================
+// 2. Resampler API
+// ============================================================
+
+opm_resampler_t *opm_resampler_create(double in_rate, double out_rate, opm_resample_quality_t quality) {
+    if (!(in_rate > 0.0) || !(out_rate > 0.0) || in_rate / out_rate > OPM_RESAMPLER_MAX_RATIO) return NULL;
+    if ((int)quality < 0 || (int)quality > OPM_RESAMPLE_HIGH) quality = OPM_RESAMPLE_MEDIUM;
+
+    opm_resampler_t *rs = (opm_resampler_t *)calloc(1, sizeof(opm_resampler_t));
+    if (!rs) return NULL;
+
+    const quality_preset_t *preset = &quality_presets[quality];
+    rs->taps = preset->taps;
+    rs->half = preset->taps / 2;
+    rs->phases = preset->phases;
+
+    // 阻止域が出力のナイキスト周波数から始まるよう、遷移帯域の半分だけ下げる
+    double nyquist = (in_rate < out_rate ? in_rate : out_rate) / 2.0 / in_rate;
+    double transition = (preset->attenuation - 8.0) / (14.36 * rs->taps);
+    double cutoff = nyquist - transition / 2.0;
+    if (cutoff < nyquist * 0.5) cutoff = nyquist * 0.5;
+
+    rs->capacity = 2 * rs->taps + (int)ceil(OPM_RESAMPLER_MAX_BLOCK * OPM_RESAMPLER_MAX_RATIO) + 4;
+    rs->hist_l = (float *)malloc(sizeof(float) * rs->capacity);
+    rs->hist_r = (float *)malloc(sizeof(float) * rs->capacity);
+
+    if (!rs->hist_l || !rs->hist_r || !rate_ratio(in_rate, out_rate, &rs->step, &rs->den) ||
+        !design_filter(rs, cutoff, preset->attenuation)) {
+        opm_resampler_destroy(rs);
+        return NULL;
+    }
+
+    opm_resampler_reset(rs);
+    return rs;
+}
+
+void opm_resampler_destroy(opm_resampler_t *rs) {
+    if (!rs) return;
+    free(rs->coeffs);
+    free(rs->deltas);
+    free(rs->hist_l);
+    free(rs->hist_r);
+    free(rs);
+}
+
+void opm_resampler_reset(opm_resampler_t *rs) {
+    if (!rs) return;
+
+    // 入力 0 より前は無音とみなす
+    rs->length = rs->half - 1;
+    rs->index = rs->half - 1;
+    rs->frac = 0;
+    memset(rs->hist_l, 0, sizeof(float) * rs->length);
+    memset(rs->hist_r, 0, sizeof(float) * rs->length);
+}
+
+int opm_resampler_latency(const opm_resampler_t *rs) {
+    return rs ? rs->half : 0;
+}
+
+int opm_resampler_input_needed(const opm_resampler_t *rs, int out_frames) {
+    if (!rs || out_frames <= 0) return 0;
+    if (out_frames > OPM_RESAMPLER_MAX_BLOCK) out_frames = OPM_RESAMPLER_MAX_BLOCK;
+
+    // 最後の出力の位置 + 先読みまでが履歴にあればよい
+    uint64_t last = rs->index + (rs->frac + (uint64_t)(out_frames - 1) * rs->step) / rs->den;
+    int64_t needed = (int64_t)last + rs->half + 1 - rs->length;
+    return needed > 0 ? (int)needed : 0;
+}
+
+// 使い終わった履歴を捨てて前に詰める
+static void history_compact(opm_resampler_t *rs) {
+    int first = rs->index - rs->half + 1;
+    if (first <= 0) return;
+    int keep = rs->length - first;
+    if (keep > 0) {
+        memmove(rs->hist_l, rs->hist_l + first, sizeof(float) * keep);
+        memmove(rs->hist_r, rs->hist_r + first, sizeof(float) * keep);
+    }
+    rs->length = keep > 0 ? keep : 0;
+    rs->index -= first;
+}
+
+// 現在位置の出力を1フレーム作る
+static void resample_frame(const opm_resampler_t *rs, float *out) {
+    double position = (double)rs->frac * rs->phases / rs->den;
+    int phase = (int)position;
+    float f = (float)(position - phase);
+
+    const float *c = &rs->coeffs[(size_t)phase * rs->taps];
+    const float *d = &rs->deltas[(size_t)phase * rs->taps];
+    const float *xl = &rs->hist_l[rs->index - rs->half + 1];
+    const float *xr = &rs->hist_r[rs->index - rs->half + 1];
+
+    float acc_l[RESAMPLER_LANES] = { 0 };
+    float acc_r[RESAMPLER_LANES] = { 0 };
+    for (int k = 0; k < rs->taps; k += RESAMPLER_LANES) {
+        for (int j = 0; j < RESAMPLER_LANES; j++) {
+            float coeff = c[k + j] + f * d[k + j];
+            acc_l[j] += coeff * xl[k + j];
+            acc_r[j] += coeff * xr[k + j];
+        }
+    }
+
+    float sum_l = 0.0f;
+    float sum_r = 0.0f;
+    for (int j = 0; j < RESAMPLER_LANES; j++) {
+        sum_l += acc_l[j];
+        sum_r += acc_r[j];
+    }
+    out[0] = sum_l;
+    out[1] = sum_r;
+}
+
+int opm_resampler_process(opm_resampler_t *rs, const float *in, int in_frames, float *out, int out_frames) {
+    if (!rs || in_frames < 0 || out_frames < 0) return -1;
+    if (out_frames > OPM_RESAMPLER_MAX_BLOCK) out_frames = OPM_RESAMPLER_MAX_BLOCK;
+
+    if (rs->length + in_frames > rs->capacity) {
+        history_compact(rs);
+        if (rs->length + in_frames > rs->capacity) return -1;
+    }
+    for (int i = 0; i < in_frames; i++) {
+        rs->hist_l[rs->length + i] = in[i * 2 + 0];
+        rs->hist_r[rs->length + i] = in[i * 2 + 1];
+    }
+    rs->length += in_frames;
+
+    int produced = 0;
+    while (produced < out_frames && rs->index + rs->half < rs->length) {
+        resample_frame(rs, &out[produced * 2]);
+        produced++;
+
+        rs->frac += rs->step;
+        rs->index += (int)(rs->frac / rs->den);
+        rs->frac %= rs->den;
+    }
+    return produced;
+}
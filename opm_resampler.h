@@ -0,0 +1,55 @@
+// ポリフェーズ・リサンプラー
+//
+// OPM の出力 (約55930Hz) をデバイスのレート (44100Hz / 48000Hz など) に
+// 変換する。カイザー窓の sinc を位相ごとの係数表にしておき、隣り合う2つの
+// 位相の結果を線形補間する。入出力のレート比は有理数として正確に扱うので、
+// 何時間鳴らしても出力の位置はずれない。
+//
+// ストリーミング用で、入力を少しずつ渡しても一度に渡しても結果は同じ。
+// 出力は入力と時刻がそろう (遅延を補正済み) 代わりに、出力を1フレーム
+// 作るのに opm_resampler_latency() フレーム先の入力まで必要になる。
+#ifndef _OPM_RESAMPLER_H_
+#define _OPM_RESAMPLER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 1回の opm_resampler_process で作れる出力フレーム数の上限
+#define OPM_RESAMPLER_MAX_BLOCK 512
+
+// 入力レート / 出力レートの上限 (これより大きく間引く変換は作れない)
+#define OPM_RESAMPLER_MAX_RATIO 8.0
+
+typedef enum {
+    OPM_RESAMPLE_FAST,    // 24 タップ。阻止域 -60dB
+    OPM_RESAMPLE_MEDIUM,  // 64 タップ。阻止域 -90dB
+    OPM_RESAMPLE_HIGH     // 128 タップ。阻止域 -120dB
+} opm_resample_quality_t;
+
+typedef struct opm_resampler opm_resampler_t;
+
+// ステレオ (インターリーブ float) の in_rate → out_rate 変換を作る。失敗時は NULL
+opm_resampler_t *opm_resampler_create(double in_rate, double out_rate, opm_resample_quality_t quality);
+void opm_resampler_destroy(opm_resampler_t *rs);
+
+// 作ったときの状態 (入力なし、位置 0) に戻す
+void opm_resampler_reset(opm_resampler_t *rs);
+
+// 出力を作るのに必要な先読み (入力フレーム数)
+int opm_resampler_latency(const opm_resampler_t *rs);
+
+// 次の out_frames フレーム (OPM_RESAMPLER_MAX_BLOCK 以下) を作るのに、
+// 追加で渡す必要がある入力フレーム数
+int opm_resampler_input_needed(const opm_resampler_t *rs, int out_frames);
+
+// in (in_frames フレーム) を取り込み、作れた出力を最大 out_frames フレーム
+// out に書く。書いたフレーム数を返す (失敗時は -1)。
+// in_frames は opm_resampler_input_needed(rs, out_frames) 以下であること
+int opm_resampler_process(opm_resampler_t *rs, const float *in, int in_frames, float *out, int out_frames);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,1713 @@
+/* Nuked OPM の複数チップを同時に回すエンジン
+ *
+ * opm.c を構造体の配列 (SoA) に書き直したもの。opm_simd.h を参照。
+ *
+ * 以下の各ステージは opm.c の同名の OPM_* ステージをそのまま書き写したもの。
+ * サイクルごとのスロット / チャンネルの選択は共通のサイクルカウンタだけで決まるので
+ * スカラーのまま、チップごとの演算はレーンのループにしている。途中の変数は参照実装と
+ * 同じ整数型にして、切り捨てや符号拡張がビット単位で一致するようにしている。
+ *
+ * このファイルは Nuked OPM から派生したもので、同じライセンス
+ * (GNU LGPL 2.1 以降) で配布する。opm.h を参照。
+ */
+#include <string.h>
+#include <stdint.h>
+
+/* ROM テーブルとピッチ計算ヘルパーは opm.c のものをそのまま使う */
+#define OPM_VENDOR_PREFIX OPM_SIMD_Ref_
+#include "opm_vendor.h"
+
+#include "opm_simd.h"
+
+#define LANES(l) for ((l) = 0; (l) < OPM_SIMD_LANES; (l)++)
+
+/* レーンごとに持つフィールド (opm_t と同名) */
+#define OPM_SIMD_LANE_FIELDS(X) \
+    X(write_data) X(write_a) X(write_a_en) X(write_d) X(write_d_en) \
+    X(write_busy) X(write_busy_cnt) X(mode_address) X(io_ct1) X(io_ct2) \
+    X(lfo_am_lock) X(lfo_pm_lock) X(lfo_counter1) X(lfo_counter1_of1) \
+    X(lfo_counter1_of2) X(lfo_counter2) X(lfo_counter2_load) \
+    X(lfo_counter2_of) X(lfo_counter2_of_lock) X(lfo_counter2_of_lock2) \
+    X(lfo_counter3_clock) X(lfo_counter3) X(lfo_counter3_step) \
+    X(lfo_frq_update) X(lfo_clock) X(lfo_clock_lock) X(lfo_clock_test) \
+    X(lfo_test) X(lfo_val) X(lfo_val_carry) X(lfo_out1) X(lfo_out2) \
+    X(lfo_out2_b) X(lfo_mult_carry) X(lfo_trig_sign) X(lfo_saw_sign) \
+    X(lfo_bit_counter) X(eg_tl_opp) X(eg_timershift_lock) X(eg_timer_lock) \
+    X(eg_inchi) X(eg_shift) X(eg_clock) X(eg_clockcnt) X(eg_clockquotinent) \
+    X(eg_inc) X(eg_instantattack) X(eg_inclinear) X(eg_incattack) X(eg_mute) \
+    X(eg_am) X(eg_timercarry) X(eg_timer) X(eg_timer2) X(eg_timerbstop) \
+    X(eg_serial) X(eg_serial_bit) X(eg_test) X(pg_serial) X(pg_opp_pms) \
+    X(op_phase_in) X(op_mod_in) X(op_phase) X(op_atten) X(op_sign) \
+    X(op_connect) X(op_mixl) X(op_mixr) X(op_opp_rl) X(mix_op) X(mix_bits) \
+    X(mix_top_bits_lock) X(mix_sign_lock) X(mix_sign_lock2) X(mix_exp_lock) \
+    X(mix_out_bit) X(smp_so) X(noise_lfsr) X(noise_timer) X(noise_timer_of) \
+    X(noise_update) X(noise_bit) X(mode_kon_channel) X(reg_address) \
+    X(reg_address_ready) X(reg_data) X(reg_data_ready) X(noise_en) \
+    X(noise_freq) X(reg_20_delay) X(reg_28_delay) X(reg_30_delay) \
+    X(timer_a_reg) X(timer_b_reg) X(timer_a_temp) X(timer_a_do_reset) \
+    X(timer_a_do_load) X(timer_a_inc) X(timer_a_val) X(timer_a_of) \
+    X(timer_a_load) X(timer_a_status) X(timer_b_inc) X(timer_b_val) \
+    X(timer_b_of) X(timer_b_do_reset) X(timer_b_do_load) X(timer_b_temp) \
+    X(timer_b_status) X(timer_irq) X(lfo_freq_hi) X(lfo_freq_lo) X(lfo_pmd) \
+    X(lfo_amd) X(lfo_wave) X(timer_irqa) X(timer_irqb) X(timer_loada) \
+    X(timer_loadb) X(timer_reseta) X(timer_resetb) X(mode_csm) X(nc_active) \
+    X(nc_active_lock) X(nc_sign) X(nc_sign_lock) X(nc_sign_lock2) X(nc_bit) \
+    X(nc_out) X(op_mix) X(kon_csm) X(kon_csm_lock) X(kon_do) \
+    X(kon_chanmatch) X(dac_bits)
+
+/* スロット/チャンネル配列 ([n][lane]) のフィールド。op_m1 は別扱い */
+#define OPM_SIMD_SLOT_FIELDS(X) \
+    X(eg_state) X(eg_level) X(eg_rate) X(eg_sl) X(eg_tl) X(eg_zr) \
+    X(eg_ratemax) X(eg_outtemp) X(eg_out) X(eg_ams) X(pg_fnum) X(pg_kcode) \
+    X(pg_inc) X(pg_phase) X(pg_reset) X(pg_reset_latch) X(pg_opp_dt2) \
+    X(op_logsin) X(op_exp) X(op_pow) X(op_out) X(op_modtable) X(op_c1) \
+    X(op_mod) X(op_fb) X(op_opp_fb) X(mix) X(mix2) X(mix_serial) \
+    X(mix_clamp_low) X(mix_clamp_high) X(mode_test) X(mode_kon_operator) \
+    X(ch_rl) X(ch_fb) X(ch_connect) X(ch_kc) X(ch_kf) X(ch_pms) X(ch_ams) \
+    X(sl_dt1) X(sl_mul) X(sl_tl) X(sl_ks) X(sl_ar) X(sl_am_e) X(sl_d1r) \
+    X(sl_dt2) X(sl_d2r) X(sl_d1l) X(sl_rr) X(ch_ramp_div) X(opp_tl_cnt) \
+    X(opp_tl) X(kon) X(kon2) X(mode_kon) X(dac_output)
+
+/* 全レーン共通のフィールド。cycles と IC の履歴だけで決まる */
+#define OPM_SIMD_UNIFORM_FIELDS(X) \
+    X(cycles) X(ic) X(ic2) X(opp) X(op_counter) X(op_fbupdate) \
+    X(op_fbshift) X(op_c1update) X(smp_sh1) X(smp_sh2) X(timer_b_sub) \
+    X(timer_b_sub_of) X(dac_osh1) X(dac_osh2)
+
+/* OPM_CalcKCode を分岐なし (選択のみ) で書き直したもの */
+static inline int32_t OPM_SIMD_CalcKCode(int32_t kcf, int32_t lfo, int32_t lfo_sign, int32_t dt)
+{
+    int32_t t2, t3, b0, b1, b2, b3, w2, w3, w6;
+    int32_t overflow1, overflow2, negoverflow;
+    int32_t sum, cr;
+    int32_t neg = !lfo_sign;
+    lfo = neg ? ~lfo : lfo;
+    sum = (kcf & 8191) + (lfo & 8191) + neg;
+    cr = ((kcf & 255) + (lfo & 255) + neg) >> 8;
+    overflow1 = (sum >> 13) & 1;
+    sum &= 8191;
+    sum += (lfo_sign && ((((sum >> 6) & 3) == 3) || cr)) ? 64 : 0;
+    negoverflow = neg && !cr;
+    sum += negoverflow ? ((-64) & 8191) : 0;
+    overflow2 = (sum >> 13) & 1;
+    sum &= 8191;
+    sum = ((neg && !overflow1) || (negoverflow && !overflow2)) ? 0 : sum;
+    sum = (lfo_sign && (overflow1 || overflow2)) ? 8127 : sum;
+
+    t2 = (sum & 63) + (dt == 2 ? 20 : 0) + ((dt == 2 || dt == 3) ? 32 : 0);
+
+    b0 = (t2 >> 6) & 1;
+    b1 = dt == 2;
+    b2 = ((sum >> 6) & 1);
+    b3 = ((sum >> 7) & 1);
+
+    w2 = (b0 && b1 && b2);
+    w3 = (b0 && b3);
+    w6 = (b0 && !w2 && !w3) || (b3 && !b0 && b1);
+
+    t2 &= 63;
+
+    t3 = (sum >> 6) + w6 + b1 + (w2 || w3) * 2 + (dt == 3) * 4 + (dt != 0) * 8;
+    t2 = (t3 & 128) ? 63 : t2;
+    t3 = (t3 & 128) ? 126 : t3;
+    return t3 * 64 + t2;
+}
+
+static void OPM_SIMD_PhaseCalcFNumBlock(opm_simd_t *chip)
+{
+    uint32_t slot = (chip->cycles + 7) & 31;
+    uint32_t channel = slot & 7;
+    uint8_t opp = chip->opp;
+    /* 表引き (ギャザー) と uint8_t へのストアが同じループにあると別名解析で
+     * ベクタ化できないので、結果はローカル配列に置いてからまとめて書き込む */
+    uint16_t fnum[OPM_SIMD_LANES];
+    uint8_t kcode_h[OPM_SIMD_LANES];
+    uint32_t l;
+    LANES(l)
+    {
+        uint32_t kcf = (chip->ch_kc[channel][l] << 6) + chip->ch_kf[channel][l];
+        uint32_t pm_lock = chip->lfo_pm_lock[l];
+        uint32_t pms_opp = chip->pg_opp_pms[l];
+        uint32_t pms_opm = chip->ch_pms[channel][l];
+        uint32_t dt_opp = chip->pg_opp_dt2[slot][l];
+        uint32_t dt_opm = chip->sl_dt2[slot][l];
+        uint32_t pmd = chip->lfo_pmd[l];
+        uint32_t lfo = pmd ? pm_lock : 0;
+        uint32_t pms = opp ? pms_opp : pms_opm;
+        uint32_t dt = opp ? dt_opp : dt_opm;
+        int32_t lfo_pm = chip->tab_pms[pms * 128 + (lfo & 127)];
+        uint32_t lfo_sign = (lfo & 0x80) != 0 && pms != 0 ? 0 : 1;
+        uint32_t kcode = OPM_SIMD_CalcKCode(kcf, lfo_pm, lfo_sign, dt);
+        fnum[l] = chip->tab_fnum[kcode & 1023];
+        kcode_h[l] = kcode >> 8;
+    }
+    memcpy(chip->pg_fnum[slot], fnum, sizeof(fnum));
+    memcpy(chip->pg_kcode[slot], kcode_h, sizeof(kcode_h));
+
+    if (chip->opp)
+    {
+        uint32_t slot = chip->cycles & 31;
+        uint32_t channel = slot & 7;
+        LANES(l)
+        {
+            chip->pg_opp_pms[l] = chip->ch_pms[channel][l];
+            chip->pg_opp_dt2[slot][l] = chip->sl_dt2[slot][l];
+        }
+    }
+}
+
+static void OPM_SIMD_PhaseCalcIncrement(opm_simd_t *chip)
+{
+    uint32_t slot = chip->cycles;
+    /* 書き込み先は行ポインタ経由にする。chip->pg_inc[slot][l] と直接書くと
+     * gcc 12 の -O1 以上で IV 最適化後のアドレスが NULL 基底と判定され、
+     * 関数ごと pure 扱いされて呼び出しが消える */
+    uint32_t *pg_inc = chip->pg_inc[slot];
+    uint32_t l;
+    LANES(l)
+    {
+        uint32_t dt = chip->sl_dt1[slot][l];
+        uint32_t dt_l = dt & 3;
+        uint32_t multi = chip->sl_mul[slot][l];
+        uint32_t kcode = chip->pg_kcode[slot][l];
+        uint32_t fnum = chip->pg_fnum[slot][l];
+        uint32_t block = kcode >> 2;
+        uint32_t basefreq = (fnum << block) >> 2;
+        uint32_t note, sum, sum_h, sum_l, detune, inc;
+        /* Apply detune */
+        kcode = kcode > 0x1c ? 0x1c : kcode;
+        block = kcode >> 2;
+        note = kcode & 0x03;
+        sum = block + 9 + ((dt_l == 3) | (dt_l & 0x02));
+        sum_h = sum >> 1;
+        sum_l = sum & 0x01;
+        detune = dt_l ? pg_detune[(sum_l << 2) | note] >> (9 - sum_h) : 0;
+        basefreq = (dt & 0x04) ? basefreq - detune : basefreq + detune;
+        basefreq &= 0x1ffff;
+        inc = multi ? basefreq * multi : basefreq >> 1;
+        inc &= 0xfffff;
+        pg_inc[l] = inc;
+    }
+}
+
+static void OPM_SIMD_PhaseGenerate(opm_simd_t *chip)
+{
+    uint32_t slot = (chip->cycles + 27) & 31;
+    uint32_t slot_inc = (chip->cycles + 25) & 31;
+    uint32_t slot_step = (chip->cycles + 24) & 31;
+    uint32_t l;
+    memcpy(chip->pg_reset_latch[slot], chip->pg_reset[slot], sizeof(chip->pg_reset_latch[0]));
+    LANES(l)
+    {
+        /* Mask increment */
+        uint32_t inc = chip->pg_reset_latch[slot_inc][l] ? 0 : chip->pg_inc[slot_inc][l];
+        /* Phase step */
+        uint32_t phase = chip->pg_phase[slot_step][l];
+        phase = (chip->pg_reset_latch[slot_step][l] || chip->mode_test[3][l]) ? 0 : phase;
+        phase += chip->pg_inc[slot_step][l];
+        chip->pg_inc[slot_inc][l] = inc;
+        chip->pg_phase[slot_step][l] = phase & 0xfffff;
+    }
+}
+
+static void OPM_SIMD_PhaseDebug(opm_simd_t *chip)
+{
+    uint32_t l;
+    LANES(l)
+    {
+        chip->pg_serial[l] >>= 1;
+    }
+    if (chip->cycles == 5)
+    {
+        LANES(l)
+        {
+            chip->pg_serial[l] |= (chip->pg_phase[29][l] & 0x3ff);
+        }
+    }
+}
+
+static void OPM_SIMD_KeyOn1(opm_simd_t *chip)
+{
+    uint32_t cycles = (chip->cycles + 1) & 31;
+    uint32_t l;
+    LANES(l)
+    {
+        chip->kon_chanmatch[l] = chip->mode_kon_channel[l] + 24u == cycles;
+    }
+}
+
+static void OPM_SIMD_KeyOn2(opm_simd_t *chip)
+{
+    uint32_t slot = (chip->cycles + 8) & 31;
+    uint32_t l;
+    LANES(l)
+    {
+        uint8_t match = chip->kon_chanmatch[l];
+        chip->mode_kon[(slot + 0) & 31][l] = match ? chip->mode_kon_operator[0][l] : chip->mode_kon[(slot + 0) & 31][l];
+        chip->mode_kon[(slot + 8) & 31][l] = match ? chip->mode_kon_operator[2][l] : chip->mode_kon[(slot + 8) & 31][l];
+        chip->mode_kon[(slot + 16) & 31][l] = match ? chip->mode_kon_operator[1][l] : chip->mode_kon[(slot + 16) & 31][l];
+        chip->mode_kon[(slot + 24) & 31][l] = match ? chip->mode_kon_operator[3][l] : chip->mode_kon[(slot + 24) & 31][l];
+    }
+}
+
+static void OPM_SIMD_EnvelopePhase1(opm_simd_t *chip)
+{
+    uint32_t slot = (chip->cycles + 2) & 31;
+    uint32_t l;
+    LANES(l)
+    {
+        uint32_t kon = chip->mode_kon[slot][l] | chip->kon_csm[l];
+        chip->kon2[slot][l] = chip->kon[slot][l];
+        chip->kon[slot][l] = kon;
+    }
+}
+
+static void OPM_SIMD_EnvelopePhase2(opm_simd_t *chip)
+{
+    uint32_t slot = chip->cycles;
+    uint32_t chan = slot & 7;
+    uint32_t slot_opp = (chip->cycles + 30) & 31;
+    uint8_t ic = chip->ic;
+    uint32_t l;
+    LANES(l)
+    {
+        uint8_t rate, ksv, zr, ams;
+        uint8_t ks = chip->sl_ks[slot][l];
+        uint8_t sel = chip->eg_state[slot][l];
+        sel = (chip->kon[slot][l] && !chip->kon2[slot][l]) ? eg_num_attack : sel;
+        rate = sel == eg_num_attack ? chip->sl_ar[slot][l]
+             : sel == eg_num_decay ? chip->sl_d1r[slot][l]
+             : sel == eg_num_sustain ? chip->sl_d2r[slot][l]
+             : chip->sl_rr[slot][l] * 2 + 1;
+        rate = ic ? 31 : rate;
+
+        zr = rate == 0;
+
+        ksv = chip->pg_kcode[slot][l] >> (ks ^ 3);
+        ksv = (ks == 0 && zr) ? ksv & ~3 : ksv;
+        rate = rate * 2 + ksv;
+        rate = (rate & 64) ? 63 : rate;
+
+        chip->eg_sl[1][l] = chip->eg_sl[0][l];
+        chip->eg_sl[0][l] = chip->sl_d1l[slot][l] == 15 ? 31 : chip->sl_d1l[slot][l];
+        chip->eg_zr[1][l] = chip->eg_zr[0][l];
+        chip->eg_zr[0][l] = zr;
+        chip->eg_rate[1][l] = chip->eg_rate[0][l];
+        chip->eg_rate[0][l] = rate;
+        chip->eg_ratemax[1][l] = chip->eg_ratemax[0][l];
+        chip->eg_ratemax[0][l] = (rate >> 1) == 31;
+        ams = chip->sl_am_e[slot][l] ? chip->ch_ams[chan][l] : 0;
+        chip->eg_am[l] = ams == 0 ? 0 : chip->lfo_am_lock[l] << (ams - 1);
+    }
+
+    if (chip->opp)
+    {
+        LANES(l)
+        {
+            chip->eg_tl_opp[l] = chip->opp_tl[slot_opp][l];
+        }
+    }
+    else
+    {
+        memcpy(chip->eg_tl[2], chip->eg_tl[1], sizeof(chip->eg_tl[0]));
+        memcpy(chip->eg_tl[1], chip->eg_tl[0], sizeof(chip->eg_tl[0]));
+        memcpy(chip->eg_tl[0], chip->sl_tl[slot], sizeof(chip->eg_tl[0]));
+    }
+}
+
+static void OPM_SIMD_EnvelopePhase3(opm_simd_t *chip)
+{
+    uint32_t slot = (chip->cycles + 31) & 31;
+    const uint32_t *stephi = &eg_stephi[0][0];
+    uint32_t l;
+    LANES(l)
+    {
+        uint16_t outtemp;
+        chip->eg_shift[l] = (chip->eg_timershift_lock[l] + (chip->eg_rate[0][l] >> 2)) & 15;
+        chip->eg_inchi[l] = stephi[(chip->eg_rate[0][l] & 3) * 4 + (chip->eg_timer_lock[l] & 3)];
+
+        chip->eg_outtemp[1][l] = chip->eg_outtemp[0][l];
+        outtemp = chip->eg_level[slot][l] + chip->eg_am[l];
+        chip->eg_outtemp[0][l] = (outtemp & 1024) ? 1023 : outtemp;
+    }
+}
+
+static void OPM_SIMD_EnvelopePhase4(opm_simd_t *chip)
+{
+    uint32_t slot = (chip->cycles + 30) & 31;
+    uint8_t ic = chip->ic;
+    uint32_t l;
+    LANES(l)
+    {
+        uint8_t inc, inc_hi, inc_lo;
+        uint8_t kon, eg_off, eg_zero, slreach, state, inclinear;
+        uint8_t rate = chip->eg_rate[1][l];
+        uint8_t shift = chip->eg_shift[l];
+        uint8_t ratemax = chip->eg_ratemax[1][l];
+        uint8_t kon_cur = chip->kon[slot][l];
+        uint16_t level = chip->eg_level[slot][l];
+
+        inc_hi = chip->eg_inchi[l] + (rate >> 2) - 11;
+        inc_hi = inc_hi > 4 ? 4 : inc_hi;
+        inc_lo = shift == 12 ? rate != 0
+               : shift == 13 ? (rate >> 1) & 1
+               : shift == 14 ? rate & 1
+               : 0;
+        inc_lo = chip->eg_zr[1][l] ? 0 : inc_lo;
+        inc = rate >= 48 ? inc_hi : inc_lo;
+        chip->eg_inc[l] = (chip->eg_clock[l] & 2) ? inc : 0;
+
+        kon = kon_cur && !chip->kon2[slot][l];
+        chip->pg_reset[slot][l] = kon;
+        chip->eg_instantattack[l] = ratemax && (kon || !ratemax);
+
+        eg_off = (level & 0x3f0) == 0x3f0;
+        slreach = (level >> 4) == (chip->eg_sl[1][l] << 1);
+        eg_zero = level == 0;
+
+        state = chip->eg_state[slot][l];
+        chip->eg_mute[l] = eg_off && state != eg_num_attack && !kon;
+        inclinear = (state == eg_num_decay && !slreach)
+            || state == eg_num_sustain || state == eg_num_release;
+        chip->eg_inclinear[l] = inclinear && !kon && !eg_off;
+        chip->eg_incattack[l] = state == eg_num_attack && !ratemax && kon_cur && !eg_zero;
+
+        // Update state (優先順位の低い遷移から順に上書きする)
+        state = (state == eg_num_attack && eg_zero) ? eg_num_decay
+              : (state == eg_num_decay && !eg_off && slreach) ? eg_num_sustain
+              : ((state == eg_num_decay || state == eg_num_sustain) && eg_off) ? eg_num_release
+              : state;
+        state = !kon_cur ? eg_num_release : state;
+        state = kon ? eg_num_attack : state;
+        state = ic ? eg_num_release : state;
+        chip->eg_state[slot][l] = state;
+    }
+}
+
+static void OPM_SIMD_EnvelopePhase5(opm_simd_t *chip)
+{
+    uint32_t slot = (chip->cycles + 29) & 31;
+    uint8_t ic = chip->ic;
+    uint8_t opp = chip->opp;
+    uint32_t l;
+    LANES(l)
+    {
+        uint32_t level = chip->eg_level[slot][l];
+        uint32_t step_linear, step_attack;
+        uint8_t inc = chip->eg_inc[l];
+        uint16_t out;
+        step_linear = (inc && chip->eg_inclinear[l]) ? 1 << (inc - 1) : 0;
+        step_attack = (inc && chip->eg_incattack[l]) ? ((~(int32_t)level) << inc) >> 5 : 0;
+        level = chip->eg_instantattack[l] ? 0 : level;
+        level = (chip->eg_mute[l] || ic) ? 0x3ff : level;
+        level += step_linear | step_attack;
+        chip->eg_level[slot][l] = (uint16_t)level;
+
+        out = chip->eg_outtemp[1][l];
+        out += opp ? chip->eg_tl_opp[l] : chip->eg_tl[2][l] << 3;
+        out = (out & 1024) ? 1023 : out;
+        out = chip->eg_test[l] ? 0 : out;
+        chip->eg_out[0][l] = out;
+
+        chip->eg_test[l] = chip->mode_test[5][l];
+    }
+}
+
+static void OPM_SIMD_EnvelopePhase6(opm_simd_t *chip)
+{
+    uint32_t l;
+    LANES(l)
+    {
+        chip->eg_serial_bit[l] = (chip->eg_serial[l] >> 9) & 1;
+    }
+    if (chip->cycles == 3)
+    {
+        LANES(l)
+        {
+            chip->eg_serial[l] = chip->eg_out[0][l] ^ 1023;
+        }
+    }
+    else
+    {
+        LANES(l)
+        {
+            chip->eg_serial[l] <<= 1;
+        }
+    }
+    LANES(l)
+    {
+        chip->eg_out[1][l] = chip->eg_out[0][l];
+    }
+}
+
+static void OPM_SIMD_EnvelopeClock(opm_simd_t *chip)
+{
+    uint8_t ic = chip->ic;
+    uint8_t last = chip->cycles == 31;
+    uint32_t l;
+    LANES(l)
+    {
+        uint8_t cnt = chip->eg_clockcnt[l];
+        chip->eg_clock[l] = (chip->eg_clock[l] << 1) | ((cnt & 2) != 0 || chip->mode_test[0][l]);
+        chip->eg_clockcnt[l] = (ic || (last && (cnt & 2) != 0)) ? 0 : cnt + last;
+    }
+}
+
+static void OPM_SIMD_EnvelopeTimer(opm_simd_t *chip)
+{
+    uint32_t cycle = (chip->cycles + 31) & 15;
+    uint32_t cycle2 = (chip->cycles + 30) & 15;
+    uint8_t inc_window = ((chip->cycles + 31) & 31) < 16;
+    uint8_t ic = chip->ic;
+    uint8_t stop_clear = cycle == 0 || chip->ic2;
+    uint32_t l;
+    LANES(l)
+    {
+        uint8_t inc = inc_window && (chip->eg_clock[l] & 1) != 0 && (cycle == 0 || chip->eg_timercarry[l]);
+        uint8_t timerbit = (chip->eg_timer[l] >> cycle) & 1;
+        uint8_t sum = timerbit + inc;
+        uint8_t sum0 = (sum & 1) && !ic;
+        uint8_t stop = chip->eg_timerbstop[l];
+        uint32_t timer;
+        uint8_t bit2;
+        chip->eg_timercarry[l] = sum >> 1;
+        timer = (chip->eg_timer[l] & (~(1 << cycle))) | (sum0 << cycle);
+        chip->eg_timer[l] = timer;
+
+        bit2 = (timer & (1 << cycle2)) != 0;
+        chip->eg_timer2[l] = (chip->eg_timer2[l] << 1) | (bit2 && !stop);
+        stop = bit2 ? 1 : stop;
+        chip->eg_timerbstop[l] = stop_clear ? 0 : stop;
+    }
+
+    if (chip->cycles == 1)
+    {
+        LANES(l)
+        {
+            uint32_t timer2 = chip->eg_timer2[l];
+            uint8_t clock = (chip->eg_clock[l] & 1) != 0;
+            uint8_t lock = 0;
+            lock |= (timer2 & (8 + 32 + 128 + 512 + 2048 + 8192 + 32768)) ? 1 : 0;
+            lock |= (timer2 & (4 + 32 + 64 + 512 + 1024 + 8192 + 16384)) ? 2 : 0;
+            lock |= (timer2 & (4 + 8 + 16 + 512 + 1024 + 2048 + 4096)) ? 4 : 0;
+            lock |= (timer2 & (4 + 8 + 16 + 32 + 64 + 128 + 256)) ? 8 : 0;
+            chip->eg_timershift_lock[l] = clock ? lock : chip->eg_timershift_lock[l];
+            chip->eg_timer_lock[l] = clock ? (uint8_t)chip->eg_timer[l] : chip->eg_timer_lock[l];
+        }
+    }
+}
+
+static void OPM_SIMD_OperatorPhase1(opm_simd_t *chip)
+{
+    uint32_t slot = chip->cycles;
+    uint32_t l;
+    LANES(l)
+    {
+        chip->op_phase_in[l] = chip->pg_phase[slot][l] >> 10;
+    }
+    if (chip->op_fbshift & 8)
+    {
+        LANES(l)
+        {
+            int16_t mod = chip->op_mod[2][l];
+            int16_t fb = chip->op_fb[1][l];
+            chip->op_mod_in[l] = fb == 0 ? 0 : mod >> (9 - fb);
+        }
+    }
+    else
+    {
+        LANES(l)
+        {
+            chip->op_mod_in[l] = chip->op_mod[2][l];
+        }
+    }
+}
+
+static void OPM_SIMD_OperatorPhase2(opm_simd_t *chip)
+{
+    uint32_t l;
+    LANES(l)
+    {
+        chip->op_phase[l] = (chip->op_phase_in[l] + chip->op_mod_in[l]) & 1023;
+    }
+}
+
+static void OPM_SIMD_OperatorPhase3(opm_simd_t *chip)
+{
+    uint32_t l;
+    LANES(l)
+    {
+        uint16_t phase = chip->op_phase[l] & 255;
+        phase = (chip->op_phase[l] & 256) ? phase ^ 255 : phase;
+        chip->op_logsin[0][l] = chip->tab_logsin[phase];
+        chip->op_sign[l] = (chip->op_sign[l] << 1) | ((chip->op_phase[l] >> 9) & 1);
+    }
+}
+
+static void OPM_SIMD_OperatorPhase4(opm_simd_t *chip)
+{
+    memcpy(chip->op_logsin[1], chip->op_logsin[0], sizeof(chip->op_logsin[0]));
+}
+
+static void OPM_SIMD_OperatorPhase5(opm_simd_t *chip)
+{
+    memcpy(chip->op_logsin[2], chip->op_logsin[1], sizeof(chip->op_logsin[0]));
+}
+
+static void OPM_SIMD_OperatorPhase6(opm_simd_t *chip)
+{
+    uint32_t l;
+    LANES(l)
+    {
+        uint16_t atten = chip->op_logsin[2][l] + (chip->eg_out[1][l] << 2);
+        chip->op_atten[l] = (atten & 4096) ? 4095 : atten;
+    }
+}
+
+static void OPM_SIMD_OperatorPhase7(opm_simd_t *chip)
+{
+    uint32_t l;
+    LANES(l)
+    {
+        chip->op_exp[0][l] = chip->tab_exp[chip->op_atten[l] & 255];
+        chip->op_pow[0][l] = chip->op_atten[l] >> 8;
+    }
+}
+
+static void OPM_SIMD_OperatorPhase8(opm_simd_t *chip)
+{
+    memcpy(chip->op_exp[1], chip->op_exp[0], sizeof(chip->op_exp[0]));
+    memcpy(chip->op_pow[1], chip->op_pow[0], sizeof(chip->op_pow[0]));
+}
+
+static void OPM_SIMD_OperatorPhase9(opm_simd_t *chip)
+{
+    uint8_t opp = chip->opp;
+    uint32_t l;
+    LANES(l)
+    {
+        int16_t out = (chip->op_exp[1][l] << 2) >> (chip->op_pow[1][l]);
+        out |= (!opp && chip->mode_test[4][l]) ? 0x2000 : 0;
+        chip->op_out[0][l] = out;
+    }
+}
+
+static void OPM_SIMD_OperatorPhase10(opm_simd_t *chip)
+{
+    uint32_t l;
+    LANES(l)
+    {
+        int16_t out = chip->op_out[0][l];
+        int16_t neg = ((out ^ 0x3fff) + 1) & 0x3fff;
+        out = (chip->op_sign[l] & 64) ? neg : out;
+        out <<= 2; out >>= 2;
+        chip->op_out[1][l] = out;
+    }
+}
+
+static void OPM_SIMD_OperatorPhase11(opm_simd_t *chip)
+{
+    memcpy(chip->op_out[2], chip->op_out[1], sizeof(chip->op_out[0]));
+}
+
+static void OPM_SIMD_OperatorPhase12(opm_simd_t *chip)
+{
+    memcpy(chip->op_out[3], chip->op_out[2], sizeof(chip->op_out[0]));
+}
+
+static void OPM_SIMD_OperatorPhase13(opm_simd_t *chip)
+{
+    uint32_t slot = (chip->cycles + 20) & 31;
+    uint32_t channel = slot & 7;
+    uint32_t l;
+    memcpy(chip->op_out[4], chip->op_out[3], sizeof(chip->op_out[0]));
+    LANES(l)
+    {
+        chip->op_connect[l] = chip->ch_connect[channel][l];
+    }
+    if (chip->opp)
+    {
+        memcpy(chip->op_opp_rl, chip->ch_rl[channel], sizeof(chip->op_opp_rl));
+        memcpy(chip->op_opp_fb[2], chip->op_opp_fb[1], sizeof(chip->op_opp_fb[0]));
+        memcpy(chip->op_opp_fb[1], chip->op_opp_fb[0], sizeof(chip->op_opp_fb[0]));
+        memcpy(chip->op_opp_fb[0], chip->ch_fb[channel], sizeof(chip->op_opp_fb[0]));
+    }
+}
+
+static void OPM_SIMD_OperatorPhase14(opm_simd_t *chip)
+{
+    uint32_t slot = (chip->cycles + 19) & 31;
+    uint32_t channel = slot & 7;
+    const uint32_t (*mod_alg)[8] = fm_algorithm[(chip->op_counter + 2) & 3];
+    const uint32_t *out_alg = fm_algorithm[chip->op_counter][5];
+    const uint8_t *ch_rl = chip->opp ? chip->op_opp_rl : chip->ch_rl[channel];
+    uint32_t l;
+    memcpy(chip->op_out[5], chip->op_out[4], sizeof(chip->op_out[0]));
+    memcpy(chip->op_mix, chip->op_out[4], sizeof(chip->op_mix));
+    chip->op_fbupdate = (chip->op_counter == 0);
+    chip->op_c1update = (chip->op_counter == 2);
+    chip->op_fbshift <<= 1;
+    chip->op_fbshift |= (chip->op_counter == 2);
+
+    LANES(l)
+    {
+        uint32_t connect = chip->op_connect[l];
+        uint8_t rl = ch_rl[l];
+        uint8_t out = out_alg[connect] != 0;
+        chip->op_modtable[0][l] = mod_alg[0][connect];
+        chip->op_modtable[1][l] = mod_alg[1][connect];
+        chip->op_modtable[2][l] = mod_alg[2][connect];
+        chip->op_modtable[3][l] = mod_alg[3][connect];
+        chip->op_modtable[4][l] = mod_alg[4][connect];
+        chip->op_mixl[l] = out & rl;
+        chip->op_mixr[l] = out & (rl >> 1);
+    }
+}
+
+static void OPM_SIMD_OperatorPhase15(opm_simd_t *chip)
+{
+    uint32_t slot = (chip->cycles + 18) & 31;
+    uint32_t ch = slot & 7;
+    uint32_t l;
+    LANES(l)
+    {
+        int16_t mod1, mod2;
+        int16_t out = chip->op_out[5][l];
+        mod2 = (chip->op_modtable[0][l] ? chip->op_m1[ch * 2 + 0][l] : 0)
+             | (chip->op_modtable[3][l] ? out : 0);
+        mod1 = (chip->op_modtable[1][l] ? chip->op_m1[ch * 2 + 1][l] : 0)
+             | (chip->op_modtable[2][l] ? chip->op_c1[ch][l] : 0)
+             | (chip->op_modtable[4][l] ? out : 0);
+        chip->op_mod[0][l] = (mod1 + mod2) >> 1;
+    }
+    if (chip->op_fbupdate)
+    {
+        memcpy(chip->op_m1[ch * 2 + 1], chip->op_m1[ch * 2 + 0], sizeof(chip->op_m1[0]));
+        memcpy(chip->op_m1[ch * 2 + 0], chip->op_out[5], sizeof(chip->op_m1[0]));
+    }
+    if (chip->op_c1update)
+    {
+        memcpy(chip->op_c1[ch], chip->op_out[5], sizeof(chip->op_c1[0]));
+    }
+}
+
+static void OPM_SIMD_OperatorPhase16(opm_simd_t *chip)
+{
+    uint32_t slot = (chip->cycles + 17) & 31;
+    const uint8_t *fb = chip->opp ? chip->op_opp_fb[2] : chip->ch_fb[slot & 7];
+    uint32_t l;
+    // hack
+    memcpy(chip->op_mod[2], chip->op_mod[1], sizeof(chip->op_mod[0]));
+    memcpy(chip->op_fb[1], chip->op_fb[0], sizeof(chip->op_fb[0]));
+
+    memcpy(chip->op_mod[1], chip->op_mod[0], sizeof(chip->op_mod[0]));
+    LANES(l)
+    {
+        chip->op_fb[0][l] = fb[l];
+    }
+}
+
+static void OPM_SIMD_OperatorCounter(opm_simd_t *chip)
+{
+    if ((chip->cycles & 7) == 4)
+    {
+        chip->op_counter++;
+    }
+    if (chip->cycles == 12)
+    {
+        chip->op_counter = 0;
+    }
+}
+
+static void OPM_SIMD_Mixer2(opm_simd_t *chip)
+{
+    uint32_t cycles = (chip->cycles + 30) & 31;
+    uint32_t phase = chip->cycles & 15;
+    const uint32_t *serial = chip->mix_serial[cycles < 16 ? 0 : 1];
+    uint32_t l;
+    if (phase == 1)
+    {
+        LANES(l)
+        {
+            chip->mix_sign_lock[l] = (serial[l] & 1) ^ 1;
+            chip->mix_top_bits_lock[l] = (chip->mix_bits[l] >> 15) & 63;
+        }
+    }
+    if (phase == 7)
+    {
+        LANES(l)
+        {
+            uint8_t top = chip->mix_top_bits_lock[l];
+            top = chip->mix_sign_lock[l] ? top ^ 63 : top;
+            chip->mix_sign_lock2[l] = chip->mix_sign_lock[l];
+            chip->mix_exp_lock[l] = (top & 32) ? 7
+                                  : (top & 16) ? 6
+                                  : (top & 8) ? 5
+                                  : (top & 4) ? 4
+                                  : (top & 2) ? 3
+                                  : (top & 1) ? 2
+                                  : 1;
+        }
+    }
+    /* 出力ビットの選択は phase だけで決まるのでループの外で分ける */
+    if (phase == 0)
+    {
+        LANES(l)
+        {
+            chip->mix_out_bit[l] = (chip->mix_out_bit[l] << 1) | (chip->mix_sign_lock2[l] ^ 1);
+        }
+    }
+    else if (phase <= 3)
+    {
+        LANES(l)
+        {
+            chip->mix_out_bit[l] = (chip->mix_out_bit[l] << 1) | ((chip->mix_exp_lock[l] >> (phase - 1)) & 1);
+        }
+    }
+    else
+    {
+        LANES(l)
+        {
+            uint8_t ex = chip->mix_exp_lock[l];
+            uint8_t bit = ex ? (chip->mix_bits[l] >> (ex - 1)) & 1 : 0;
+            chip->mix_out_bit[l] = (chip->mix_out_bit[l] << 1) | bit;
+        }
+    }
+    LANES(l)
+    {
+        chip->mix_bits[l] = (chip->mix_bits[l] >> 1) | ((serial[l] & 1) << 20);
+    }
+}
+
+static void OPM_SIMD_Output(opm_simd_t *chip)
+{
+    uint32_t slot = (chip->cycles + 27) & 31;
+    uint32_t l;
+    LANES(l)
+    {
+        chip->smp_so[l] = (chip->mix_out_bit[l] & 1) != 0;
+    }
+    chip->smp_sh1 = (slot & 24) == 8 && !chip->ic;
+    chip->smp_sh2 = (slot & 24) == 24 && !chip->ic;
+}
+
+static void OPM_SIMD_DAC(opm_simd_t *chip)
+{
+    uint32_t l;
+    if (chip->dac_osh1 && !chip->smp_sh1)
+    {
+        LANES(l)
+        {
+            int32_t exp = (chip->dac_bits[l] >> 10) & 7;
+            int32_t mant = (chip->dac_bits[l] >> 0) & 1023;
+            mant -= 512;
+            chip->dac_output[1][l] = (mant << exp) >> 1;
+        }
+    }
+    if (chip->dac_osh2 && !chip->smp_sh2)
+    {
+        LANES(l)
+        {
+            int32_t exp = (chip->dac_bits[l] >> 10) & 7;
+            int32_t mant = (chip->dac_bits[l] >> 0) & 1023;
+            mant -= 512;
+            chip->dac_output[0][l] = (mant << exp) >> 1;
+        }
+    }
+    LANES(l)
+    {
+        chip->dac_bits[l] = (chip->dac_bits[l] >> 1) | (chip->smp_so[l] << 12);
+    }
+    chip->dac_osh1 = chip->smp_sh1;
+    chip->dac_osh2 = chip->smp_sh2;
+}
+
+/* OPM_Mixer の片チャンネル分。ch=1 が R (cycles 13/14)、ch=0 が L (29/30) */
+static void OPM_SIMD_MixerSerial(opm_simd_t *chip, uint32_t ch, uint32_t load_cycle)
+{
+    uint32_t l;
+    LANES(l)
+    {
+        chip->mix_serial[ch][l] >>= 1;
+    }
+    if (chip->cycles == load_cycle)
+    {
+        LANES(l)
+        {
+            chip->mix_serial[ch][l] |= (chip->mix[ch][l] & 1023) << 4;
+        }
+    }
+    if (chip->cycles == load_cycle + 1)
+    {
+        LANES(l)
+        {
+            int32_t mix2 = chip->mix2[ch][l];
+            uint32_t top = (mix2 >> 15) & 7;
+            chip->mix_serial[ch][l] |= ((mix2 >> 10) & 31) << 13;
+            chip->mix_serial[ch][l] |= (((mix2 >> 17) & 1) ^ 1) << 18;
+            chip->mix_clamp_low[ch][l] = top >= 4 && top <= 6;
+            chip->mix_clamp_high[ch][l] = top >= 1 && top <= 3;
+        }
+    }
+    LANES(l)
+    {
+        uint32_t serial = chip->mix_serial[ch][l];
+        serial = chip->mix_clamp_low[ch][l] ? serial & ~2 : serial;
+        serial = chip->mix_clamp_high[ch][l] ? serial | 2 : serial;
+        chip->mix_serial[ch][l] = serial;
+    }
+}
+
+static void OPM_SIMD_Mixer(opm_simd_t *chip)
+{
+    uint32_t l;
+    // Right channel
+    OPM_SIMD_MixerSerial(chip, 1, 13);
+    // Left channel
+    OPM_SIMD_MixerSerial(chip, 0, 29);
+    memcpy(chip->mix2, chip->mix, sizeof(chip->mix));
+    if (chip->cycles == 13)
+    {
+        memset(chip->mix[1], 0, sizeof(chip->mix[1]));
+    }
+    if (chip->cycles == 29)
+    {
+        memset(chip->mix[0], 0, sizeof(chip->mix[0]));
+    }
+    LANES(l)
+    {
+        chip->mix[0][l] += chip->op_mix[l] * chip->op_mixl[l];
+        chip->mix[1][l] += chip->op_mix[l] * chip->op_mixr[l];
+    }
+}
+
+static void OPM_SIMD_Noise(opm_simd_t *chip)
+{
+    uint8_t ic = chip->ic;
+    uint32_t l;
+    LANES(l)
+    {
+        uint32_t lfsr = chip->noise_lfsr[l];
+        uint8_t noise_bit = chip->noise_bit[l];
+        uint8_t noise_step = ic || chip->noise_update[l];
+        uint8_t rst = (lfsr & 0xffff) == 0 && noise_bit == 0;
+        uint8_t xr = ((lfsr >> 2) & 1) ^ noise_bit;
+        uint8_t bit = noise_step ? (ic ? 0 : rst | xr) : lfsr & 1;
+        chip->noise_bit[l] = noise_step ? lfsr & 1 : noise_bit;
+        chip->noise_lfsr[l] = (lfsr >> 1) | (bit << 15);
+    }
+}
+
+static void OPM_SIMD_NoiseTimer(opm_simd_t *chip)
+{
+    uint8_t tick = (chip->cycles & 15) == 15;
+    uint8_t ic = chip->ic;
+    uint32_t l;
+    LANES(l)
+    {
+        uint32_t timer = chip->noise_timer[l];
+        uint8_t of = chip->noise_timer_of[l];
+
+        chip->noise_update[l] = of;
+        chip->noise_timer_of[l] = timer == (chip->noise_freq[l] ^ 31u);
+        timer = (timer + tick) & 31;
+        chip->noise_timer[l] = (ic || (of && tick)) ? 0 : timer;
+    }
+}
+
+static void OPM_SIMD_DoTimerA(opm_simd_t *chip)
+{
+    uint32_t l;
+    LANES(l)
+    {
+        uint16_t value = chip->timer_a_val[l];
+        value += chip->timer_a_inc[l];
+        chip->timer_a_of[l] = (value >> 10) & 1;
+        value = chip->timer_a_do_reset[l] ? 0 : value;
+        value = chip->timer_a_do_load[l] ? chip->timer_a_reg[l] : value;
+
+        chip->timer_a_val[l] = value & 1023;
+    }
+}
+
+static void OPM_SIMD_DoTimerA2(opm_simd_t *chip)
+{
+    uint8_t cycle0 = chip->cycles == 0;
+    uint8_t ic = chip->ic;
+    uint32_t l;
+    if (chip->cycles == 1)
+    {
+        memcpy(chip->timer_a_load, chip->timer_loada, sizeof(chip->timer_a_load));
+    }
+    LANES(l)
+    {
+        uint8_t load = chip->timer_a_load[l];
+        uint8_t status = chip->timer_a_status[l] | (chip->timer_irqa[l] && chip->timer_a_of[l]);
+        chip->timer_a_inc[l] = chip->mode_test[2][l] || (load && cycle0);
+        chip->timer_a_do_load[l] = chip->timer_a_of[l] || (load && chip->timer_a_temp[l]);
+        chip->timer_a_do_reset[l] = chip->timer_a_temp[l];
+        chip->timer_a_temp[l] = !load;
+        chip->timer_a_status[l] = (chip->timer_reseta[l] || ic) ? 0 : status;
+        chip->timer_reseta[l] = 0;
+    }
+}
+
+static void OPM_SIMD_DoTimerB(opm_simd_t *chip)
+{
+    uint32_t l;
+    LANES(l)
+    {
+        uint16_t value = chip->timer_b_val[l];
+        value += chip->timer_b_inc[l];
+        chip->timer_b_of[l] = (value >> 8) & 1;
+        value = chip->timer_b_do_reset[l] ? 0 : value;
+        value = chip->timer_b_do_load[l] ? chip->timer_b_reg[l] : value;
+
+        chip->timer_b_val[l] = value & 255;
+    }
+
+    if (chip->cycles == 0)
+    {
+        chip->timer_b_sub++;
+    }
+
+    if (chip->opp)
+    {
+        chip->timer_b_sub_of = (chip->timer_b_sub >> 5) & 1;
+        chip->timer_b_sub &= 31;
+    }
+    else
+    {
+        chip->timer_b_sub_of = (chip->timer_b_sub >> 4) & 1;
+        chip->timer_b_sub &= 15;
+    }
+    if (chip->ic)
+    {
+        chip->timer_b_sub = 0;
+    }
+}
+
+static void OPM_SIMD_DoTimerB2(opm_simd_t *chip)
+{
+    uint8_t sub_of = chip->timer_b_sub_of;
+    uint8_t ic = chip->ic;
+    uint32_t l;
+    LANES(l)
+    {
+        uint8_t load = chip->timer_loadb[l];
+        uint8_t status = chip->timer_b_status[l] | (chip->timer_irqb[l] && chip->timer_b_of[l]);
+        chip->timer_b_inc[l] = chip->mode_test[2][l] || (load && sub_of);
+        chip->timer_b_do_load[l] = chip->timer_b_of[l] || (load && chip->timer_b_temp[l]);
+        chip->timer_b_do_reset[l] = chip->timer_b_temp[l];
+        chip->timer_b_temp[l] = !load;
+        chip->timer_b_status[l] = (chip->timer_resetb[l] || ic) ? 0 : status;
+        chip->timer_resetb[l] = 0;
+    }
+}
+
+static void OPM_SIMD_DoTimerIRQ(opm_simd_t *chip)
+{
+    uint32_t l;
+    LANES(l)
+    {
+        chip->timer_irq[l] = chip->timer_a_status[l] || chip->timer_b_status[l];
+    }
+}
+
+static void OPM_SIMD_DoLFOMult(opm_simd_t *chip)
+{
+    uint8_t carry_clear = (chip->cycles & 15) == 15;
+    uint32_t l;
+    memcpy(chip->lfo_out2_b, chip->lfo_out2, sizeof(chip->lfo_out2_b));
+    LANES(l)
+    {
+        uint8_t counter = chip->lfo_bit_counter[l];
+        uint8_t ampm_sel = (counter & 8) != 0;
+        uint8_t dp = ampm_sel ? chip->lfo_pmd[l] : chip->lfo_amd[l];
+        uint32_t mask = (counter & 7) == 7 ? 0 : 64 >> (counter & 7);
+        uint8_t bit = (dp & chip->lfo_out1[l] & mask) != 0;
+        uint8_t b1 = (counter & 7) != 0 && (chip->lfo_out2[l] & 1) != 0;
+        uint8_t b2 = carry_clear ? 0 : chip->lfo_mult_carry[l];
+        uint8_t sum = bit + b1 + b2;
+        chip->lfo_out2[l] = (chip->lfo_out2[l] >> 1) | ((sum & 1) << 15);
+        chip->lfo_mult_carry[l] = sum >> 1;
+    }
+}
+
+static void OPM_SIMD_DoLFO1(opm_simd_t *chip)
+{
+    uint32_t phase = chip->cycles & 15;
+    uint8_t mulm = ((chip->cycles + 1) & 15) < 8;
+    uint8_t ic = chip->ic;
+    uint32_t l;
+    LANES(l)
+    {
+        uint16_t counter2 = chip->lfo_counter2[l];
+        uint8_t of_old = chip->lfo_counter2_of[l];
+        uint8_t lfo_bit, sum, carry;
+        uint8_t bb, sb, x, w2, w3, mb;
+        uint8_t lfo_pm_sign, lock_out;
+        uint8_t wave = chip->lfo_wave[l];
+        uint8_t ampm_sel = (chip->lfo_bit_counter[l] & 8) != 0;
+        uint8_t counter1, of_lock2, trig_sign, saw_sign, bit_counter;
+        uint8_t clock_lock = chip->lfo_clock_lock[l];
+        uint32_t val = chip->lfo_val[l];
+        counter2 += (chip->lfo_counter1_of1[l] & 2) != 0 || chip->mode_test[3][l];
+        chip->lfo_counter2_of[l] = (counter2 >> 15) & 1;
+        counter2 = ic ? 0 : counter2;
+        counter2 = chip->lfo_counter2_load[l] ? chip->tab_lfo_counter2[chip->lfo_freq_hi[l]] : counter2;
+        chip->lfo_counter2[l] = counter2 & 32767;
+        chip->lfo_counter2_load[l] = chip->lfo_frq_update[l] || of_old;
+        chip->lfo_frq_update[l] = 0;
+        counter1 = chip->lfo_counter1[l] + (phase == 12);
+        chip->lfo_counter1_of1[l] = (chip->lfo_counter1_of1[l] << 1) | ((counter1 >> 4) & 1);
+        counter1 = ic ? 0 : counter1 & 15;
+        chip->lfo_counter1[l] = counter1;
+
+        of_lock2 = phase == 5 ? chip->lfo_counter2_of_lock[l] : chip->lfo_counter2_of_lock2[l];
+        chip->lfo_counter2_of_lock2[l] = of_lock2;
+
+        chip->lfo_counter3[l] = ic ? 0 : chip->lfo_counter3[l] + chip->lfo_counter3_clock[l];
+
+        chip->lfo_counter3_clock[l] = phase == 13 && of_lock2;
+
+        trig_sign = phase == 15 ? (val & 0x80) != 0 : chip->lfo_trig_sign[l];
+        saw_sign = phase == 15 ? (val & 0x100) != 0 : chip->lfo_saw_sign[l];
+        chip->lfo_trig_sign[l] = trig_sign;
+        chip->lfo_saw_sign[l] = saw_sign;
+
+        lfo_pm_sign = wave == 2 ? trig_sign : saw_sign;
+
+        x = chip->lfo_clock[l] && wave != 3 && phase == 15;
+        w2 = wave == 2 && x;
+        w3 = !ic && !chip->mode_test[1][l] && (!clock_lock || wave != 3) && (val & 0x8000) != 0;
+
+        bb = ampm_sel ? saw_sign : (wave != 2 || !trig_sign);
+        bb ^= w3;
+
+        sb = ampm_sel ? (phase == 6) : !saw_sign;
+
+        mb = mulm && (wave == 1 ? sb : bb);
+
+        chip->lfo_out1[l] = (chip->lfo_out1[l] << 1) | mb;
+
+        carry = x || (phase != 15 && chip->lfo_val_carry[l] != 0 && wave != 3);
+        sum = carry + w2 + w3;
+        lfo_bit = (sum & 1) | ((wave == 3 && clock_lock) ? chip->noise_lfsr[l] & 1 : 0);
+        chip->lfo_val_carry[l] = sum >> 1;
+        chip->lfo_val[l] = (val << 1) | lfo_bit;
+
+        bit_counter = chip->lfo_bit_counter[l];
+        lock_out = (chip->lfo_out2_b[l] >> 8) & 255;
+        mb = phase == 15 && (bit_counter & 7) == 7;
+        chip->lfo_pm_lock[l] = (mb && ampm_sel) ? lock_out ^ (lfo_pm_sign << 7) : chip->lfo_pm_lock[l];
+        chip->lfo_am_lock[l] = (mb && !ampm_sel) ? lock_out : chip->lfo_am_lock[l];
+
+        bit_counter += phase == 14;
+        chip->lfo_bit_counter[l] = (phase != 12 && chip->lfo_counter1_of2[l]) ? 0 : bit_counter;
+        chip->lfo_counter1_of2[l] = counter1 == 2;
+    }
+}
+
+static void OPM_SIMD_DoLFO2(opm_simd_t *chip)
+{
+    uint8_t latch = (chip->cycles & 15) == 14;
+    uint32_t l;
+    LANES(l)
+    {
+        uint16_t counter3 = chip->lfo_counter3[l];
+        uint8_t freq_lo = chip->lfo_freq_lo[l];
+        uint8_t clock = chip->lfo_counter2_of[l] || chip->lfo_test[l] || chip->lfo_counter3_step[l];
+        uint8_t step = (counter3 & 1) == 0 ? (freq_lo & 8) != 0
+                     : (counter3 & 2) == 0 ? (freq_lo & 4) != 0
+                     : (counter3 & 4) == 0 ? (freq_lo & 2) != 0
+                     : (counter3 & 8) == 0 ? (freq_lo & 1) != 0
+                     : 0;
+        chip->lfo_clock_test[l] = chip->lfo_clock[l];
+        chip->lfo_clock[l] = clock;
+        chip->lfo_counter2_of_lock[l] = latch ? chip->lfo_counter2_of[l] : chip->lfo_counter2_of_lock[l];
+        chip->lfo_clock_lock[l] = latch ? clock : chip->lfo_clock_lock[l];
+        chip->lfo_counter3_step[l] = chip->lfo_counter3_clock[l] ? step : 0;
+        chip->lfo_test[l] = chip->mode_test[2][l];
+    }
+}
+
+static void OPM_SIMD_CSM(opm_simd_t *chip)
+{
+    uint32_t l;
+    memcpy(chip->kon_csm, chip->kon_csm_lock, sizeof(chip->kon_csm));
+    if (chip->cycles == 1)
+    {
+        LANES(l)
+        {
+            chip->kon_csm_lock[l] = chip->timer_a_do_load[l] && chip->mode_csm[l];
+        }
+    }
+}
+
+static void OPM_SIMD_NoiseChannel(opm_simd_t *chip)
+{
+    uint8_t clear = chip->cycles == 13;
+    uint32_t l;
+    LANES(l)
+    {
+        uint8_t active = chip->nc_active[l] | (chip->eg_serial_bit[l] & 1);
+        chip->nc_active[l] = clear ? 0 : active;
+        chip->nc_out[l] = (chip->nc_out[l] << 1) | (chip->nc_sign[l] ^ chip->eg_serial_bit[l]);
+        chip->nc_sign[l] = !chip->nc_sign_lock[l];
+    }
+    if (chip->cycles == 12)
+    {
+        LANES(l)
+        {
+            int16_t mix = ((chip->nc_out[l] & ~1) << 2);
+            chip->nc_active_lock[l] = chip->nc_active[l];
+            chip->nc_sign_lock2[l] = chip->nc_active_lock[l] && !chip->nc_sign_lock[l];
+            chip->nc_sign_lock[l] = (chip->noise_lfsr[l] & 1);
+
+            mix = chip->nc_sign_lock2[l] ? mix | -4089 : mix;
+            chip->op_mix[l] = chip->noise_en[l] ? mix : chip->op_mix[l];
+        }
+    }
+}
+
+static void OPM_SIMD_DoIO(opm_simd_t *chip)
+{
+    uint8_t ic = chip->ic;
+    uint32_t l;
+    LANES(l)
+    {
+        // Busy
+        uint8_t cnt = chip->write_busy_cnt[l] + chip->write_busy[l];
+        chip->write_busy[l] = (!(cnt >> 5) && chip->write_busy[l] && !ic) | chip->write_d_en[l];
+        chip->write_busy_cnt[l] = ic ? 0 : cnt & 0x1f;
+    }
+    // Write signal check
+    memcpy(chip->write_a_en, chip->write_a, sizeof(chip->write_a_en));
+    memcpy(chip->write_d_en, chip->write_d, sizeof(chip->write_d_en));
+    memset(chip->write_a, 0, sizeof(chip->write_a));
+    memset(chip->write_d, 0, sizeof(chip->write_d));
+}
+
+/* OPM_DoRegWrite のスロット書き込み部分 (OPM/OPP 共通)。
+ * write が立っているレーンだけ reg_address の上位 3bit で選んだレジスタを
+ * 更新し、clear が立っているレーンは全部 0 にする */
+static inline void OPM_SIMD_WriteSlot(opm_simd_t *chip, uint32_t l, uint32_t slot,
+                                      uint8_t write, uint8_t clear, uint8_t tl_mask)
+{
+    uint8_t data = chip->reg_data[l];
+    uint8_t sel = write ? chip->reg_address[l] & 0xe0 : 0;
+#define OPM_SIMD_SLOT_REG(reg, addr, value) \
+    chip->reg[slot][l] = clear ? 0 : sel == (addr) ? (value) : chip->reg[slot][l]
+    OPM_SIMD_SLOT_REG(sl_dt1, 0x40, (data >> 4) & 0x07);
+    OPM_SIMD_SLOT_REG(sl_mul, 0x40, data & 0x0f);
+    OPM_SIMD_SLOT_REG(sl_tl, 0x60, data & tl_mask);
+    OPM_SIMD_SLOT_REG(sl_ks, 0x80, data >> 6);
+    OPM_SIMD_SLOT_REG(sl_ar, 0x80, data & 0x1f);
+    OPM_SIMD_SLOT_REG(sl_am_e, 0xa0, data >> 7);
+    OPM_SIMD_SLOT_REG(sl_d1r, 0xa0, data & 0x1f);
+    OPM_SIMD_SLOT_REG(sl_dt2, 0xc0, data >> 6);
+    OPM_SIMD_SLOT_REG(sl_d2r, 0xc0, data & 0x1f);
+    OPM_SIMD_SLOT_REG(sl_d1l, 0xe0, data >> 4);
+    OPM_SIMD_SLOT_REG(sl_rr, 0xe0, data & 0x0f);
+#undef OPM_SIMD_SLOT_REG
+}
+
+static void OPM_SIMD_ClearSlot(opm_simd_t *chip, uint32_t l, uint32_t slot)
+{
+    chip->sl_dt1[slot][l] = 0;
+    chip->sl_mul[slot][l] = 0;
+    chip->sl_tl[slot][l] = 0;
+    chip->sl_ks[slot][l] = 0;
+    chip->sl_ar[slot][l] = 0;
+    chip->sl_am_e[slot][l] = 0;
+    chip->sl_d1r[slot][l] = 0;
+    chip->sl_dt2[slot][l] = 0;
+    chip->sl_d2r[slot][l] = 0;
+    chip->sl_d1l[slot][l] = 0;
+    chip->sl_rr[slot][l] = 0;
+}
+
+static void OPM_SIMD_DoRegWriteOPP(opm_simd_t *chip, uint32_t cycles)
+{
+    uint32_t channel = cycles & 7;
+    uint32_t slot = cycles;
+    uint32_t channel_d1 = (cycles + 7) & 7;
+    uint32_t channel_d4 = (cycles + 4) & 7;
+    uint32_t l;
+    LANES(l)
+    {
+        // mode_test[4] が立っていると書き込みの代わりにクリアする
+        uint8_t clear = chip->mode_test[4][l];
+        uint8_t data = chip->reg_data[l];
+        uint8_t address = chip->reg_address[l];
+        uint8_t ready = chip->reg_data_ready[l];
+        uint8_t w20 = !clear && (chip->reg_20_delay[l] & 8); // RL, FB, CONNECT
+        uint8_t w28 = !clear && chip->reg_28_delay[l]; // KC
+        uint8_t w30 = !clear && chip->reg_30_delay[l]; // KF
+        uint8_t write = !clear && ready;
+
+        chip->ch_rl[channel_d4][l] = clear ? 0 : w20 ? data >> 6 : chip->ch_rl[channel_d4][l];
+        chip->ch_fb[channel_d4][l] = clear ? 0 : w20 ? (data >> 3) & 0x07 : chip->ch_fb[channel_d4][l];
+        chip->ch_connect[channel_d4][l] = clear ? 0 : w20 ? data & 0x07 : chip->ch_connect[channel_d4][l];
+        chip->ch_kc[channel_d1][l] = clear ? 0 : w28 ? data & 0x7f : chip->ch_kc[channel_d1][l];
+        chip->ch_kf[channel_d1][l] = clear ? 0 : w30 ? data >> 2 : chip->ch_kf[channel_d1][l];
+        // Channel
+        chip->ch_ramp_div[channel][l] = clear ? 0
+            : (write && address == channel) ? data // Ramp div
+            : chip->ch_ramp_div[channel][l];
+        chip->ch_pms[channel][l] = clear ? 0
+            : (write && address == (0x38 | channel)) ? (data >> 4) & 0x07 // PMS, AMS
+            : chip->ch_pms[channel][l];
+        chip->ch_ams[channel][l] = clear ? 0
+            : (write && address == (0x38 | channel)) ? data & 0x03
+            : chip->ch_ams[channel][l];
+        // Slot
+        OPM_SIMD_WriteSlot(chip, l, slot, write && (address & 0x1f) == slot, clear, 0xff);
+
+        chip->reg_20_delay[l] = (chip->reg_20_delay[l] << 1) | (ready && address == (0x20 | channel));
+        chip->reg_28_delay[l] = ready && address == (0x28 | channel);
+        chip->reg_30_delay[l] = ready && address == (0x30 | channel);
+    }
+}
+
+static void OPM_SIMD_DoRegWriteOPM(opm_simd_t *chip, uint32_t cycles)
+{
+    uint32_t channel = cycles & 7;
+    uint32_t slot = cycles;
+    uint32_t l;
+    LANES(l)
+    {
+        uint8_t data = chip->reg_data[l];
+        uint8_t address = chip->reg_address[l];
+        uint8_t ready = chip->reg_data_ready[l];
+        // Channel
+        uint8_t sel = (ready && (address & 0xe7) == (0x20 | channel)) ? 0x20 | (address & 0x18) : 0;
+        chip->ch_rl[channel][l] = sel == 0x20 ? data >> 6 : chip->ch_rl[channel][l]; // RL, FB, CONNECT
+        chip->ch_fb[channel][l] = sel == 0x20 ? (data >> 3) & 0x07 : chip->ch_fb[channel][l];
+        chip->ch_connect[channel][l] = sel == 0x20 ? data & 0x07 : chip->ch_connect[channel][l];
+        chip->ch_kc[channel][l] = sel == 0x28 ? data & 0x7f : chip->ch_kc[channel][l]; // KC
+        chip->ch_kf[channel][l] = sel == 0x30 ? data >> 2 : chip->ch_kf[channel][l]; // KF
+        chip->ch_pms[channel][l] = sel == 0x38 ? (data >> 4) & 0x07 : chip->ch_pms[channel][l]; // PMS, AMS
+        chip->ch_ams[channel][l] = sel == 0x38 ? data & 0x03 : chip->ch_ams[channel][l];
+        // Slot
+        OPM_SIMD_WriteSlot(chip, l, slot, ready && (address & 0x1f) == slot, 0, 0x7f);
+    }
+}
+
+static void OPM_SIMD_DoModeWrite(opm_simd_t *chip, uint32_t l)
+{
+    int32_t i;
+    uint8_t data = chip->write_data[l];
+    if (chip->mode_address[l] == (chip->opp ? 9 : 1))
+    {
+        for (i = 0; i < 8; i++)
+        {
+            chip->mode_test[i][l] = (data >> i) & 0x01;
+        }
+    }
+    switch (chip->mode_address[l])
+    {
+    case 0x08:
+        for (i = 0; i < 4; i++)
+        {
+            chip->mode_kon_operator[i][l] = (data >> (i + 3)) & 0x01;
+        }
+        chip->mode_kon_channel[l] = data & 0x07;
+        break;
+    case 0x0f:
+        chip->noise_en[l] = data >> 7;
+        chip->noise_freq[l] = data & 0x1f;
+        break;
+    case 0x10:
+        chip->timer_a_reg[l] &= 0x03;
+        chip->timer_a_reg[l] |= data << 2;
+        break;
+    case 0x11:
+        chip->timer_a_reg[l] &= 0x3fc;
+        chip->timer_a_reg[l] |= data & 0x03;
+        break;
+    case 0x12:
+        chip->timer_b_reg[l] = data;
+        break;
+    case 0x14:
+        chip->mode_csm[l] = (data >> 7) & 1;
+        chip->timer_irqb[l] = (data >> 3) & 1;
+        chip->timer_irqa[l] = (data >> 2) & 1;
+        chip->timer_resetb[l] = (data >> 5) & 1;
+        chip->timer_reseta[l] = (data >> 4) & 1;
+        chip->timer_loadb[l] = (data >> 1) & 1;
+        chip->timer_loada[l] = (data >> 0) & 1;
+        break;
+    case 0x18:
+        chip->lfo_freq_hi[l] = data >> 4;
+        chip->lfo_freq_lo[l] = data & 0x0f;
+        chip->lfo_frq_update[l] = 1;
+        break;
+    case 0x19:
+        if (data & 0x80)
+        {
+            chip->lfo_pmd[l] = data & 0x7f;
+        }
+        else
+        {
+            chip->lfo_amd[l] = data;
+        }
+        break;
+    case 0x1b:
+        chip->lfo_wave[l] = data & 0x03;
+        chip->io_ct1[l] = (data >> 6) & 0x01;
+        chip->io_ct2[l] = data >> 7;
+        break;
+    }
+}
+
+static void OPM_SIMD_DoRegWrite(opm_simd_t *chip)
+{
+    uint8_t opp = chip->opp;
+    uint8_t mode_write = 0;
+    uint32_t l;
+
+    if (opp)
+    {
+        OPM_SIMD_DoRegWriteOPP(chip, (chip->cycles + 1) & 31);
+    }
+    else
+    {
+        OPM_SIMD_DoRegWriteOPM(chip, chip->cycles);
+    }
+
+    // Mode write。書き込みはまれなので、どのレーンにもなければ飛ばす
+    LANES(l)
+    {
+        mode_write |= chip->write_d_en[l];
+    }
+    if (mode_write)
+    {
+        LANES(l)
+        {
+            if (chip->write_d_en[l])
+            {
+                OPM_SIMD_DoModeWrite(chip, l);
+            }
+        }
+    }
+
+    LANES(l)
+    {
+        uint8_t write_a_en = chip->write_a_en[l];
+        uint8_t data = chip->write_data[l];
+        uint8_t data_write = chip->reg_address_ready[l] && chip->write_d_en[l];
+        uint8_t address_write = write_a_en && ((data & 0xe0) != 0 || (opp && (data & 0xf8) == 0));
+        // Register data write
+        chip->reg_data[l] = data_write ? data : chip->reg_data[l];
+        chip->reg_data_ready[l] = data_write || (chip->reg_data_ready[l] && !write_a_en);
+
+        // Register address write
+        chip->reg_address[l] = address_write ? data : chip->reg_address[l];
+        chip->reg_address_ready[l] = address_write || (chip->reg_address_ready[l] && !write_a_en);
+        chip->mode_address[l] = write_a_en ? data : chip->mode_address[l];
+    }
+}
+
+static void OPM_SIMD_DoIC(opm_simd_t *chip)
+{
+    uint32_t channel = chip->cycles & 7;
+    uint32_t slot = chip->cycles;
+    uint32_t l;
+    if (chip->ic)
+    {
+        LANES(l)
+        {
+            if (chip->opp)
+            {
+                uint32_t i;
+                for (i = 0; i < 2; i++)
+                {
+                    uint8_t ch = (channel + 4 * i) & 7;
+                    chip->ch_ramp_div[ch][l] = 0;
+                    chip->ch_rl[ch][l] = 0;
+                    chip->ch_fb[ch][l] = 0;
+                    chip->ch_connect[ch][l] = 0;
+                    chip->ch_kc[ch][l] = 0;
+                    chip->ch_kf[ch][l] = 0;
+                    chip->ch_pms[ch][l] = 0;
+                    chip->ch_ams[ch][l] = 0;
+                }
+                for (i = 0; i < 8; i++)
+                {
+                    OPM_SIMD_ClearSlot(chip, l, (slot + 4 * i) & 31);
+                }
+            }
+            else
+            {
+                chip->ch_rl[channel][l] = 0;
+                chip->ch_fb[channel][l] = 0;
+                chip->ch_connect[channel][l] = 0;
+                chip->ch_kc[channel][l] = 0;
+                chip->ch_kf[channel][l] = 0;
+                chip->ch_pms[channel][l] = 0;
+                chip->ch_ams[channel][l] = 0;
+
+                OPM_SIMD_ClearSlot(chip, l, slot);
+            }
+
+            chip->timer_a_reg[l] = 0;
+            chip->timer_b_reg[l] = 0;
+            chip->timer_irqa[l] = 0;
+            chip->timer_irqb[l] = 0;
+            chip->timer_loada[l] = 0;
+            chip->timer_loadb[l] = 0;
+            chip->mode_csm[l] = 0;
+
+            chip->mode_test[0][l] = 0;
+            chip->mode_test[1][l] = 0;
+            chip->mode_test[2][l] = 0;
+            chip->mode_test[3][l] = 0;
+            chip->mode_test[4][l] = 0;
+            chip->mode_test[5][l] = 0;
+            chip->mode_test[6][l] = 0;
+            chip->mode_test[7][l] = 0;
+            chip->noise_en[l] = 0;
+            chip->noise_freq[l] = 0;
+
+            chip->mode_kon_channel[l] = 0;
+            chip->mode_kon_operator[0][l] = 0;
+            chip->mode_kon_operator[1][l] = 0;
+            chip->mode_kon_operator[2][l] = 0;
+            chip->mode_kon_operator[3][l] = 0;
+            chip->mode_kon[(slot + 8) & 31][l] = 0;
+
+            chip->lfo_pmd[l] = 0;
+            chip->lfo_amd[l] = 0;
+            chip->lfo_wave[l] = 0;
+            chip->lfo_freq_hi[l] = 0;
+            chip->lfo_freq_lo[l] = 0;
+
+            chip->io_ct1[l] = 0;
+            chip->io_ct2[l] = 0;
+
+            chip->reg_address[l] = 0;
+            chip->reg_data[l] = 0;
+        }
+    }
+    chip->ic2 = chip->ic;
+}
+
+static void OPP_SIMD_TLRamp(opm_simd_t *chip)
+{
+    uint32_t slot = chip->cycles;
+    uint32_t channel = slot & 7;
+    uint8_t step = ((chip->cycles + 1) & 31) < 8;
+    uint8_t ic = chip->ic;
+    uint32_t l;
+    LANES(l)
+    {
+        uint8_t cnt = chip->opp_tl_cnt[channel][l];
+        uint8_t match = chip->ch_ramp_div[channel][l] == cnt;
+        uint8_t tl = chip->sl_tl[slot][l];
+        uint16_t cur = chip->opp_tl[slot][l];
+        uint16_t val = cur >> 3;
+        uint8_t target = tl & 127;
+        uint16_t ramp = val < target ? cur + 1 : val > target ? cur - 1 : cur;
+
+        chip->opp_tl_cnt[channel][l] = (ic || (step && match)) ? 0 : cnt + step;
+        chip->opp_tl[slot][l] = !(tl & 128) ? tl << 3 : match ? ramp : cur;
+    }
+}
+
+void OPM_SIMD_Clock(opm_simd_t *chip, int32_t *output)
+{
+    uint32_t l;
+
+    OPM_SIMD_Output(chip);
+    OPM_SIMD_DAC(chip);
+    OPM_SIMD_Mixer2(chip);
+    OPM_SIMD_Mixer(chip);
+
+    OPM_SIMD_OperatorPhase16(chip);
+    OPM_SIMD_OperatorPhase15(chip);
+    OPM_SIMD_OperatorPhase14(chip);
+    OPM_SIMD_OperatorPhase13(chip);
+    OPM_SIMD_OperatorPhase12(chip);
+    OPM_SIMD_OperatorPhase11(chip);
+    OPM_SIMD_OperatorPhase10(chip);
+    OPM_SIMD_OperatorPhase9(chip);
+    OPM_SIMD_OperatorPhase8(chip);
+    OPM_SIMD_OperatorPhase7(chip);
+    OPM_SIMD_OperatorPhase6(chip);
+    OPM_SIMD_OperatorPhase5(chip);
+    OPM_SIMD_OperatorPhase4(chip);
+    OPM_SIMD_OperatorPhase3(chip);
+    OPM_SIMD_OperatorPhase2(chip);
+    OPM_SIMD_OperatorPhase1(chip);
+    OPM_SIMD_OperatorCounter(chip);
+
+    OPM_SIMD_EnvelopeTimer(chip);
+    OPM_SIMD_EnvelopePhase6(chip);
+    OPM_SIMD_EnvelopePhase5(chip);
+    OPM_SIMD_EnvelopePhase4(chip);
+    OPM_SIMD_EnvelopePhase3(chip);
+    OPM_SIMD_EnvelopePhase2(chip);
+    OPM_SIMD_EnvelopePhase1(chip);
+
+    if (chip->opp)
+        OPP_SIMD_TLRamp(chip);
+
+    OPM_SIMD_PhaseDebug(chip);
+    OPM_SIMD_PhaseGenerate(chip);
+    OPM_SIMD_PhaseCalcIncrement(chip);
+    OPM_SIMD_PhaseCalcFNumBlock(chip);
+
+    OPM_SIMD_DoTimerIRQ(chip);
+    OPM_SIMD_DoTimerA(chip);
+    OPM_SIMD_DoTimerB(chip);
+    OPM_SIMD_DoLFOMult(chip);
+    OPM_SIMD_DoLFO1(chip);
+    OPM_SIMD_Noise(chip);
+    OPM_SIMD_KeyOn2(chip);
+    OPM_SIMD_DoRegWrite(chip);
+    OPM_SIMD_EnvelopeClock(chip);
+    OPM_SIMD_NoiseTimer(chip);
+    OPM_SIMD_KeyOn1(chip);
+    OPM_SIMD_DoIO(chip);
+    OPM_SIMD_DoTimerA2(chip);
+    OPM_SIMD_DoTimerB2(chip);
+    OPM_SIMD_DoLFO2(chip);
+    OPM_SIMD_CSM(chip);
+    OPM_SIMD_NoiseChannel(chip);
+    OPM_SIMD_DoIC(chip);
+    if (output)
+    {
+        LANES(l)
+        {
+            output[l * 2 + 0] = chip->dac_output[0][l];
+            output[l * 2 + 1] = chip->dac_output[1][l];
+        }
+    }
+    chip->cycles = (chip->cycles + 1) & 31;
+}
+
+void OPM_SIMD_Write(opm_simd_t *chip, uint32_t lane, uint32_t port, uint8_t data)
+{
+    if (lane >= OPM_SIMD_LANES)
+    {
+        return;
+    }
+    chip->write_data[lane] = data;
+    if (chip->ic)
+    {
+        return;
+    }
+    if (port & 0x01)
+    {
+        chip->write_d[lane] = 1;
+    }
+    else
+    {
+        chip->write_a[lane] = 1;
+    }
+}
+
+void OPM_SIMD_SetIC(opm_simd_t *chip, uint8_t ic)
+{
+    if (chip->ic != ic)
+    {
+        chip->ic = ic;
+        if (!ic)
+        {
+            chip->cycles = 0;
+        }
+    }
+}
+
+static void OPM_SIMD_InitTables(opm_simd_t *chip)
+{
+    uint32_t i, j;
+    for (i = 0; i < 256; i++)
+    {
+        chip->tab_logsin[i] = logsinrom[i];
+        chip->tab_exp[i] = exprom[i];
+    }
+    /* OPM_KCToFNum は kcode の下位 10bit しか見ない */
+    for (i = 0; i < 1024; i++)
+    {
+        chip->tab_fnum[i] = OPM_KCToFNum(i);
+    }
+    for (i = 0; i < 8; i++)
+    {
+        for (j = 0; j < 128; j++)
+        {
+            chip->tab_pms[i * 128 + j] = OPM_LFOApplyPMS(j, i);
+        }
+    }
+    for (i = 0; i < 16; i++)
+    {
+        chip->tab_lfo_counter2[i] = lfo_counter2_table[i];
+    }
+}
+
+void OPM_SIMD_Reset(opm_simd_t *chip, uint32_t flags)
+{
+    uint32_t i;
+    memset(chip, 0, sizeof(opm_simd_t));
+    OPM_SIMD_InitTables(chip);
+    chip->opp = (flags & opm_flags_ym2164) != 0;
+    OPM_SIMD_SetIC(chip, 1);
+    for (i = 0; i < 32 * 64; i++)
+    {
+        OPM_SIMD_Clock(chip, NULL);
+    }
+    OPM_SIMD_SetIC(chip, 0);
+}
+
+int OPM_SIMD_LoadLane(opm_simd_t *chip, uint32_t lane, const opm_t *src)
+{
+    uint32_t i;
+    if (lane >= OPM_SIMD_LANES)
+    {
+        return 0;
+    }
+#define X(f) if (chip->f != src->f) return 0;
+    OPM_SIMD_UNIFORM_FIELDS(X)
+#undef X
+#define X(f) chip->f[lane] = src->f;
+    OPM_SIMD_LANE_FIELDS(X)
+#undef X
+#define X(f) \
+    for (i = 0; i < sizeof(chip->f) / sizeof(chip->f[0]); i++) \
+        chip->f[i][lane] = src->f[i];
+    OPM_SIMD_SLOT_FIELDS(X)
+#undef X
+    for (i = 0; i < 8 * 2; i++)
+    {
+        chip->op_m1[i][lane] = src->op_m1[i >> 1][i & 1];
+    }
+    return 1;
+}
+
+int OPM_SIMD_StoreLane(const opm_simd_t *chip, uint32_t lane, opm_t *dst)
+{
+    uint32_t i;
+    if (lane >= OPM_SIMD_LANES)
+    {
+        return 0;
+    }
+    memset(dst, 0, sizeof(opm_t));
+#define X(f) dst->f = chip->f;
+    OPM_SIMD_UNIFORM_FIELDS(X)
+#undef X
+#define X(f) dst->f = chip->f[lane];
+    OPM_SIMD_LANE_FIELDS(X)
+#undef X
+#define X(f) \
+    for (i = 0; i < sizeof(chip->f) / sizeof(chip->f[0]); i++) \
+        dst->f[i] = chip->f[i][lane];
+    OPM_SIMD_SLOT_FIELDS(X)
+#undef X
+    for (i = 0; i < 8 * 2; i++)
+    {
+        dst->op_m1[i >> 1][i & 1] = chip->op_m1[i][lane];
+    }
+    return 1;
+}
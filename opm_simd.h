@@ -0,0 +1,303 @@
+/* Nuked OPM の複数チップを同時に回すエンジン
+ *
+ * Nuked OPM のコア (opm.c) を構造体の配列 (SoA) に書き直したもの。1つの opm_simd_t に
+ * 独立したチップを OPM_SIMD_LANES 個 (ベクトルのレーンごとに1つ) 持つ。サイクルカウンタと
+ * IC / チップの種類は全レーンで共通なので、パイプラインのどのステージも全レーンで同じ
+ * 制御になり、レーンごとの処理は連続した配列の単純なループとして書いてある。
+ * これをコンパイラが SSE / AVX2 (ネイティブ) や simd128 (wasm) の命令にする。
+ * ネイティブで SSE2 より新しい命令を使うには CMake の -DOPM_SIMD_ARCH を指定する
+ * (指定しなければ SSE2 までの自動ベクトル化になり、速くならない)。
+ *
+ * レーンごとの出力は、同じレジスタ書き込みを別々の opm_t の OPM_Clock で
+ * 回したものとビット単位で一致する。
+ *
+ * このファイルは Nuked OPM から派生したもので、同じライセンス
+ * (GNU LGPL 2.1 以降) で配布する。opm.h を参照。
+ */
+#ifndef _OPM_SIMD_H_
+#define _OPM_SIMD_H_
+
+#include <stdint.h>
+#include "opm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 4 / 8 / 16 。uint8_t のフィールドが多いので 16 で 128bit レジスタが埋まる。
+ * 8 以下だとレーンループのオーバーヘッドが勝ってスカラーより遅くなる */
+#ifndef OPM_SIMD_LANES
+#define OPM_SIMD_LANES 16
+#endif
+
+#define OPM_SIMD_LANE_ARRAY(type, name) type name[OPM_SIMD_LANES]
+#define OPM_SIMD_SLOT_ARRAY(type, name, n) type name[n][OPM_SIMD_LANES]
+
+typedef struct {
+    /* 全レーン共通 */
+    uint32_t cycles;
+    uint8_t ic;
+    uint8_t ic2;
+    uint8_t opp;
+
+    // IO
+    OPM_SIMD_LANE_ARRAY(uint8_t, write_data);
+    OPM_SIMD_LANE_ARRAY(uint8_t, write_a);
+    OPM_SIMD_LANE_ARRAY(uint8_t, write_a_en);
+    OPM_SIMD_LANE_ARRAY(uint8_t, write_d);
+    OPM_SIMD_LANE_ARRAY(uint8_t, write_d_en);
+    OPM_SIMD_LANE_ARRAY(uint8_t, write_busy);
+    OPM_SIMD_LANE_ARRAY(uint8_t, write_busy_cnt);
+    OPM_SIMD_LANE_ARRAY(uint8_t, mode_address);
+    OPM_SIMD_LANE_ARRAY(uint8_t, io_ct1);
+    OPM_SIMD_LANE_ARRAY(uint8_t, io_ct2);
+
+    // LFO
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_am_lock);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_pm_lock);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_counter1);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_counter1_of1);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_counter1_of2);
+    OPM_SIMD_LANE_ARRAY(uint16_t, lfo_counter2);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_counter2_load);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_counter2_of);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_counter2_of_lock);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_counter2_of_lock2);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_counter3_clock);
+    OPM_SIMD_LANE_ARRAY(uint16_t, lfo_counter3);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_counter3_step);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_frq_update);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_clock);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_clock_lock);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_clock_test);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_test);
+    OPM_SIMD_LANE_ARRAY(uint32_t, lfo_val);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_val_carry);
+    OPM_SIMD_LANE_ARRAY(uint32_t, lfo_out1);
+    OPM_SIMD_LANE_ARRAY(uint32_t, lfo_out2);
+    OPM_SIMD_LANE_ARRAY(uint32_t, lfo_out2_b);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_mult_carry);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_trig_sign);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_saw_sign);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_bit_counter);
+
+    // Env Gen
+    OPM_SIMD_SLOT_ARRAY(uint8_t, eg_state, 32);
+    OPM_SIMD_SLOT_ARRAY(uint16_t, eg_level, 32);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, eg_rate, 2);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, eg_sl, 2);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, eg_tl, 3);
+    OPM_SIMD_LANE_ARRAY(uint16_t, eg_tl_opp);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, eg_zr, 2);
+    OPM_SIMD_LANE_ARRAY(uint8_t, eg_timershift_lock);
+    OPM_SIMD_LANE_ARRAY(uint8_t, eg_timer_lock);
+    OPM_SIMD_LANE_ARRAY(uint8_t, eg_inchi);
+    OPM_SIMD_LANE_ARRAY(uint8_t, eg_shift);
+    OPM_SIMD_LANE_ARRAY(uint8_t, eg_clock);
+    OPM_SIMD_LANE_ARRAY(uint8_t, eg_clockcnt);
+    OPM_SIMD_LANE_ARRAY(uint8_t, eg_clockquotinent);
+    OPM_SIMD_LANE_ARRAY(uint8_t, eg_inc);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, eg_ratemax, 2);
+    OPM_SIMD_LANE_ARRAY(uint8_t, eg_instantattack);
+    OPM_SIMD_LANE_ARRAY(uint8_t, eg_inclinear);
+    OPM_SIMD_LANE_ARRAY(uint8_t, eg_incattack);
+    OPM_SIMD_LANE_ARRAY(uint8_t, eg_mute);
+    OPM_SIMD_SLOT_ARRAY(uint16_t, eg_outtemp, 2);
+    OPM_SIMD_SLOT_ARRAY(uint16_t, eg_out, 2);
+    OPM_SIMD_LANE_ARRAY(uint16_t, eg_am);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, eg_ams, 2);
+    OPM_SIMD_LANE_ARRAY(uint8_t, eg_timercarry);
+    OPM_SIMD_LANE_ARRAY(uint32_t, eg_timer);
+    OPM_SIMD_LANE_ARRAY(uint32_t, eg_timer2);
+    OPM_SIMD_LANE_ARRAY(uint8_t, eg_timerbstop);
+    OPM_SIMD_LANE_ARRAY(uint32_t, eg_serial);
+    OPM_SIMD_LANE_ARRAY(uint8_t, eg_serial_bit);
+    OPM_SIMD_LANE_ARRAY(uint8_t, eg_test);
+
+    // Phase Gen
+    OPM_SIMD_SLOT_ARRAY(uint16_t, pg_fnum, 32);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, pg_kcode, 32);
+    OPM_SIMD_SLOT_ARRAY(uint32_t, pg_inc, 32);
+    OPM_SIMD_SLOT_ARRAY(uint32_t, pg_phase, 32);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, pg_reset, 32);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, pg_reset_latch, 32);
+    OPM_SIMD_LANE_ARRAY(uint32_t, pg_serial);
+    OPM_SIMD_LANE_ARRAY(uint8_t, pg_opp_pms);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, pg_opp_dt2, 32);
+
+    // Operator
+    OPM_SIMD_LANE_ARRAY(uint16_t, op_phase_in);
+    OPM_SIMD_LANE_ARRAY(uint16_t, op_mod_in);
+    OPM_SIMD_LANE_ARRAY(uint16_t, op_phase);
+    OPM_SIMD_SLOT_ARRAY(uint16_t, op_logsin, 3);
+    OPM_SIMD_LANE_ARRAY(uint16_t, op_atten);
+    OPM_SIMD_SLOT_ARRAY(uint16_t, op_exp, 2);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, op_pow, 2);
+    OPM_SIMD_LANE_ARRAY(uint32_t, op_sign);
+    OPM_SIMD_SLOT_ARRAY(int16_t, op_out, 6);
+    OPM_SIMD_LANE_ARRAY(uint32_t, op_connect);
+    uint8_t op_counter;
+    uint8_t op_fbupdate;
+    uint8_t op_fbshift;
+    uint8_t op_c1update;
+    OPM_SIMD_SLOT_ARRAY(uint8_t, op_modtable, 5);
+    OPM_SIMD_SLOT_ARRAY(int16_t, op_m1, 8 * 2);
+    OPM_SIMD_SLOT_ARRAY(int16_t, op_c1, 8);
+    OPM_SIMD_SLOT_ARRAY(int16_t, op_mod, 3);
+    OPM_SIMD_SLOT_ARRAY(int16_t, op_fb, 2);
+    OPM_SIMD_LANE_ARRAY(uint8_t, op_mixl);
+    OPM_SIMD_LANE_ARRAY(uint8_t, op_mixr);
+    OPM_SIMD_LANE_ARRAY(uint8_t, op_opp_rl);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, op_opp_fb, 3);
+
+    // Mixer
+    OPM_SIMD_SLOT_ARRAY(int32_t, mix, 2);
+    OPM_SIMD_SLOT_ARRAY(int32_t, mix2, 2);
+    OPM_SIMD_LANE_ARRAY(int32_t, mix_op);
+    OPM_SIMD_SLOT_ARRAY(uint32_t, mix_serial, 2);
+    OPM_SIMD_LANE_ARRAY(uint32_t, mix_bits);
+    OPM_SIMD_LANE_ARRAY(uint32_t, mix_top_bits_lock);
+    OPM_SIMD_LANE_ARRAY(uint8_t, mix_sign_lock);
+    OPM_SIMD_LANE_ARRAY(uint8_t, mix_sign_lock2);
+    OPM_SIMD_LANE_ARRAY(uint8_t, mix_exp_lock);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, mix_clamp_low, 2);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, mix_clamp_high, 2);
+    OPM_SIMD_LANE_ARRAY(uint8_t, mix_out_bit);
+
+    // Output
+    OPM_SIMD_LANE_ARRAY(uint8_t, smp_so);
+    uint8_t smp_sh1;
+    uint8_t smp_sh2;
+
+    // Noise
+    OPM_SIMD_LANE_ARRAY(uint32_t, noise_lfsr);
+    OPM_SIMD_LANE_ARRAY(uint32_t, noise_timer);
+    OPM_SIMD_LANE_ARRAY(uint8_t, noise_timer_of);
+    OPM_SIMD_LANE_ARRAY(uint8_t, noise_update);
+    OPM_SIMD_LANE_ARRAY(uint8_t, noise_bit);
+
+    // Register set
+    OPM_SIMD_SLOT_ARRAY(uint8_t, mode_test, 8);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, mode_kon_operator, 4);
+    OPM_SIMD_LANE_ARRAY(uint8_t, mode_kon_channel);
+
+    OPM_SIMD_LANE_ARRAY(uint8_t, reg_address);
+    OPM_SIMD_LANE_ARRAY(uint8_t, reg_address_ready);
+    OPM_SIMD_LANE_ARRAY(uint8_t, reg_data);
+    OPM_SIMD_LANE_ARRAY(uint8_t, reg_data_ready);
+
+    OPM_SIMD_SLOT_ARRAY(uint8_t, ch_rl, 8);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, ch_fb, 8);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, ch_connect, 8);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, ch_kc, 8);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, ch_kf, 8);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, ch_pms, 8);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, ch_ams, 8);
+
+    OPM_SIMD_SLOT_ARRAY(uint8_t, sl_dt1, 32);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, sl_mul, 32);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, sl_tl, 32);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, sl_ks, 32);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, sl_ar, 32);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, sl_am_e, 32);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, sl_d1r, 32);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, sl_dt2, 32);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, sl_d2r, 32);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, sl_d1l, 32);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, sl_rr, 32);
+
+    OPM_SIMD_LANE_ARRAY(uint8_t, noise_en);
+    OPM_SIMD_LANE_ARRAY(uint8_t, noise_freq);
+
+    // OPP
+    OPM_SIMD_SLOT_ARRAY(uint8_t, ch_ramp_div, 8);
+    OPM_SIMD_LANE_ARRAY(uint8_t, reg_20_delay);
+    OPM_SIMD_LANE_ARRAY(uint8_t, reg_28_delay);
+    OPM_SIMD_LANE_ARRAY(uint8_t, reg_30_delay);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, opp_tl_cnt, 8);
+    OPM_SIMD_SLOT_ARRAY(uint16_t, opp_tl, 32);
+
+    // Timer
+    OPM_SIMD_LANE_ARRAY(uint16_t, timer_a_reg);
+    OPM_SIMD_LANE_ARRAY(uint8_t, timer_b_reg);
+    OPM_SIMD_LANE_ARRAY(uint8_t, timer_a_temp);
+    OPM_SIMD_LANE_ARRAY(uint8_t, timer_a_do_reset);
+    OPM_SIMD_LANE_ARRAY(uint8_t, timer_a_do_load);
+    OPM_SIMD_LANE_ARRAY(uint8_t, timer_a_inc);
+    OPM_SIMD_LANE_ARRAY(uint16_t, timer_a_val);
+    OPM_SIMD_LANE_ARRAY(uint8_t, timer_a_of);
+    OPM_SIMD_LANE_ARRAY(uint8_t, timer_a_load);
+    OPM_SIMD_LANE_ARRAY(uint8_t, timer_a_status);
+
+    uint8_t timer_b_sub;
+    uint8_t timer_b_sub_of;
+    OPM_SIMD_LANE_ARRAY(uint8_t, timer_b_inc);
+    OPM_SIMD_LANE_ARRAY(uint16_t, timer_b_val);
+    OPM_SIMD_LANE_ARRAY(uint8_t, timer_b_of);
+    OPM_SIMD_LANE_ARRAY(uint8_t, timer_b_do_reset);
+    OPM_SIMD_LANE_ARRAY(uint8_t, timer_b_do_load);
+    OPM_SIMD_LANE_ARRAY(uint8_t, timer_b_temp);
+    OPM_SIMD_LANE_ARRAY(uint8_t, timer_b_status);
+    OPM_SIMD_LANE_ARRAY(uint8_t, timer_irq);
+
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_freq_hi);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_freq_lo);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_pmd);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_amd);
+    OPM_SIMD_LANE_ARRAY(uint8_t, lfo_wave);
+
+    OPM_SIMD_LANE_ARRAY(uint8_t, timer_irqa);
+    OPM_SIMD_LANE_ARRAY(uint8_t, timer_irqb);
+    OPM_SIMD_LANE_ARRAY(uint8_t, timer_loada);
+    OPM_SIMD_LANE_ARRAY(uint8_t, timer_loadb);
+    OPM_SIMD_LANE_ARRAY(uint8_t, timer_reseta);
+    OPM_SIMD_LANE_ARRAY(uint8_t, timer_resetb);
+    OPM_SIMD_LANE_ARRAY(uint8_t, mode_csm);
+
+    OPM_SIMD_LANE_ARRAY(uint8_t, nc_active);
+    OPM_SIMD_LANE_ARRAY(uint8_t, nc_active_lock);
+    OPM_SIMD_LANE_ARRAY(uint8_t, nc_sign);
+    OPM_SIMD_LANE_ARRAY(uint8_t, nc_sign_lock);
+    OPM_SIMD_LANE_ARRAY(uint8_t, nc_sign_lock2);
+    OPM_SIMD_LANE_ARRAY(uint8_t, nc_bit);
+    OPM_SIMD_LANE_ARRAY(uint16_t, nc_out);
+    OPM_SIMD_LANE_ARRAY(int16_t, op_mix);
+
+    OPM_SIMD_LANE_ARRAY(uint8_t, kon_csm);
+    OPM_SIMD_LANE_ARRAY(uint8_t, kon_csm_lock);
+    OPM_SIMD_LANE_ARRAY(uint8_t, kon_do);
+    OPM_SIMD_LANE_ARRAY(uint8_t, kon_chanmatch);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, kon, 32);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, kon2, 32);
+    OPM_SIMD_SLOT_ARRAY(uint8_t, mode_kon, 32);
+
+    // DAC
+    uint8_t dac_osh1, dac_osh2;
+    OPM_SIMD_LANE_ARRAY(uint16_t, dac_bits);
+    OPM_SIMD_SLOT_ARRAY(int32_t, dac_output, 2);
+
+    /* 表引き用テーブル (OPM_SIMD_Reset で作る)。ROM を 32bit に広げたものと、
+     * 分岐の多いピッチ計算 (OPM_KCToFNum / OPM_LFOApplyPMS) を展開したもの。
+     * レーンごとの表引きがギャザー命令になるようにしている */
+    uint32_t tab_logsin[256];
+    uint32_t tab_exp[256];
+    uint32_t tab_fnum[1024];
+    uint32_t tab_pms[8 * 128];
+    uint32_t tab_lfo_counter2[16];
+} opm_simd_t;
+
+/* output には [lane][L,R] の順で OPM_SIMD_LANES * 2 個書き込む (NULL 可) */
+void OPM_SIMD_Clock(opm_simd_t *chip, int32_t *output);
+void OPM_SIMD_Write(opm_simd_t *chip, uint32_t lane, uint32_t port, uint8_t data);
+void OPM_SIMD_SetIC(opm_simd_t *chip, uint8_t ic);
+void OPM_SIMD_Reset(opm_simd_t *chip, uint32_t flags);
+
+/* 単体の opm_t とレーンの相互変換。cycles / ic / チップ種別が一致している必要がある */
+int OPM_SIMD_LoadLane(opm_simd_t *chip, uint32_t lane, const opm_t *src);
+int OPM_SIMD_StoreLane(const opm_simd_t *chip, uint32_t lane, opm_t *dst);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,51 @@
+/* opm.c (Nuked OPM) をこの翻訳単位に取り込むためのヘッダ
+ *
+ * opm.c / opm.h は fetch_nuked_opm.yml で上流から取得したまま手を入れない。
+ * 派生エンジンが ROM テーブル (logsinrom, exprom, pg_freqtable, fm_algorithm
+ * など) や static なヘルパー関数を再利用したいときは、opm.c を直接
+ * #include する。公開関数はそのままだとリンク時に opm.c 本体と衝突するので、
+ * OPM_VENDOR_PREFIX を前置した名前にリネームして取り込む。
+ *
+ * 使い方:
+ *   #define OPM_VENDOR_PREFIX OPM_SIMD_Ref_
+ *   #include "opm_vendor.h"
+ *   // OPM_SIMD_Ref_Clock() などとして参照実装も呼べる
+ *
+ * 1つの翻訳単位で1回だけ include すること。
+ */
+#ifndef _OPM_VENDOR_H_
+#define _OPM_VENDOR_H_
+
+#ifndef OPM_VENDOR_PREFIX
+#error "define OPM_VENDOR_PREFIX before including opm_vendor.h"
+#endif
+
+#ifdef _OPM_H_
+#error "opm_vendor.h must be included before opm.h"
+#endif
+
+#define OPM_VENDOR_CAT_(a, b) a##b
+#define OPM_VENDOR_CAT(a, b) OPM_VENDOR_CAT_(a, b)
+#define OPM_VENDOR_NAME(name) OPM_VENDOR_CAT(OPM_VENDOR_PREFIX, name)
+
+#define OPM_Clock OPM_VENDOR_NAME(Clock)
+#define OPM_Write OPM_VENDOR_NAME(Write)
+#define OPM_Read OPM_VENDOR_NAME(Read)
+#define OPM_ReadIRQ OPM_VENDOR_NAME(ReadIRQ)
+#define OPM_ReadCT1 OPM_VENDOR_NAME(ReadCT1)
+#define OPM_ReadCT2 OPM_VENDOR_NAME(ReadCT2)
+#define OPM_SetIC OPM_VENDOR_NAME(SetIC)
+#define OPM_Reset OPM_VENDOR_NAME(Reset)
+
+#include "opm.c"
+
+#undef OPM_Clock
+#undef OPM_Write
+#undef OPM_Read
+#undef OPM_ReadIRQ
+#undef OPM_ReadCT1
+#undef OPM_ReadCT2
+#undef OPM_SetIC
+#undef OPM_Reset
+
+#endif
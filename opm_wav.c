@@ -0,0 +1,133 @@
+#include <string.h>
+#include "opm_wav.h"
+
+#define WAV_CHANNELS 2
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_IEEE_FLOAT 3
+
+// 1回の fwrite でまとめて書くフレーム数 (ビッグエンディアンでの変換用)
+#define WAV_CONVERT_FRAMES 1024
+
+
+// ============================================================
+// 1. Byte Order
+// ============================================================
+
+static int host_is_little_endian(void) {
+    const uint16_t probe = 1;
+    return *(const uint8_t *)&probe == 1;
+}
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+
+// ============================================================
+// 2. Header / Data
+// ============================================================
+
+int opm_wav_write_header(FILE *fp, opm_sample_format_t format, uint32_t sample_rate, uint32_t num_frames) {
+    int is_float = format == OPM_SAMPLE_FLOAT32;
+    uint32_t bytes_per_sample = is_float ? 4 : 2;
+    uint32_t block_align = bytes_per_sample * WAV_CHANNELS;
+
+    // float の場合は fmt を 18 バイト (cbSize 付き) にして fact チャンクを足す
+    uint32_t fmt_size = is_float ? 18 : 16;
+    uint32_t fact_size = is_float ? 12 : 0;
+    uint32_t header_size = 12 + 8 + fmt_size + fact_size + 8;
+
+    uint64_t data_size = (uint64_t)num_frames * block_align;
+    if (data_size + header_size - 8 > UINT32_MAX) return -1;
+
+    uint8_t header[64];
+    uint8_t *p = header;
+    memcpy(p, "RIFF", 4);
+    put_u32(p + 4, (uint32_t)(data_size + header_size - 8));
+    memcpy(p + 8, "WAVE", 4);
+    p += 12;
+
+    memcpy(p, "fmt ", 4);
+    put_u32(p + 4, fmt_size);
+    put_u16(p + 8, is_float ? WAV_FORMAT_IEEE_FLOAT : WAV_FORMAT_PCM);
+    put_u16(p + 10, WAV_CHANNELS);
+    put_u32(p + 12, sample_rate);
+    put_u32(p + 16, sample_rate * block_align);
+    put_u16(p + 20, (uint16_t)block_align);
+    put_u16(p + 22, (uint16_t)(bytes_per_sample * 8));
+    if (is_float) {
+        put_u16(p + 24, 0);
+    }
+    p += 8 + fmt_size;
+
+    if (is_float) {
+        memcpy(p, "fact", 4);
+        put_u32(p + 4, 4);
+        put_u32(p + 8, num_frames);
+        p += fact_size;
+    }
+
+    memcpy(p, "data", 4);
+    put_u32(p + 4, (uint32_t)data_size);
+    p += 8;
+
+    return fwrite(header, 1, header_size, fp) == header_size ? 0 : -1;
+}
+
+int opm_wav_write_frames(FILE *fp, opm_sample_format_t format, const void *samples, size_t num_frames) {
+    size_t bytes_per_sample = format == OPM_SAMPLE_FLOAT32 ? 4 : 2;
+    size_t count = num_frames * WAV_CHANNELS;
+
+    if (host_is_little_endian()) {
+        return fwrite(samples, bytes_per_sample, count, fp) == count ? 0 : -1;
+    }
+
+    // ビッグエンディアンのホストではバイトを入れ替えてから書く
+    const uint8_t *src = (const uint8_t *)samples;
+    uint8_t tmp[WAV_CONVERT_FRAMES * WAV_CHANNELS * 4];
+    while (count > 0) {
+        size_t n = count < WAV_CONVERT_FRAMES * WAV_CHANNELS ? count : WAV_CONVERT_FRAMES * WAV_CHANNELS;
+        for (size_t i = 0; i < n; i++) {
+            for (size_t b = 0; b < bytes_per_sample; b++) {
+                tmp[i * bytes_per_sample + b] = src[i * bytes_per_sample + (bytes_per_sample - 1 - b)];
+            }
+        }
+        if (fwrite(tmp, bytes_per_sample, n, fp) != n) return -1;
+        src += n * bytes_per_sample;
+        count -= n;
+    }
+    return 0;
+}
+
+
+// ============================================================
+// 3. Streaming Render
+// ============================================================
+
+int opm_wav_write_render(FILE *fp, opm_renderer_t *renderer, opm_sample_format_t format, uint32_t num_frames,
+                         void *block, int block_frames) {
+    if (block_frames <= 0) return -1;
+
+    // WAV のサンプルレートは整数なので丸める (OPM のレートのままなら実際は約55930.4Hz)
+    uint32_t sample_rate = (uint32_t)(opm_renderer_output_rate(renderer) + 0.5);
+    if (opm_wav_write_header(fp, format, sample_rate, num_frames) != 0) return -1;
+
+    opm_output_t output;
+    opm_output_init_interleaved(&output, format, block);
+
+    for (uint32_t done = 0; done < num_frames; ) {
+        int frames = num_frames - done < (uint32_t)block_frames ? (int)(num_frames - done) : block_frames;
+        if (opm_renderer_render_block(renderer, frames, &output) != frames) return -1;
+        if (opm_wav_write_frames(fp, format, block, frames) != 0) return -1;
+        done += frames;
+    }
+    return 0;
+}
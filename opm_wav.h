@@ -0,0 +1,34 @@
+// WAV ファイル書き出し
+//
+// ヘッダを先に書き、その後サンプルを少しずつ追記する。フレーム数は
+// 最初に決めておく必要があるが、シークしないので stdout にも書ける。
+#ifndef _OPM_WAV_H_
+#define _OPM_WAV_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "opm_renderer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ステレオ num_frames フレーム分のヘッダを書く。
+// format は OPM_SAMPLE_FLOAT32 (IEEE float) か OPM_SAMPLE_INT16 (PCM)。
+// データが 4GB を超える場合と書き込みエラーのときは -1
+int opm_wav_write_header(FILE *fp, opm_sample_format_t format, uint32_t sample_rate, uint32_t num_frames);
+
+// インターリーブされたサンプルを num_frames フレーム分書く (リトルエンディアンに変換する)
+int opm_wav_write_frames(FILE *fp, opm_sample_format_t format, const void *samples, size_t num_frames);
+
+// 開始済みの renderer から num_frames フレームを取り出し、ヘッダごと WAV として書く。
+// block は block_frames フレーム分 (format のインターリーブ) の作業領域。
+// レンダリングに失敗したら途中で -1 を返す (書きかけのファイルは呼び出し側で消す)
+int opm_wav_write_render(FILE *fp, opm_renderer_t *renderer, opm_sample_format_t format, uint32_t num_frames,
+                         void *block, int block_frames);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,211 @@
+// レンダリング結果のキャッシュ (ブラウザ版)
+//
+// opm_render_cache.c と同じ作り方のキー (正規化したイベント列とチップの設定の FNV-1a 64 ビット) で、
+// レンダリングした L / R (Float32Array) を持つ。ヒットすればエミュレータを回さずに鳴らせる。
+// キーに出力のレートは入らない。
+//   - メモリ: 出力のレートに変換した L / R。合計サイズが maxBytes を超えたら最も長く使っていないものから
+//     捨てる (LRU)。出力のレートを変えたら clear する
+//   - IndexedDB: persist なら書いておき、メモリにないときに読む (リロードしても残る)。
+//     リサンプルした float はそのままでは縮まないので、リサンプル前の OPM のレートの出力を
+//     opm_codec で圧縮したもの (packed) を置き、読むときに unpack (wasm) で L / R に戻す
+// index.html から使う。
+'use strict';
+
+// opm_render_cache.h の OPM_RENDER_CACHE_VERSION と同じ
+const RENDER_CACHE_VERSION = 4;
+const RENDER_CACHE_OPM_RATE = 3579545 / 64;
+const RENDER_CACHE_DB = 'web-ym2151';
+const RENDER_CACHE_STORE = 'renders';
+
+
+// ============================================================
+// 1. Key
+// ============================================================
+
+// FNV-1a 64 ビットを上位 / 下位 32 ビットに分けて回す (BigInt を使わない)
+class Fnv64 {
+    constructor() {
+        this.hi = 0xcbf29ce4;
+        this.lo = 0x84222325;
+        this.scratch = new DataView(new ArrayBuffer(8));
+    }
+
+    // prime = 2^40 + 0x1b3 なので、hash * prime = hash * 0x1b3 + (hash << 40)
+    byte(b) {
+        const lo = (this.lo ^ b) >>> 0;
+        const l = lo * 0x1b3;
+        const carry = Math.floor(l / 4294967296);
+        this.hi = (Math.imul(this.hi, 0x1b3) + carry + (lo << 8)) >>> 0;
+        this.lo = l >>> 0;
+    }
+
+    // C の fnv_u64 と同じく、リトルエンディアンの 8 バイトとして入れる
+    u64(hi, lo) {
+        this.scratch.setUint32(0, lo, true);
+        this.scratch.setUint32(4, hi, true);
+        for (let i = 0; i < 8; i++) this.byte(this.scratch.getUint8(i));
+    }
+
+    // 0 以上の整数 (2^53 未満)
+    uint(v) {
+        this.u64(Math.floor(v / 4294967296), v >>> 0);
+    }
+
+    hex() {
+        return this.hi.toString(16).padStart(8, '0') + this.lo.toString(16).padStart(8, '0');
+    }
+}
+
+// シーケンサ (opm_renderer.c) がイベントを書き始められる最初のサンプル。
+// time は opm_event_t と同じく float に丸めてから使う。NaN (parseFloat できない値など) は
+// シーケンサがすぐ書くので 0、書かれない +Inf などは Number.MAX_SAFE_INTEGER (C と同じ値)
+function renderCacheTriggerSample(time) {
+    const t = Math.fround(parseFloat(time)) * RENDER_CACHE_OPM_RATE;
+    if (!(t > 0)) return 0;
+    return Math.min(Math.ceil(t), Number.MAX_SAFE_INTEGER);
+}
+
+// events は JSON のまま ([{ time, addr, data }, ...])。
+// params: { chip, engine, channelMask, frames }
+// (値は opm_render_cache_params_t と同じ。chip は wasm のレンダラーなら 1 = opm_flags_ym2164、
+// frames は OPM のレートでの長さ)
+function renderCacheKey(events, params) {
+    const h = new Fnv64();
+    h.uint(RENDER_CACHE_VERSION);
+    h.uint(params.chip);
+    h.uint(params.engine);
+    h.uint(params.channelMask & 0xff);
+    h.uint(params.frames);
+
+    h.uint(events.length);
+    for (const evt of events) {
+        h.uint(renderCacheTriggerSample(evt.time));
+        h.uint(((parseInt(evt.addr) & 0xff) << 8) | (parseInt(evt.data) & 0xff));
+    }
+    return h.hex();
+}
+
+
+// ============================================================
+// 2. Cache
+// ============================================================
+
+// unpack(packed, frames) は packed を展開して出力のレートの frames フレームにした { left, right }
+// (失敗なら null) に解決する Promise を返す
+class RenderCache {
+    constructor(maxBytes, persist, unpack) {
+        this.maxBytes = maxBytes;
+        this.bytes = 0;
+        this.entries = new Map(); // key -> { left, right }。Map の順番が古い順 (LRU)
+        this.unpack = unpack;
+        this.db = persist && unpack && typeof indexedDB !== 'undefined' ? this.openDb() : null;
+    }
+
+    // 開けなければ null に解決する (プライベートモードなど)
+    openDb() {
+        return new Promise((resolve) => {
+            let request;
+            try {
+                request = indexedDB.open(RENDER_CACHE_DB, RENDER_CACHE_VERSION);
+            } catch (e) {
+                resolve(null);
+                return;
+            }
+            // 古いバージョンのものは形式が違うので捨てる
+            request.onupgradeneeded = () => {
+                const db = request.result;
+                if (db.objectStoreNames.contains(RENDER_CACHE_STORE)) {
+                    db.deleteObjectStore(RENDER_CACHE_STORE);
+                }
+                db.createObjectStore(RENDER_CACHE_STORE);
+            };
+            request.onsuccess = () => resolve(request.result);
+            request.onerror = () => resolve(null);
+            request.onblocked = () => resolve(null);
+        });
+    }
+
+    // メモリにあるものだけ見る (同期)。なければ null
+    get(key) {
+        const entry = this.entries.get(key);
+        if (!entry) return null;
+        this.entries.delete(key);
+        this.entries.set(key, entry);
+        return entry;
+    }
+
+    // 出力のレートが変わったときに呼ぶ (IndexedDB のものは変換し直して使えるので残す)
+    clear() {
+        this.entries.clear();
+        this.bytes = 0;
+    }
+
+    // key があるかだけ見る。IndexedDB のものはキーだけ調べて展開しない (使うときに load する)
+    async has(key) {
+        if (this.entries.has(key)) return true;
+        if (!this.db) return false;
+        const db = await this.db;
+        if (!db) return false;
+        return new Promise((resolve) => {
+            try {
+                const store = db.transaction(RENDER_CACHE_STORE, 'readonly').objectStore(RENDER_CACHE_STORE);
+                const request = store.getKey ? store.getKey(key) : store.count(key);
+                request.onsuccess = () => resolve(store.getKey ? request.result !== undefined : request.result > 0);
+                request.onerror = () => resolve(false);
+            } catch (e) {
+                resolve(false);
+            }
+        });
+    }
+
+    // メモリになければ IndexedDB を見て、出力のレートの frames フレームに展開する。なければ null に解決する
+    async load(key, frames) {
+        const entry = this.get(key);
+        if (entry || !this.db) return entry;
+        const db = await this.db;
+        if (!db) return null;
+        const stored = await new Promise((resolve) => {
+            const request = db.transaction(RENDER_CACHE_STORE, 'readonly').objectStore(RENDER_CACHE_STORE).get(key);
+            request.onsuccess = () => resolve(request.result || null);
+            request.onerror = () => resolve(null);
+        });
+        if (!stored) return null;
+        const unpacked = await this.unpack(stored.packed, frames);
+        if (!unpacked) return null;
+        this.remember(key, unpacked.left, unpacked.right);
+        return unpacked;
+    }
+
+    // left / right はそのまま持つので、呼び出し側は書き換えないこと。
+    // packed (Uint8Array) がなければメモリにだけ置く
+    put(key, left, right, packed) {
+        this.remember(key, left, right);
+        if (!this.db || !packed) return;
+        this.db.then((db) => {
+            if (!db) return;
+            try {
+                db.transaction(RENDER_CACHE_STORE, 'readwrite').objectStore(RENDER_CACHE_STORE)
+                    .put({ packed }, key);
+            } catch (e) {
+                console.warn('Render cache: cannot persist', e);
+            }
+        });
+    }
+
+    remember(key, left, right) {
+        const size = left.byteLength + right.byteLength;
+        if (size > this.maxBytes) return;
+        if (this.entries.has(key)) {
+            const old = this.entries.get(key);
+            this.bytes -= old.left.byteLength + old.right.byteLength;
+            this.entries.delete(key);
+        }
+        for (const [oldest, entry] of this.entries) {
+            if (this.bytes + size <= this.maxBytes) break;
+            this.bytes -= entry.left.byteLength + entry.right.byteLength;
+            this.entries.delete(oldest);
+        }
+        this.entries.set(key, { left, right });
+        this.bytes += size;
+    }
+}
@@ -0,0 +1,345 @@
+// レンダリング用の Web Worker
+//
+// wasm (sine_test.js / sine_test_simd.js) をこのワーカーで読み込み、メインスレッドを
+// 止めずにレンダリングする。index.html から使う。
+//
+// メッセージ (メインスレッド → ワーカー)
+//   { type: 'init', scripts }   : scripts (読み込む候補の順) の最初に読めたものを使う
+//   { type: 'render', id, engine, events, frames, rate, quality, stream }
+//                               : engine は 'nuked' / 'fast'。events は [{ time, addr, data }, ...]。
+//                                 rate (0 なら OPM のレート) で frames フレーム鳴らす。
+//                                 stream なら書いたブロックを 'block' でも送る (プログレッシブ再生用)
+//   { type: 'unpack', id, packed, frames, rate, quality }
+//                               : 'done' の packed を展開し、rate に変換して frames フレームにする
+//                                 (同じ設定でレンダリングしたのと同じ結果を 'done' で返す)
+//   { type: 'prerender', id, events, frames, rate, quality }
+//                               : 'render' の 'nuked' と同じ (stream なし、'progress' も送らない) だが、
+//                                 ほかのジョブがないときだけ進める先読み (キャッシュを埋める用)
+//   { type: 'cancel', id }      : 待っている、または途中のレンダリングをやめる
+//
+// メッセージ (ワーカー → メインスレッド)
+//   { type: 'ready', script }
+//   { type: 'block', id, offset, left, right } : stream のとき、offset フレーム目からのブロック (transfer)
+//   { type: 'progress', id, done, total }    : ブロックを書くたび
+//   { type: 'done', id, left, right, packed } : L / R の Float32Array。buffer は transfer する。
+//                                              packed は 'nuked' のとき、リサンプル前の出力を opm_codec で
+//                                              圧縮した Uint8Array (キャッシュ用。作れなければ null)
+//   { type: 'cancelled', id }
+//   { type: 'error', id, message }           : id は init の失敗なら 0
+//
+// ジョブは届いた順に1つずつ処理する。BLOCK_FRAMES ごとに処理を返してメッセージを
+// 受け取るので、cancel はブロックの境目で効く。
+// prerender は別のキューと別のレンダラーで、ほかのジョブがないときに1ブロックずつ進める。
+// 途中でジョブが届けばそちらを先に処理し、終わったら続きから再開する。
+// prerender はリセット直後のチップ状態 (1つだけ取っておく) から始める。
+'use strict';
+
+const STRUCT_SIZE = 8;
+const SAMPLE_FLOAT32 = 0;
+const ENGINE_FAST = 1;
+const BLOCK_FRAMES = 8192;
+
+const queue = [];        // 待っているジョブ
+let active = null;       // 処理中のジョブ
+const idleQueue = [];    // 待っている prerender
+let background = null;   // 処理中の prerender (active があれば止めておく)
+let resetSnapshot = 0;   // リセット直後の opm_t (prerender 用)
+const renderers = {};    // engine 名 -> opm_renderer_t
+let blockRegion = 0;     // render_block の出力 (プレーナー float32、L の BLOCK_FRAMES 個の後に R)
+let loadedScript = null;
+
+// setTimeout(0) は入れ子になると 4ms 待たされるので、次のブロックは MessageChannel で回す
+const tick = new MessageChannel();
+let tickPending = false;
+tick.port1.onmessage = () => {
+    tickPending = false;
+    step();
+};
+
+function schedule() {
+    if (!tickPending && (active || queue.length > 0 || background || idleQueue.length > 0)) {
+        tickPending = true;
+        tick.port2.postMessage(null);
+    }
+}
+
+var Module = {
+    onRuntimeInitialized: function() {
+        blockRegion = Module._malloc(BLOCK_FRAMES * 2 * 4);
+        if (!blockRegion) {
+            postMessage({ type: 'error', id: 0, message: 'out of memory' });
+            return;
+        }
+        postMessage({ type: 'ready', script: loadedScript });
+        schedule();
+    }
+};
+
+
+// ============================================================
+// 1. Jobs
+// ============================================================
+
+function getRenderer(engine) {
+    if (!renderers[engine]) {
+        const r = Module._renderer_create();
+        if (!r) return 0;
+        if (engine === 'fast' && Module._renderer_set_engine(r, ENGINE_FAST) !== 0) {
+            Module._renderer_destroy(r);
+            return 0;
+        }
+        renderers[engine] = r;
+    }
+    return renderers[engine];
+}
+
+function releaseJob(job) {
+    if (job.eventsPtr) {
+        Module._free(job.eventsPtr);
+        job.eventsPtr = 0;
+    }
+}
+
+// 取れなければ 0 (prerender は普通に start する)
+function getResetSnapshot(r) {
+    if (!resetSnapshot) {
+        Module._renderer_start(r, 0, 0);
+        resetSnapshot = Module._renderer_snapshot(r);
+    }
+    return resetSnapshot;
+}
+
+// イベントを wasm ヒープに書き、出力先を確保して先頭に戻す。失敗時は false
+function startJob(job) {
+    // prerender は止めておく間も状態を持つので、ほかのジョブとレンダラーを分ける
+    job.renderer = getRenderer(job.prerender ? 'prerender' : job.engine);
+    if (!job.renderer || Module._renderer_set_output_rate(job.renderer, job.rate, job.quality) !== 0) {
+        return false;
+    }
+    // 正確な結果はキャッシュに置くので、OPM のレートの出力も取っておく (確保はここで済ませる。
+    // できなければキャッシュに置かないだけ)
+    if (job.prerender || job.engine !== 'fast') {
+        Module._renderer_set_capture(job.renderer, job.frames);
+    }
+
+    const count = job.events.length;
+    job.eventsPtr = Module._malloc(Math.max(count, 1) * STRUCT_SIZE);
+    if (!job.eventsPtr) return false;
+    const view = new DataView(Module.HEAPU8.buffer);
+    job.events.forEach((evt, i) => {
+        const base = job.eventsPtr + i * STRUCT_SIZE;
+        view.setFloat32(base, parseFloat(evt.time), true);
+        Module.HEAPU8[base + 4] = parseInt(evt.addr);
+        Module.HEAPU8[base + 5] = parseInt(evt.data);
+        Module.HEAPU8[base + 6] = 0;
+        Module.HEAPU8[base + 7] = 0;
+    });
+
+    job.left = new Float32Array(job.frames);
+    job.right = new Float32Array(job.frames);
+    job.done = 0;
+    const snapshot = job.prerender ? getResetSnapshot(job.renderer) : 0;
+    if (snapshot) {
+        Module._renderer_start_from(job.renderer, snapshot, job.eventsPtr, count);
+    } else {
+        Module._renderer_start(job.renderer, job.eventsPtr, count);
+    }
+    return true;
+}
+
+// start から取っておいた出力を圧縮して JS 側にコピーする。作れなければ null
+function packCapture(renderer) {
+    const sizePtr = Module._malloc(4);
+    if (!sizePtr) return null;
+    const ptr = Module._renderer_pack_capture(renderer, sizePtr);
+    const size = Module.getValue(sizePtr, 'i32');
+    Module._free(sizePtr);
+    if (!ptr) return null;
+    const packed = Module.HEAPU8.slice(ptr, ptr + size);
+    Module._free(ptr);
+    return packed;
+}
+
+// packed をヒープに置いて展開する
+function unpackJob(job) {
+    const dataPtr = Module._malloc(Math.max(job.packed.length, 1));
+    const leftPtr = Module._malloc(Math.max(job.frames, 1) * 4);
+    const rightPtr = Module._malloc(Math.max(job.frames, 1) * 4);
+    let written = 0;
+    if (dataPtr && leftPtr && rightPtr) {
+        Module.HEAPU8.set(job.packed, dataPtr);
+        written = Module._unpack_render(dataPtr, job.packed.length, job.rate, job.quality, leftPtr, rightPtr, job.frames);
+    }
+    if (written === job.frames) {
+        const left = Module.HEAPF32.slice(leftPtr >> 2, (leftPtr >> 2) + written);
+        const right = Module.HEAPF32.slice(rightPtr >> 2, (rightPtr >> 2) + written);
+        postMessage({ type: 'done', id: job.id, left, right, packed: null }, [left.buffer, right.buffer]);
+    } else {
+        postMessage({ type: 'error', id: job.id, message: 'cannot unpack' });
+    }
+    Module._free(dataPtr);
+    Module._free(leftPtr);
+    Module._free(rightPtr);
+}
+
+// 展開はここで済ませる。レンダリングを始めたら true
+function beginJob(job) {
+    if (job.packed) {
+        unpackJob(job);
+        return false;
+    }
+    if (!startJob(job)) {
+        releaseJob(job);
+        postMessage({ type: 'error', id: job.id, message: 'cannot start render' });
+        return false;
+    }
+    return true;
+}
+
+// 終わった、またはやめたジョブを外す
+function clearJob(job) {
+    if (job === active) {
+        active = null;
+    } else {
+        background = null;
+    }
+}
+
+// 1ブロック進める。prerender はほかのジョブがないときだけ
+function step() {
+    if (!blockRegion) return;
+    if (!active && queue.length > 0) {
+        active = queue.shift();
+        if (!beginJob(active)) {
+            active = null;
+            schedule();
+            return;
+        }
+    }
+    if (!active && !background) {
+        background = idleQueue.shift() || null;
+        if (!background) return;
+        if (!beginJob(background)) {
+            background = null;
+            schedule();
+            return;
+        }
+    }
+
+    const job = active || background;
+    const frames = Math.min(BLOCK_FRAMES, job.frames - job.done);
+    const written = frames > 0 ? Module._renderer_render_block_to(
+        job.renderer, frames, SAMPLE_FLOAT32, blockRegion, blockRegion + BLOCK_FRAMES * 4, 1) : 0;
+    if (frames > 0 && written <= 0) {
+        releaseJob(job);
+        postMessage({ type: 'error', id: job.id, message: 'render failed' });
+        clearJob(job);
+        schedule();
+        return;
+    }
+
+    // ヒープが伸びると HEAPF32 が作り直されるので、毎回ここで参照する
+    const base = blockRegion >> 2;
+    job.left.set(Module.HEAPF32.subarray(base, base + written), job.done);
+    job.right.set(Module.HEAPF32.subarray(base + BLOCK_FRAMES, base + BLOCK_FRAMES + written), job.done);
+    if (job.stream && written > 0) {
+        const left = job.left.slice(job.done, job.done + written);
+        const right = job.right.slice(job.done, job.done + written);
+        postMessage({ type: 'block', id: job.id, offset: job.done, left, right }, [left.buffer, right.buffer]);
+    }
+    job.done += written;
+    if (!job.prerender) {
+        postMessage({ type: 'progress', id: job.id, done: job.done, total: job.frames });
+    }
+
+    if (job.done >= job.frames) {
+        releaseJob(job);
+        const packed = job.engine === 'nuked' ? packCapture(job.renderer) : null;
+        const transfer = [job.left.buffer, job.right.buffer];
+        if (packed) transfer.push(packed.buffer);
+        postMessage({ type: 'done', id: job.id, left: job.left, right: job.right, packed }, transfer);
+        clearJob(job);
+    }
+    schedule();
+}
+
+function cancel(id) {
+    const running = [active, background].find(job => job && job.id === id);
+    if (running) {
+        releaseJob(running);
+        clearJob(running);
+    } else {
+        const waiting = queue.some(job => job.id === id) ? queue : idleQueue;
+        const index = waiting.findIndex(job => job.id === id);
+        if (index < 0) return;
+        waiting.splice(index, 1);
+    }
+    postMessage({ type: 'cancelled', id });
+    schedule();
+}
+
+
+// ============================================================
+// 2. Messages
+// ============================================================
+
+// 読めなければ (ファイルがない) 次の候補を試す
+function loadEngine(scripts) {
+    for (const script of scripts) {
+        try {
+            loadedScript = script;
+            importScripts(script);
+            return;
+        } catch (e) {
+            console.warn(`render_worker: cannot load ${script}`);
+        }
+    }
+    postMessage({ type: 'error', id: 0, message: 'no engine could be loaded' });
+}
+
+onmessage = (e) => {
+    const msg = e.data;
+    switch (msg.type) {
+    case 'init':
+        loadEngine(msg.scripts);
+        break;
+    case 'render':
+        queue.push({
+            id: msg.id,
+            engine: msg.engine === 'fast' ? 'fast' : 'nuked',
+            events: msg.events,
+            frames: Math.max(0, Math.floor(msg.frames)),
+            rate: msg.rate || 0,
+            quality: msg.quality || 0,
+            stream: !!msg.stream
+        });
+        schedule();
+        break;
+    case 'prerender':
+        idleQueue.push({
+            id: msg.id,
+            engine: 'nuked',
+            prerender: true,
+            events: msg.events,
+            frames: Math.max(0, Math.floor(msg.frames)),
+            rate: msg.rate || 0,
+            quality: msg.quality || 0,
+            stream: false
+        });
+        schedule();
+        break;
+    case 'unpack':
+        queue.push({
+            id: msg.id,
+            packed: msg.packed,
+            frames: Math.max(0, Math.floor(msg.frames)),
+            rate: msg.rate || 0,
+            quality: msg.quality || 0
+        });
+        schedule();
+        break;
+    case 'cancel':
+        cancel(msg.id);
+        break;
+    }
+};
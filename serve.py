@@ -0,0 +1,31 @@
+#!/usr/bin/env python3
+# ローカル確認用 HTTP サーバー
+#
+# python3 -m http.server と同じだが、SharedArrayBuffer (Emscripten の pthreads)
+# を使えるように cross-origin isolation 用のヘッダを付ける。
+#
+# 使い方: python3 serve.py [ポート番号]
+
+import sys
+from http.server import SimpleHTTPRequestHandler, ThreadingHTTPServer
+
+
+class IsolatedRequestHandler(SimpleHTTPRequestHandler):
+    def end_headers(self):
+        self.send_header("Cross-Origin-Opener-Policy", "same-origin")
+        self.send_header("Cross-Origin-Embedder-Policy", "require-corp")
+        super().end_headers()
+
+
+def main():
+    port = int(sys.argv[1]) if len(sys.argv) > 1 else 8000
+    server = ThreadingHTTPServer(("", port), IsolatedRequestHandler)
+    print(f"Serving on http://localhost:{port}/ (cross-origin isolated)")
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
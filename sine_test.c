@@ -1,181 +1,310 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
-#include <math.h>
 #include <emscripten.h>
-#include "opm.h"
+#ifdef __EMSCRIPTEN_PTHREADS__
+#include <emscripten/threading.h>
+#include "opm_render_pool.h"
+#endif
+#include "opm_renderer.h"
+#include "opm_codec.h"
+#include "opm_profile.h"
 
-// --- 定数定義 ---
-#define BUSY_CYCLES 128     
-#define CLOCK_STEP 64       
-#define OPM_CLOCK 3579545   
+// --- グローバル変数 ---
+// generate_sound / get_sample 用の既定のレンダラー (初回に作る)
+static opm_renderer_t *default_renderer = NULL;
 
-// サンプルレート (約55930Hz)
-#define SAMPLE_RATE ((double)OPM_CLOCK / CLOCK_STEP)
 
-// 1アクションあたりの待機サンプル数
-#define SAMPLES_PER_ACCESS ((double)BUSY_CYCLES / CLOCK_STEP)
+// ============================================================
+// 1. Renderer Handle API
+// ============================================================
+//
+// JS から opm_renderer_t をハンドル (ポインタ) として直接扱う。
+// レンダラーはいくつでも同時に持てる (複数トラック、A/B 比較など)
 
-// --- データ構造 ---
+EMSCRIPTEN_KEEPALIVE
+opm_renderer_t *renderer_create() {
+    return opm_renderer_create();
+}
 
-typedef struct {
-    float time;     
-    uint8_t addr;   
-    uint8_t data;   
-    uint8_t pad[2]; 
-} opm_event_t;
+EMSCRIPTEN_KEEPALIVE
+void renderer_destroy(opm_renderer_t *r) {
+    opm_renderer_destroy(r);
+}
 
-typedef struct {
-    opm_event_t *events;          
-    int count;                    
-    int current_index;            
-    double next_available_sample; 
-    int pending_data_write;       
-} sequencer_t;
+// 戻り値は生成したフレーム数
+EMSCRIPTEN_KEEPALIVE
+int renderer_render(opm_renderer_t *r, void *event_data_ptr, int event_count, int num_samples) {
+    return opm_renderer_render(r, (const opm_event_t *)event_data_ptr, event_count, num_samples);
+}
 
-// --- グローバル変数 ---
-static opm_t chip;
-static float *global_buffer = NULL;
-static int global_total_floats = 0; // floatの総数（サンプル数 × 2）
+// 呼び出し側が確保したメモリに直接書く (format: 0 = float32, 1 = int16)。
+// left / right / stride の意味は opm_output_t と同じ。レンダリング中は確保しない
+EMSCRIPTEN_KEEPALIVE
+int renderer_render_to(opm_renderer_t *r, void *event_data_ptr, int event_count, int num_samples,
+                       int format, void *left, void *right, int stride) {
+    opm_output_t out;
+    out.format = format == 1 ? OPM_SAMPLE_INT16 : OPM_SAMPLE_FLOAT32;
+    out.left = left;
+    out.right = right;
+    out.stride = stride;
+    return opm_renderer_render_to(r, (const opm_event_t *)event_data_ptr, event_count, num_samples, &out);
+}
 
+// ストリーミング用 (render_worker.js)。renderer_start で先頭に戻し、
+// renderer_render_block_to を呼ぶたびに続きの num_frames フレームを書く。
+// events は最後の renderer_render_block_to まで解放しないこと
+EMSCRIPTEN_KEEPALIVE
+void renderer_start(opm_renderer_t *r, void *event_data_ptr, int event_count) {
+    opm_renderer_start(r, (const opm_event_t *)event_data_ptr, event_count);
+}
 
-// ============================================================
-// 1. OPM Hardware Control
-// ============================================================
+// renderer_start と同じだが、OPM_Reset せずに snapshot (renderer_snapshot で取ったもの) から始める。
+// リセット直後のものを1つ取っておけば、短いものを続けて鳴らすときにリセットを回さずに済む
+EMSCRIPTEN_KEEPALIVE
+void renderer_start_from(opm_renderer_t *r, const opm_t *snapshot, void *event_data_ptr, int event_count) {
+    opm_renderer_start_from(r, snapshot, (const opm_event_t *)event_data_ptr, event_count);
+}
 
-static void opm_initialize() {
-    OPM_Reset(&chip, OPM_CLOCK);
+// 現在のチップ状態のコピー。戻り値は malloc した領域 (JS が _free する)。失敗時は 0
+EMSCRIPTEN_KEEPALIVE
+opm_t *renderer_snapshot(opm_renderer_t *r) {
+    const opm_t *chip = opm_renderer_chip(r);
+    opm_t *snapshot = chip ? (opm_t *)malloc(sizeof(opm_t)) : NULL;
+    if (snapshot) *snapshot = *chip;
+    return snapshot;
 }
 
-// 1サンプル分の処理を行い、L/Rの結果をポインタに返す
-static void opm_render_stereo(float *out_l, float *out_r) {
-    int32_t sample_buf[2];
-    uint8_t sh1, sh2, so;
-    
-    // CLOCK_STEP分回す
-    for (int j = 0; j < CLOCK_STEP; j++) {
-        OPM_Clock(&chip, sample_buf, &sh1, &sh2, &so);
-    }
-    
-    // OPMの出力を正規化して書き込み
-    // ミックスせず、LとRを独立して返す
-    *out_l = (float)sample_buf[0] / 32768.0f;
-    *out_r = (float)sample_buf[1] / 32768.0f;
+EMSCRIPTEN_KEEPALIVE
+int renderer_render_block_to(opm_renderer_t *r, int num_frames, int format, void *left, void *right, int stride) {
+    opm_output_t out;
+    out.format = format == 1 ? OPM_SAMPLE_INT16 : OPM_SAMPLE_FLOAT32;
+    out.left = left;
+    out.right = right;
+    out.stride = stride;
+    return opm_renderer_render_block(r, num_frames, &out);
 }
 
+// 出力のサンプルレートを rate (AudioContext.sampleRate など) にする。
+// quality: 0 = fast, 1 = medium, 2 = high。0 以下の rate で OPM のレートに戻す
+EMSCRIPTEN_KEEPALIVE
+int renderer_set_output_rate(opm_renderer_t *r, double rate, int quality) {
+    return opm_renderer_set_output_rate(r, rate, (opm_resample_quality_t)quality);
+}
 
-// ============================================================
-// 2. Memory Management
-// ============================================================
+// ミックスに入れるチャンネル (bit ch が 1 のものだけ鳴らす。0xFF で全部)。
+// チップの状態は変わらないので、ソロ / ミュートの切り替えに使える
+EMSCRIPTEN_KEEPALIVE
+void renderer_set_channel_mask(opm_renderer_t *r, int mask) {
+    opm_renderer_set_channel_mask(r, (uint8_t)mask);
+}
 
-// ステレオなので、必要な「floatの個数」は num_frames * 2 になる点に注意
-static int buffer_ensure_capacity(int num_floats) {
-    if (global_buffer) {
-        free(global_buffer);
-    }
-    
-    global_buffer = (float*)malloc(sizeof(float) * num_floats);
-    if (!global_buffer) {
-        global_total_floats = 0;
-        return 0;
-    }
-    
-    global_total_floats = num_floats;
-    return 1;
+// チップのエミュレーション (0 = Nuked、1 = サンプル単位の近似エンジン)。render の前に呼ぶ。
+// 大量のプレビューなど、多少の誤差より速さが欲しいときに 1 にする
+EMSCRIPTEN_KEEPALIVE
+int renderer_set_engine(opm_renderer_t *r, int engine) {
+    return opm_renderer_set_engine(r, engine == 1 ? OPM_RENDERER_ENGINE_FAST : OPM_RENDERER_ENGINE_NUKED);
 }
 
+// renderer_render で書く形式 (0 = float32, 1 = int16)。int16 ならメモリが半分になる
+EMSCRIPTEN_KEEPALIVE
+void renderer_set_buffer_format(opm_renderer_t *r, int format) {
+    opm_renderer_set_buffer_format(r, format == 1 ? OPM_SAMPLE_INT16 : OPM_SAMPLE_FLOAT32);
+}
 
-// ============================================================
-// 3. Sequencer Logic
-// ============================================================
+// リサンプルして int16 で出すときに TPDF ディザをかける (0 / 1)
+EMSCRIPTEN_KEEPALIVE
+void renderer_set_dither(opm_renderer_t *r, int enabled) {
+    opm_renderer_set_dither(r, enabled);
+}
 
-static void sequencer_init(sequencer_t *seq, void *event_data_ptr, int event_count) {
-    seq->events = (opm_event_t *)event_data_ptr;
-    seq->count = event_count;
-    seq->current_index = 0;
-    seq->next_available_sample = 0.0;
-    seq->pending_data_write = 0; 
+// 出力バッファ ([L0, R0, L1, R1, ...]) の先頭。
+// JS からは float32 なら HEAPF32、int16 なら HEAP16 で読む
+EMSCRIPTEN_KEEPALIVE
+const void *renderer_get_buffer(opm_renderer_t *r) {
+    return opm_renderer_buffer_data(r);
 }
 
-static void sequencer_process(sequencer_t *seq, int current_sample_idx) {
-    if (seq->current_index >= seq->count) {
-        return;
-    }
+EMSCRIPTEN_KEEPALIVE
+int renderer_get_buffer_length(opm_renderer_t *r) {
+    return opm_renderer_buffer_length(r);
+}
 
-    opm_event_t *evt = &seq->events[seq->current_index];
-    
-    double trigger_sample = evt->time * SAMPLE_RATE;
-    if ((double)current_sample_idx < trigger_sample) {
-        return;
-    }
+// キャッシュ用に、出力のレートで max_frames フレームまで鳴らした OPM のレートの出力も取っておく
+// (0 で無効)。確保はここで済ませる。成功時 0、失敗時 -1
+EMSCRIPTEN_KEEPALIVE
+int renderer_set_capture(opm_renderer_t *r, int max_frames) {
+    return opm_renderer_set_capture(r, max_frames);
+}
 
-    if ((double)current_sample_idx < seq->next_available_sample) {
-        return;
-    }
+// start から取っておいた出力を opm_codec で圧縮する。戻り値は malloc した領域
+// (JS が _free する) で、*size にバイト数を入れる。失敗時は 0
+EMSCRIPTEN_KEEPALIVE
+void *renderer_pack_capture(opm_renderer_t *r, uint32_t *size) {
+    int frames;
+    const float *capture = opm_renderer_capture(r, &frames);
+    size_t bytes = 0;
+    void *packed = capture && frames > 0 ? opm_codec_encode(capture, OPM_SAMPLE_FLOAT32, frames, 0, &bytes) : NULL;
+    *size = (uint32_t)bytes;
+    return packed;
+}
 
-    if (seq->pending_data_write == 0) {
-        OPM_Write(&chip, 0, evt->addr);
-        seq->pending_data_write = 1;
-        seq->next_available_sample = (double)current_sample_idx + SAMPLES_PER_ACCESS;
-    } else {
-        OPM_Write(&chip, 1, evt->data);
-        seq->pending_data_write = 0;
-        seq->current_index++;
-        seq->next_available_sample = (double)current_sample_idx + SAMPLES_PER_ACCESS;
+// renderer_pack_capture したものを展開し、set_output_rate(rate, quality) したレンダラーが
+// 書くのと同じ num_frames フレームを left / right (プレーナー float32) に書く。
+// 書いたフレーム数を返す (壊れていれば 0)
+EMSCRIPTEN_KEEPALIVE
+int unpack_render(const void *data, int size, double rate, int quality, float *left, float *right, int num_frames) {
+    opm_codec_info_t info;
+    if (size <= 0 || opm_codec_info(data, (size_t)size, &info) != 0 || info.format != OPM_SAMPLE_FLOAT32) return 0;
+
+    float *frames = (float *)malloc(sizeof(float) * 2 * (size_t)(info.num_frames > 0 ? info.num_frames : 1));
+    int written = 0;
+    if (frames && opm_codec_decode(data, (size_t)size, 0, info.num_frames, frames) == info.num_frames) {
+        opm_output_t out;
+        opm_output_init_planar(&out, OPM_SAMPLE_FLOAT32, left, right);
+        written = opm_renderer_resample(frames, info.num_frames, rate, (opm_resample_quality_t)quality, 0,
+                                        num_frames, &out);
     }
+    free(frames);
+    return written;
 }
 
 
 // ============================================================
-// 4. Main Orchestrator
+// 2. Main Orchestrator
 // ============================================================
 
+static opm_renderer_t *get_default_renderer() {
+    if (!default_renderer) {
+        default_renderer = opm_renderer_create();
+    }
+    return default_renderer;
+}
+
 EMSCRIPTEN_KEEPALIVE
 int generate_sound(void *event_data_ptr, int event_count, int num_samples) {
-    if (num_samples <= 0) return 0;
+    opm_renderer_t *r = get_default_renderer();
+    if (!r) return 0;
 
-    // 修正: ステレオなのでサンプル数×2倍のfloat領域を確保する
-    if (!buffer_ensure_capacity(num_samples * 2)) return 0;
+    // 生成したフレーム数(時間)を返す
+    return opm_renderer_render(r, (const opm_event_t *)event_data_ptr, event_count, num_samples);
+}
 
-    opm_initialize();
+// 複数のイベント列を SIMD エンジンでまとめて鳴らす。
+// event_ptrs / event_counts は num_voices 個の配列 (int32)。
+// 結果は voice ごとに num_samples * 2 個の float を連続して並べる
+// (voice v のサンプル i は (v * num_samples + i) * 2 + {0,1})
+EMSCRIPTEN_KEEPALIVE
+int generate_sound_multi(int num_voices, int32_t *event_ptrs, int32_t *event_counts, int num_samples) {
+    opm_renderer_t *r = get_default_renderer();
+    if (!r || num_voices <= 0) return 0;
+
+    const opm_event_t **events = (const opm_event_t **)malloc(sizeof(opm_event_t *) * num_voices);
+    int *counts = (int *)malloc(sizeof(int) * num_voices);
+    int frames = 0;
+    if (events && counts) {
+        for (int v = 0; v < num_voices; v++) {
+            events[v] = (const opm_event_t *)(intptr_t)event_ptrs[v];
+            counts[v] = event_counts[v];
+        }
+        frames = opm_renderer_render_multi(r, events, counts, num_voices, num_samples);
+    }
+    free(events);
+    free(counts);
+    return frames;
+}
+
+
+// ============================================================
+// 3. Render Thread Pool (-pthread ビルドのみ)
+// ============================================================
+//
+// メインスレッドを止めずに、独立したレンダージョブを opm_render_pool で
+// 並行して処理する。終わったらメインスレッドで
+// Module.onRenderJobDone(job_id, frames) を呼ぶ。
 
-    sequencer_t seq;
-    sequencer_init(&seq, event_data_ptr, event_count);
+#ifdef __EMSCRIPTEN_PTHREADS__
 
-    for (int i = 0; i < num_samples; i++) {
-        sequencer_process(&seq, i);
+static opm_render_pool_t *pool = NULL;
 
-        // ステレオで取得して書き込む
-        float l, r;
-        opm_render_stereo(&l, &r);
+// メインスレッドで実行される。JS 側にジョブ完了を通知する
+static void render_pool_notify(int job_id, int frames) {
+    EM_ASM({
+        if (Module.onRenderJobDone) Module.onRenderJobDone($0, $1);
+    }, job_id, frames);
+}
 
-        // インターリーブ形式 (L, R, L, R...) で格納
-        global_buffer[i * 2 + 0] = l;
-        global_buffer[i * 2 + 1] = r;
+// ワーカースレッドから呼ばれるので、メインスレッドに投げ直す
+static void render_pool_done(int job_id, int frames, void *user) {
+    (void)user;
+    emscripten_async_run_in_main_runtime_thread(EM_FUNC_SIG_VII, render_pool_notify, job_id, frames);
+}
+
+// スレッドを num_threads 本起動する。起動できた本数を返す
+EMSCRIPTEN_KEEPALIVE
+int render_pool_start(int num_threads) {
+    if (!pool) {
+        pool = opm_render_pool_create(num_threads, render_pool_done, NULL);
     }
-    
-    // 生成したフレーム数(時間)を返す
-    return num_samples;
+    return opm_render_pool_thread_count(pool);
+}
+
+// ジョブを積んで job_id を返す (失敗時は 0)。
+// イベントはコピーするので、呼び出し後すぐに解放してよい
+EMSCRIPTEN_KEEPALIVE
+int render_pool_submit(void *event_data_ptr, int event_count, int num_samples) {
+    return opm_render_pool_submit(pool, (const opm_event_t *)event_data_ptr, event_count, num_samples);
 }
 
+// これ以降に submit するジョブの出力レート (renderer_set_output_rate と同じ)
+EMSCRIPTEN_KEEPALIVE
+void render_pool_set_output_rate(double rate, int quality) {
+    opm_render_pool_set_output_rate(pool, rate, (opm_resample_quality_t)quality);
+}
+
+// 完了したジョブの出力バッファ (float を num_samples * 2 個) を返す。
+// 未完了・不明なジョブは NULL
+EMSCRIPTEN_KEEPALIVE
+const float *render_pool_get_buffer(int job_id) {
+    return opm_render_pool_get_buffer(pool, job_id);
+}
+
+// 完了したジョブを解放する。実行中・待ち行列中のジョブは解放しない (0 を返す)
+EMSCRIPTEN_KEEPALIVE
+int render_pool_release(int job_id) {
+    return opm_render_pool_release(pool, job_id);
+}
+
+#endif // __EMSCRIPTEN_PTHREADS__
+
 // ------------------------------------------------------------
 // JS Helper Functions
 // ------------------------------------------------------------
 
 EMSCRIPTEN_KEEPALIVE
 float get_sample(int index) {
-    // 範囲チェックは global_total_floats (確保した全要素数) で行う
-    if (global_buffer && index >= 0 && index < global_total_floats) {
-        return global_buffer[index];
+    // 範囲チェックは直前の render で書いた float の個数で行う
+    const float *buffer = opm_renderer_buffer(default_renderer);
+    if (buffer && index >= 0 && index < opm_renderer_buffer_length(default_renderer)) {
+        return buffer[index];
     }
     return 0.0f;
 }
 
+// ステージ別の計測値を 0 に戻す (OPM_PROFILE=1 ./build.sh のときだけ計測する)
+EMSCRIPTEN_KEEPALIVE
+void profile_reset() {
+    opm_profile_reset();
+}
+
+// ステージ別の計測結果をコンソールに出す
+EMSCRIPTEN_KEEPALIVE
+void profile_report() {
+    opm_profile_report(stdout);
+}
+
 EMSCRIPTEN_KEEPALIVE
 void free_buffer() {
-    if (global_buffer) {
-        free(global_buffer);
-        global_buffer = NULL;
-        global_total_floats = 0;
-    }
+    opm_renderer_destroy(default_renderer);
+    default_renderer = NULL;
 }
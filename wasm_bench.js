@@ -0,0 +1,397 @@
+#!/usr/bin/env node
+// wasm 版のベンチマーク (Node.js)
+//
+// build.sh で作った sine_test.js / sine_test.wasm (または SIMD 版) をブラウザなしで
+// 読み込み、index.html と同じように _generate_sound を呼んで次を測る。
+//   - presets.json の全エントリと合成した負荷の実時間比
+//   - wasm ヒープの大きさ (最初と最大)
+//   - 結果を JS に読み出すコスト:
+//       get_sample    : _get_sample を1サンプルずつ呼ぶ
+//       deinterleave  : _renderer_render の [L, R, ...] を HEAPF32 から L / R に分ける
+//                       (レンダースレッド版の index.html と同じ)
+//       planar        : _renderer_render_to でプレーナーに書かせてコピーする
+//                       (シングルスレッド版の index.html と同じ)
+//
+// 出力は opm-bench と同じ形の JSON。checksum も opm-bench と同じ方法 (出力の float の
+// FNV-1a) で作るので、同じプリセットならネイティブ版と一致する。
+//
+//   node wasm_bench.js > wasm_bench.json
+//   node wasm_bench.js -m sine_test_simd.js -t 5 -n 5 -o wasm_bench.json
+'use strict';
+
+const fs = require('fs');
+const path = require('path');
+
+const OPM_SAMPLE_RATE = 3579545 / 64;
+const STRUCT_SIZE = 8;
+const SAMPLE_FLOAT32 = 0;
+
+
+// ============================================================
+// 1. Command Line
+// ============================================================
+
+function printUsage() {
+    process.stderr.write(
+        'usage: node wasm_bench.js [options]\n' +
+        '\n' +
+        'options:\n' +
+        '  -m, --module FILE     Emscripten build to load (default: sine_test.js)\n' +
+        '  -i, --input FILE      presets.json to benchmark (default: presets.json, "none" to skip)\n' +
+        '  -o, --output FILE     JSON results (default: stdout)\n' +
+        '  -t, --seconds SEC     audio length for the stress cases (default: 2)\n' +
+        '  -n, --repeat N        runs per case; the fastest is reported (default: 3)\n' +
+        '  -q, --quiet           do not print the summary to stderr\n' +
+        '  -h, --help            show this help\n');
+}
+
+function parseOptions(argv) {
+    const opt = {
+        module: 'sine_test.js',
+        input: 'presets.json',
+        output: '-',
+        seconds: 2.0,
+        repeat: 3,
+        quiet: false
+    };
+    for (let i = 0; i < argv.length; i++) {
+        const arg = argv[i];
+        const value = () => {
+            if (i + 1 >= argv.length) throw new Error(`${arg} needs a value`);
+            return argv[++i];
+        };
+        switch (arg) {
+        case '-m': case '--module': opt.module = value(); break;
+        case '-i': case '--input': opt.input = value(); break;
+        case '-o': case '--output': opt.output = value(); break;
+        case '-t': case '--seconds': opt.seconds = parseFloat(value()); break;
+        case '-n': case '--repeat': opt.repeat = parseInt(value(), 10); break;
+        case '-q': case '--quiet': opt.quiet = true; break;
+        case '-h': case '--help': printUsage(); return null;
+        default: throw new Error(`unknown option: ${arg}`);
+        }
+    }
+    if (!(opt.seconds > 0 && opt.seconds <= 600)) throw new Error('invalid length');
+    if (!(opt.repeat > 0)) throw new Error('invalid repeat count');
+    return opt;
+}
+
+
+// ============================================================
+// 2. Module Loading
+// ============================================================
+
+// build.sh の出力は <script> で読む前提 (MODULARIZE なし) なので、
+// index.html と同じく Module を先に用意してからスクリプトを評価する
+function loadModule(file) {
+    const filename = path.resolve(file);
+    const source = fs.readFileSync(filename, 'utf8');
+    return new Promise((resolve, reject) => {
+        const Module = {
+            onRuntimeInitialized: () => resolve(Module),
+            onAbort: (what) => reject(new Error(`wasm aborted: ${what}`)),
+            print: (text) => process.stderr.write(text + '\n'),
+            printErr: (text) => process.stderr.write(text + '\n')
+        };
+        const run = new Function('Module', 'require', '__filename', '__dirname', source);
+        run(Module, require, filename, path.dirname(filename));
+    });
+}
+
+
+// ============================================================
+// 3. Event Sequences
+// ============================================================
+
+function parseNumber(value) {
+    return typeof value === 'number' ? value : parseInt(value);
+}
+
+// { time, addr, data } の配列 (index.html と同じ形式)
+function loadPresets(file) {
+    const json = JSON.parse(fs.readFileSync(file, 'utf8'));
+    const bank = Array.isArray(json) ? json : [json];
+    return bank.map((preset, i) => ({
+        name: preset.name ? `${i}:${preset.name}` : `${i}`,
+        events: preset.events.map(e => ({
+            time: Math.fround(parseFloat(e.time)), // C 側と同じく float にする
+            addr: parseNumber(e.addr),
+            data: parseNumber(e.data)
+        }))
+    }));
+}
+
+const STRESS_LFO = 1;
+const STRESS_NOISE = 2;
+const STRESS_DENSE = 4;
+
+// opm_bench.c の build_stress と同じ列 (変えるときは両方変える)
+function buildStress(flags, seconds) {
+    const events = [];
+    const add = (time, addr, data) => events.push({ time: time, addr: addr, data: data });
+
+    if (flags & STRESS_LFO) {
+        add(0, 0x18, 0xC0);
+        add(0, 0x19, 0x7F);
+        add(0, 0x19, 0x80 | 0x40);
+        add(0, 0x1B, 0x02);
+    }
+    if (flags & STRESS_NOISE) {
+        add(0, 0x0F, 0x80 | 0x10);
+    }
+
+    for (let ch = 0; ch < 8; ch++) {
+        add(0, 0x20 + ch, 0xC0 | (3 << 3) | 4);
+        add(0, 0x28 + ch, 0x3A + ch * 8);
+        add(0, 0x30 + ch, 0x00);
+        add(0, 0x38 + ch, (flags & STRESS_LFO) ? 0x73 : 0x00);
+        for (let op = 0; op < 4; op++) {
+            const slot = op * 8 + ch;
+            const carrier = op === 1 || op === 3;
+            add(0, 0x40 + slot, 0x01 + op);
+            add(0, 0x60 + slot, carrier ? 0x10 : 0x24);
+            add(0, 0x80 + slot, 0x1F);
+            add(0, 0xA0 + slot, (flags & STRESS_LFO) ? 0x80 : 0x00);
+            add(0, 0xC0 + slot, 0x00);
+            add(0, 0xE0 + slot, 0x0F);
+        }
+        add(0, 0x08, 0x78 | ch);
+    }
+
+    if (flags & STRESS_DENSE) {
+        const writes = Math.floor(seconds * OPM_SAMPLE_RATE / 2.0);
+        for (let i = 0; i < writes; i++) {
+            const time = Math.fround(i * 2.0 / OPM_SAMPLE_RATE);
+            const ch = i & 7;
+            if (i & 8) {
+                add(time, 0x28 + ch, 0x30 + ((i >> 4) & 0x3F));
+            } else {
+                add(time, 0x60 + 8 + ch, 0x10 + ((i >> 4) & 0x0F));
+            }
+        }
+    }
+    return events;
+}
+
+const STRESS_CASES = [
+    { name: '8ch', flags: 0 },
+    { name: '8ch_lfo', flags: STRESS_LFO },
+    { name: '8ch_noise', flags: STRESS_NOISE },
+    { name: '8ch_dense', flags: STRESS_DENSE },
+    { name: '8ch_lfo_noise_dense', flags: STRESS_LFO | STRESS_NOISE | STRESS_DENSE }
+];
+
+// 最後のイベントの時刻 + 1 秒 (index.html の calculateDuration と同じ)
+function eventsDuration(events) {
+    let maxTime = 0.0;
+    for (const e of events) {
+        if (e.time > maxTime) maxTime = e.time;
+    }
+    return maxTime + 1.0;
+}
+
+
+// ============================================================
+// 4. Benchmarks
+// ============================================================
+
+// FNV-1a (opm_bench.c の checksum_update と同じ)
+function checksum(bytes) {
+    let hash = 2166136261;
+    for (let i = 0; i < bytes.length; i++) {
+        hash ^= bytes[i];
+        hash = Math.imul(hash, 16777619) >>> 0;
+    }
+    return hash.toString(16).padStart(8, '0');
+}
+
+class Bench {
+    constructor(Module, opt) {
+        this.Module = Module;
+        this.opt = opt;
+        this.renderer = Module._renderer_create();
+        this.initialHeap = this.heapBytes();
+        this.peakHeap = this.initialHeap;
+        this.region = { ptr: 0, frames: 0 };
+    }
+
+    heapBytes() {
+        return this.Module.HEAPU8.buffer.byteLength;
+    }
+
+    notePeak() {
+        this.peakHeap = Math.max(this.peakHeap, this.heapBytes());
+    }
+
+    // index.html と同じく 8 バイトの opm_event_t の配列を wasm ヒープに書く
+    writeEvents(events) {
+        const Module = this.Module;
+        const ptr = Module._malloc(events.length * STRUCT_SIZE);
+        if (!ptr) throw new Error('out of wasm memory');
+        const view = new DataView(Module.HEAPU8.buffer);
+        events.forEach((e, i) => {
+            const base = ptr + i * STRUCT_SIZE;
+            view.setFloat32(base, e.time, true);
+            Module.HEAPU8[base + 4] = e.addr;
+            Module.HEAPU8[base + 5] = e.data;
+            Module.HEAPU8[base + 6] = 0;
+            Module.HEAPU8[base + 7] = 0;
+        });
+        return ptr;
+    }
+
+    ensureRegion(frames) {
+        const Module = this.Module;
+        if (frames > this.region.frames) {
+            if (this.region.ptr) Module._free(this.region.ptr);
+            this.region.ptr = Module._malloc(frames * 2 * 4);
+            this.region.frames = this.region.ptr ? frames : 0;
+            if (!this.region.ptr) throw new Error('out of wasm memory');
+        }
+        return { left: this.region.ptr, right: this.region.ptr + this.region.frames * 4 };
+    }
+
+    // 最も速い回の経過時間 (ms) と、最後の回の戻り値
+    best(fn) {
+        let bestMs = Infinity;
+        let result;
+        for (let rep = 0; rep < this.opt.repeat; rep++) {
+            const start = performance.now();
+            result = fn();
+            const elapsed = performance.now() - start;
+            if (elapsed < bestMs) bestMs = elapsed;
+            this.notePeak();
+        }
+        return { ms: bestMs, result: result };
+    }
+
+    runCase(kind, name, events, frames) {
+        const Module = this.Module;
+        const dataPtr = this.writeEvents(events);
+        try {
+            const render = this.best(() => Module._generate_sound(dataPtr, events.length, frames));
+            if (render.result !== frames) throw new Error(`${name}: generated ${render.result} of ${frames} frames`);
+
+            // _get_sample で1つずつ読む (checksum もここで作る)
+            const samples = new Float32Array(frames * 2);
+            const getSample = this.best(() => {
+                for (let i = 0; i < samples.length; i++) samples[i] = Module._get_sample(i);
+            });
+            const sum = checksum(new Uint8Array(samples.buffer));
+
+            // [L, R, ...] を HEAPF32 から分ける
+            Module._renderer_render(this.renderer, dataPtr, events.length, frames);
+            this.notePeak();
+            const left = new Float32Array(frames);
+            const right = new Float32Array(frames);
+            const deinterleave = this.best(() => {
+                const heap = Module.HEAPF32;
+                const base = Module._renderer_get_buffer(this.renderer) >> 2;
+                for (let i = 0; i < frames; i++) {
+                    left[i] = heap[base + i * 2];
+                    right[i] = heap[base + i * 2 + 1];
+                }
+            });
+
+            // プレーナーで書かせたものをコピーする
+            const out = this.ensureRegion(frames);
+            Module._renderer_render_to(this.renderer, dataPtr, events.length, frames,
+                                       SAMPLE_FLOAT32, out.left, out.right, 1);
+            this.notePeak();
+            const planar = this.best(() => {
+                const heap = Module.HEAPF32;
+                left.set(heap.subarray(out.left >> 2, (out.left >> 2) + frames));
+                right.set(heap.subarray(out.right >> 2, (out.right >> 2) + frames));
+            });
+
+            const audioSeconds = frames / OPM_SAMPLE_RATE;
+            return {
+                kind: kind,
+                name: name,
+                value: audioSeconds / (render.ms / 1000),
+                unit: 'x realtime',
+                seconds: render.ms / 1000,
+                audio_seconds: audioSeconds,
+                checksum: sum,
+                readback_ms: {
+                    get_sample: getSample.ms,
+                    deinterleave: deinterleave.ms,
+                    planar: planar.ms
+                }
+            };
+        } finally {
+            Module._free(dataPtr);
+        }
+    }
+}
+
+
+// ============================================================
+// 5. Main
+// ============================================================
+
+function writeJson(opt, bench, results) {
+    const report = {
+        benchmark: 'wasm-bench',
+        timestamp: Math.floor(Date.now() / 1000),
+        module: path.basename(opt.module),
+        node: process.version,
+        sample_rate: OPM_SAMPLE_RATE,
+        repeat: opt.repeat,
+        heap_bytes: { initial: bench.initialHeap, peak: bench.peakHeap },
+        results: results
+    };
+    const text = JSON.stringify(report, null, 2) + '\n';
+    if (opt.output === '-') {
+        process.stdout.write(text);
+    } else {
+        fs.writeFileSync(opt.output, text);
+    }
+}
+
+function printSummary(bench, results) {
+    for (const r of results) {
+        process.stderr.write(`${r.kind.padEnd(8)} ${r.name.padEnd(28)} ${r.value.toFixed(2).padStart(10)} ${r.unit}` +
+            `   readback ms: get_sample ${r.readback_ms.get_sample.toFixed(2)},` +
+            ` deinterleave ${r.readback_ms.deinterleave.toFixed(2)}, planar ${r.readback_ms.planar.toFixed(2)}\n`);
+    }
+    process.stderr.write(`wasm heap: ${bench.initialHeap} bytes initial, ${bench.peakHeap} bytes peak\n`);
+}
+
+async function main() {
+    let opt;
+    try {
+        opt = parseOptions(process.argv.slice(2));
+    } catch (e) {
+        process.stderr.write(`${e.message}\n`);
+        printUsage();
+        return 2;
+    }
+    if (!opt) return 0;
+
+    const Module = await loadModule(opt.module);
+    const bench = new Bench(Module, opt);
+    const results = [];
+
+    if (opt.input !== 'none') {
+        for (const preset of loadPresets(opt.input)) {
+            const frames = Math.floor(OPM_SAMPLE_RATE * eventsDuration(preset.events));
+            results.push(bench.runCase('preset', preset.name, preset.events, frames));
+        }
+    }
+    const frames = Math.floor(OPM_SAMPLE_RATE * opt.seconds);
+    for (const c of STRESS_CASES) {
+        results.push(bench.runCase('stress', c.name, buildStress(c.flags, opt.seconds), frames));
+    }
+
+    writeJson(opt, bench, results);
+    if (!opt.quiet) printSummary(bench, results);
+    return 0;
+}
+
+main().then(
+    (status) => process.exit(status),
+    (e) => {
+        process.stderr.write(`${e.stack || e}\n`);
+        process.exit(1);
+    });